@@ -0,0 +1,64 @@
+#include "../src/DkCore/DkBasicLoader.h"
+#include "DkBenchUtils.h"
+#include <QBuffer>
+#include <QFile>
+#include <QImageWriter>
+#include <QTemporaryDir>
+#include <benchmark/benchmark.h>
+
+/**
+ * Writes the synthetic image to a temporary file with the given format.
+ * Returns an empty string if the format is not supported.
+ */
+static QString encodedFile(int megaPixels, const QByteArray &format) {
+  static QTemporaryDir dir;
+  QString filePath = dir.filePath(
+      QString("synthetic-%1mp.%2").arg(megaPixels).arg(QString(format)));
+
+  if (QFile::exists(filePath))
+    return filePath;
+
+  QImageWriter writer(filePath, format);
+  if (!writer.canWrite() ||
+      !writer.write(nmc::bench::syntheticImage(megaPixels))) {
+    QFile::remove(filePath);
+    return QString();
+  }
+
+  return filePath;
+}
+
+static void BM_LoadGeneral(benchmark::State &state, const QByteArray &format) {
+  QString filePath = encodedFile(state.range(0), format);
+  if (filePath.isEmpty()) {
+    state.SkipWithError("format not supported for this size");
+    return;
+  }
+
+  // we measure decoding - the file is read once
+  QFile file(filePath);
+  file.open(QIODevice::ReadOnly);
+  QSharedPointer<QByteArray> ba(new QByteArray(file.readAll()));
+
+  QSize size;
+  for (auto _ : state) {
+    nmc::DkBasicLoader loader;
+    if (!loader.loadGeneral(filePath, ba)) {
+      state.SkipWithError("could not load image");
+      break;
+    }
+    size = loader.image().size();
+  }
+
+  state.SetItemsProcessed(state.iterations() * (int64_t)size.width() *
+                          size.height());
+  state.SetBytesProcessed(state.iterations() * ba->size());
+}
+BENCHMARK_CAPTURE(BM_LoadGeneral, jpg, QByteArray("jpg"))
+    ->Apply(nmc::bench::megaPixelArgs);
+BENCHMARK_CAPTURE(BM_LoadGeneral, png, QByteArray("png"))
+    ->Apply(nmc::bench::megaPixelArgs);
+BENCHMARK_CAPTURE(BM_LoadGeneral, tif, QByteArray("tif"))
+    ->Apply(nmc::bench::megaPixelArgs);
+BENCHMARK_CAPTURE(BM_LoadGeneral, webp, QByteArray("webp"))
+    ->Apply(nmc::bench::megaPixelArgs);
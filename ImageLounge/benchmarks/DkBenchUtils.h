@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QImage>
+#include <QtMath>
+#include <benchmark/benchmark.h>
+
+namespace nmc {
+namespace bench {
+
+/**
+ * Registers the synthetic input sizes (in mega pixels).
+ */
+inline void megaPixelArgs(benchmark::internal::Benchmark *b) {
+  b->ArgName("MP")->Arg(1)->Arg(12)->Arg(50)->Arg(200)->Unit(
+      benchmark::kMillisecond);
+}
+
+/**
+ * Returns the size of a 3:2 image with the given number of mega pixels.
+ */
+inline QSize syntheticSize(int megaPixels) {
+  int h = qRound(qSqrt(megaPixels * 1e6 / 1.5));
+  return QSize(qRound(h * 1.5), h);
+}
+
+/**
+ * Creates a deterministic photo-like test image (smooth gradients + texture).
+ * The last image is cached since generating 200 MP takes a while.
+ */
+inline QImage syntheticImage(int megaPixels,
+                             QImage::Format format = QImage::Format_ARGB32) {
+  static QImage cached;
+  QSize s = syntheticSize(megaPixels);
+
+  if (cached.size() == s && cached.format() == format)
+    return cached;
+
+  cached = QImage(); // free the old one first
+  QImage img(s, QImage::Format_ARGB32);
+  quint32 seed = 42;
+
+  for (int y = 0; y < img.height(); y++) {
+    QRgb *px = reinterpret_cast<QRgb *>(img.scanLine(y));
+
+    for (int x = 0; x < img.width(); x++) {
+      // xorshift noise so that encoders don't compress it away
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+      int n = (seed & 31) - 16;
+
+      int r = qBound(0, x * 255 / img.width() + n, 255);
+      int g = qBound(0, y * 255 / img.height() + n, 255);
+      int b = qBound(0, ((x / 64 + y / 64) % 2) * 128 + 64 + n, 255);
+      px[x] = qRgb(r, g, b);
+    }
+  }
+
+  cached = (format == img.format()) ? img : img.convertToFormat(format);
+  return cached;
+}
+
+inline void setPixelsProcessed(benchmark::State &state, const QImage &img) {
+  state.SetItemsProcessed(state.iterations() * (int64_t)img.width() *
+                          img.height());
+}
+
+} // namespace bench
+} // namespace nmc
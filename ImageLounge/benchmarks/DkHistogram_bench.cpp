@@ -0,0 +1,17 @@
+#include "../src/DkGui/DkWidgets.h"
+#include "DkBenchUtils.h"
+#include <benchmark/benchmark.h>
+
+static void BM_DrawHistogram(benchmark::State &state) {
+  QImage img = nmc::bench::syntheticImage(state.range(0));
+
+  // drawHistogram() returns early if the histogram is not visible
+  nmc::DkHistogram hist(nullptr);
+  hist.show();
+
+  for (auto _ : state) {
+    hist.drawHistogram(img);
+  }
+  nmc::bench::setPixelsProcessed(state, img);
+}
+BENCHMARK(BM_DrawHistogram)->Apply(nmc::bench::megaPixelArgs);
@@ -1,4 +1,5 @@
 #include "../src/DkCore/DkImageStorage.h"
+#include "DkBenchUtils.h"
 #include <benchmark/benchmark.h>
 
 const int ROTATE_ANGLE = 0;
@@ -22,4 +23,80 @@ static void BM_RotateImage(benchmark::State &state) {
 }
 BENCHMARK(BM_RotateImage);
 
-BENCHMARK_MAIN();
+static void BM_ScaleToSize(benchmark::State &state) {
+  QImage img = nmc::bench::syntheticImage(state.range(0));
+  QImage res{};
+  for (auto _ : state) {
+    // full HD screen
+    res = nmc::imageStorageScaleToSize(
+        img, img.size().scaled(1920, 1080, Qt::KeepAspectRatio));
+  }
+  nmc::bench::setPixelsProcessed(state, img);
+}
+BENCHMARK(BM_ScaleToSize)->Apply(nmc::bench::megaPixelArgs);
+
+static void BM_BuildPyramid(benchmark::State &state) {
+  QImage img = nmc::bench::syntheticImage(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(nmc::imageStorageBuildPyramid(img, 2048));
+  }
+  nmc::bench::setPixelsProcessed(state, img);
+}
+BENCHMARK(BM_BuildPyramid)->Apply(nmc::bench::megaPixelArgs);
+
+static void BM_CreateThumb(benchmark::State &state) {
+  QImage img = nmc::bench::syntheticImage(state.range(0));
+  QImage res{};
+  for (auto _ : state) {
+    res = nmc::DkImage::createThumb(img);
+  }
+  nmc::bench::setPixelsProcessed(state, img);
+}
+BENCHMARK(BM_CreateThumb)->Apply(nmc::bench::megaPixelArgs);
+
+static void BM_HueSaturation(benchmark::State &state) {
+  QImage img = nmc::bench::syntheticImage(state.range(0));
+  QImage res{};
+  for (auto _ : state) {
+    res = nmc::DkImage::hueSaturation(img, 20, 30, 10);
+  }
+  nmc::bench::setPixelsProcessed(state, img);
+}
+BENCHMARK(BM_HueSaturation)->Apply(nmc::bench::megaPixelArgs);
+
+static void BM_Exposure(benchmark::State &state) {
+  QImage img = nmc::bench::syntheticImage(state.range(0));
+  QImage res{};
+  for (auto _ : state) {
+    res = nmc::DkImage::exposure(img, 0.5, 0.01, 1.2);
+  }
+  nmc::bench::setPixelsProcessed(state, img);
+}
+BENCHMARK(BM_Exposure)->Apply(nmc::bench::megaPixelArgs);
+
+static void BM_AutoAdjustImage(benchmark::State &state) {
+  QImage src = nmc::bench::syntheticImage(state.range(0));
+  for (auto _ : state) {
+    // autoAdjustImage works in place
+    state.PauseTiming();
+    QImage img = src.copy();
+    state.ResumeTiming();
+
+    nmc::DkImage::autoAdjustImage(img);
+  }
+  nmc::bench::setPixelsProcessed(state, src);
+}
+BENCHMARK(BM_AutoAdjustImage)->Apply(nmc::bench::megaPixelArgs);
+
+static void BM_UnsharpMask(benchmark::State &state) {
+  QImage src = nmc::bench::syntheticImage(state.range(0));
+  for (auto _ : state) {
+    state.PauseTiming();
+    QImage img = src.copy();
+    state.ResumeTiming();
+
+    nmc::DkImage::unsharpMask(img, 20.0f, 1.5f);
+  }
+  nmc::bench::setPixelsProcessed(state, src);
+}
+BENCHMARK(BM_UnsharpMask)->Apply(nmc::bench::megaPixelArgs);
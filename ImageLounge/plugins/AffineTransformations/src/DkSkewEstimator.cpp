@@ -29,11 +29,65 @@
 #include "DkImageStorage.h"
 
 #include <QDebug>
+#include <QEventLoop>
+#include <QFutureWatcher>
 #include <QRandomGenerator>
+#include <QTimer>
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
+
+#include <atomic>
 
 namespace nmp
 {
 
+// progress of both directions, they are computed concurrently
+struct DkSkewProgress {
+    std::atomic<int> value[DkSkewEstimator::dir_end] = {{0}, {0}}; // 0 - 50 per direction
+    std::atomic<bool> canceled{false};
+};
+
+// box with rows [y0 y1] and columns [c + x0, c + x1] in an integral image
+struct DkSepBox {
+    int y0;
+    int y1;
+    int x0;
+    int x1;
+};
+
+/**
+ * Computes the separability of two boxes for a row.
+ * All reads are contiguous rows of the integral images -> the loop is vectorized.
+ **/
+static void separabilityRow(const cv::Mat &integral,
+                            const cv::Mat &integralSq,
+                            const DkSepBox &b1,
+                            const DkSepBox &b2,
+                            int cStart,
+                            int cEnd,
+                            double norm,
+                            float *dst)
+{
+    const double *i10 = integral.ptr<double>(b1.y0);
+    const double *i11 = integral.ptr<double>(b1.y1);
+    const double *i20 = integral.ptr<double>(b2.y0);
+    const double *i21 = integral.ptr<double>(b2.y1);
+    const double *s10 = integralSq.ptr<double>(b1.y0);
+    const double *s11 = integralSq.ptr<double>(b1.y1);
+    const double *s20 = integralSq.ptr<double>(b2.y0);
+    const double *s21 = integralSq.ptr<double>(b2.y1);
+
+    for (int c = cStart; c < cEnd; c++) {
+        double mean1 = (i10[c + b1.x0] + i11[c + b1.x1] - i10[c + b1.x1] - i11[c + b1.x0]) * norm;
+        double mean2 = (i20[c + b2.x0] + i21[c + b2.x1] - i20[c + b2.x1] - i21[c + b2.x0]) * norm;
+
+        double var1 = (s10[c + b1.x0] + s11[c + b1.x1] - s10[c + b1.x1] - s11[c + b1.x0]) * norm - mean1 * mean1;
+        double var2 = (s20[c + b2.x0] + s21[c + b2.x1] - s20[c + b2.x1] - s21[c + b2.x0]) * norm - mean2 * mean2;
+
+        dst[c] = (float)((mean1 - mean2) * (mean1 - mean2) / (var1 + var2));
+    }
+}
+
 DkSkewEstimator::DkSkewEstimator(QWidget *mainWin)
 {
     this->mainWin = mainWin;
@@ -47,7 +101,11 @@ DkSkewEstimator::DkSkewEstimator(QWidget *mainWin)
     delta = 0; // based on image size
     minLineLength = 10;
     minLineProjLength = minLineLength / 4;
+    maxSide = 2000;
     rotationFactor = 1;
+    imgCacheKey = 0;
+    scaleFactor = 1.0;
+    progress = 0;
 
     selectedLines.clear();
 }
@@ -58,18 +116,44 @@ DkSkewEstimator::~DkSkewEstimator()
 
 void DkSkewEstimator::setImage(QImage inImage)
 {
+    // the integral images are re-used if the same image is estimated again
+    if (inImage.cacheKey() == imgCacheKey && !matImg.empty())
+        return;
+
+    imgCacheKey = inImage.cacheKey();
+    integral.release();
+    integralSq.release();
+    fullImg.release();
+
     matImg = nmc::DkImage::qImage2Mat(inImage);
 
-    sepDims = QSize(qRound(inImage.width() / 1430.0 * 49.0), qRound(inImage.height() / 700.0 * 12.0));
-    delta = qRound(inImage.width() / 1430.0 * 20.0);
-    minLineLength = qRound(inImage.width() / 1430.0 * 20.0);
+    if (matImg.channels() > 1)
+        cv::cvtColor(matImg, matImg, CV_BGR2GRAY);
+
+    // coarse estimate: large scans are downsampled - the parameters below scale with the image size
+    // the selected lines are refined on the full resolution image (see refineLine)
+    int maxImgSide = qMax(matImg.rows, matImg.cols);
+    if (maxImgSide > maxSide) {
+        double s = maxSide / (double)maxImgSide;
+        fullImg = matImg;
+        cv::resize(fullImg, matImg, cv::Size(), s, s, cv::INTER_AREA);
+    }
+
+    scaleFactor = matImg.cols / (double)inImage.width();
+
+    int width = matImg.cols;
+    int height = matImg.rows;
+
+    sepDims = QSize(qRound(width / 1430.0 * 49.0), qRound(height / 700.0 * 12.0));
+    delta = qRound(width / 1430.0 * 20.0);
+    minLineLength = qRound(width / 1430.0 * 20.0);
     rotationFactor = 1;
 
-    if (inImage.width() < inImage.height()) {
+    if (width < height) {
         matImg = matImg.t();
-        sepDims = QSize(qRound(inImage.width() / 1430.0 * 49.0), qRound(inImage.height() / 700.0 * 12.0));
-        delta = qRound(inImage.height() / 1430.0 * 20.0);
-        minLineLength = qRound(inImage.height() / 1430.0 * 20.0);
+        sepDims = QSize(qRound(width / 1430.0 * 49.0), qRound(height / 700.0 * 12.0));
+        delta = qRound(height / 1430.0 * 20.0);
+        minLineLength = qRound(height / 1430.0 * 20.0);
         rotationFactor = -1;
     }
 
@@ -97,62 +181,79 @@ double DkSkewEstimator::getSkewAngle()
         progress->hide();
         progress->show();
 
-        cv::Mat matGray;
+        if (integral.empty())
+            cv::integral(matImg, integral, integralSq, CV_64F);
 
-        if (matImg.channels() > 1)
-            cv::cvtColor(matImg, matGray, CV_BGR2GRAY);
-        else
-            matGray = matImg;
+        // the horizontal and vertical passes are independent
+        DkSkewProgress p;
+        DkSkewLines hor, ver;
 
-        cv::Mat integral, integralSq;
-        cv::integral(matGray, integral, integralSq, CV_64F);
-        if (integral.channels() > 1)
-            qDebug() << "Error! integral image has more than one channel";
+        QFuture<void> future = QtConcurrent::run([&] {
+            QFuture<DkSkewLines> verFuture = QtConcurrent::run([&] {
+                return estimateLines(dir_vertical, p);
+            });
+            hor = estimateLines(dir_horizontal, p);
+            ver = verFuture.result();
+        });
 
-        cv::Mat separabilityHor = computeSeparability(integral, integralSq, dir_horizontal);
-        if (progress->wasCanceled()) {
-            progress->deleteLater();
-            return 0;
-        }
+        QEventLoop loop;
+        QTimer timer;
+        QFutureWatcher<void> watcher;
 
-        cv::Mat separabilityVer = computeSeparability(integral, integralSq, dir_vertical);
-        if (progress->wasCanceled()) {
-            progress->deleteLater();
-            return 0;
-        }
+        QObject::connect(&watcher, &QFutureWatcher<void>::finished, &loop, &QEventLoop::quit);
+        QObject::connect(&timer, &QTimer::timeout, [&] {
+            progress->setValue(p.value[dir_horizontal] + p.value[dir_vertical]);
+            if (progress->wasCanceled())
+                p.canceled = true;
+        });
 
-        double min, max;
-        cv::minMaxLoc(separabilityHor, &min, &max);
-        cv::Mat edgeMapHor = computeEdgeMap(separabilityHor, sepThr * max, dir_horizontal);
-        // cv::Mat edgeMapHor = computeEdgeMap(separabilityHor, 0.1, dir_horizontal);
-        if (progress->wasCanceled()) {
-            progress->deleteLater();
-            return 0;
-        }
+        watcher.setFuture(future);
+        timer.start(50);
 
-        cv::minMaxLoc(separabilityVer, &min, &max);
-        cv::Mat edgeMapVer = computeEdgeMap(separabilityVer, sepThr * max, dir_vertical);
-        // cv::Mat edgeMapVer = computeEdgeMap(separabilityVer, 0.1, dir_vertical);
-        if (progress->wasCanceled()) {
-            progress->deleteLater();
-            return 0;
-        }
+        if (!future.isFinished())
+            loop.exec();
+
+        future.waitForFinished();
 
         selectedLines.clear();
+        selectedLineTypes.clear();
 
-        QVector<QVector3D> weightsHor = computeWeights(edgeMapHor, dir_horizontal);
-        qDebug() << weightsHor.size();
-        QVector<QVector3D> weightsVer = computeWeights(edgeMapVer, dir_vertical);
-        qDebug() << weightsVer.size();
-        if (progress->wasCanceled()) {
-            selectedLines.clear();
+        if (p.canceled || progress->wasCanceled()) {
             progress->deleteLater();
             return 0;
         }
 
-        weightsHor += weightsVer;
+        qDebug() << hor.weights.size();
+        qDebug() << ver.weights.size();
+
+        QVector<QVector3D> weights = hor.weights + ver.weights;
+        QVector<QVector4D> lines = hor.lines + ver.lines;
+        selectedLineTypes.fill(0, lines.size());
+
+        double diag = qSqrt(matImg.rows * matImg.rows + matImg.cols * matImg.cols);
+        double retAngle = computeSkewAngle(weights, diag);
+
+        // the candidate angle is refined with the full resolution lines
+        if (!fullImg.empty()) {
+            for (int i = 0; i < lines.size(); i++) {
+                double angle;
+                int direction = i < hor.lines.size() ? dir_horizontal : dir_vertical;
+
+                if (selectedLineTypes[i] && refineLine(lines[i], angle, direction))
+                    weights[i].setY((float)angle);
+            }
+
+            selectedLineTypes.fill(0);
+            retAngle = computeSkewAngle(weights, diag);
+        }
 
-        double retAngle = computeSkewAngle(weightsHor, qSqrt(matGray.rows * matGray.rows + matGray.cols * matGray.cols));
+        // lines are drawn in image coordinates
+        for (const QVector4D &l : lines) {
+            if (rotationFactor == -1)
+                selectedLines.append(QVector4D(l.y(), l.x(), l.w(), l.z()) / (float)scaleFactor);
+            else
+                selectedLines.append(l / (float)scaleFactor);
+        }
 
         progress->setValue(100);
         progress->deleteLater();
@@ -162,73 +263,61 @@ double DkSkewEstimator::getSkewAngle()
         return 0;
 }
 
-cv::Mat DkSkewEstimator::computeSeparability(cv::Mat integral, cv::Mat integralSq, int direction)
+DkSkewEstimator::DkSkewLines DkSkewEstimator::estimateLines(int direction, DkSkewProgress &p) const
+{
+    cv::Mat separability = computeSeparability(integral, integralSq, direction, p);
+    if (p.canceled)
+        return DkSkewLines();
+
+    double min, max;
+    cv::minMaxLoc(separability, &min, &max);
+    cv::Mat edgeMap = computeEdgeMap(separability, sepThr * max, direction, p);
+    if (p.canceled)
+        return DkSkewLines();
+
+    return computeWeights(edgeMap, direction, p);
+}
+
+cv::Mat DkSkewEstimator::computeSeparability(const cv::Mat &integral, const cv::Mat &integralSq, int direction, DkSkewProgress &p) const
 {
     cv::Mat separability = cv::Mat::zeros(integral.rows, integral.cols, CV_32FC1);
 
     int W2 = qCeil(sepDims.width() / 2);
     int H2 = qCeil(sepDims.height() / 2);
 
-    if (direction == dir_horizontal) {
-        int progressStep = integral.rows - 2 * H2 - 2 * qCeil(delta / 2);
-        int lastValue = progress->value();
+    // horizontal edges separate the boxes above & below a pixel, vertical edges the boxes left & right
+    int rBorder = (direction == dir_horizontal ? H2 : W2) + qCeil(delta / 2);
+    int cBorder = (direction == dir_horizontal ? W2 : H2) + qCeil(delta / 2);
+    int numRows = integral.rows - 2 * rBorder;
+    double norm = 1.0 / (2 * W2 * H2);
 
-        for (int r = H2 + qCeil(delta / 2); r < integral.rows - H2 - qCeil(delta / 2); r++) {
-            progress->setValue(lastValue + qRound(30.0 * (r - H2 - qCeil(delta / 2)) / (double)progressStep));
-            if (progress->wasCanceled())
-                break;
-            for (int c = W2 + qCeil(delta / 2); c < integral.cols - W2 - qCeil(delta / 2); c++) {
-                double mean1 = integral.at<double>(r - H2, c - W2) + integral.at<double>(r - 1, c + W2) - integral.at<double>(r - H2, c + W2)
-                    - integral.at<double>(r - 1, c - W2);
-                double mean2 = integral.at<double>(r + 1, c - W2) + integral.at<double>(r + H2, c + W2) - integral.at<double>(r + 1, c + W2)
-                    - integral.at<double>(r + H2, c - W2);
-                mean1 /= (2 * W2 * H2);
-                mean2 /= (2 * W2 * H2);
-
-                double var1 = integralSq.at<double>(r - H2, c - W2) + integralSq.at<double>(r - 1, c + W2) - integralSq.at<double>(r - H2, c + W2)
-                    - integralSq.at<double>(r - 1, c - W2);
-                double var2 = integralSq.at<double>(r + 1, c - W2) + integralSq.at<double>(r + H2, c + W2) - integralSq.at<double>(r + 1, c + W2)
-                    - integralSq.at<double>(r + H2, c - W2);
-                var1 /= (2 * W2 * H2);
-                var2 /= (2 * W2 * H2);
-
-                var1 = var1 - (mean1 * mean1);
-                var2 = var2 - (mean2 * mean2);
-
-                separability.at<float>(r, c) = (float)((mean1 - mean2) * (mean1 - mean2) / (var1 + var2));
-            }
-        }
-    } else {
-        int progressStep = integral.rows - 2 * W2 - 2 * qCeil(delta / 2);
-        int lastValue = progress->value();
+    const int chunkSize = 32;
+    QVector<int> chunks;
+    for (int r = rBorder; r < integral.rows - rBorder; r += chunkSize)
+        chunks << r;
 
-        for (int r = W2 + qCeil(delta / 2); r < integral.rows - W2 - qCeil(delta / 2); r++) {
-            progress->setValue(lastValue + qRound(30.0 * (r - W2 - qCeil(delta / 2)) / (double)progressStep));
-            if (progress->wasCanceled())
-                break;
+    std::atomic<int> numDone(0);
+
+    QtConcurrent::blockingMap(chunks, [&](int rStart) {
+        int rEnd = qMin(rStart + chunkSize, integral.rows - rBorder);
+
+        for (int r = rStart; r < rEnd && !p.canceled; r++) {
+            DkSepBox b1, b2;
 
-            for (int c = H2 + qCeil(delta / 2); c < integral.cols - H2 - qCeil(delta / 2); c++) {
-                double mean1 = integral.at<double>(r - W2, c - H2) + integral.at<double>(r + W2, c - 1) - integral.at<double>(r + W2, c - H2)
-                    - integral.at<double>(r - W2, c - 1);
-                double mean2 = integral.at<double>(r - W2, c + 1) + integral.at<double>(r + W2, c + H2) - integral.at<double>(r + W2, c + 1)
-                    - integral.at<double>(r - W2, c + H2);
-                mean1 /= (2 * W2 * H2);
-                mean2 /= (2 * W2 * H2);
-
-                double var1 = integralSq.at<double>(r - W2, c - H2) + integralSq.at<double>(r + W2, c - 1) - integralSq.at<double>(r + W2, c - H2)
-                    - integralSq.at<double>(r - W2, c - 1);
-                double var2 = integralSq.at<double>(r - W2, c + 1) + integralSq.at<double>(r + W2, c + H2) - integralSq.at<double>(r + W2, c + 1)
-                    - integralSq.at<double>(r - W2, c + H2);
-                var1 /= (2 * W2 * H2);
-                var2 /= (2 * W2 * H2);
-
-                var1 = var1 - (mean1 * mean1);
-                var2 = var2 - (mean2 * mean2);
-
-                separability.at<float>(r, c) = (float)((mean1 - mean2) * (mean1 - mean2) / (var1 + var2));
+            if (direction == dir_horizontal) {
+                b1 = {r - H2, r - 1, -W2, W2};
+                b2 = {r + 1, r + H2, -W2, W2};
+            } else {
+                b1 = {r - W2, r + W2, -H2, -1};
+                b2 = {r - W2, r + W2, 1, H2};
             }
+
+            separabilityRow(integral, integralSq, b1, b2, cBorder, integral.cols - cBorder, norm, separability.ptr<float>(r));
         }
-    }
+
+        int done = numDone += rEnd - rStart;
+        p.value[direction] = qRound(30.0 * done / numRows);
+    });
 
     // for displaying:
     // cv::normalize(separability, separability, 0, 255, NORM_MINMAX, CV_8UC1);
@@ -237,7 +326,7 @@ cv::Mat DkSkewEstimator::computeSeparability(cv::Mat integral, cv::Mat integralS
     return separability;
 }
 
-cv::Mat DkSkewEstimator::computeEdgeMap(cv::Mat separability, double thr, int direction)
+cv::Mat DkSkewEstimator::computeEdgeMap(const cv::Mat &separability, double thr, int direction, DkSkewProgress &prog) const
 {
     int tmpStatus;
 
@@ -248,12 +337,11 @@ cv::Mat DkSkewEstimator::computeEdgeMap(cv::Mat separability, double thr, int di
 
     if (direction == dir_horizontal) {
         int progressStep = separability.rows - 2 * H2 - 2 * kMax;
-        int lastValue = progress->value();
 
-        float *p;
+        const float *p;
         for (int r = H2 + kMax; r < separability.rows - H2 - kMax; r++) {
-            progress->setValue(lastValue + qRound(5.0 * (r - H2 - kMax) / (double)progressStep));
-            if (progress->wasCanceled())
+            prog.value[direction] = 30 + qRound(5.0 * (r - H2 - kMax) / (double)progressStep);
+            if (prog.canceled)
                 break;
 
             p = separability.ptr<float>(r);
@@ -263,7 +351,7 @@ cv::Mat DkSkewEstimator::computeEdgeMap(cv::Mat separability, double thr, int di
                     for (int k = -kMax; k <= kMax; k++) {
                         if (k == 0)
                             k++;
-                        float *pK;
+                        const float *pK;
                         pK = separability.ptr<float>(r + k);
                         if (pK[c] > p[c]) {
                             tmpStatus = 0;
@@ -281,12 +369,11 @@ cv::Mat DkSkewEstimator::computeEdgeMap(cv::Mat separability, double thr, int di
         }
     } else {
         int progressStep = separability.rows - 2 * W2 - 2 * kMax;
-        int lastValue = progress->value();
 
-        float *p;
+        const float *p;
         for (int r = W2; r < separability.rows - W2; r++) {
-            progress->setValue(lastValue + qRound(5.0 * (r - W2 - kMax) / (double)progressStep));
-            if (progress->wasCanceled())
+            prog.value[direction] = 30 + qRound(5.0 * (r - W2 - kMax) / (double)progressStep);
+            if (prog.canceled)
                 break;
 
             p = separability.ptr<float>(r);
@@ -320,18 +407,20 @@ int DkSkewEstimator::randInt(int low, int high)
     return QRandomGenerator::global()->bounded(low, high);
 }
 
-QVector<QVector3D> DkSkewEstimator::computeWeights(cv::Mat edgeMap, int direction)
+DkSkewEstimator::DkSkewLines DkSkewEstimator::computeWeights(const cv::Mat &edgeMap, int direction, DkSkewProgress &p) const
 {
     std::vector<cv::Vec4i> lines;
     QVector4D maxLine = QVector4D();
-    HoughLinesP(edgeMap, lines, 1, CV_PI / 180, 50, minLineLength, 20); // params: rho resolution, theta resolution, threshold, min Line length, max line gap
+    // threshold and gap are defined for full resolution images
+    int houghThr = qMax(1, qRound(50 * scaleFactor));
+    int houghGap = qMax(1, qRound(20 * scaleFactor));
+    HoughLinesP(edgeMap, lines, 1, CV_PI / 180, houghThr, minLineLength, houghGap); // params: rho resolution, theta resolution, threshold, min Line length, max line gap
 
-    QVector<QVector3D> computedWeights = QVector<QVector3D>();
-    int lastValue = progress->value();
+    DkSkewLines computedLines;
 
     for (size_t i = 0; i < lines.size(); i++) {
-        progress->setValue(lastValue + qRound(15.0 * (float)i / lines.size()));
-        if (progress->wasCanceled())
+        p.value[direction] = 35 + qRound(15.0 * (float)i / lines.size());
+        if (p.canceled)
             break;
 
         cv::Vec4i l = lines[i];
@@ -471,14 +560,140 @@ QVector<QVector3D> DkSkewEstimator::computeWeights(cv::Mat edgeMap, int directio
         }
 
         if (currMax.x() > 0) {
-            computedWeights.append(currMax);
-            if (rotationFactor == -1)
-                maxLine = QVector4D(maxLine.y(), maxLine.x(), maxLine.w(), maxLine.z());
-            selectedLines.append(maxLine);
-            selectedLineTypes.append(0);
+            computedLines.weights.append(currMax);
+            computedLines.lines.append(maxLine);
+        }
+    }
+
+    p.value[direction] = 50;
+
+    return computedLines;
+}
+
+/**
+ * Refines a line of the downsampled image on the full resolution image.
+ * Only a narrow band around the line is scanned: for each position along the line the edge
+ * is located at the maximal separability and a line is fitted to these edge points.
+ * @param line the line in (downsampled) matImg coordinates, it is updated if refined
+ * @param angle the refined angle (same convention as the line weights)
+ * @param direction the edge direction of the line
+ * @return bool true if the line could be refined
+ **/
+bool DkSkewEstimator::refineLine(QVector4D &line, double &angle, int direction) const
+{
+    // along (x) and across (y) coordinates of the end points at full resolution
+    QPointF p1, p2;
+    if (direction == dir_horizontal) {
+        p1 = QPointF(line.x(), line.y());
+        p2 = QPointF(line.z(), line.w());
+    } else {
+        p1 = QPointF(line.y(), line.x());
+        p2 = QPointF(line.w(), line.z());
+    }
+    p1 /= scaleFactor;
+    p2 /= scaleFactor;
+
+    if (p2.x() < p1.x())
+        std::swap(p1, p2);
+
+    // fullImg is not transposed - matImg is if rotationFactor == -1
+    bool transposed = rotationFactor == -1;
+    int cols = transposed ? fullImg.rows : fullImg.cols;
+    int rows = transposed ? fullImg.cols : fullImg.rows;
+    int alongLength = direction == dir_horizontal ? cols : rows;
+    int acrossLength = direction == dir_horizontal ? rows : cols;
+
+    int W2 = qMax(1, qRound(sepDims.width() / scaleFactor) / 2);
+    int H2 = qMax(1, qRound(sepDims.height() / scaleFactor) / 2);
+    int margin = qCeil(epsilon / scaleFactor); // the coarse line is accurate to epsilon pixels
+
+    int a0 = qMax(0, qFloor(p1.x()) - W2);
+    int a1 = qMin(alongLength, qCeil(p2.x()) + W2 + 1);
+    int b0 = qMax(0, qFloor(qMin(p1.y(), p2.y())) - margin - H2 - 1);
+    int b1 = qMin(acrossLength, qCeil(qMax(p1.y(), p2.y())) + margin + H2 + 2);
+
+    if (a1 - a0 <= 2 * W2 + 1 || b1 - b0 <= 2 * H2 + 1)
+        return false;
+
+    // the band is cut such that its rows are across and its columns along the line
+    cv::Rect roi = direction == dir_horizontal ? cv::Rect(a0, b0, a1 - a0, b1 - b0) : cv::Rect(b0, a0, b1 - b0, a1 - a0);
+    if (transposed)
+        roi = cv::Rect(roi.y, roi.x, roi.height, roi.width);
+
+    cv::Mat band = fullImg(roi);
+    if ((direction == dir_vertical) != transposed)
+        band = band.t();
+
+    cv::Mat bandIntegral, bandIntegralSq;
+    cv::integral(band, bandIntegral, bandIntegralSq, CV_64F);
+
+    cv::Mat separability = cv::Mat::zeros(bandIntegral.rows, bandIntegral.cols, CV_32FC1);
+    double norm = 1.0 / (2 * W2 * H2);
+
+    for (int r = H2; r < bandIntegral.rows - H2; r++) {
+        DkSepBox bb1 = {r - H2, r - 1, -W2, W2};
+        DkSepBox bb2 = {r + 1, r + H2, -W2, W2};
+        separabilityRow(bandIntegral, bandIntegralSq, bb1, bb2, W2, bandIntegral.cols - W2, norm, separability.ptr<float>(r));
+    }
+
+    double min, max;
+    cv::minMaxLoc(separability, &min, &max);
+    double thr = sepThr * max;
+
+    double slope = (p2.y() - p1.y()) / qMax(p2.x() - p1.x(), 1.0);
+
+    // edge points: the maximal separability next to the coarse line
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int n = 0;
+
+    for (int c = qMax(W2, qFloor(p1.x()) - a0); c < qMin(bandIntegral.cols - W2, qCeil(p2.x()) - a0 + 1); c++) {
+        int yc = qRound(p1.y() - b0 + (c + a0 - p1.x()) * slope);
+        int bestR = -1;
+        float bestVal = (float)thr;
+
+        for (int r = qMax(H2, yc - margin); r <= qMin(bandIntegral.rows - H2 - 1, yc + margin); r++) {
+            float v = separability.at<float>(r, c);
+            if (v > bestVal) {
+                bestVal = v;
+                bestR = r;
+            }
         }
+
+        if (bestR == -1)
+            continue;
+
+        sx += c;
+        sy += bestR;
+        sxx += (double)c * c;
+        sxy += (double)c * bestR;
+        n++;
     }
-    return computedWeights;
+
+    // we need edge points along (at least) half of the line
+    if (n < 2 || n < (p2.x() - p1.x()) * 0.5)
+        return false;
+
+    double den = n * sxx - sx * sx;
+    if (den == 0)
+        return false;
+
+    double b = (n * sxy - sx * sy) / den;
+    double a = (sy - b * sx) / n;
+    double lineAngle = qAtan(b);
+
+    angle = direction == dir_horizontal ? -rotationFactor * lineAngle : rotationFactor * lineAngle;
+
+    // refined end points in matImg coordinates
+    double y1 = a + b * (p1.x() - a0) + b0;
+    double y2 = a + b * (p2.x() - a0) + b0;
+
+    if (direction == dir_horizontal)
+        line = QVector4D((float)p1.x(), (float)y1, (float)p2.x(), (float)y2);
+    else
+        line = QVector4D((float)y1, (float)p1.x(), (float)y2, (float)p2.x());
+    line *= (float)scaleFactor;
+
+    return true;
 }
 
 double DkSkewEstimator::computeSkewAngle(QVector<QVector3D> weights, double imgDiagonal)
@@ -503,9 +718,7 @@ double DkSkewEstimator::computeSkewAngle(QVector<QVector3D> weights, double imgD
             // weights.at(i).z() / imgDiagonal));
         }
 
-    QVector<QPointF> saliencyVec = QVector<QPointF>();
-
-    for (double skewAngle = -30; skewAngle <= 30.001; skewAngle += 0.1) {
+    auto computeSaliency = [&](double skewAngle) {
         double saliency = 0;
 
         for (int i = 0; i < thrWeights.size(); i++) {
@@ -513,8 +726,13 @@ double DkSkewEstimator::computeSkewAngle(QVector<QVector3D> weights, double imgD
                 * qExp(-0.5 * ((skewAngle - thrWeights.at(i).y()) * (skewAngle - thrWeights.at(i).y())) / (sigma * sigma));
         }
 
-        saliencyVec.append(QPointF(skewAngle, saliency));
-    }
+        return saliency;
+    };
+
+    QVector<QPointF> saliencyVec = QVector<QPointF>();
+
+    for (double skewAngle = -30; skewAngle <= 30.001; skewAngle += 0.1)
+        saliencyVec.append(QPointF(skewAngle, computeSaliency(skewAngle)));
 
     // for (int i = 0; i < saliencyVec.size(); i++) qDebug() << saliencyVec.at(i);
 
@@ -528,6 +746,17 @@ double DkSkewEstimator::computeSkewAngle(QVector<QVector3D> weights, double imgD
         }
     }
 
+    // refine around the candidate angle
+    double coarseAngle = salSkewAngle;
+    for (double skewAngle = coarseAngle - 0.1; skewAngle <= coarseAngle + 0.1001; skewAngle += 0.01) {
+        double saliency = computeSaliency(skewAngle);
+
+        if (maxSaliency < saliency) {
+            maxSaliency = saliency;
+            salSkewAngle = skewAngle;
+        }
+    }
+
     for (int i = 0; i < weights.size(); i++)
         if (weights.at(i).x() > eta && qAbs(weights.at(i).y() / M_PI * 180 - salSkewAngle) < 0.15)
             selectedLineTypes.replace(i, 1);
@@ -54,6 +54,8 @@
 namespace nmp
 {
 
+struct DkSkewProgress;
+
 class DkSkewEstimator
 {
 public:
@@ -73,9 +75,17 @@ public:
     void setImage(QImage inImage);
 
 private:
-    cv::Mat computeSeparability(cv::Mat integral, cv::Mat integralSq, int direction);
-    cv::Mat computeEdgeMap(cv::Mat separability, double thr, int direction);
-    QVector<QVector3D> computeWeights(cv::Mat edgeMap, int direction);
+    // weighted lines of one direction
+    struct DkSkewLines {
+        QVector<QVector3D> weights;
+        QVector<QVector4D> lines;
+    };
+
+    DkSkewLines estimateLines(int direction, DkSkewProgress &p) const;
+    cv::Mat computeSeparability(const cv::Mat &integral, const cv::Mat &integralSq, int direction, DkSkewProgress &p) const;
+    cv::Mat computeEdgeMap(const cv::Mat &separability, double thr, int direction, DkSkewProgress &p) const;
+    DkSkewLines computeWeights(const cv::Mat &edgeMap, int direction, DkSkewProgress &p) const;
+    bool refineLine(QVector4D &line, double &angle, int direction) const;
     double computeSkewAngle(QVector<QVector3D> weights, double imgDiagonal);
     int randInt(int low, int high);
 
@@ -88,10 +98,16 @@ private:
     int kMax;
     int minLineLength;
     int minLineProjLength;
+    int maxSide; // larger images are downsampled for the estimate
 
     QVector<QVector4D> selectedLines;
     QVector<int> selectedLineTypes;
-    cv::Mat matImg;
+    cv::Mat matImg; // gray
+    cv::Mat fullImg; // gray, full resolution - only kept if matImg is downsampled
+    cv::Mat integral; // cached for repeated estimates of the same image
+    cv::Mat integralSq;
+    qint64 imgCacheKey;
+    double scaleFactor;
     int rotationFactor;
     QProgressDialog *progress;
     QWidget *mainWin;
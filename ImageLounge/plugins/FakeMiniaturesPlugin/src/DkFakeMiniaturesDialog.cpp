@@ -27,6 +27,10 @@
 
 #include "DkFakeMiniaturesDialog.h"
 
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QtConcurrentMap>
+#pragma warning(pop) // no warnings from includes - end
+
 #define INIT_X 0
 #define INIT_Y 0.7117
 #define INIT_WIDTH 1
@@ -35,15 +39,6 @@
 namespace nmp
 {
 
-#ifdef WITH_OPENCV
-// I know - but I just want to get rid of these little issues...
-#if (CV_MAJOR_VERSION > 3)
-int DIST_C = cv::DIST_C;
-#else
-int DIST_C = CV_DIST_C;
-#endif
-#endif
-
 /**************************************************************
  * DkFakeMiniaturesDialog: Dialog for creating fake miniatures
  ***************************************************************/
@@ -169,6 +164,10 @@ void DkFakeMiniaturesDialog::createImgPreview()
     previewImgRect.setWidth(previewImgRect.width() - 1); // we have a border... correct that...
     previewImgRect.setHeight(previewImgRect.height() - 1);
 
+#ifdef WITH_OPENCV
+    previewPyramid = DkBlurPyramid();
+#endif
+
     if (rMin < 1)
         scaledImg = mImg->scaled(imgSizeScaled, Qt::KeepAspectRatio, Qt::SmoothTransformation);
     else
@@ -216,140 +215,215 @@ QImage DkFakeMiniaturesDialog::applyMiniaturesFilter(QImage inImg, QRect qRoi)
     int saturation = saturationWidget->getToolValue();
     float satFactor = saturation / 50.0f + 1;
 
-    cv::Mat blurImg = DkFakeMiniaturesDialog::qImage2Mat(inImg);
-    cv::Mat distImg(blurImg.size(), CV_8UC1);
-    distImg = 255;
-    cv::Mat roi(distImg, Rect(qRoi.topLeft().x(), qRoi.topLeft().y(), qRoi.width(), qRoi.height()));
-    roi.setTo(0);
-    // blur plane by plane
-    std::vector<cv::Mat> planes;
-    cv::split(blurImg, planes);
-
-    // dist image based on 'some' threshold
-    // cv::Mat distImg;
-    // cv::threshold(planes.at(0), distImg, 40, 255, THRESH_BINARY);
-
-    cv::distanceTransform(distImg, distImg, DIST_C, 3);
-    cv::normalize(distImg, distImg, 1.0f, 0.0f, NORM_MINMAX);
-
-    for (size_t idx = 0; idx < planes.size(); idx++)
-        planes.at(idx) = blurPanTilt(planes.at(idx), distImg, kernelSize); // 140 is the maximal blurring kernel size
-    // planes.at(idx) = distImg;
-
-    cv::merge(planes, blurImg);
-    // return (DkFakeMiniaturesDialog::mat2QImage(blurImg));
-
-    if (satFactor > 1) {
-        Mat imgHsv;
-        cvtColor(blurImg, imgHsv, cv::COLOR_RGB2HSV);
-        std::vector<Mat> imgHsvCh;
-        split(imgHsv, imgHsvCh);
-
-        for (int row = 0; row < imgHsv.rows; row++) {
-            unsigned char *ptr = imgHsvCh[1].ptr<unsigned char>(row);
-
-            for (int col = 0; col < imgHsv.cols; col++) {
-                float tmp = (float)ptr[col] * satFactor;
-                if (tmp > 255.0f)
-                    tmp = 255.0f;
-                if (tmp < 0)
-                    tmp = 0.0f;
-                ptr[col] = (unsigned char)qRound(tmp);
-            }
-        }
+    // the preview's pyramid is only computed if the image or the kernel size change
+    if (inImg == scaledImg) {
+        if (previewPyramid.isEmpty() || previewPyramid.maxRadius() < kernelSize / 2)
+            previewPyramid = DkBlurPyramid(DkFakeMiniaturesDialog::qImage2Mat(inImg), kernelSize / 2);
 
-        merge(imgHsvCh, imgHsv);
-        Mat tempImg(blurImg);
-        cvtColor(imgHsv, blurImg, cv::COLOR_HSV2RGB);
-
-        if (tempImg.type() == CV_8UC4) { // the retImg is always CV_8UC3, so for pics in CV_8UC4 we need to add one channel
-            std::vector<Mat> inImgCh;
-            split(tempImg, inImgCh);
-            std::vector<Mat> retImgCh;
-            split(blurImg, retImgCh);
-            retImgCh.push_back(inImgCh[3]);
-            merge(retImgCh, blurImg);
-        }
+        return DkFakeMiniaturesDialog::mat2QImage(previewPyramid.apply(qRoi, kernelSize, satFactor));
     }
 
-    return (DkFakeMiniaturesDialog::mat2QImage(blurImg));
+    DkBlurPyramid pyramid(DkFakeMiniaturesDialog::qImage2Mat(inImg), kernelSize / 2);
+    return DkFakeMiniaturesDialog::mat2QImage(pyramid.apply(qRoi, kernelSize, satFactor));
 #else
     return inImg;
 #endif
 }
 
 #ifdef WITH_OPENCV
+/**************************************************************
+ * DkBlurPyramid: box filtered levels of an image
+ ***************************************************************/
+/**
+ * Creates the pyramid.
+ * @param src input Mat (interleaved channels, 8 bit)
+ * @param maxRadius the largest blur radius needed
+ **/
+DkBlurPyramid::DkBlurPyramid(const Mat &src, int maxRadius)
+{
+    mSrc = src;
+
+    if (mSrc.empty())
+        return;
+
+    Level l;
+    l.img = mSrc;
+    mLevels.push_back(l);
+
+    Mat octave = mSrc;
+    int scale = 1;
+
+    for (int radius = 2; maxRadius > 0; radius *= 2) {
+        // the box radius of a level is at most 4px - larger kernels are applied to downsampled images
+        while (radius / scale > 4 && octave.cols > 1 && octave.rows > 1) {
+            cv::resize(octave, octave, cv::Size((octave.cols + 1) / 2, (octave.rows + 1) / 2), 0, 0, cv::INTER_AREA);
+            scale *= 2;
+        }
+
+        int ks = qMax(qRound(radius / (float)scale), 1);
+
+        Level l;
+        cv::blur(octave, l.img, cv::Size(2 * ks + 1, 2 * ks + 1));
+        l.radius = radius;
+        l.sx = (float)mSrc.cols / l.img.cols;
+        l.sy = (float)mSrc.rows / l.img.rows;
+        mLevels.push_back(l);
+
+        if (radius >= maxRadius)
+            break;
+    }
+}
+
+bool DkBlurPyramid::isEmpty() const
+{
+    return mLevels.empty();
+}
+
+int DkBlurPyramid::maxRadius() const
+{
+    return mLevels.empty() ? 0 : mLevels.back().radius;
+}
+
+/**
+ * Bilinear interpolation of a level at the source pixel x, y.
+ **/
+void DkBlurPyramid::sample(const Level &l, int x, int y, float *px) const
+{
+    const int cn = l.img.channels();
+
+    if (l.img.size() == mSrc.size()) {
+        const uchar *ptr = l.img.ptr<uchar>(y) + x * cn;
+        for (int c = 0; c < cn; c++)
+            px[c] = ptr[c];
+        return;
+    }
+
+    float fx = (x + 0.5f) / l.sx - 0.5f;
+    float fy = (y + 0.5f) / l.sy - 0.5f;
+    int x0 = cvFloor(fx);
+    int y0 = cvFloor(fy);
+    float wx = fx - x0;
+    float wy = fy - y0;
+
+    int x1 = qBound(0, x0 + 1, l.img.cols - 1) * cn;
+    int y1 = qBound(0, y0 + 1, l.img.rows - 1);
+    x0 = qBound(0, x0, l.img.cols - 1) * cn;
+    y0 = qBound(0, y0, l.img.rows - 1);
+
+    const uchar *r0 = l.img.ptr<uchar>(y0);
+    const uchar *r1 = l.img.ptr<uchar>(y1);
+
+    for (int c = 0; c < cn; c++) {
+        float top = r0[x0 + c] + (r0[x1 + c] - r0[x0 + c]) * wx;
+        float bottom = r1[x0 + c] + (r1[x1 + c] - r1[x0 + c]) * wx;
+        px[c] = top + (bottom - top) * wy;
+    }
+}
+
+/**
+ * scales the saturation (HSV) of a pixel while hue and value are kept
+ **/
+static inline void saturatePixel(float *px, float satFactor)
+{
+    float maxV = qMax(px[0], qMax(px[1], px[2]));
+    float minV = qMin(px[0], qMin(px[1], px[2]));
+
+    if (maxV <= 0.0f || maxV == minV)
+        return;
+
+    float s = (maxV - minV) / maxV;
+    float f = qMin(s * satFactor, 1.0f) / s;
+
+    for (int c = 0; c < 3; c++)
+        px[c] = maxV - (maxV - px[c]) * f;
+}
+
 /**
- * blur filter
- * @param src input Mat
- * @param depthImg distance transform based on a roi
+ * Applies the tilt-shift filter.
+ * The image is processed in parallel tiles. Each pixel interpolates the two levels
+ * that enclose its kernel size and its saturation is adjusted in the same pass.
+ * @param roi the rectangle that will not be blurred
  * @param maxKernel maximum blur kernel size
- * @return Mat blurres mat
+ * @param satFactor saturation factor (applied if > 1)
+ * @return Mat the miniature
  **/
-Mat DkFakeMiniaturesDialog::blurPanTilt(Mat src, Mat depthImg, int maxKernel)
+Mat DkBlurPyramid::apply(const QRect &roi, int maxKernel, float satFactor) const
 {
-    cv::Mat integralImg;
+    if (mSrc.empty())
+        return Mat();
 
-    cv::Mat blurImg(src.size(), src.depth());
+    Mat dst(mSrc.size(), mSrc.type());
 
-    // a template function would have more 'style' here
-    // const double* itgrl64Ptr = 0;
+    const int cn = mSrc.channels();
+    const bool saturate = satFactor > 1 && cn >= 3;
+    const float maxKs = mLevels.size() > 1 ? maxKernel * 0.5f : 0.0f;
 
-    // images with an area below 4000*4000 can be compuated using 32 bit
-    cv::integral(src, integralImg, CV_32S);
-    const unsigned int *itgrl32Ptr = integralImg.ptr<unsigned int>();
+    // chessboard distance to the roi - this equals the distance transform of a rectangle
+    QRect r = roi.normalized() & QRect(0, 0, mSrc.cols, mSrc.rows);
+    int maxDist = 0;
 
-    for (int rIdx = 0; rIdx < src.rows; rIdx++) {
-        unsigned char *blurPtr = blurImg.ptr<unsigned char>(rIdx); // assuming unsigned char
-        const float *depthPtr = depthImg.ptr<float>(rIdx);
-        const unsigned char *srcPtr = src.ptr<unsigned char>(rIdx);
+    if (!r.isEmpty())
+        maxDist = qMax(qMax(r.left(), mSrc.cols - 1 - r.right()), qMax(r.top(), mSrc.rows - 1 - r.bottom()));
 
-        for (int cIdx = 0; cIdx < src.cols; cIdx++) {
-            // kernel size depends on the distance transform, the user selected
-            // float dpv = depthPtr[cIdx];
-            float ksf = depthPtr[cIdx] * maxKernel * 0.5f;
+    const int tileHeight = 64;
+    QVector<int> tiles;
+    for (int idx = 0; idx * tileHeight < mSrc.rows; idx++)
+        tiles << idx;
 
-            // if (!ks) {
-            //	blurPtr[cIdx] = srcPtr[cIdx];
-            //	continue;
-            // }
+    QtConcurrent::blockingMap(tiles, [&](int tIdx) {
+        std::vector<float> px(cn), upper(cn);
 
-            int ks = qRound(ksf);
-            if (ksf > 0 && ksf < 2)
-                ks = 2;
-            else if (ks == 0) { // early skip
-                blurPtr[cIdx] = srcPtr[cIdx];
-                continue;
-            }
+        int yEnd = qMin((tIdx + 1) * tileHeight, mSrc.rows);
+
+        for (int y = tIdx * tileHeight; y < yEnd; y++) {
+            const uchar *srcPtr = mSrc.ptr<uchar>(y);
+            uchar *dstPtr = dst.ptr<uchar>(y);
+            int dy = qMax(qMax(r.top() - y, y - r.bottom()), 0);
+
+            for (int x = 0; x < mSrc.cols; x++) {
+                float depth = 1.0f;
+
+                if (!r.isEmpty()) {
+                    int dx = qMax(qMax(r.left() - x, x - r.right()), 0);
+                    depth = maxDist > 0 ? qMax(dx, dy) / (float)maxDist : 0.0f;
+                }
 
-            // clip all coordinates
-            int left = qMax(cIdx - ks, 0);
-            int right = qMin(cIdx + ks + 1, src.cols); // note not cols-1 since integral mImg is src.cols+1
-            int bottom = qMax(rIdx - ks, 0); // note top bottom is flipped since -y coords
-            int top = qMin(rIdx + ks + 1, src.rows);
-            int area = (right - left) * (top - bottom);
+                float ks = depth * maxKs;
 
-            top *= integralImg.cols;
-            bottom *= integralImg.cols;
+                if (ks <= 0.0f) {
+                    for (int c = 0; c < cn; c++)
+                        px[c] = srcPtr[x * cn + c];
+                } else {
+                    // the smallest kernel has a radius of 2
+                    ks = qBound(2.0f, ks, (float)mLevels.back().radius);
 
-            float tmp = 0.0f;
+                    size_t lIdx = 1;
+                    while (lIdx + 1 < mLevels.size() && mLevels[lIdx + 1].radius <= ks)
+                        lIdx++;
 
-            // compute mean kernel
-            if (area && itgrl32Ptr && ks > 1)
-                tmp = (float)(*(itgrl32Ptr + top + right) + *(itgrl32Ptr + bottom + left) - *(itgrl32Ptr + top + left) - *(itgrl32Ptr + bottom + right)) / area;
-            else
-                tmp = srcPtr[cIdx];
+                    const Level &lower = mLevels[lIdx];
+                    sample(lower, x, y, px.data());
 
-            if (tmp < 0)
-                tmp = 0.0f;
-            if (tmp > 255)
-                tmp = 255.0f;
+                    if (lIdx + 1 < mLevels.size() && ks > lower.radius) {
+                        const Level &l = mLevels[lIdx + 1];
+                        float w = (ks - lower.radius) / (l.radius - lower.radius);
+                        sample(l, x, y, upper.data());
 
-            blurPtr[cIdx] = (uchar)qRound(tmp);
+                        for (int c = 0; c < cn; c++)
+                            px[c] += (upper[c] - px[c]) * w;
+                    }
+                }
+
+                if (saturate)
+                    saturatePixel(px.data(), satFactor);
+
+                for (int c = 0; c < cn; c++)
+                    dstPtr[x * cn + c] = cv::saturate_cast<uchar>(px[c]);
+            }
         }
-    }
+    });
 
-    return blurImg;
+    return dst;
 }
 #endif
 
@@ -61,6 +61,36 @@ class DkPreviewLabel;
 class DkKernelSize;
 class DkSaturation;
 
+#ifdef WITH_OPENCV
+/**
+ * Blur pyramid of an image.
+ * Level k is blurred with a box of radius 2^k. Levels with large radii are
+ * computed on downsampled images so that large kernels are cheap.
+ **/
+class DkBlurPyramid
+{
+public:
+    DkBlurPyramid(const Mat &src = Mat(), int maxRadius = 0);
+
+    bool isEmpty() const;
+    int maxRadius() const;
+    Mat apply(const QRect &roi, int maxKernel, float satFactor) const;
+
+protected:
+    struct Level {
+        Mat img;
+        int radius = 0;
+        float sx = 1.0f; // downsampling factor
+        float sy = 1.0f;
+    };
+
+    void sample(const Level &l, int x, int y, float *px) const;
+
+    Mat mSrc;
+    std::vector<Level> mLevels;
+};
+#endif
+
 class DkFakeMiniaturesDialog : public QDialog
 {
     Q_OBJECT
@@ -104,6 +134,9 @@ protected:
     float rMin;
     DkKernelSize *kernelSizeWidget;
     DkSaturation *saturationWidget;
+#ifdef WITH_OPENCV
+    DkBlurPyramid previewPyramid; // re-used if the roi or the saturation change
+#endif
 
     int previewWidth;
     int previewHeight;
@@ -116,8 +149,6 @@ protected:
     void createImgPreview();
 
 #ifdef WITH_OPENCV
-    Mat blurPanTilt(Mat src, Mat depthImg, int maxKernel);
-
     /**
      * Converts a QImage to a Mat
      * @param mImg formats supported: ARGB32 | RGB32 | RGB888 | Indexed8
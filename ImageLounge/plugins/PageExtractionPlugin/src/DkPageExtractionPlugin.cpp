@@ -139,10 +139,12 @@ QSharedPointer<nmc::DkImageContainer> DkPageExtractionPlugin::runPlugin(const QS
     if (!mRunIDs.contains(runID) || !imgC)
         return imgC;
 
+    // NOTE: the batch pipeline calls this concurrently for several pages - so do not modify members here
     cv::Mat img = nmc::DkImage::qImage2Mat(imgC->image());
     bool alternativeMethod = mMethod == m_bhaskar;
 
     DkPageSegmentation segM(img, alternativeMethod);
+    segM.coarseToFine = mCoarseToFine;
 
     // run the page segmentation
     nmc::DkTimer dt;
@@ -210,6 +212,7 @@ void DkPageExtractionPlugin::loadSettings(QSettings &settings)
     int mIdx = settings.value("Method", mMethod).toInt();
     if (mIdx >= 0 && mIdx < m_end)
         mMethod = (MethodIndex)mIdx;
+    mCoarseToFine = settings.value("CoarseToFine", mCoarseToFine).toBool();
     settings.endGroup();
 }
 
@@ -217,6 +220,7 @@ void DkPageExtractionPlugin::saveSettings(QSettings &settings) const
 {
     settings.beginGroup(name());
     settings.setValue("Method", mMethod);
+    settings.setValue("CoarseToFine", mCoarseToFine);
     settings.endGroup();
 }
 
@@ -80,6 +80,7 @@ protected:
     QString mResultPath;
 
     MethodIndex mMethod = m_thresholds;
+    bool mCoarseToFine = false; // see DkPageSegmentation::coarseToFine
 
     QPolygonF readGT(const QString &imgPath) const;
     double jaccardIndex(const QSize &imgSize, const QPolygonF &gt, const QPolygonF &computed) const;
@@ -26,10 +26,13 @@
 #include "DkMath.h" // nomacs
 #include "DkPageSegmentationUtils.h"
 
+#include "DkTimer.h"
+
 #pragma warning(push, 0) // no warnings from includes - begin
 #include <QDebug>
 #include <QPainter>
 #include <QPainterPath>
+#include <QtConcurrentMap>
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/imgproc/imgproc_c.h>
@@ -38,6 +41,21 @@
 namespace nmp
 {
 
+// per-thread work buffers - they are re-used for all pages of a batch
+struct DkSegmentationBuffers {
+    cv::Mat tImg;
+    std::vector<cv::Mat> planes = std::vector<cv::Mat>(3);
+    std::vector<cv::Mat> coarsePlanes = std::vector<cv::Mat>(3);
+    cv::Mat gray;
+    std::vector<std::vector<cv::Point>> contours;
+};
+
+static DkSegmentationBuffers &segmentationBuffers()
+{
+    static thread_local DkSegmentationBuffers buffers;
+    return buffers;
+}
+
 // DkSegmentBurger --------------------------------------------------------------------
 // This code is based on OpenCV's rectangle sample (squares.cpp)
 DkPageSegmentation::DkPageSegmentation(const cv::Mat &colImg /* = cv::Mat */, bool alternativeMethod /* = false */)
@@ -81,6 +99,7 @@ QImage DkPageSegmentation::getCropped(const QImage &img) const
 
 void DkPageSegmentation::compute()
 {
+    nmc::DkTimer dt;
     cv::Mat lImg;
     if (alternativeMethod) {
         if (scale == 1.0f && mImg.rows > 700.0f)
@@ -88,120 +107,75 @@ void DkPageSegmentation::compute()
 
         lImg = findRectanglesAlternative(mImg, mRects);
     } else {
-        cv::Mat imgLab;
-
         if (scale == 1.0f && 960.0f / mImg.cols < 0.8f)
             scale = 960.0f / mImg.cols;
 
-        cv::cvtColor(mImg, imgLab, CV_RGB2Lab); // boost colors
         lImg = findRectangles(mImg, mRects);
     }
 
-    qDebug() << "[DkPageSegmentation] " << mRects.size() << " rectangles circles found resize factor: " << scale;
+    qDebug() << "[DkPageSegmentation] " << mRects.size() << " rectangles circles found resize factor: " << scale << "in" << dt;
 }
 
 cv::Mat DkPageSegmentation::findRectangles(const cv::Mat &img, std::vector<DkPolyRect> &rects) const
 {
-    cv::Mat tImg, gray;
+    DkSegmentationBuffers &buf = segmentationBuffers();
+    cv::Mat tImg;
 
-    if (scale != 1.0f)
-        cv::resize(img, tImg, cv::Size(), scale, scale, CV_INTER_AREA); // inter nn -> assuming resize to be 1/(2^n)
-    else
-        tImg = img;
+    {
+        DK_TRACE_SCOPE("page segmentation - resize");
 
-    std::vector<std::vector<cv::Point>> contours;
+        if (scale != 1.0f) {
+            cv::resize(img, buf.tImg, cv::Size(), scale, scale, CV_INTER_AREA); // inter nn -> assuming resize to be 1/(2^n)
+            tImg = buf.tImg;
+        } else
+            tImg = img;
+    }
 
-    cv::Mat gray0(tImg.size(), CV_8UC1);
-    cv::Mat lImg(tImg.size(), CV_8UC1);
-
-    // find squares in every color plane of the image
-    for (int c = 0; c < 3; c++) {
-        int ch[] = {c, 0};
-        mixChannels(&tImg, 1, &gray0, 1, ch, 1);
-        cv::normalize(gray0, gray0, 255, 0, cv::NORM_MINMAX);
-
-        if (c == 0) // back-up the luminance channel - we use it as precomputed image for the circle detection
-            lImg = gray0.clone();
-
-        int nT = numThresh; //(c == 0) ? numThresh*2 : numThresh;	// more luminance thresholds
-
-        // try several threshold levels
-        for (int l = 0; l < nT; l++) {
-            // hack: use Canny instead of zero threshold level.
-            // Canny helps to catch squares with gradient shading
-            if (l == 0) {
-                Canny(gray0, gray, thresh, thresh * 3, 5);
-                // dilate canny output to remove potential
-                // holes between edge segments
-                dilate(gray, gray, cv::Mat(), cv::Point(-1, -1));
-
-                // DkIP::imwrite("edgeImg.png", gray);
-            } else {
-                gray = gray0 >= (l + 1) * 255 / numThresh;
-            }
+    {
+        DK_TRACE_SCOPE("page segmentation - planes");
 
-            // find contours and store them all as a list
-            findContours(gray, contours, CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE);
+        // find squares in every color plane of the image
+        for (int c = 0; c < 3; c++) {
+            int ch[] = {c, 0};
+            buf.planes[c].create(tImg.size(), CV_8UC1);
+            mixChannels(&tImg, 1, &buf.planes[c], 1, ch, 1);
+            cv::normalize(buf.planes[c], buf.planes[c], 255, 0, cv::NORM_MINMAX);
+        }
+    }
 
-            if (looseDetection) {
-                std::vector<std::vector<cv::Point>> hull;
-                for (int i = 0; i < (int)contours.size(); i++) {
-                    double cArea = contourArea(cv::Mat(contours[i]));
+    // each color plane is tested with numThresh thresholds (the first 'threshold' is Canny)
+    std::vector<int> passes(3 * numThresh);
+    for (int idx = 0; idx < (int)passes.size(); idx++)
+        passes[idx] = idx;
 
-                    if (fabs(cArea) > mMinArea * scale * scale && (!mMaxArea || fabs(cArea) < mMaxArea * (scale * scale))) {
-                        std::vector<cv::Point> cHull;
-                        cv::convexHull(cv::Mat(contours[i]), cHull, false);
-                        hull.push_back(cHull);
-                    }
-                }
+    // coarse-to-fine: only passes that find pages on the coarse level are run at full scale
+    if (coarseToFine && std::min(tImg.rows, tImg.cols) * coarseScale >= minCoarseSide) {
+        DK_TRACE_SCOPE("page segmentation - coarse");
 
-                contours = hull;
-            }
+        for (int c = 0; c < 3; c++)
+            cv::resize(buf.planes[c], buf.coarsePlanes[c], cv::Size(), coarseScale, coarseScale, CV_INTER_AREA);
 
-            std::vector<cv::Point> approx;
-
-            // DEBUG ------------------------
-            // cv::Mat pImg = image.clone();
-            // cv::cvtColor(pImg, pImg, CV_Lab2RGB);
-            // DEBUG ------------------------
-
-            // test each contour
-            for (size_t i = 0; i < contours.size(); i++) {
-                // approxicv::Mate contour with accuracy proportional
-                // to the contour perimeter
-                approxPolyDP(cv::Mat(contours[i]), approx, arcLength(cv::Mat(contours[i]), true) * 0.02, true);
-
-                double cArea = contourArea(cv::Mat(approx));
-
-                // DEBUG ------------------------
-                // if (fabs(cArea) < mMaxArea)
-                //	fillConvexPoly(pImg, &approx[0], (int)approx.size(), DkUtils::blue);
-                // DEBUG ------------------------
-
-                // square contours should have 4 vertices after approxicv::Mation
-                // relatively large area (to filter out noisy contours)
-                // and be convex.
-                // Note: absolute value of an area is used because
-                // area may be positive or negative - in accordance with the
-                // contour orientation
-                if (approx.size() == 4 && fabs(cArea) > mMinArea * scale * scale && (!mMaxArea || fabs(cArea) < mMaxArea * scale * scale)
-                    && isContourConvex(cv::Mat(approx))) {
-                    DkPolyRect cr(approx);
-                    // moutc << mMinArea*scale*scale << " < " << fabs(cArea) << " < " << mMaxArea*scale*scale << dkendl;
-
-                    // if cosines of all angles are small
-                    // (all angles are ~90 degree)
-                    if (/*cr.maxSide() < std::max(tImg.rows, tImg.cols)*maxSideFactor && */
-                        (!maxSide || cr.maxSide() < maxSide * scale) && cr.getMaxCosine() < 0.3) {
-                        rects.push_back(cr);
-                    }
-                }
-            }
-            // DEBUG ------------------------
-            // cv::cvtColor(pImg, pImg, CV_RGB2BGR);
-            // DkIP::imwrite("polyImg" + DkUtils::stringify(c) + "-" + DkUtils::stringify(l) + ".png", pImg);
-            // DEBUG ------------------------
+        std::vector<std::vector<DkPolyRect>> coarseRects = findRectanglesParallel(buf.coarsePlanes, passes, scale * coarseScale);
+        std::vector<int> hits;
+
+        for (int idx : passes) {
+            if (!coarseRects[idx].empty())
+                hits.push_back(idx);
         }
+
+        // nothing found -> fall back to all passes
+        if (!hits.empty())
+            passes = hits;
+    }
+
+    {
+        DK_TRACE_SCOPE("page segmentation - fine");
+
+        std::vector<std::vector<DkPolyRect>> passRects = findRectanglesParallel(buf.planes, passes, scale);
+
+        // keep the order of a sequential run
+        for (int idx : passes)
+            rects.insert(rects.end(), passRects[idx].begin(), passRects[idx].end());
     }
 
     for (size_t idx = 0; idx < rects.size(); idx++)
@@ -219,7 +193,94 @@ cv::Mat DkPageSegmentation::findRectangles(const cv::Mat &img, std::vector<DkPol
 
     rects = noLargeRects;
 
-    return lImg;
+    // back-up the luminance channel - the buffers are re-used by the next page
+    return buf.planes[0].clone();
+}
+
+/**
+ * Runs the threshold & contour passes in parallel.
+ * @param planes normalized color planes
+ * @param passes indexes of the passes (plane * numThresh + threshold level)
+ * @param pScale the scale of the planes w.r.t. the original image
+ * @return the rectangles found per pass
+ **/
+std::vector<std::vector<DkPolyRect>>
+DkPageSegmentation::findRectanglesParallel(const std::vector<cv::Mat> &planes, const std::vector<int> &passes, float pScale) const
+{
+    std::vector<std::vector<DkPolyRect>> passRects(3 * numThresh);
+    std::vector<int> indexes = passes;
+
+    QtConcurrent::blockingMap(indexes, [&](int idx) {
+        findRectanglesInPass(planes[idx / numThresh], idx % numThresh, pScale, passRects[idx]);
+    });
+
+    return passRects;
+}
+
+void DkPageSegmentation::findRectanglesInPass(const cv::Mat &plane, int level, float pScale, std::vector<DkPolyRect> &rects) const
+{
+    DkSegmentationBuffers &b = segmentationBuffers();
+    cv::Mat &gray = b.gray;
+    std::vector<std::vector<cv::Point>> &contours = b.contours;
+
+    // hack: use Canny instead of zero threshold level.
+    // Canny helps to catch squares with gradient shading
+    if (level == 0) {
+        Canny(plane, gray, thresh, thresh * 3, 5);
+        // dilate canny output to remove potential
+        // holes between edge segments
+        dilate(gray, gray, cv::Mat(), cv::Point(-1, -1));
+
+        // DkIP::imwrite("edgeImg.png", gray);
+    } else {
+        cv::compare(plane, (double)((level + 1) * 255 / numThresh), gray, cv::CMP_GE);
+    }
+
+    // find contours and store them all as a list
+    findContours(gray, contours, CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE);
+
+    if (looseDetection) {
+        std::vector<std::vector<cv::Point>> hull;
+        for (int i = 0; i < (int)contours.size(); i++) {
+            double cArea = contourArea(cv::Mat(contours[i]));
+
+            if (fabs(cArea) > mMinArea * pScale * pScale && (!mMaxArea || fabs(cArea) < mMaxArea * (pScale * pScale))) {
+                std::vector<cv::Point> cHull;
+                cv::convexHull(cv::Mat(contours[i]), cHull, false);
+                hull.push_back(cHull);
+            }
+        }
+
+        contours = hull;
+    }
+
+    std::vector<cv::Point> approx;
+
+    // test each contour
+    for (size_t i = 0; i < contours.size(); i++) {
+        // approxicv::Mate contour with accuracy proportional
+        // to the contour perimeter
+        approxPolyDP(cv::Mat(contours[i]), approx, arcLength(cv::Mat(contours[i]), true) * 0.02, true);
+
+        double cArea = contourArea(cv::Mat(approx));
+
+        // square contours should have 4 vertices after approxicv::Mation
+        // relatively large area (to filter out noisy contours)
+        // and be convex.
+        // Note: absolute value of an area is used because
+        // area may be positive or negative - in accordance with the
+        // contour orientation
+        if (approx.size() == 4 && fabs(cArea) > mMinArea * pScale * pScale && (!mMaxArea || fabs(cArea) < mMaxArea * pScale * pScale)
+            && isContourConvex(cv::Mat(approx))) {
+            DkPolyRect cr(approx);
+
+            // if cosines of all angles are small
+            // (all angles are ~90 degree)
+            if ((!maxSide || cr.maxSide() < maxSide * pScale) && cr.getMaxCosine() < 0.3) {
+                rects.push_back(cr);
+            }
+        }
+    }
 }
 
 cv::Mat DkPageSegmentation::findRectanglesAlternative(const cv::Mat &img, std::vector<DkPolyRect> &rects) const
@@ -277,6 +338,8 @@ void DkPageSegmentation::filterDuplicates(float overlap, float areaRatio)
 
 void DkPageSegmentation::filterDuplicates(std::vector<DkPolyRect> &rects, float overlap, float areaRatio) const
 {
+    DK_TRACE_SCOPE("page segmentation - filter duplicates");
+
     std::vector<int> delIdx;
     std::sort(rects.rbegin(), rects.rend(), &DkPolyRect::compArea); // rbegin() -> sort descending
 
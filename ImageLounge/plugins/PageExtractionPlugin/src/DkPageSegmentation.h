@@ -61,6 +61,12 @@ public:
 
     bool looseDetection;
 
+    // if true, only threshold passes that find pages on a coarse level are run at full scale.
+    // This is faster but misses pages that are only found at full scale by passes that
+    // found nothing on the coarse level. All passes are run if the coarse level finds nothing.
+    // It is off by default since its results were not validated against ground truth (see DkPageExtractionPlugin::jaccardIndex).
+    bool coarseToFine = false;
+
 protected:
     cv::Mat mImg;
     cv::Mat dbgImg;
@@ -72,11 +78,15 @@ protected:
     float maxSide = 0;
     float maxSideFactor = 0.97f;
     float scale = 1.0f;
+    float coarseScale = 0.5f; // relative scale of the coarse level
+    int minCoarseSide = 320; // the coarse level is skipped for smaller images
     bool alternativeMethod;
 
     std::vector<DkPolyRect> mRects;
 
     virtual cv::Mat findRectangles(const cv::Mat &img, std::vector<DkPolyRect> &squares) const;
+    virtual void findRectanglesInPass(const cv::Mat &plane, int level, float pScale, std::vector<DkPolyRect> &rects) const;
+    std::vector<std::vector<DkPolyRect>> findRectanglesParallel(const std::vector<cv::Mat> &planes, const std::vector<int> &passes, float pScale) const;
     virtual cv::Mat findRectanglesAlternative(const cv::Mat &img, std::vector<DkPolyRect> &squares) const;
     QImage cropToRect(const QImage &img, const nmc::DkRotatingRect &rect, const QColor &bgCol = QColor(0, 0, 0)) const;
     void drawRects(QPainter *p, const std::vector<DkPolyRect> &rects, const QColor &col = QColor(100, 100, 100)) const;
@@ -31,6 +31,7 @@
 #include <QActionGroup>
 #include <QDebug>
 #include <QMouseEvent>
+#include <QPainter>
 
 namespace nmp
 {
@@ -122,25 +123,56 @@ QLineF getShorterLine(QPainterPath line, const int thickness)
     return l.toLine();
 }
 
-// blur selected rectangle region
-void getBlur(QPainterPath rect, QPainter *painter, QImage &img, int radius)
+// box filters a line of premultiplied pixels in-place (edges are clamped)
+static void boxBlurLine(QRgb *px, int length, int step, int radius, QVector<QRgb> &line)
 {
-    // auto pixelRatio = pixmap.devicePixelRatio();
-    QRectF selection = rect.boundingRect();
-    QRect selectionScaled = QRect(selection.topLeft().toPoint(), selection.bottomRight().toPoint());
+    if (length <= 1)
+        return;
 
-    QGraphicsBlurEffect *blur = new QGraphicsBlurEffect;
-    blur->setBlurRadius(radius);
-    QGraphicsPixmapItem *item = new QGraphicsPixmapItem(QPixmap::fromImage(img).copy(selectionScaled));
-    item->setGraphicsEffect(blur);
+    line.resize(length);
+    for (int idx = 0; idx < length; idx++)
+        line[idx] = px[idx * step];
+
+    const int size = 2 * radius + 1;
+    int a = 0, r = 0, g = 0, b = 0;
+
+    auto add = [&](int idx, int sign) {
+        QRgb c = line[qBound(0, idx, length - 1)];
+        a += sign * qAlpha(c);
+        r += sign * qRed(c);
+        g += sign * qGreen(c);
+        b += sign * qBlue(c);
+    };
+
+    for (int idx = -radius; idx <= radius; idx++)
+        add(idx, 1);
+
+    // running sum -> the costs do not depend on the radius
+    for (int idx = 0; idx < length; idx++) {
+        px[idx * step] = qRgba((r + size / 2) / size, (g + size / 2) / size, (b + size / 2) / size, (a + size / 2) / size);
+        add(idx - radius, -1);
+        add(idx + radius + 1, 1);
+    }
+}
 
-    QGraphicsScene scene;
-    scene.addItem(item);
+// three separable box filters approximate a gaussian
+static void boxBlur(QImage &img, int radius)
+{
+    img = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    QVector<QRgb> line;
+    const int stride = img.bytesPerLine() / sizeof(QRgb);
+    QRgb *px = reinterpret_cast<QRgb *>(img.bits());
+
+    for (int y = 0; y < img.height(); y++) {
+        for (int pass = 0; pass < 3; pass++)
+            boxBlurLine(px + y * stride, img.width(), 1, radius, line);
+    }
 
-    scene.render(painter, selection, QRectF());
-    blur->setBlurRadius(radius + 2);
-    scene.render(painter, selection, QRectF());
-    scene.render(painter, selection, QRectF());
+    for (int x = 0; x < img.width(); x++) {
+        for (int pass = 0; pass < 3; pass++)
+            boxBlurLine(px + x, img.height(), stride, radius, line);
+    }
 }
 
 QSharedPointer<nmc::DkImageContainer> DkPaintPlugin::runPlugin(const QString &runID, QSharedPointer<nmc::DkImageContainer> image) const
@@ -275,6 +307,16 @@ void DkPaintViewPort::undoLastPaint()
     paths.pop_back();
     pathsPen.pop_back();
     pathsMode.pop_back();
+
+    // the stroke is cached -> re-render all others
+    if (mNumCommitted > paths.size()) {
+        mLayer.fill(Qt::transparent);
+        mNumCommitted = 0;
+        commitStrokes();
+    }
+
+    clearStrokeLayer();
+    mActiveRect = QRectF();
     update();
 }
 
@@ -291,7 +333,7 @@ void DkPaintViewPort::mousePressEvent(QMouseEvent *event)
     if (event->buttons() == Qt::LeftButton && parent()) {
         nmc::DkBaseViewPort *viewport = dynamic_cast<nmc::DkBaseViewPort *>(parent());
         if (viewport) {
-            if (QRectF(QPointF(), viewport->getImage().size()).contains(mapToImage(event->pos()))) {
+            if (QRectF(QPointF(), viewport->getImageSize()).contains(mapToImage(event->pos()))) {
                 isOutside = false;
 
                 // roll back the empty painterpath generated by click mouse
@@ -299,6 +341,12 @@ void DkPaintViewPort::mousePressEvent(QMouseEvent *event)
                     if (paths.last().isEmpty())
                         undoLastPaint();
 
+                if (!initLayer())
+                    return;
+
+                // e.g. the text that was entered
+                commitStrokes();
+
                 // create new painterpath
                 paths.append(QPainterPath());
                 paths.last().moveTo(mapToImage(event->pos()));
@@ -311,7 +359,8 @@ void DkPaintViewPort::mousePressEvent(QMouseEvent *event)
                     // lineedit show only when in text mode and mouse click
                     emit editShowSignal(true);
                 }
-                update();
+                mActiveRect = strokeRect(paths.size() - 1);
+                update(imageToWidget(mActiveRect));
             } else
                 isOutside = true;
         }
@@ -339,18 +388,27 @@ void DkPaintViewPort::mouseMoveEvent(QMouseEvent *event)
             viewport->unsetCursor();
 
             if (event->buttons() == Qt::LeftButton && parent()) {
-                if (QRectF(QPointF(), viewport->getImage().size()).contains(mapToImage(event->pos()))) {
+                if (QRectF(QPointF(), viewport->getImageSize()).contains(mapToImage(event->pos()))) {
                     if (isOutside) {
+                        commitStrokes();
                         paths.append(QPainterPath());
                         paths.last().moveTo(mapToImage(event->pos()));
                         pathsPen.append(mPen);
                         pathsMode.append(selectedMode);
                     } else {
                         QPointF point = mapToImage(event->pos());
+                        bool incremental = false;
+
                         switch (selectedMode) {
                         case mode_pencil:
+                        default: {
+                            // only the new segment is rasterized
+                            QLineF segment(paths.last().currentPosition(), point);
                             paths.last().lineTo(point);
+                            addSegment(segment);
+                            incremental = true;
                             break;
+                        }
 
                         case mode_line:
                         case mode_arrow:
@@ -376,12 +434,14 @@ void DkPaintViewPort::mouseMoveEvent(QMouseEvent *event)
 
                         case mode_text:
                             break;
+                        }
 
-                        default:
-                            paths.last().lineTo(point);
-                            break;
+                        // shapes are redrawn -> repaint their old & new region
+                        if (!incremental) {
+                            QRectF r = strokeRect(paths.size() - 1);
+                            update(imageToWidget(r.united(mActiveRect)));
+                            mActiveRect = r;
                         }
-                        update();
                     }
                     isOutside = false;
                 } else
@@ -401,6 +461,10 @@ void DkPaintViewPort::mouseReleaseEvent(QMouseEvent *event)
         event->ignore();
         return;
     }
+
+    // the text is committed when editing is finished
+    if (event->button() == Qt::LeftButton && !paths.empty() && !paths.last().isEmpty() && pathsMode.last() != mode_text)
+        commitStrokes();
 }
 
 void DkPaintViewPort::paintEvent(QPaintEvent *event)
@@ -410,39 +474,31 @@ void DkPaintViewPort::paintEvent(QPaintEvent *event)
     if (mWorldMatrix)
         painter.setWorldTransform((*mImgMatrix) * (*mWorldMatrix)); // >DIR: using both matrices allows for correct resizing [16.10.2013 markus]
 
-    for (int idx = 0; idx < paths.size(); idx++) {
-        painter.setPen(pathsPen.at(idx));
-        if (pathsMode.at(idx) == mode_arrow) {
-            painter.fillPath(getArrowHead(paths.at(idx), pathsPen.at(idx).width()), QBrush(pathsPen.at(idx).color()));
-            painter.drawLine(getShorterLine(paths.at(idx), pathsPen.at(idx).width()));
-        }
-        // else if(pathsMode.at(idx) == mode_square_fill || pathsMode.at(idx) == mode_text)
-        else if (pathsMode.at(idx) == mode_square_fill)
-            painter.fillPath(paths.at(idx), QBrush(pathsPen.at(idx).color()));
-        else if (pathsMode.at(idx) == mode_text) {
-            painter.fillPath(paths.at(idx), QBrush(pathsPen.at(idx).color()));
-            // painter.setPen(QPen(QBrush(QColor(0,0,0,180)),1,Qt::DashLine));
-            // painter.setBrush(QBrush(QColor(255,255,255,120)));
-            // painter.drawRect(paths.at(idx).boundingRect());
-            // painter.setPen(pathsPen.at(idx));
-            QPointF p = paths.at(idx).boundingRect().bottomRight();
-            if ((idx == paths.size() - 1) && (textinputenable)) {
-                painter.setPen(QPen(QBrush(QColor(0, 0, 0, 180)), pathsPen.at(idx).width(), Qt::DotLine));
-                if (sbuffer.isEmpty())
-                    painter.drawLine(QLineF(begin, begin - QPoint(0, pathsPen.at(idx).width() * 10)));
-                else
-                    painter.drawLine(QLineF(p, p - QPoint(0, pathsPen.at(idx).width() * 10)));
-            }
-            // painter.drawPoint(paths.at(idx).boundingRect().bottomRight());
-        } else if (pathsMode.at(idx) == mode_blur) {
-            if (parent()) {
-                nmc::DkBaseViewPort *viewport = dynamic_cast<nmc::DkBaseViewPort *>(parent());
-                QImage img = viewport->getImage();
-                // QPixmap pixmap = QPixmap::fromImage(mImg).copy();
-                getBlur(paths.at(idx), &painter, img, pathsPen.at(idx).width());
-            }
-        } else
-            painter.drawPath(paths.at(idx));
+    // committed strokes are cached -> we just blit the exposed region
+    QRect exposed = painter.worldTransform().inverted().mapRect(QRectF(event->rect())).toAlignedRect();
+
+    QRect r = exposed & mLayer.rect();
+    if (!r.isEmpty())
+        painter.drawImage(r, mLayer, r);
+
+    r = exposed & mStrokeRect;
+    if (!r.isEmpty())
+        painter.drawImage(r, mStrokeLayer, r.translated(-mStrokeLayerRect.topLeft()));
+
+    for (int idx = mNumCommitted; idx < paths.size(); idx++) {
+        // pencil strokes are drawn by the stroke layer
+        if (idx == paths.size() - 1 && !mStrokeRect.isEmpty())
+            continue;
+
+        drawStroke(painter, idx);
+    }
+
+    // text cursor
+    if (textinputenable && !paths.empty() && pathsMode.last() == mode_text) {
+        int width = pathsPen.last().width();
+        QPointF p = sbuffer.isEmpty() ? begin : paths.last().boundingRect().bottomRight();
+        painter.setPen(QPen(QBrush(QColor(0, 0, 0, 180)), width, Qt::DotLine));
+        painter.drawLine(QLineF(p, p - QPoint(0, width * 10)));
     }
 
     painter.end();
@@ -452,42 +508,193 @@ void DkPaintViewPort::paintEvent(QPaintEvent *event)
 
 QImage DkPaintViewPort::getPaintedImage()
 {
-    if (parent()) {
-        nmc::DkBaseViewPort *viewport = dynamic_cast<nmc::DkBaseViewPort *>(parent());
-        if (viewport) {
-            if (!paths.isEmpty()) { // if nothing is drawn there is no need to change the image
-
-                QImage img = viewport->getImage();
-
-                QPainter painter(&img);
-
-                // >DIR: do not apply world matrix if painting in the image [14.10.2014 markus]
-                // if (worldMatrix)
-                //	painter.setWorldTransform(*worldMatrix);
-
-                painter.setRenderHint(QPainter::Antialiasing);
-
-                for (int idx = 0; idx < paths.size(); idx++) {
-                    painter.setPen(pathsPen.at(idx));
-                    if (pathsMode.at(idx) == mode_arrow) {
-                        painter.fillPath(getArrowHead(paths.at(idx), pathsPen.at(idx).width()), QBrush(pathsPen.at(idx).color()));
-                        painter.drawLine(getShorterLine(paths.at(idx), pathsPen.at(idx).width()));
-                    } else if (pathsMode.at(idx) == mode_square_fill || pathsMode.at(idx) == mode_text)
-                        painter.fillPath(paths.at(idx), QBrush(pathsPen.at(idx).color()));
-                    else if (pathsMode.at(idx) == mode_blur) {
-                        // QPixmap pixmap = QPixmap::fromImage(mImg).copy();
-                        getBlur(paths.at(idx), &painter, img, pathsPen.at(idx).width());
-                    } else
-                        painter.drawPath(paths.at(idx));
-                }
-                painter.end();
+    // if nothing is drawn there is no need to change the image
+    if (paths.isEmpty() || !initLayer())
+        return QImage();
 
-                return img;
-            }
+    commitStrokes();
+
+    // >DIR: do not apply world matrix if painting in the image [14.10.2014 markus]
+    QImage img = mImg;
+    QPainter painter(&img);
+    painter.drawImage(QPoint(), mLayer);
+    painter.end();
+
+    return img;
+}
+
+/**
+ * Allocates the layer for the current image.
+ * If the image changed (e.g. it was edited), the committed strokes are rendered again.
+ * @return false if there is no image to paint on
+ **/
+bool DkPaintViewPort::initLayer()
+{
+    nmc::DkBaseViewPort *viewport = dynamic_cast<nmc::DkBaseViewPort *>(parent());
+    QImage img = viewport ? viewport->getImage() : QImage();
+
+    if (img.isNull())
+        return false;
+
+    if (img.cacheKey() == mImg.cacheKey())
+        return true;
+
+    mImg = img;
+    mLayer = QImage(mImg.size(), QImage::Format_ARGB32_Premultiplied);
+    mLayer.fill(Qt::transparent);
+
+    // e.g. blurred regions depend on the image
+    mNumCommitted = qMin(mNumCommitted, (int)paths.size());
+
+    QPainter painter(&mLayer);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    for (int idx = 0; idx < mNumCommitted; idx++)
+        drawStroke(painter, idx);
+
+    return true;
+}
+
+/**
+ * Renders all paths that are not cached yet to the layer.
+ * Hence, each stroke is rasterized once rather than with every paint event.
+ **/
+void DkPaintViewPort::commitStrokes()
+{
+    if (!initLayer() || mNumCommitted >= paths.size())
+        return;
+
+    QPainter painter(&mLayer);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    for (int idx = mNumCommitted; idx < paths.size(); idx++) {
+        if (idx == paths.size() - 1 && !mStrokeRect.isEmpty())
+            painter.drawImage(mStrokeRect, mStrokeLayer, mStrokeRect.translated(-mStrokeLayerRect.topLeft()));
+        else
+            drawStroke(painter, idx);
+    }
+
+    painter.end();
+
+    clearStrokeLayer();
+    mNumCommitted = paths.size();
+    mActiveRect = QRectF();
+}
+
+/**
+ * Rasterizes the newest segment of the current pencil stroke.
+ **/
+void DkPaintViewPort::addSegment(const QLineF &segment)
+{
+    if (mLayer.isNull())
+        return;
+
+    const QPen &pen = pathsPen.last();
+
+    qreal m = pen.widthF() * 0.5 + 2;
+    QRect r = QRectF(segment.p1(), segment.p2()).normalized().adjusted(-m, -m, m, m).toAlignedRect() & mLayer.rect();
+
+    if (r.isEmpty())
+        return;
+
+    // the layer only covers the stroke - it grows in steps so that we do not reallocate with every segment
+    QRect strokeRect = mStrokeRect | r;
+    if (!mStrokeLayerRect.contains(strokeRect)) {
+        const int growth = 256;
+        QRect lr = strokeRect.adjusted(-growth, -growth, growth, growth) & mLayer.rect();
+
+        QImage layer(lr.size(), QImage::Format_ARGB32_Premultiplied);
+        layer.fill(Qt::transparent);
+
+        if (!mStrokeLayer.isNull()) {
+            QPainter painter(&layer);
+            painter.setCompositionMode(QPainter::CompositionMode_Source);
+            painter.drawImage(mStrokeLayerRect.topLeft() - lr.topLeft(), mStrokeLayer);
         }
+
+        mStrokeLayer = layer;
+        mStrokeLayerRect = lr;
+    }
+
+    // we replace rather than blend -> overlapping segments of transparent pens do not get darker
+    QPainter painter(&mStrokeLayer);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.translate(-mStrokeLayerRect.topLeft());
+    painter.setPen(pen);
+    painter.drawLine(segment);
+    painter.end();
+
+    mStrokeRect = strokeRect;
+    update(imageToWidget(r));
+}
+
+void DkPaintViewPort::clearStrokeLayer()
+{
+    // the layer is released - the next stroke allocates its own region
+    mStrokeLayer = QImage();
+    mStrokeLayerRect = QRect();
+    mStrokeRect = QRect();
+}
+
+void DkPaintViewPort::drawStroke(QPainter &painter, int idx) const
+{
+    const QPainterPath &path = paths.at(idx);
+    const QPen &pen = pathsPen.at(idx);
+
+    painter.setPen(pen);
+
+    switch (pathsMode.at(idx)) {
+    case mode_arrow:
+        painter.fillPath(getArrowHead(path, pen.width()), QBrush(pen.color()));
+        painter.drawLine(getShorterLine(path, pen.width()));
+        break;
+    case mode_square_fill:
+    case mode_text:
+        painter.fillPath(path, QBrush(pen.color()));
+        break;
+    case mode_blur: {
+        QRect r = path.boundingRect().toAlignedRect() & mImg.rect();
+        if (!r.isEmpty())
+            painter.drawImage(r.topLeft(), blurredRegion(r, pen.width()));
+        break;
+    }
+    default:
+        painter.drawPath(path);
     }
+}
 
-    return QImage();
+/**
+ * Returns the blurred image (including previous strokes) within rect.
+ **/
+QImage DkPaintViewPort::blurredRegion(const QRect &rect, int radius) const
+{
+    QImage region = mImg.copy(rect).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    QPainter painter(&region);
+    painter.drawImage(QPoint(), mLayer, rect);
+    painter.end();
+
+    boxBlur(region, qMax(1, radius / 2));
+
+    return region;
+}
+
+// region that is covered by a path
+QRectF DkPaintViewPort::strokeRect(int idx) const
+{
+    // arrow heads exceed the pen's width
+    qreal m = pathsPen.at(idx).widthF() * 4 + ArrowHeight;
+    return paths.at(idx).boundingRect().adjusted(-m, -m, m, m);
+}
+
+QRect DkPaintViewPort::imageToWidget(const QRectF &rect) const
+{
+    QTransform t;
+    if (mWorldMatrix && mImgMatrix)
+        t = (*mImgMatrix) * (*mWorldMatrix);
+
+    return t.mapRect(rect).toAlignedRect().adjusted(-2, -2, 2, 2);
 }
 
 void DkPaintViewPort::setMode(int mode)
@@ -525,6 +732,13 @@ void DkPaintViewPort::clear()
     paths.clear();
     pathsPen.clear();
     pathsMode.clear();
+
+    // release the layers
+    mImg = QImage();
+    mLayer = QImage();
+    clearStrokeLayer();
+    mActiveRect = QRectF();
+    mNumCommitted = 0;
 }
 
 void DkPaintViewPort::setBrush(const QBrush &brush)
@@ -29,9 +29,6 @@
 
 #include <QAction>
 #include <QColorDialog>
-#include <QGraphicsBlurEffect>
-#include <QGraphicsPathItem>
-#include <QGraphicsSceneMouseEvent>
 #include <QImage>
 #include <QLineEdit>
 #include <QMainWindow>
@@ -84,7 +81,6 @@ public:
 
     QPainterPath getArrowHead(QPainterPath line, const int thickness);
     QLineF getShorterLine(QPainterPath line, const int thickness);
-    void getBlur(QPainterPath rect, QPainter *painter, QImage &img, int radius);
 
     QSharedPointer<nmc::DkImageContainer> runPlugin(const QString &runID = QString(),
                                                     QSharedPointer<nmc::DkImageContainer> image = QSharedPointer<nmc::DkImageContainer>()) const override;
@@ -142,6 +138,23 @@ protected:
     void loadSettings();
     void saveSettings() const;
 
+    bool initLayer();
+    void commitStrokes();
+    void addSegment(const QLineF &segment);
+    void clearStrokeLayer();
+    void drawStroke(QPainter &painter, int idx) const;
+    QImage blurredRegion(const QRect &rect, int radius) const;
+    QRectF strokeRect(int idx) const;
+    QRect imageToWidget(const QRectF &rect) const;
+
+    QImage mImg; // the image we paint on
+    QImage mLayer; // committed strokes (image resolution)
+    QImage mStrokeLayer; // the pencil stroke that is currently drawn (covers mStrokeLayerRect only)
+    QRect mStrokeLayerRect; // region of the image covered by mStrokeLayer
+    QRect mStrokeRect; // dirty region of mStrokeLayer (image coordinates)
+    QRectF mActiveRect; // last repainted region of the current shape
+    int mNumCommitted = 0; // number of paths rendered to mLayer
+
     QVector<QPainterPath> paths;
     QVector<QPen> pathsPen;
     QVector<int> pathsMode;
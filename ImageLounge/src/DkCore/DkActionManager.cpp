@@ -29,6 +29,7 @@
 #include "DkImageStorage.h"
 #include "DkSettings.h"
 #include "DkStatusBar.h"
+#include "DkTimer.h"
 #include "DkToolbars.h"
 #include "DkUtils.h"
 
@@ -424,6 +425,7 @@ QMenu *DkActionManager::createSortMenu(QWidget *parent)
     mSortMenu->addAction(mSortActions[menu_sort_file_size]);
     mSortMenu->addAction(mSortActions[menu_sort_date_created]);
     mSortMenu->addAction(mSortActions[menu_sort_date_modified]);
+    mSortMenu->addAction(mSortActions[menu_sort_date_taken]);
     mSortMenu->addAction(mSortActions[menu_sort_random]);
     mSortMenu->addSeparator();
     mSortMenu->addAction(mSortActions[menu_sort_ascending]);
@@ -595,6 +597,7 @@ QMenu *DkActionManager::createHelpMenu(QWidget *parent)
     mHelpMenu->addAction(mHelpActions[menu_help_update_translation]);
     mHelpMenu->addSeparator();
     mHelpMenu->addAction(mHelpActions[menu_help_bug]);
+    mHelpMenu->addAction(mHelpActions[menu_help_trace]);
     mHelpMenu->addAction(mHelpActions[menu_help_documentation]);
     mHelpMenu->addAction(mHelpActions[menu_help_about]);
 
@@ -616,6 +619,7 @@ QMenu *DkActionManager::createSyncMenu(QWidget *parent)
     mSyncMenu->addAction(mSyncActions[menu_sync_view]);
     mSyncMenu->addAction(mSyncActions[menu_sync_pos]);
     mSyncMenu->addAction(mSyncActions[menu_sync_arrange]);
+    mSyncMenu->addAction(mSyncActions[menu_sync_send_image]);
     mSyncMenu->addAction(mSyncActions[menu_sync_all_actions]);
 
     return mSyncMenu;
@@ -1106,6 +1110,12 @@ void DkActionManager::createActions(QWidget *parent)
     mSortActions[menu_sort_date_modified]->setCheckable(true);
     mSortActions[menu_sort_date_modified]->setChecked(DkSettingsManager::param().global().sortMode == DkSettings::sort_date_modified);
 
+    mSortActions[menu_sort_date_taken] = new QAction(QObject::tr("by Date &Taken"), parent);
+    mSortActions[menu_sort_date_taken]->setObjectName("menu_sort_date_taken");
+    mSortActions[menu_sort_date_taken]->setStatusTip(QObject::tr("Sort by the Date the Photo was Taken (EXIF)"));
+    mSortActions[menu_sort_date_taken]->setCheckable(true);
+    mSortActions[menu_sort_date_taken]->setChecked(DkSettingsManager::param().global().sortMode == DkSettings::sort_date_taken);
+
     mSortActions[menu_sort_random] = new QAction(QObject::tr("Random"), parent);
     mSortActions[menu_sort_random]->setObjectName("menu_sort_random");
     mSortActions[menu_sort_random]->setStatusTip(QObject::tr("Sort in Random Order"));
@@ -1448,6 +1458,11 @@ void DkActionManager::createActions(QWidget *parent)
     mHelpActions[menu_help_bug] = new QAction(QObject::tr("&Report a Bug"), parent);
     mHelpActions[menu_help_bug]->setStatusTip(QObject::tr("Report a Bug"));
 
+    mHelpActions[menu_help_trace] = new QAction(QObject::tr("Record &Performance Trace"), parent);
+    mHelpActions[menu_help_trace]->setStatusTip(QObject::tr("Records where time is spent and saves it as Chrome trace"));
+    mHelpActions[menu_help_trace]->setCheckable(true);
+    mHelpActions[menu_help_trace]->setChecked(DkTrace::isEnabled());
+
     mHelpActions[menu_help_update] = new QAction(QObject::tr("&Check for Updates"), parent);
     mHelpActions[menu_help_update]->setStatusTip(QObject::tr("check for updates"));
     mHelpActions[menu_help_update]->setDisabled(DkSettingsManager::param().sync().disableUpdateInteraction);
@@ -1473,6 +1488,10 @@ void DkActionManager::createActions(QWidget *parent)
     mSyncActions[menu_sync_arrange]->setStatusTip(QObject::tr("arrange connected instances"));
     mSyncActions[menu_sync_arrange]->setEnabled(false);
 
+    mSyncActions[menu_sync_send_image] = new QAction(QObject::tr("Send &Image"), parent);
+    mSyncActions[menu_sync_send_image]->setStatusTip(QObject::tr("send the current image to connected instances"));
+    mSyncActions[menu_sync_send_image]->setEnabled(false);
+
     mSyncActions[menu_sync_connect_all] = new QAction(QObject::tr("Connect &All"), parent);
     mSyncActions[menu_sync_connect_all]->setShortcut(QKeySequence(shortcut_connect_all));
     mSyncActions[menu_sync_connect_all]->setStatusTip(QObject::tr("connect all instances"));
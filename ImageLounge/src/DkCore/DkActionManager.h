@@ -146,6 +146,7 @@ public:
         menu_sort_date_created,
         menu_sort_date_modified,
         menu_sort_random,
+        menu_sort_date_taken,
         menu_sort_ascending,
         menu_sort_descending,
 
@@ -250,6 +251,7 @@ public:
         menu_sync_view,
         menu_sync_pos,
         menu_sync_arrange,
+        menu_sync_send_image,
         menu_sync_connect_all,
         menu_sync_all_actions,
 
@@ -266,6 +268,7 @@ public:
         menu_help_update,
         menu_help_update_translation,
         menu_help_bug,
+        menu_help_trace,
         menu_help_documentation,
         menu_help_about,
 
@@ -30,6 +30,7 @@
 #include "DkSettings.h"
 #include "DkShortcuts.h"
 #include "DkStatusBar.h"
+#include "DkTimer.h"
 #include "DkUtils.h"
 
 #pragma warning(push, 0) // no warnings from includes - begin
@@ -344,6 +345,8 @@ bool DkBaseViewPort::unloadImage(bool)
 // events --------------------------------------------------------------------
 void DkBaseViewPort::paintEvent(QPaintEvent *event)
 {
+    DK_TRACE_SCOPE("paint");
+
     QPainter painter(viewport());
 
     if (!mImgStorage.isEmpty()) {
@@ -544,7 +547,10 @@ void DkBaseViewPort::draw(QPainter &painter, double opacity)
         } else {
             if (mImgMatrix.m11() * mWorldMatrix.m11() - std::numeric_limits<double>::epsilon() < 1.0)
                 painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
-            painter.drawImage(mImgViewRect, img, img.rect());
+
+            // large images: only blit the visible region of the matching pyramid level
+            if (!mImgStorage.drawVisibleRegion(painter, mImgViewRect))
+                painter.drawImage(mImgViewRect, img, img.rect());
         }
     }
 
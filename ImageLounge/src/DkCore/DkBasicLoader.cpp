@@ -34,21 +34,30 @@
 #include "DkSettings.h"
 #include "DkTimer.h"
 #include "DkUtils.h" // just needed for qInfo() #ifdef
+#include <functional>
 #include <utility>
 
 #pragma warning(push, 0)
 #include <QBuffer>
+#include <QCache>
 #include <QColorSpace>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDebug>
 #include <QDir>
 #include <QFileInfo>
 #include <QIcon>
 #include <QImageWriter>
+#include <QMutex>
 #include <QNetworkProxyFactory>
 #include <QNetworkReply>
 #include <QObject>
 #include <QPixmap>
 #include <QRegularExpression>
+#include <QSaveFile>
+#include <QSet>
+#include <QTemporaryFile>
+#include <QtConcurrentMap>
 #include <QtConcurrentRun>
 
 #include <assert.h>
@@ -103,6 +112,297 @@
 
 namespace nmc
 {
+// DkEditImageData --------------------------------------------------------------------
+static const int sHistoryTileSize = 128;
+
+/**
+ * Keeps the pixels of a history item.
+ * The newest (and the current) item and its predecessor hold their full
+ * image. Older items store the compressed difference of all tiles that
+ * changed w.r.t. their successor. Items that do not fit into memory are written to a temp file.
+ **/
+class DkEditImageData
+{
+public:
+    DkEditImageData(const QImage &img)
+        : mImg(img)
+    {
+    }
+
+    bool isNull() const
+    {
+        return mImg.isNull() && !mNext && !mSpillFile;
+    }
+
+    QImage image() const;
+    float memory() const;
+
+    void rebase(const QSharedPointer<DkEditImageData> &next);
+    void detach();
+    void setCached(bool cached);
+    bool spill();
+
+    bool isSpilled() const
+    {
+        return !mSpillFile.isNull();
+    }
+
+protected:
+    static QByteArray computeDelta(const QImage &img, const QImage &next);
+    static QImage applyDelta(const QImage &next, const QByteArray &delta);
+    static QByteArray encodeImage(const QImage &img);
+    static QImage decodeImage(const QByteArray &data);
+
+    QImage mImg; // full image - or an empty image if we are stored as delta
+    QSharedPointer<DkEditImageData> mNext; // the successor our delta refers to
+    QByteArray mData; // compressed delta (or the full image if spilled)
+    QSharedPointer<QTemporaryFile> mSpillFile;
+};
+
+QImage DkEditImageData::image() const
+{
+    if (!mImg.isNull() || isNull())
+        return mImg;
+
+    DK_TRACE_SCOPE("restore history image");
+
+    QByteArray data = mData;
+
+    if (mSpillFile) {
+        mSpillFile->seek(0);
+        data = mSpillFile->readAll();
+    }
+
+    if (mNext)
+        return applyDelta(mNext->image(), data);
+
+    return decodeImage(data);
+}
+
+float DkEditImageData::memory() const
+{
+    float mem = (float)mData.size() / (1024.0f * 1024.0f);
+
+    if (!mImg.isNull())
+        mem += DkImage::getBufferSizeFloat(mImg.size(), mImg.depth());
+
+    return mem;
+}
+
+void DkEditImageData::rebase(const QSharedPointer<DkEditImageData> &next)
+{
+    if (!next || next.data() == this || isNull())
+        return;
+
+    QImage img = image();
+    QByteArray delta = computeDelta(img, next->image());
+
+    // different size or format - we need to keep the full image
+    if (delta.isEmpty())
+        return;
+
+    mImg = QImage();
+    mNext = next;
+    mData = delta;
+    mSpillFile.clear();
+}
+
+void DkEditImageData::detach()
+{
+    mImg = image();
+    mNext.clear();
+    mData.clear();
+    mSpillFile.clear();
+}
+
+void DkEditImageData::setCached(bool cached)
+{
+    if (cached)
+        mImg = image();
+    else if (mNext || mSpillFile)
+        mImg = QImage(); // we can restore the image if needed
+}
+
+bool DkEditImageData::spill()
+{
+    if (mSpillFile)
+        return true;
+
+    if (isNull())
+        return false;
+
+    QByteArray data = mNext ? mData : encodeImage(mImg);
+
+    auto file = QSharedPointer<QTemporaryFile>::create(QDir(QDir::tempPath()).filePath("nomacs-history-XXXXXX"));
+
+    if (!file->open() || file->write(data) != data.size() || !file->flush()) {
+        qWarning() << "[DkEditImage] cannot write history to" << file->fileName();
+        return false;
+    }
+
+    mSpillFile = file;
+    mData.clear();
+    mImg = QImage();
+
+    return true;
+}
+
+QByteArray DkEditImageData::computeDelta(const QImage &img, const QImage &next)
+{
+    if (img.isNull() || img.size() != next.size() || img.format() != next.format() || img.depth() < 8
+        || img.bytesPerLine() != next.bytesPerLine() || img.colorTable() != next.colorTable())
+        return QByteArray();
+
+    DK_TRACE_SCOPE("history delta");
+
+    const int bpp = img.depth() / 8;
+    const int ts = sHistoryTileSize;
+    const int numTilesX = (img.width() + ts - 1) / ts;
+    const int numTilesY = (img.height() + ts - 1) / ts;
+
+    QVector<QByteArray> tiles(numTilesX * numTilesY);
+
+    QVector<int> tileRows;
+    for (int tyIdx = 0; tyIdx < numTilesY; tyIdx++)
+        tileRows << tyIdx;
+
+    // store the (byte-wise) difference of all changed tiles
+    // small changes (e.g. brightness) compress much better than the old pixels
+    QtConcurrent::blockingMap(tileRows, [&](int tyIdx) {
+        const int y0 = tyIdx * ts;
+        const int th = qMin(ts, img.height() - y0);
+
+        for (int txIdx = 0; txIdx < numTilesX; txIdx++) {
+            const int x0 = txIdx * ts * bpp;
+            const int tw = qMin(ts, img.width() - txIdx * ts) * bpp;
+
+            bool changed = false;
+            for (int rIdx = y0; rIdx < y0 + th && !changed; rIdx++)
+                changed = memcmp(img.constScanLine(rIdx) + x0, next.constScanLine(rIdx) + x0, tw) != 0;
+
+            if (!changed)
+                continue;
+
+            QByteArray diff(tw * th, Qt::Uninitialized);
+            uchar *ptrD = reinterpret_cast<uchar *>(diff.data());
+
+            for (int rIdx = y0; rIdx < y0 + th; rIdx++) {
+                const uchar *ptrI = img.constScanLine(rIdx) + x0;
+                const uchar *ptrN = next.constScanLine(rIdx) + x0;
+
+                for (int cIdx = 0; cIdx < tw; cIdx++)
+                    *ptrD++ = (uchar)(ptrI[cIdx] - ptrN[cIdx]);
+            }
+
+            tiles[tyIdx * numTilesX + txIdx] = qCompress(diff, 1);
+        }
+    });
+
+    QByteArray delta;
+    QDataStream ds(&delta, QIODevice::WriteOnly);
+    ds << img.size() << img.colorSpace() << (qint32)ts;
+
+    qint32 numChanged = 0;
+    for (const QByteArray &t : tiles)
+        numChanged += t.isEmpty() ? 0 : 1;
+
+    ds << numChanged;
+
+    for (int idx = 0; idx < tiles.size(); idx++) {
+        if (!tiles[idx].isEmpty())
+            ds << (qint32)idx << tiles[idx];
+    }
+
+    return delta;
+}
+
+QImage DkEditImageData::applyDelta(const QImage &next, const QByteArray &delta)
+{
+    QDataStream ds(delta);
+
+    QSize size;
+    QColorSpace colorSpace;
+    qint32 ts = 0, numChanged = 0;
+    ds >> size >> colorSpace >> ts >> numChanged;
+
+    if (size != next.size() || ts <= 0) {
+        qWarning() << "[DkEditImage] history delta does not match" << size << "vs" << next.size();
+        return QImage();
+    }
+
+    QVector<QPair<qint32, QByteArray>> tiles(numChanged);
+    for (auto &t : tiles)
+        ds >> t.first >> t.second;
+
+    QImage img = next.copy();
+    img.setColorSpace(colorSpace);
+
+    const int bpp = img.depth() / 8;
+    const int numTilesX = (img.width() + ts - 1) / ts;
+    const qsizetype bpl = img.bytesPerLine();
+    uchar *bits = img.bits(); // detach before going parallel
+
+    QtConcurrent::blockingMap(tiles, [&](const QPair<qint32, QByteArray> &t) {
+        const QByteArray diff = qUncompress(t.second);
+        const int y0 = (t.first / numTilesX) * ts;
+        const int x0 = (t.first % numTilesX) * ts * bpp;
+        const int th = qMin(ts, img.height() - y0);
+        const int tw = qMin(ts, img.width() - (t.first % numTilesX) * ts) * bpp;
+
+        if (diff.size() != tw * th)
+            return;
+
+        const uchar *ptrD = reinterpret_cast<const uchar *>(diff.constData());
+
+        for (int rIdx = y0; rIdx < y0 + th; rIdx++) {
+            uchar *ptr = bits + rIdx * bpl + x0;
+
+            for (int cIdx = 0; cIdx < tw; cIdx++)
+                ptr[cIdx] = (uchar)(ptr[cIdx] + *ptrD++);
+        }
+    });
+
+    return img;
+}
+
+QByteArray DkEditImageData::encodeImage(const QImage &img)
+{
+    QByteArray data;
+    QDataStream ds(&data, QIODevice::WriteOnly);
+
+    ds << img.size() << (qint32)img.format() << img.colorTable() << img.colorSpace();
+    ds << qCompress(img.constBits(), img.sizeInBytes(), 1);
+
+    return data;
+}
+
+QImage DkEditImageData::decodeImage(const QByteArray &data)
+{
+    QDataStream ds(data);
+
+    QSize size;
+    qint32 format = QImage::Format_Invalid;
+    QVector<QRgb> colorTable;
+    QColorSpace colorSpace;
+    QByteArray bits;
+    ds >> size >> format >> colorTable >> colorSpace >> bits;
+
+    bits = qUncompress(bits);
+
+    QImage img(size, (QImage::Format)format);
+
+    if (img.isNull() || img.sizeInBytes() != bits.size()) {
+        qWarning() << "[DkEditImage] could not restore history image";
+        return QImage();
+    }
+
+    memcpy(img.bits(), bits.constData(), bits.size());
+    img.setColorTable(colorTable);
+    img.setColorSpace(colorSpace);
+
+    return img;
+}
+
 // DkEditImage --------------------------------------------------------------------
 
 DkEditImage::DkEditImage()
@@ -111,7 +411,7 @@ DkEditImage::DkEditImage()
 {
 }
 DkEditImage::DkEditImage(const QImage &img, const QSharedPointer<DkMetaDataT> &metaData, const QString &editName)
-    : mImg(img)
+    : mData(new DkEditImageData(img))
     , mMetaData(metaData)
     , mEditName(editName)
     , mNewImg(true)
@@ -121,7 +421,7 @@ DkEditImage::DkEditImage(const QImage &img, const QSharedPointer<DkMetaDataT> &m
 }
 
 DkEditImage::DkEditImage(const QSharedPointer<DkMetaDataT> &metaData, const QImage &img, const QString &editName)
-    : mImg(img)
+    : mData(new DkEditImageData(img))
     , mMetaData(metaData)
     , mEditName(editName)
     , mNewImg(false)
@@ -133,7 +433,7 @@ DkEditImage::DkEditImage(const QSharedPointer<DkMetaDataT> &metaData, const QIma
 bool DkEditImage::hasImage() const
 {
     // Every edit item has an image, but it may be the old/original one if only metadata has been edited
-    return !mImg.isNull();
+    return mData && !mData->isNull();
 }
 
 bool DkEditImage::hasMetaData() const
@@ -156,12 +456,12 @@ bool DkEditImage::hasNewMetaData() const
 
 void DkEditImage::setImage(const QImage &img)
 {
-    mImg = img;
+    mData = QSharedPointer<DkEditImageData>(new DkEditImageData(img));
 }
 
 QImage DkEditImage::image() const
 {
-    return mImg;
+    return mData ? mData->image() : QImage();
 }
 
 QSharedPointer<DkMetaDataT> DkEditImage::metaData() const
@@ -176,7 +476,39 @@ QString DkEditImage::editName() const
 
 int DkEditImage::size() const
 {
-    return qRound(DkImage::getBufferSizeFloat(mImg.size(), mImg.depth()));
+    return mData ? qRound(mData->memory()) : 0;
+}
+
+/// stores the image as difference to next (which must be the successor in the history)
+void DkEditImage::rebase(const DkEditImage &next)
+{
+    if (mData)
+        mData->rebase(next.mData);
+}
+
+/// makes the item independent of all other history items
+void DkEditImage::detach()
+{
+    if (mData)
+        mData->detach();
+}
+
+/// keeps the full image in memory (e.g. for the current history item)
+void DkEditImage::setCached(bool cached)
+{
+    if (mData)
+        mData->setCached(cached);
+}
+
+/// moves the item's image data to a temporary file
+bool DkEditImage::spill()
+{
+    return mData && mData->spill();
+}
+
+bool DkEditImage::isSpilled() const
+{
+    return mData && mData->isSpilled();
 }
 
 // Basic loader and image edit class --------------------------------------------------------------------
@@ -236,6 +568,8 @@ bool DkBasicLoader::loadGeneral(const QString &filePath, bool loadMetaData, bool
 
 bool DkBasicLoader::loadGeneral(const QString &filePath, QSharedPointer<QByteArray> ba, bool loadMetaData, bool fast)
 {
+    DK_TRACE_SCOPE("loadGeneral");
+
     DkTimer dt;
 
     mFile = DkUtils::resolveSymLink(filePath);
@@ -301,11 +635,12 @@ bool DkBasicLoader::loadGeneral(const QString &filePath, QSharedPointer<QByteArr
     // }
 
     // RAW tries early otherwise Qt's TIFF plugin is used
+    QSize rawFullSize; // set if RAW data was developed at half resolution
 #ifdef WITH_LIBRAW
     bool libRawUsed = false;
     if (loader.isNull() && rawFormats.contains(suffix)) {
         libRawUsed = true;
-        if (loadRAW(mFile, img, ba, fast))
+        if (loadRAW(mFile, img, ba, fast, &rawFullSize))
             loader = "raw";
     }
 #endif
@@ -349,7 +684,7 @@ bool DkBasicLoader::loadGeneral(const QString &filePath, QSharedPointer<QByteArr
     // - "image/jpeg" fixes #435 - thumbnail gets loaded in the RAW loader
     if (loader.isNull() && !libRawUsed && !qtFormats.contains(suffix) && mMetaData->getMimeType() != "image/jpeg") {
         // TODO: sometimes (e.g. _DSC6289.tif) strange opencv errors are thrown - catch them!
-        if (loadRAW(mFile, img, ba, fast))
+        if (loadRAW(mFile, img, ba, fast, &rawFullSize))
             loader = "raw-unknown-suffix";
     }
 #endif
@@ -449,6 +784,20 @@ bool DkBasicLoader::loadGeneral(const QString &filePath, QSharedPointer<QByteArr
         }
     }
 
+    // we decoded a preview only (see setTargetSize())
+    QSize decodedFullSize;
+    if (loader.startsWith("qt") && result.ok && result.img.size() != result.fullSize)
+        decodedFullSize = result.fullSize;
+    else if (loader.startsWith("raw"))
+        decodedFullSize = rawFullSize;
+
+    if (!decodedFullSize.isEmpty()) {
+        mFullSize = decodedFullSize;
+
+        if ((img.width() > img.height()) != (mFullSize.width() > mFullSize.height()))
+            mFullSize.transpose();
+    }
+
     if (!loader.isNull()) {
         setEditImage(img, tr("Original Image"));
 
@@ -495,8 +844,33 @@ bool DkBasicLoader::loadGeneral(const QString &filePath, QSharedPointer<QByteArr
     return !loader.isNull();
 }
 
+/**
+ * Returns the smallest size that covers target if the image is rotated or not.
+ * @return an empty size if the image is not (much) larger than target
+ **/
+static QSize decodeSize(const QSize &imgSize, const QSize &target)
+{
+    if (imgSize.isEmpty() || target.isEmpty())
+        return QSize();
+
+    double sx = (double)target.width() / imgSize.width();
+    double sy = (double)target.height() / imgSize.height();
+    double sxr = (double)target.height() / imgSize.width();
+    double syr = (double)target.width() / imgSize.height();
+
+    double scale = qMax(qMin(sx, sy), qMin(sxr, syr));
+
+    // not worth it
+    if (scale > 0.75)
+        return QSize();
+
+    return QSize(qCeil(imgSize.width() * scale), qCeil(imgSize.height() * scale));
+}
+
 DkBasicLoader::LoaderResult DkBasicLoader::loadQt(const QString &filePath, QSharedPointer<QByteArray> ba, const QByteArray &format)
 {
+    DK_TRACE_SCOPE("decode Qt");
+
     LoaderResult result;
 
     std::unique_ptr<QIODevice> device;
@@ -516,6 +890,17 @@ DkBasicLoader::LoaderResult DkBasicLoader::loadQt(const QString &filePath, QShar
     qir.setAutoDetectImageFormat(format.isEmpty());
     qir.setFormat(format);
 
+    // browsing: let the codec decode a smaller image (if it can do that faster than decoding everything)
+    if (!mTargetSize.isEmpty() && qir.supportsOption(QImageIOHandler::ScaledSize)) {
+        QSize fullSize = qir.size();
+        QSize scaledSize = decodeSize(fullSize, mTargetSize);
+
+        if (!scaledSize.isEmpty()) {
+            qir.setScaledSize(scaledSize);
+            result.fullSize = fullSize;
+        }
+    }
+
     // load the largest icon (height*depth)
     int index = -1;
     if (format == "ico" || format == "icns") {
@@ -621,16 +1006,26 @@ bool DkBasicLoader::loadTGA(const QString &filePath, QImage &img, QSharedPointer
     return success;
 }
 
-bool DkBasicLoader::loadRAW(const QString &filePath, QImage &img, QSharedPointer<QByteArray> ba, bool fast) const
+bool DkBasicLoader::loadRAW(const QString &filePath, QImage &img, QSharedPointer<QByteArray> ba, bool fast, QSize *fullSize) const
 {
+    DK_TRACE_SCOPE("decode RAW");
+
     DkRawLoader rawLoader(filePath, mMetaData);
     rawLoader.setLoadFast(fast);
 
+    // half resolution is only used for browsing (see setTargetSize()),
+    // editing, saving and batch processing always get the full resolution
+    rawLoader.setHalfSize(DkSettingsManager::param().resources().halfSizeRawImages && !mTargetSize.isEmpty() && fullSize);
+
     bool success = rawLoader.load(ba);
 
-    if (success)
+    if (success) {
         img = rawLoader.image();
 
+        if (fullSize)
+            *fullSize = rawLoader.fullSize();
+    }
+
     return success;
 }
 
@@ -641,6 +1036,8 @@ bool DkBasicLoader::loadPSD(const QString &, QImage &, QSharedPointer<QByteArray
 #else
 bool DkBasicLoader::loadPSD(const QString &filePath, QImage &img, QSharedPointer<QByteArray> ba) const
 {
+    DK_TRACE_SCOPE("decode PSD");
+
     // load from file?
     if (!ba || ba->isEmpty()) {
         QFile file(filePath);
@@ -677,6 +1074,40 @@ bool DkBasicLoader::loadPSD(const QString &filePath, QImage &img, QSharedPointer
     return false;
 }
 
+#if defined(WITH_LIBTIFF) && defined(Q_OS_WIN)
+/**
+ * Read-only std::streambuf on top of a file buffer.
+ * It lets libtiff's TIFFStreamOpen read (mapped) buffers without copying them.
+ **/
+class DkMemoryStreamBuf : public std::streambuf
+{
+public:
+    DkMemoryStreamBuf(QSharedPointer<QByteArray> ba)
+    {
+        char *data = ba ? const_cast<char *>(ba->constData()) : nullptr;
+        qint64 size = ba ? ba->size() : 0;
+        setg(data, data, data + size);
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in) override
+    {
+        char *pos = (dir == std::ios_base::beg) ? eback() + off : (dir == std::ios_base::cur) ? gptr() + off : egptr() + off;
+
+        if (!(which & std::ios_base::in) || pos < eback() || pos > egptr())
+            return pos_type(off_type(-1));
+
+        setg(eback(), pos, egptr());
+        return pos_type(pos - eback());
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+#endif
+
 #ifndef WITH_LIBTIFF
 bool DkBasicLoader::loadTIFF(const QString &, QImage &, QSharedPointer<QByteArray>) const
 {
@@ -684,6 +1115,8 @@ bool DkBasicLoader::loadTIFF(const QString &, QImage &, QSharedPointer<QByteArra
 #else
 bool DkBasicLoader::loadTIFF(const QString &filePath, QImage &img, QSharedPointer<QByteArray> ba) const
 {
+    DK_TRACE_SCOPE("decode TIFF");
+
     bool success = false;
 
     // first turn off nasty warning/error dialogs - (we do the GUI : )
@@ -697,7 +1130,8 @@ bool DkBasicLoader::loadTIFF(const QString &filePath, QImage &img, QSharedPointe
 // TODO: currently TIFFStreamOpen can only be linked on Windows?!
 #if defined(Q_OS_WIN)
 
-    std::istringstream is(ba ? ba->toStdString() : "");
+    DkMemoryStreamBuf isBuf(ba);
+    std::istream is(&isBuf);
 
     if (ba)
         tiff = TIFFStreamOpen("MemTIFF", &is);
@@ -714,7 +1148,8 @@ bool DkBasicLoader::loadTIFF(const QString &filePath, QImage &img, QSharedPointe
     if (!tiff)
         bal = loadFileToBuffer(filePath);
 
-    std::istringstream isl(bal ? bal->toStdString() : "");
+    DkMemoryStreamBuf islBuf(bal);
+    std::istream isl(&islBuf);
 
     if (bal)
         tiff = TIFFStreamOpen("MemTIFF", &isl);
@@ -911,6 +1346,7 @@ bool DkBasicLoader::loadDRIF(const QString &filePath, QImage &img, QSharedPointe
 void DkBasicLoader::setImage(const QImage &img, const QString &editName, const QString &file)
 {
     mFile = file;
+    mFullSize = QSize();
     setEditImage(img, editName);
 }
 
@@ -920,6 +1356,10 @@ void DkBasicLoader::pruneEditHistory()
     for (int idx = mImages.size() - 1; idx > mImageIndex; idx--) {
         mImages.pop_back();
     }
+
+    // the last item must not refer to the deleted states
+    if (!mImages.isEmpty())
+        mImages.last().detach();
 }
 
 void DkBasicLoader::setEditImage(const QImage &img, const QString &editName)
@@ -930,25 +1370,48 @@ void DkBasicLoader::setEditImage(const QImage &img, const QString &editName)
     // delete all hidden edit states
     pruneEditHistory();
 
-    // compute new history size
-    int historySize = 0;
-    for (const DkEditImage &e : mImages) {
-        historySize += e.size();
-    }
-
     // reset exif orientation after image edit
     if (!mImages.isEmpty())
         mMetaData->clearOrientation();
     // new history item with new pixmap (and old or original metadata)
     DkEditImage newImg(img, mMetaData->copy(), editName); // new image, old/unchanged metadata
 
-    if (historySize + newImg.size() > DkSettingsManager::param().resources().historyMemory && mImages.size() > mMinHistorySize) {
-        mImages.removeAt(1);
-        qWarning() << "removing history image because it's too large:" << historySize + newImg.size() << "MB";
-    }
+    appendEdit(newImg, true);
+}
+
+void DkBasicLoader::appendEdit(const DkEditImage &edit, bool dropOldEdits)
+{
+    // the previous state keeps its full image since extended manipulators are re-applied to it
+    // (see DkViewPort::manipulatorSource()), older states just keep the tiles that differ from their successor
+    if (mImages.size() > 1)
+        mImages[mImages.size() - 2].rebase(mImages.last());
 
-    mImages.append(newImg);
+    mImages.append(edit);
     mImageIndex = mImages.size() - 1; // set the index again to the last
+
+    // compute new history size
+    int historySize = 0;
+    for (const DkEditImage &e : std::as_const(mImages)) {
+        historySize += e.size();
+    }
+
+    int maxHistorySize = qRound(DkSettingsManager::param().resources().historyMemory);
+
+    // move the oldest states to a temp file
+    for (int idx = 0; idx < mImages.size() - 2 && historySize > maxHistorySize; idx++) {
+        int size = mImages[idx].size();
+
+        if (size > 0 && mImages[idx].spill())
+            historySize -= size;
+    }
+
+    // we cannot spill (e.g. no temp space) -> drop history states
+    if (dropOldEdits && historySize > maxHistorySize && mImages.size() > mMinHistorySize && mImages.size() > 2) {
+        mImages[0].rebase(mImages[2]);
+        mImages.removeAt(1);
+        mImageIndex = mImages.size() - 1;
+        qWarning() << "removing history image because it's too large:" << historySize << "MB";
+    }
 }
 
 void DkBasicLoader::setEditMetaData(const QSharedPointer<DkMetaDataT> &metaData, const QImage &img, const QString &editName)
@@ -961,8 +1424,7 @@ void DkBasicLoader::setEditMetaData(const QSharedPointer<DkMetaDataT> &metaData,
     // new history item with new metadata (and image, but hasNewImage() will be false)
     DkEditImage newImg(metaData->copy(), img, editName); // new metadata, old/unchanged image
 
-    mImages.append(newImg);
-    mImageIndex = mImages.size() - 1; // set the index again to the last
+    appendEdit(newImg);
 }
 
 void DkBasicLoader::setEditMetaData(const QSharedPointer<DkMetaDataT> &metaData, const QString &editName)
@@ -1070,7 +1532,7 @@ void DkBasicLoader::undo()
 {
     // Change history index (for image()...)
     if (mImageIndex > 0)
-        mImageIndex--;
+        setHistoryIndex(mImageIndex - 1);
 
     // Get last history item with modified metadata (up until new history index)
     QSharedPointer<DkMetaDataT> metaData(mMetaData);
@@ -1088,7 +1550,7 @@ void DkBasicLoader::redo()
 {
     // Change history index (for image()...)
     if (mImageIndex < mImages.size() - 1)
-        mImageIndex++;
+        setHistoryIndex(mImageIndex + 1);
 
     // Get last history item with modified metadata (up until new history index)
     QSharedPointer<DkMetaDataT> metaData(mMetaData);
@@ -1118,84 +1580,404 @@ int DkBasicLoader::historyIndex() const
     return mImageIndex;
 }
 
-void DkBasicLoader::setMinHistorySize(int size)
-{
-    mMinHistorySize = size;
+void DkBasicLoader::setMinHistorySize(int size)
+{
+    mMinHistorySize = size;
+}
+
+void DkBasicLoader::setHistoryIndex(int idx)
+{
+    // keep the current state in memory - older states are restored from their deltas
+    if (mImageIndex >= 0 && mImageIndex < mImages.size() - 1)
+        mImages[mImageIndex].setCached(false);
+
+    mImageIndex = idx;
+
+    if (mImageIndex >= 0 && mImageIndex < mImages.size())
+        mImages[mImageIndex].setCached(true);
+
+    // TODO update mMetaData, see undo()
+}
+
+// QByteArray DkBasicLoader::loadFileToBuffer(const QString &filePath) const
+// {
+//     QFileInfo fi(filePath);
+
+//     if (!fi.exists())
+//         return;
+
+// #ifdef WITH_QUAZIP
+//     if (fi.dir().path().contains(DkZipContainer::zipMarker()))
+//         DkZipContainer::extractImage(DkZipContainer::decodeZipFile(filePath), DkZipContainer::decodeImageFile(filePath), ba);
+// #endif
+
+//     QFile file(filePath);
+//     file.open(QIODevice::ReadOnly);
+
+//     ba = file.readAll();
+// }
+
+QSharedPointer<QByteArray> DkBasicLoader::loadFileToBuffer(const QString &filePath) const
+{
+    QFileInfo fi(filePath);
+
+#ifdef WITH_QUAZIP
+    if (fi.dir().path().contains(DkZipContainer::zipMarker()))
+        return DkZipContainer::extractImage(DkZipContainer::decodeZipFile(filePath), DkZipContainer::decodeImageFile(filePath));
+#endif
+
+    return mapFileToBuffer(filePath);
+}
+
+// mapping small files is not worth it
+static const qint64 sMinMappedFileSize = 256 * 1024;
+
+/**
+ * Returns a read-only buffer of the file that is memory mapped.
+ * Nothing is copied - pages are read when a decoder accesses them.
+ * The file stays mapped (and open) until the last QSharedPointer is released,
+ * so mapped buffers should only be kept for one decode - not in caches.
+ * Do not keep (shallow) copies of the QByteArray beyond that.
+ * Modifying the buffer detaches (copies) it.
+ * Small files and files that cannot be mapped are read into memory.
+ * @param filePath the file
+ * @return QSharedPointer<QByteArray> the file buffer
+ **/
+QSharedPointer<QByteArray> DkBasicLoader::mapFileToBuffer(const QString &filePath)
+{
+    QSharedPointer<QFile> file(new QFile(filePath));
+
+    if (!file->open(QIODevice::ReadOnly))
+        return QSharedPointer<QByteArray>(new QByteArray());
+
+    // mapped files cannot be deleted or replaced on windows
+#ifndef Q_OS_WIN
+    if (file->size() >= sMinMappedFileSize) {
+        const char *data = reinterpret_cast<const char *>(file->map(0, file->size()));
+
+        if (data) {
+            // the deleter owns the file (and with it the mapping)
+            return QSharedPointer<QByteArray>(new QByteArray(QByteArray::fromRawData(data, file->size())), [file](QByteArray *ba) {
+                delete ba;
+                file->close();
+            });
+        }
+    }
+#endif
+
+    return QSharedPointer<QByteArray>(new QByteArray(file->readAll()));
+}
+
+/**
+ * Returns true if ba references a mapped file (see mapFileToBuffer).
+ **/
+bool DkBasicLoader::isMappedBuffer(const QSharedPointer<QByteArray> &ba)
+{
+    // QByteArray::fromRawData() does not allocate - so the array has no capacity
+    return ba && !ba->isEmpty() && ba->capacity() == 0;
+}
+
+/**
+ * @brief writeBufferToFile() writes the passed in file buffer to the specified file.
+ *
+ * It's called by the save() routine, which saves the image to that file buffer
+ * and updates that file buffer to also contain exif data.
+ *
+ * @param fileInfo path to file to be written
+ * @param ba raw content to be written to file
+ */
+bool DkBasicLoader::writeBufferToFile(const QString &fileInfo, const QSharedPointer<QByteArray> ba) const
+{
+    if (!ba || ba->isEmpty())
+        return false;
+
+    // the file might be mapped (see mapFileToBuffer) - so we
+    // replace it rather than truncating it while it is in use
+    QSaveFile file(fileInfo);
+    file.setDirectWriteFallback(true);
+    file.open(QIODevice::WriteOnly);
+    qint64 bytesWritten = file.write(*ba.data(), ba->size());
+    qDebug() << "[DkBasicLoader] buffer saved, bytes written: " << bytesWritten;
+
+    if (!bytesWritten || bytesWritten == -1) {
+        file.cancelWriting();
+        return false;
+    }
+
+    return file.commit();
+}
+
+#ifdef WITH_LIBTIFF
+/**
+ * Silences libtiff's warning & error handlers (we do the GUI : ) while it is alive.
+ * It is ref counted because pages are decoded concurrently.
+ **/
+class DkTiffQuietScope
+{
+public:
+    DkTiffQuietScope()
+    {
+        QMutexLocker locker(&mutex());
+        if (refCount()++ == 0) {
+            oldWarningHandler() = TIFFSetWarningHandler(NULL);
+            oldErrorHandler() = TIFFSetErrorHandler(NULL);
+        }
+    }
+
+    ~DkTiffQuietScope()
+    {
+        QMutexLocker locker(&mutex());
+        if (--refCount() == 0) {
+            TIFFSetWarningHandler(oldWarningHandler());
+            TIFFSetErrorHandler(oldErrorHandler());
+        }
+    }
+
+private:
+    static QMutex &mutex()
+    {
+        static QMutex m;
+        return m;
+    }
+
+    static int &refCount()
+    {
+        static int c = 0;
+        return c;
+    }
+
+    static TIFFErrorHandler &oldWarningHandler()
+    {
+        static TIFFErrorHandler h = NULL;
+        return h;
+    }
+
+    static TIFFErrorHandler &oldErrorHandler()
+    {
+        static TIFFErrorHandler h = NULL;
+        return h;
+    }
+};
+
+// libtiff client procs that read from a (mapped) file buffer -------------------------------------------
+struct DkTiffBuffer {
+    QSharedPointer<QByteArray> ba;
+    toff_t pos = 0;
+};
+
+static tmsize_t tiffBufferRead(thandle_t handle, void *buf, tmsize_t size)
+{
+    DkTiffBuffer *b = static_cast<DkTiffBuffer *>(handle);
+    toff_t baSize = b->ba->size();
+
+    if (size <= 0 || b->pos >= baSize)
+        return 0;
+
+    tmsize_t n = (tmsize_t)qMin<toff_t>(size, baSize - b->pos);
+    memcpy(buf, b->ba->constData() + b->pos, n);
+    b->pos += n;
+
+    return n;
+}
+
+static tmsize_t tiffBufferWrite(thandle_t, void *, tmsize_t)
+{
+    return 0;
+}
+
+static toff_t tiffBufferSeek(thandle_t handle, toff_t offset, int whence)
+{
+    DkTiffBuffer *b = static_cast<DkTiffBuffer *>(handle);
+
+    if (whence == SEEK_CUR)
+        offset += b->pos;
+    else if (whence == SEEK_END)
+        offset += b->ba->size();
+
+    b->pos = offset;
+    return b->pos;
+}
+
+static int tiffBufferClose(thandle_t)
+{
+    return 0;
+}
+
+static toff_t tiffBufferSize(thandle_t handle)
+{
+    return static_cast<DkTiffBuffer *>(handle)->ba->size();
+}
+
+// libtiff reads strips directly from the buffer if we 'map' it
+static int tiffBufferMap(thandle_t handle, void **base, toff_t *size)
+{
+    DkTiffBuffer *b = static_cast<DkTiffBuffer *>(handle);
+    *base = const_cast<char *>(b->ba->constData());
+    *size = b->ba->size();
+
+    return 1;
+}
+
+static void tiffBufferUnmap(thandle_t, void *, toff_t)
+{
+}
+
+/**
+ * Decodes the TIFF page whose IFD starts at ifdOffset.
+ * This function is thread-safe, so neighbouring pages can be decoded in the background.
+ **/
+static QImage decodeTiffPage(QSharedPointer<QByteArray> ba, quint64 ifdOffset)
+{
+    DK_TRACE_SCOPE("decode TIFF page");
+
+    if (!ba || ba->isEmpty())
+        return QImage();
+
+    DkTiffQuietScope quiet;
+    DkTiffBuffer buffer;
+    buffer.ba = ba;
+
+    TIFF *tiff = TIFFClientOpen("MemTIFF",
+                                "r",
+                                &buffer,
+                                tiffBufferRead,
+                                tiffBufferWrite,
+                                tiffBufferSeek,
+                                tiffBufferClose,
+                                tiffBufferSize,
+                                tiffBufferMap,
+                                tiffBufferUnmap);
+
+    if (!tiff)
+        return QImage();
+
+    QImage img;
+
+    // seek to the page - no need to walk the IFD chain
+    if (TIFFSetSubDirectory(tiff, ifdOffset)) {
+        uint32_t width = 0;
+        uint32_t height = 0;
+
+        TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &height);
+
+        img = QImage(width, height, QImage::Format_ARGB32);
+
+        const int stopOnError = 1;
+        if (img.isNull() || !TIFFReadRGBAImageOriented(tiff, width, height, reinterpret_cast<uint32_t *>(img.bits()), ORIENTATION_TOPLEFT, stopOnError))
+            img = QImage();
+    }
+
+    TIFFClose(tiff);
+
+    // libtiff writes ABGR
+    return std::move(img).rgbSwapped();
 }
 
-void DkBasicLoader::setHistoryIndex(int idx)
+/**
+ * Returns the IFD offsets of all pages of a TIFF file (classic & BigTIFF).
+ * We walk the IFD chain ourselves since this only needs the entry counts and the next-IFD links,
+ * which is way faster than letting libtiff parse every directory.
+ **/
+static QVector<quint64> readTiffPageOffsets(const QByteArray &ba)
 {
-    mImageIndex = idx;
-    // TODO update mMetaData, see undo()
-}
+    QVector<quint64> offsets;
 
-// QByteArray DkBasicLoader::loadFileToBuffer(const QString &filePath) const
-// {
-//     QFileInfo fi(filePath);
+    const uchar *data = reinterpret_cast<const uchar *>(ba.constData());
+    const quint64 size = ba.size();
 
-//     if (!fi.exists())
-//         return;
+    if (size < 8)
+        return offsets;
 
-// #ifdef WITH_QUAZIP
-//     if (fi.dir().path().contains(DkZipContainer::zipMarker()))
-//         DkZipContainer::extractImage(DkZipContainer::decodeZipFile(filePath), DkZipContainer::decodeImageFile(filePath), ba);
-// #endif
+    bool bigEndian = false;
+    if (data[0] == 'M' && data[1] == 'M')
+        bigEndian = true;
+    else if (data[0] != 'I' || data[1] != 'I')
+        return offsets;
 
-//     QFile file(filePath);
-//     file.open(QIODevice::ReadOnly);
+    auto read = [&](quint64 pos, int numBytes) -> quint64 {
+        quint64 val = 0;
+        for (int idx = 0; idx < numBytes; idx++)
+            val |= quint64(data[pos + idx]) << (bigEndian ? 8 * (numBytes - 1 - idx) : 8 * idx);
+        return val;
+    };
 
-//     ba = file.readAll();
-// }
+    const quint64 version = read(2, 2);
+    const bool bigTiff = version == 43;
 
-QSharedPointer<QByteArray> DkBasicLoader::loadFileToBuffer(const QString &filePath) const
-{
-    QFileInfo fi(filePath);
+    if (version != 42 && (!bigTiff || size < 16))
+        return offsets;
 
-#ifdef WITH_QUAZIP
-    if (fi.dir().path().contains(DkZipContainer::zipMarker()))
-        return DkZipContainer::extractImage(DkZipContainer::decodeZipFile(filePath), DkZipContainer::decodeImageFile(filePath));
-#endif
+    const int countSize = bigTiff ? 8 : 2;
+    const int entrySize = bigTiff ? 20 : 12;
+    const int offsetSize = bigTiff ? 8 : 4;
 
-    QFile file(filePath);
-    file.open(QIODevice::ReadOnly);
+    quint64 offset = bigTiff ? read(8, 8) : read(4, 4);
+    QSet<quint64> visited; // corrupted files may contain loops
 
-    QSharedPointer<QByteArray> ba(new QByteArray(file.readAll()));
-    file.close();
+    while (offset > 0 && offset <= size - countSize && !visited.contains(offset)) {
+        visited.insert(offset);
 
-    return ba;
+        const quint64 numEntries = read(offset, countSize);
+        const quint64 next = offset + countSize + numEntries * entrySize;
+
+        if (numEntries > size || next > size - offsetSize)
+            break;
+
+        offsets << offset;
+        offset = read(next, offsetSize);
+    }
+
+    return offsets;
 }
 
 /**
- * @brief writeBufferToFile() writes the passed in file buffer to the specified file.
- *
- * It's called by the save() routine, which saves the image to that file buffer
- * and updates that file buffer to also contain exif data.
- *
- * @param fileInfo path to file to be written
- * @param ba raw content to be written to file
- */
-bool DkBasicLoader::writeBufferToFile(const QString &fileInfo, const QSharedPointer<QByteArray> ba) const
+ * IFD offsets of recently opened multi-page TIFFs.
+ * The index is shared between loaders so that reopening a file does not walk it again.
+ **/
+struct DkTiffPageIndex {
+    qint64 fileSize = 0;
+    QDateTime modified;
+    QVector<quint64> offsets;
+};
+
+static QVector<quint64> tiffPageOffsets(const QString &filePath, const QByteArray &ba)
 {
-    if (!ba || ba->isEmpty())
-        return false;
+    static QMutex mutex;
+    static QCache<QString, DkTiffPageIndex> cache(100);
 
-    QFile file(fileInfo);
-    file.open(QIODevice::WriteOnly);
-    qint64 bytesWritten = file.write(*ba.data(), ba->size());
-    file.close();
-    qDebug() << "[DkBasicLoader] buffer saved, bytes written: " << bytesWritten;
+    const QFileInfo fInfo(filePath);
 
-    if (!bytesWritten || bytesWritten == -1)
-        return false;
+    {
+        QMutexLocker locker(&mutex);
+        DkTiffPageIndex *index = cache.object(fInfo.absoluteFilePath());
 
-    return true;
+        if (index && index->fileSize == fInfo.size() && index->modified == fInfo.lastModified())
+            return index->offsets;
+    }
+
+    DkTiffPageIndex *index = new DkTiffPageIndex();
+    index->fileSize = fInfo.size();
+    index->modified = fInfo.lastModified();
+    index->offsets = readTiffPageOffsets(ba);
+
+    QVector<quint64> offsets = index->offsets;
+
+    QMutexLocker locker(&mutex);
+    cache.insert(fInfo.absoluteFilePath(), index);
+
+    return offsets;
 }
+#endif // WITH_LIBTIFF
 
 void DkBasicLoader::indexPages(const QString &filePath, const QSharedPointer<QByteArray> ba)
 {
     // reset counters
     mNumPages = 1;
     mPageIdx = 1;
+    mPageOffsets.clear();
+    mPageBuffer.clear();
+    mPagePrefetch.clear();
 
 #ifdef WITH_LIBTIFF
 
@@ -1205,61 +1987,27 @@ void DkBasicLoader::indexPages(const QString &filePath, const QSharedPointer<QBy
     if (!fInfo.suffix().contains(QRegularExpression("(tif|tiff)", QRegularExpression::CaseInsensitiveOption)))
         return;
 
-    // first turn off nasty warning/error dialogs - (we do the GUI : )
-    TIFFErrorHandler oldErrorHandler, oldWarningHandler;
-    oldWarningHandler = TIFFSetWarningHandler(NULL);
-    oldErrorHandler = TIFFSetErrorHandler(NULL);
-
     DkTimer dt;
-    TIFF *tiff = 0;
-
-#if defined(Q_OS_WIN)
-    std::istringstream is(ba ? ba->toStdString() : "");
-
-    if (ba)
-        tiff = TIFFStreamOpen("MemTIFF", &is);
-
-    // read from file
-    if (!tiff)
-        tiff = TIFFOpen(filePath.toLatin1(), "r"); // this->mFile was here before - not sure why
 
     // loading from buffer allows us to load files with non-latin names
-    QSharedPointer<QByteArray> bal;
-    if (!tiff)
-        bal = loadFileToBuffer(filePath);
-    ;
-    std::istringstream isl(bal ? bal->toStdString() : "");
+    QSharedPointer<QByteArray> buffer = (ba && !ba->isEmpty()) ? ba : mapFileToBuffer(filePath);
 
-    if (bal)
-        tiff = TIFFStreamOpen("MemTIFF", &isl);
-#else
-    // read from file
-    tiff = TIFFOpen(filePath.toLatin1(), "r"); // this->mFile was here before - not sure why
-#endif
-
-    if (!tiff)
+    if (!buffer)
         return;
 
-    // libtiff example
-    int dircount = 0;
-
-    do {
-        dircount++;
-
-    } while (TIFFReadDirectory(tiff));
+    QVector<quint64> offsets = tiffPageOffsets(filePath, *buffer);
 
-    mNumPages = dircount;
-
-    if (mNumPages > 1)
-        mPageIdx = 1;
-
-    qDebug() << dircount << " TIFF directories... " << dt;
-    TIFFClose(tiff);
+    if (offsets.size() > 1) {
+        mNumPages = offsets.size();
+        mPageOffsets = offsets;
+        // keep it for page turns - mapped files are mapped again to not keep the file open
+        mPageBuffer = isMappedBuffer(buffer) ? QSharedPointer<QByteArray>() : buffer;
+    }
 
-    TIFFSetWarningHandler(oldWarningHandler);
-    TIFFSetWarningHandler(oldErrorHandler);
+    qDebug() << offsets.size() << " TIFF directories... " << dt;
 #else
     Q_UNUSED(filePath);
+    Q_UNUSED(ba);
 #endif
 }
 
@@ -1282,61 +2030,41 @@ bool DkBasicLoader::loadPageAt(int pageIdx)
 
 #ifdef WITH_LIBTIFF
 
-    // <= 1 since first page is loaded using qt
-    if (pageIdx > mNumPages || pageIdx < 1)
+    if (pageIdx > mNumPages || pageIdx < 1 || pageIdx > mPageOffsets.size())
         return imgLoaded;
 
-    // first turn off nasty warning/error dialogs - (we do the GUI : )
-    TIFFErrorHandler oldErrorHandler, oldWarningHandler;
-    oldWarningHandler = TIFFSetWarningHandler(NULL);
-    oldErrorHandler = TIFFSetErrorHandler(NULL);
-
     DkTimer dt;
-    TIFF *tiff = TIFFOpen(mFile.toLatin1(), "r");
-
-#if defined(Q_OS_WIN)
-
-    // loading from buffer allows us to load files with non-latin names
-    QSharedPointer<QByteArray> ba;
-    if (!tiff)
-        ba = loadFileToBuffer(mFile);
-
-    std::istringstream is(ba ? ba->toStdString() : "");
-    if (ba)
-        tiff = TIFFStreamOpen("MemTIFF", &is);
-#endif
+    QImage img;
 
-    if (!tiff)
-        return imgLoaded;
+    // the page was decoded in the background
+    if (mPagePrefetch.contains(pageIdx))
+        img = mPagePrefetch.value(pageIdx).result();
 
-    uint32_t width = 0;
-    uint32_t height = 0;
+    QSharedPointer<QByteArray> buffer = mPageBuffer ? mPageBuffer : mapFileToBuffer(mFile);
 
-    // go to current directory
-    for (int idx = 1; idx < pageIdx; idx++) {
-        if (!TIFFReadDirectory(tiff))
-            return false;
-    }
-    TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &width);
-    TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &height);
+    if (img.isNull())
+        img = decodeTiffPage(buffer, mPageOffsets[pageIdx - 1]);
 
-    // init the qImage
-    QImage img = QImage(width, height, QImage::Format_ARGB32);
+    imgLoaded = !img.isNull();
 
-    const int stopOnError = 1;
-    imgLoaded = TIFFReadRGBAImageOriented(tiff, width, height, reinterpret_cast<uint32_t *>(img.bits()), ORIENTATION_TOPLEFT, stopOnError) != 0;
+    // prefetch the neighbours - users typically flip through pages
+    // the first page is not prefetched since it is loaded with Qt
+    QMap<int, QFuture<QImage>> prefetch;
+    for (int idx : {pageIdx + 1, pageIdx - 1}) {
+        if (idx <= 1 || idx > mNumPages)
+            continue;
 
-    if (imgLoaded) {
-        for (uint32_t y = 0; y < height; ++y)
-            convert32BitOrder(img.scanLine(y), width);
+        if (mPagePrefetch.contains(idx))
+            prefetch.insert(idx, mPagePrefetch.value(idx));
+        else
+            prefetch.insert(idx, QtConcurrent::run(decodeTiffPage, buffer, mPageOffsets[idx - 1]));
     }
+    mPagePrefetch = prefetch;
 
-    TIFFClose(tiff);
-
-    TIFFSetWarningHandler(oldWarningHandler);
-    TIFFSetWarningHandler(oldErrorHandler);
+    qDebug() << "[DkBasicLoader] TIFF page" << pageIdx << "loaded in" << dt;
 
-    setEditImage(img, tr("Original Image"));
+    if (imgLoaded)
+        setEditImage(img, tr("Original Image"));
 #else
     Q_UNUSED(pageIdx);
 #endif
@@ -1396,6 +2124,8 @@ void DkBasicLoader::convert32BitOrder(void *buffer, int width) const
  */
 QString DkBasicLoader::save(const QString &filePath, const QImage &img, int compression)
 {
+    DK_TRACE_SCOPE("save");
+
     QSharedPointer<QByteArray> ba;
 
     DkTimer dt;
@@ -1616,11 +2346,83 @@ void DkBasicLoader::release()
 
     mImages.clear(); // clear history
     mImageIndex = -1;
+    mFullSize = QSize();
 
     // Unload metadata
     mMetaData = QSharedPointer<DkMetaDataT>(new DkMetaDataT());
 }
 
+void DkBasicLoader::setTargetSize(const QSize &size)
+{
+    mTargetSize = size;
+}
+
+QSize DkBasicLoader::targetSize() const
+{
+    return mTargetSize;
+}
+
+bool DkBasicLoader::isDownscaled() const
+{
+    return !mFullSize.isEmpty();
+}
+
+QSize DkBasicLoader::fullSize() const
+{
+    return isDownscaled() ? mFullSize : pixmap().size();
+}
+
+bool DkBasicLoader::loadFullSize(QSharedPointer<QByteArray> ba)
+{
+    if (!isDownscaled())
+        return false;
+
+    DkTimer dt;
+
+    // loadGeneral() releases everything - keep it in case we fail
+    QVector<DkEditImage> images = mImages;
+    int imageIndex = mImageIndex;
+    QSharedPointer<DkMetaDataT> metaData = mMetaData;
+    QSize fullSize = mFullSize;
+    QSize targetSize = mTargetSize;
+
+    mTargetSize = QSize();
+    bool loaded = loadGeneral(mFile, ba, true, false);
+    mTargetSize = targetSize;
+
+    if (!loaded) {
+        mImages = images;
+        mImageIndex = imageIndex;
+        mMetaData = metaData;
+        mFullSize = fullSize;
+        return false;
+    }
+
+    // keep unsaved changes (e.g. the rating)
+    if (metaData->isDirty())
+        mMetaData = metaData;
+
+    qInfo() << "[DkBasicLoader] full resolution image loaded in" << dt;
+
+    return true;
+}
+
+bool DkBasicLoader::setFullSize(const DkBasicLoader &loader)
+{
+    // the image was edited, reloaded or replaced in the meantime
+    if (!isDownscaled() || mImages.size() != 1 || loader.mFile != mFile)
+        return false;
+
+    if (loader.isDownscaled() || loader.mImages.size() != 1 || !loader.mImages.first().hasImage())
+        return false;
+
+    // our metadata is kept - it is shared with the metadata widgets
+    mImages.first().setImage(loader.mImages.first().image());
+    mFullSize = QSize();
+
+    return true;
+}
+
 #ifdef Q_OS_WIN
 // bool DkBasicLoader::saveWindowsIcon(const QString &filePath, const QImage &img) const
 // {
@@ -2167,6 +2969,20 @@ void DkRawLoader::setLoadFast(bool fast)
     mLoadFast = fast;
 }
 
+void DkRawLoader::setHalfSize(bool halfSize)
+{
+    mHalfSize = halfSize;
+}
+
+/**
+ * Returns the size of the fully developed image.
+ * @return QSize empty if the image was developed at full resolution
+ **/
+QSize DkRawLoader::fullSize() const
+{
+    return mFullSize;
+}
+
 bool DkRawLoader::load(const QSharedPointer<QByteArray> ba)
 {
     DkTimer dt;
@@ -2224,19 +3040,24 @@ bool DkRawLoader::load(const QSharedPointer<QByteArray> ba)
         if (error != LIBRAW_SUCCESS)
             return false;
 
-        // develop using libraw
-        error = iProcessor.dcraw_process();
+        // half size: bin the bayer quads ourselves - dcraw_process is far too slow for browsing
+        bool halfSize = mHalfSize && iProcessor.imgdata.idata.filters;
 
-        auto rimg = iProcessor.dcraw_make_mem_image();
+        if (!halfSize) {
+            // develop using libraw
+            error = iProcessor.dcraw_process();
 
-        if (rimg) {
-            mImg = QImage(rimg->data, rimg->width, rimg->height, rimg->width * 3, QImage::Format_RGB888);
-            mImg = mImg.copy(); // make a deep copy...
-            mImg.setColorSpace(QColorSpace(QColorSpace::SRgb));
-            LibRaw::dcraw_clear_mem(rimg);
-            mImg.setText("RAW.Loader", "Default");
-            mImg.setText("RAW.IsPreview", "no");
-            return true;
+            auto rimg = iProcessor.dcraw_make_mem_image();
+
+            if (rimg) {
+                mImg = QImage(rimg->data, rimg->width, rimg->height, rimg->width * 3, QImage::Format_RGB888);
+                mImg = mImg.copy(); // make a deep copy...
+                mImg.setColorSpace(QColorSpace(QColorSpace::SRgb));
+                LibRaw::dcraw_clear_mem(rimg);
+                mImg.setText("RAW.Loader", "Default");
+                mImg.setText("RAW.IsPreview", "no");
+                return true;
+            }
         }
 
         // demosaic image
@@ -2246,7 +3067,13 @@ bool DkRawLoader::load(const QSharedPointer<QByteArray> ba)
         info.insert("RAW.Loader", "Nomacs");
         info.insert("RAW.IsPreview", "no");
 
-        if (iProcessor.imgdata.idata.filters) {
+        if (halfSize)
+            rawMat = demosaicHalfSize(iProcessor);
+
+        bool binned = !rawMat.empty();
+        if (binned) {
+            info.insert("RAW.Processing", "Quad Binning");
+        } else if (iProcessor.imgdata.idata.filters) {
             rawMat = demosaic(iProcessor);
             info.insert("RAW.Processing", "Demosaic");
         } else {
@@ -2254,15 +3081,11 @@ bool DkRawLoader::load(const QSharedPointer<QByteArray> ba)
             info.insert("RAW.Processing", "Copy");
         }
 
-        // color correction + white balance
-        if (mIsChromatic)
-            whiteBalance(iProcessor, rawMat);
+        // color correction + white balance + gamma correction
+        develop(iProcessor, rawMat);
 
         info.insert("RAW.ColorCorrection", mIsChromatic ? "yes" : "no");
 
-        // gamma correction
-        gammaCorrection(iProcessor, rawMat);
-
         // reduce color noise
         bool noiseReduced = false;
         if (DkSettingsManager::param().resources().filterRawImages && mIsChromatic) {
@@ -2273,6 +3096,10 @@ bool DkRawLoader::load(const QSharedPointer<QByteArray> ba)
 
         mImg = raw2Img(iProcessor, rawMat);
 
+        // each bayer quad is one pixel
+        if (binned)
+            mFullSize = mImg.size() * 2;
+
         for (auto &key : std::as_const(info).keys())
             mImg.setText(key, info.value(key));
 
@@ -2406,24 +3233,90 @@ void DkRawLoader::detectSpecialCamera(const LibRaw &iProcessor)
     // add your camera flag (for hacks) here
 }
 
+/// runs fnc(fromRow, toRow) on blocks of rows in parallel
+static void rawRowBlocks(int numRows, const std::function<void(int, int)> &fnc)
+{
+    const int blockSize = 64;
+    QVector<int> blocks;
+    for (int rIdx = 0; rIdx < numRows; rIdx += blockSize)
+        blocks << rIdx;
+
+    QtConcurrent::blockingMap(blocks, [&](int startRow) {
+        fnc(startRow, qMin(startRow + blockSize, numRows));
+    });
+}
+
+/// 16.16 fixed point factor that maps [black maximum] to [0 USHRT_MAX]
+static qint64 rawScale(const LibRaw &iProcessor)
+{
+    int dynamicRange = qMax((int)iProcessor.imgdata.color.maximum - (int)iProcessor.imgdata.color.black, 1);
+    return qRound64((double)USHRT_MAX * 65536.0 / dynamicRange);
+}
+
+/// the integer version of clip<unsigned short>()
+static inline unsigned short clipRaw(qint64 val)
+{
+    // with -2 we do not get pink in oversaturated areas
+    if (val > USHRT_MAX)
+        return USHRT_MAX - 2;
+    if (val < 0)
+        return 0;
+
+    return (unsigned short)val;
+}
+
+static inline unsigned short normalizeRaw(int val, int black, qint64 scale)
+{
+    return clipRaw((qMax(val - black, 0) * scale + 32768) >> 16);
+}
+
+bool DkRawLoader::bayerPattern(LibRaw &iProcessor, int pattern[2][2]) const
+{
+    for (int rIdx = 0; rIdx < 2; rIdx++)
+        for (int cIdx = 0; cIdx < 2; cIdx++)
+            pattern[rIdx][cIdx] = iProcessor.COLOR(rIdx, cIdx);
+
+    // is it a plain 2x2 color filter array (e.g. not X-Trans)?
+    for (int rIdx = 0; rIdx < 16; rIdx++) {
+        for (int cIdx = 0; cIdx < 16; cIdx++) {
+            if (iProcessor.COLOR(rIdx, cIdx) != pattern[rIdx & 1][cIdx & 1])
+                return false;
+        }
+    }
+
+    return true;
+}
+
 cv::Mat DkRawLoader::demosaic(LibRaw &iProcessor) const
 {
+    DK_TRACE_SCOPE("RAW demosaic");
+
     cv::Mat rawMat = cv::Mat(iProcessor.imgdata.sizes.height, iProcessor.imgdata.sizes.width, CV_16UC1);
-    double dynamicRange = (double)(iProcessor.imgdata.color.maximum - iProcessor.imgdata.color.black);
 
-    // normalize all image values
-    for (int rIdx = 0; rIdx < rawMat.rows; rIdx++) {
-        unsigned short *ptrRaw = rawMat.ptr<unsigned short>(rIdx);
+    const int black = (int)iProcessor.imgdata.color.black;
+    const qint64 scale = rawScale(iProcessor);
+    const unsigned short(*image)[4] = iProcessor.imgdata.image;
+
+    int pattern[2][2];
+    bool periodic = bayerPattern(iProcessor, pattern);
+
+    // normalize all image values w.r.t the black point defined
+    rawRowBlocks(rawMat.rows, [&](int from, int to) {
+        for (int rIdx = from; rIdx < to; rIdx++) {
+            unsigned short *ptrRaw = rawMat.ptr<unsigned short>(rIdx);
+            const unsigned short(*ptrImg)[4] = image + (size_t)rawMat.cols * rIdx;
 
-        for (int cIdx = 0; cIdx < rawMat.cols; cIdx++) {
-            int colIdx = iProcessor.COLOR(rIdx, cIdx);
-            double val = (double)(iProcessor.imgdata.image[(rawMat.cols * rIdx) + cIdx][colIdx]);
+            if (periodic) {
+                const int *rowPattern = pattern[rIdx & 1];
 
-            // normalize the value w.r.t the black point defined
-            val = (val - iProcessor.imgdata.color.black) / dynamicRange;
-            ptrRaw[cIdx] = clip<unsigned short>(val * USHRT_MAX); // for conversion to 16U
+                for (int cIdx = 0; cIdx < rawMat.cols; cIdx++)
+                    ptrRaw[cIdx] = normalizeRaw(ptrImg[cIdx][rowPattern[cIdx & 1]], black, scale);
+            } else {
+                for (int cIdx = 0; cIdx < rawMat.cols; cIdx++)
+                    ptrRaw[cIdx] = normalizeRaw(ptrImg[cIdx][iProcessor.COLOR(rIdx, cIdx)], black, scale);
+            }
         }
-    }
+    });
 
     // no demosaicing
     if (mIsChromatic) {
@@ -2454,29 +3347,91 @@ cv::Mat DkRawLoader::demosaic(LibRaw &iProcessor) const
     return rawMat;
 }
 
+cv::Mat DkRawLoader::demosaicHalfSize(LibRaw &iProcessor) const
+{
+    DK_TRACE_SCOPE("RAW quad binning");
+
+    int pattern[2][2];
+    if (!bayerPattern(iProcessor, pattern))
+        return cv::Mat();
+
+    // find the quad positions of red, green & blue (colors are 0: R, 1: G, 2: B, 3: G2)
+    int rPos = -1, bPos = -1, g1Pos = -1, g2Pos = -1;
+    for (int idx = 0; idx < 4; idx++) {
+        int col = pattern[idx / 2][idx % 2];
+
+        if (col == 0)
+            rPos = idx;
+        else if (col == 2)
+            bPos = idx;
+        else if (g1Pos == -1)
+            g1Pos = idx;
+        else
+            g2Pos = idx;
+    }
+
+    if (mIsChromatic && (rPos == -1 || bPos == -1 || g2Pos == -1)) {
+        qWarning() << "[RAW] cannot bin" << iProcessor.imgdata.idata.filters << "pattern";
+        return cv::Mat();
+    }
+
+    const int width = iProcessor.imgdata.sizes.width;
+    cv::Mat rawMat = cv::Mat(iProcessor.imgdata.sizes.height / 2, width / 2, mIsChromatic ? CV_16UC3 : CV_16UC1);
+
+    const int black = (int)iProcessor.imgdata.color.black;
+    const qint64 scale = rawScale(iProcessor);
+    const unsigned short(*image)[4] = iProcessor.imgdata.image;
+
+    // each 2x2 quad becomes one pixel - no interpolation needed
+    rawRowBlocks(rawMat.rows, [&](int from, int to) {
+        int q[4];
+
+        for (int rIdx = from; rIdx < to; rIdx++) {
+            unsigned short *ptr = rawMat.ptr<unsigned short>(rIdx);
+            const unsigned short(*ptrImg0)[4] = image + (size_t)width * rIdx * 2;
+            const unsigned short(*ptrImg1)[4] = ptrImg0 + width;
+
+            for (int cIdx = 0; cIdx < rawMat.cols; cIdx++) {
+                int x = cIdx * 2;
+                q[0] = ptrImg0[x][pattern[0][0]];
+                q[1] = ptrImg0[x + 1][pattern[0][1]];
+                q[2] = ptrImg1[x][pattern[1][0]];
+                q[3] = ptrImg1[x + 1][pattern[1][1]];
+
+                if (mIsChromatic) {
+                    *ptr++ = normalizeRaw(q[rPos], black, scale);
+                    *ptr++ = normalizeRaw((q[g1Pos] + q[g2Pos] + 1) >> 1, black, scale);
+                    *ptr++ = normalizeRaw(q[bPos], black, scale);
+                } else
+                    *ptr++ = normalizeRaw((q[0] + q[1] + q[2] + q[3] + 2) >> 2, black, scale);
+            }
+        }
+    });
+
+    // 16U (1 or 3 channeled) Mat
+    return rawMat;
+}
+
 cv::Mat DkRawLoader::prepareImg(const LibRaw &iProcessor) const
 {
     cv::Mat rawMat = cv::Mat(iProcessor.imgdata.sizes.height, iProcessor.imgdata.sizes.width, CV_16UC3, cv::Scalar(0));
-    double dynamicRange = (double)(iProcessor.imgdata.color.maximum - iProcessor.imgdata.color.black);
 
-    // normalization function
-    auto normalize = [&](double val) {
-        val = (val - iProcessor.imgdata.color.black) / dynamicRange;
-        return clip<unsigned short>(val * USHRT_MAX);
-    };
+    const int black = (int)iProcessor.imgdata.color.black;
+    const qint64 scale = rawScale(iProcessor);
+    const unsigned short(*image)[4] = iProcessor.imgdata.image;
 
-    for (int rIdx = 0; rIdx < rawMat.rows; rIdx++) {
-        unsigned short *ptrI = rawMat.ptr<unsigned short>(rIdx);
+    rawRowBlocks(rawMat.rows, [&](int from, int to) {
+        for (int rIdx = from; rIdx < to; rIdx++) {
+            unsigned short *ptrI = rawMat.ptr<unsigned short>(rIdx);
+            const unsigned short(*ptrImg)[4] = image + (size_t)rawMat.cols * rIdx;
 
-        for (int cIdx = 0; cIdx < rawMat.cols; cIdx++) {
-            *ptrI = normalize(iProcessor.imgdata.image[rawMat.cols * rIdx + cIdx][0]);
-            ptrI++;
-            *ptrI = normalize(iProcessor.imgdata.image[rawMat.cols * rIdx + cIdx][1]);
-            ptrI++;
-            *ptrI = normalize(iProcessor.imgdata.image[rawMat.cols * rIdx + cIdx][2]);
-            ptrI++;
+            for (int cIdx = 0; cIdx < rawMat.cols; cIdx++) {
+                *ptrI++ = normalizeRaw(ptrImg[cIdx][0], black, scale);
+                *ptrI++ = normalizeRaw(ptrImg[cIdx][1], black, scale);
+                *ptrI++ = normalizeRaw(ptrImg[cIdx][2], black, scale);
+            }
         }
-    }
+    });
 
     return rawMat;
 }
@@ -2536,59 +3491,76 @@ cv::Mat DkRawLoader::gammaTable(const LibRaw &iProcessor) const
     return gmt;
 }
 
-void DkRawLoader::whiteBalance(const LibRaw &iProcessor, cv::Mat &img) const
-{
-    // white balance must not be empty at this point
-    cv::Mat wb = whiteMultipliers(iProcessor);
-    const float *wbp = wb.ptr<float>();
-    assert(wb.cols == 4);
-
-    for (int rIdx = 0; rIdx < img.rows; rIdx++) {
-        unsigned short *ptr = img.ptr<unsigned short>(rIdx);
-
-        for (int cIdx = 0; cIdx < img.cols; cIdx++) {
-            // apply white balance correction
-            unsigned short r = clip<unsigned short>(*ptr * wbp[0]);
-            unsigned short g = clip<unsigned short>(*(ptr + 1) * wbp[1]);
-            unsigned short b = clip<unsigned short>(*(ptr + 2) * wbp[2]);
-
-            // apply color correction
-            int cr =
-                qRound(iProcessor.imgdata.color.rgb_cam[0][0] * r + iProcessor.imgdata.color.rgb_cam[0][1] * g + iProcessor.imgdata.color.rgb_cam[0][2] * b);
-            int cg =
-                qRound(iProcessor.imgdata.color.rgb_cam[1][0] * r + iProcessor.imgdata.color.rgb_cam[1][1] * g + iProcessor.imgdata.color.rgb_cam[1][2] * b);
-            int cb =
-                qRound(iProcessor.imgdata.color.rgb_cam[2][0] * r + iProcessor.imgdata.color.rgb_cam[2][1] * g + iProcessor.imgdata.color.rgb_cam[2][2] * b);
-
-            // clip & save color corrected values
-            *ptr = clip<unsigned short>(cr);
-            ptr++;
-            *ptr = clip<unsigned short>(cg);
-            ptr++;
-            *ptr = clip<unsigned short>(cb);
-            ptr++;
-        }
-    }
-}
-
-void DkRawLoader::gammaCorrection(const LibRaw &iProcessor, cv::Mat &img) const
+void DkRawLoader::develop(const LibRaw &iProcessor, cv::Mat &img) const
 {
-    // white balance must not be empty at this point
+    DK_TRACE_SCOPE("RAW develop");
+
+    if (img.empty())
+        return;
+
+    // fuse the gamma table with the final 8-bit conversion
     cv::Mat gt = gammaTable(iProcessor);
     const unsigned short *gammaLookup = gt.ptr<unsigned short>();
     assert(gt.cols == USHRT_MAX);
 
-    for (int rIdx = 0; rIdx < img.rows; rIdx++) {
-        unsigned short *ptr = img.ptr<unsigned short>(rIdx);
+    QVector<uchar> lut(USHRT_MAX + 1);
+    for (int idx = 0; idx < lut.size(); idx++) {
+        // values close to 0 are treated linear
+        int val = (idx <= 5) // 0.018 * 255
+            ? qRound(idx * (double)iProcessor.imgdata.params.gamm[1] / 255.0)
+            : gammaLookup[qMin(idx, USHRT_MAX - 1)];
+        lut[idx] = (uchar)qBound(0, val, 255);
+    }
 
-        for (int cIdx = 0; cIdx < img.cols * img.channels(); cIdx++) {
-            // values close to 0 are treated linear
-            if (ptr[cIdx] <= 5) // 0.018 * 255
-                ptr[cIdx] = (unsigned short)qRound(ptr[cIdx] * (double)iProcessor.imgdata.params.gamm[1] / 255.0);
-            else
-                ptr[cIdx] = gammaLookup[ptr[cIdx]];
+    // white balance & color correction in 16.16 fixed point
+    bool correctColors = mIsChromatic && img.channels() == 3;
+    qint64 wb[3] = {0, 0, 0};
+    qint64 cm[3][3] = {};
+
+    if (correctColors) {
+        // white balance must not be empty at this point
+        cv::Mat wbm = whiteMultipliers(iProcessor);
+        const float *wbp = wbm.ptr<float>();
+        assert(wbm.cols == 4);
+
+        for (int idx = 0; idx < 3; idx++) {
+            wb[idx] = qRound64(wbp[idx] * 65536.0);
+
+            for (int cIdx = 0; cIdx < 3; cIdx++)
+                cm[idx][cIdx] = qRound64(iProcessor.imgdata.color.rgb_cam[idx][cIdx] * 65536.0);
         }
     }
+
+    cv::Mat dst(img.rows, img.cols, CV_8UC(img.channels()));
+    const uchar *gammaLut = lut.constData();
+
+    rawRowBlocks(img.rows, [&](int from, int to) {
+        for (int rIdx = from; rIdx < to; rIdx++) {
+            const unsigned short *ptr = img.ptr<unsigned short>(rIdx);
+            uchar *ptrD = dst.ptr<uchar>(rIdx);
+
+            if (!correctColors) {
+                for (int cIdx = 0; cIdx < img.cols * img.channels(); cIdx++)
+                    ptrD[cIdx] = gammaLut[ptr[cIdx]];
+                continue;
+            }
+
+            for (int cIdx = 0; cIdx < img.cols; cIdx++, ptr += 3, ptrD += 3) {
+                // apply white balance correction
+                qint64 r = clipRaw((ptr[0] * wb[0] + 32768) >> 16);
+                qint64 g = clipRaw((ptr[1] * wb[1] + 32768) >> 16);
+                qint64 b = clipRaw((ptr[2] * wb[2] + 32768) >> 16);
+
+                // apply color correction
+                ptrD[0] = gammaLut[clipRaw((cm[0][0] * r + cm[0][1] * g + cm[0][2] * b + 32768) >> 16)];
+                ptrD[1] = gammaLut[clipRaw((cm[1][0] * r + cm[1][1] * g + cm[1][2] * b + 32768) >> 16)];
+                ptrD[2] = gammaLut[clipRaw((cm[2][0] * r + cm[2][1] * g + cm[2][2] * b + 32768) >> 16)];
+            }
+        }
+    });
+
+    // 8U (1 or 3 channeled) Mat
+    img = dst;
 }
 
 void DkRawLoader::reduceColorNoise(const LibRaw &iProcessor, cv::Mat &img) const
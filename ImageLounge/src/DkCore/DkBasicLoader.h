@@ -30,6 +30,7 @@
 #pragma warning(push, 0)
 #include <QFutureWatcher>
 #include <QImageReader>
+#include <QMap>
 #include <QNetworkAccessManager>
 #include <QSharedPointer>
 #include <QUrl>
@@ -96,6 +97,14 @@ protected:
 };
 #endif
 
+class DkEditImageData;
+
+/**
+ * A history item of DkBasicLoader.
+ * Items older than the predecessor of the newest item do not keep their full image. They store the tiles
+ * that differ from their successor (see rebase()) and can be moved
+ * to a temporary file if the history gets too large (see spill()).
+ **/
 class DllCoreExport DkEditImage
 {
 public:
@@ -113,9 +122,15 @@ public:
     QSharedPointer<DkMetaDataT> metaData() const;
     int size() const;
 
+    void rebase(const DkEditImage &next);
+    void detach();
+    void setCached(bool cached);
+    bool spill();
+    bool isSpilled() const;
+
 protected:
     QString mEditName;
-    QImage mImg;
+    QSharedPointer<DkEditImageData> mData;
     bool mNewImg;
     bool mNewMetaData;
     QSharedPointer<DkMetaDataT> mMetaData;
@@ -128,16 +143,19 @@ public:
 
     bool isEmpty() const;
     void setLoadFast(bool fast);
+    void setHalfSize(bool halfSize);
 
     bool load(const QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
 
     QImage image() const;
+    QSize fullSize() const;
 
 protected:
     QString mFilePath;
     QSharedPointer<DkMetaDataT> mMetaData;
 
     QImage mImg;
+    QSize mFullSize; // empty if the image was developed at full resolution
 
     enum Cam {
         camera_unknown = 0,
@@ -148,6 +166,7 @@ protected:
     };
 
     bool mLoadFast = false;
+    bool mHalfSize = false;
     bool mIsChromatic = true;
     Cam mCamType = camera_unknown;
 
@@ -161,15 +180,15 @@ protected:
     bool openBuffer(const QSharedPointer<QByteArray> &ba, LibRaw &iProcessor) const;
     void detectSpecialCamera(const LibRaw &iProcessor);
 
+    bool bayerPattern(LibRaw &iProcessor, int pattern[2][2]) const;
     cv::Mat demosaic(LibRaw &iProcessor) const;
+    cv::Mat demosaicHalfSize(LibRaw &iProcessor) const;
     cv::Mat prepareImg(const LibRaw &iProcessor) const;
 
     cv::Mat whiteMultipliers(const LibRaw &iProcessor) const;
     cv::Mat gammaTable(const LibRaw &iProcessor) const;
 
-    void whiteBalance(const LibRaw &iProcessor, cv::Mat &img) const;
-
-    void gammaCorrection(const LibRaw &iProcessor, cv::Mat &img) const;
+    void develop(const LibRaw &iProcessor, cv::Mat &img) const;
 
     void reduceColorNoise(const LibRaw &iProcessor, cv::Mat &img) const;
 
@@ -370,10 +389,45 @@ public:
     int historyIndex() const;
 
     QSharedPointer<QByteArray> loadFileToBuffer(const QString &filePath) const;
+    static QSharedPointer<QByteArray> mapFileToBuffer(const QString &filePath);
+    static bool isMappedBuffer(const QSharedPointer<QByteArray> &ba);
     bool writeBufferToFile(const QString &fileInfo, const QSharedPointer<QByteArray> ba) const;
 
     void release();
 
+    /**
+     * Images are decoded at the smallest scale that still covers size
+     * if the codec supports it (e.g. JPEG's DCT scaling). This speeds up browsing large images.
+     * An empty size decodes at full resolution (default).
+     **/
+    void setTargetSize(const QSize &size);
+    QSize targetSize() const;
+
+    /**
+     * @return true if the current image was decoded at a reduced scale (see setTargetSize())
+     **/
+    bool isDownscaled() const;
+
+    /**
+     * @return the size of the full resolution image (the pixmap's size if it is not downscaled)
+     **/
+    QSize fullSize() const;
+
+    /**
+     * Replaces a downscaled image with the full resolution image.
+     * @param ba the file buffer (optional)
+     * @return true if the full resolution image was loaded
+     **/
+    bool loadFullSize(QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
+
+    /**
+     * Replaces a downscaled image with the image of loader which
+     * was decoded at full resolution (e.g. in a background thread).
+     * @param loader a loader that decoded the same file at full resolution
+     * @return true if the image was replaced
+     **/
+    bool setFullSize(const DkBasicLoader &loader);
+
     // TODO: return this type from all load* functions instead of bool
     struct LoaderResult {
         bool ok = false;
@@ -382,6 +436,7 @@ public:
         QImage img;
         bool supportsTransform = false;
         QImageIOHandler::Transformations transform = QImageIOHandler::TransformationNone;
+        QSize fullSize; // size of the image in the file if it was decoded at a smaller scale
     };
 
 #ifdef WITH_OPENCV
@@ -439,10 +494,15 @@ protected:
     /**
      * LibRAW image loader
      */
-    bool loadRAW(const QString &filePath, QImage &img, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>(), bool fast = false) const;
+    bool loadRAW(const QString &filePath,
+                 QImage &img,
+                 QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>(),
+                 bool fast = false,
+                 QSize *fullSize = 0) const;
 
     /**
      * Get page count for multi-page files (currently TIFF)
+     * The IFD offsets are indexed too, so pages can be loaded without walking the file.
      */
     void indexPages(const QString &filePath, const QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
 
@@ -451,12 +511,22 @@ protected:
      */
     void convert32BitOrder(void *buffer, int width) const;
 
+    /**
+     * Appends a history item, older items are stored as deltas/spilled to disk
+     */
+    void appendEdit(const DkEditImage &edit, bool dropOldEdits = false);
+
     // bool mTraining;
 
     QString mFile;
     int mNumPages;
     int mPageIdx;
     bool mPageIdxDirty;
+    QVector<quint64> mPageOffsets; // IFD offset of each TIFF page
+    QSharedPointer<QByteArray> mPageBuffer; // file of multi-page TIFFs - empty if the file is mapped per page
+    QMap<int, QFuture<QImage>> mPagePrefetch; // neighbouring pages decoded in the background
+    QSize mTargetSize;
+    QSize mFullSize; // empty if the image is not downscaled
     QSharedPointer<DkMetaDataT> mMetaData;
     QVector<DkEditImage> mImages;
     int mMinHistorySize = 2;
@@ -0,0 +1,480 @@
+/*******************************************************************************************************
+ DkExifScanner.cpp
+ Created on:	18.10.2026
+
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+
+ Copyright (C) 2011-2013 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2013 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2013 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#include "DkExifScanner.h"
+#include "DkTimer.h"
+
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QDebug>
+#include <QFile>
+#pragma warning(pop) // no warnings from includes - end
+
+#include <climits>
+#include <cstring>
+
+namespace nmc
+{
+
+// EXIF tags we are interested in
+static const quint16 sTagOrientation = 0x0112;
+static const quint16 sTagDateTime = 0x0132;
+static const quint16 sTagXmp = 0x02BC;
+static const quint16 sTagRating = 0x4746;
+static const quint16 sTagExifIfd = 0x8769;
+static const quint16 sTagDateTimeOriginal = 0x9003;
+
+// if the file cannot be mapped we read this many bytes
+static const qint64 sMaxHeaderSize = 1 << 20;
+
+// CR3 stores its EXIF data (CMT1, CMT2) in this uuid box
+static const uchar sCanonUuid[16] = {0x85, 0xc0, 0xb6, 0x87, 0x82, 0x0f, 0x11, 0xe0, 0x81, 0x11, 0xf4, 0xce, 0x46, 0x2b, 0x6a, 0x48};
+static const uchar sXmpUuid[16] = {0xbe, 0x7a, 0xcf, 0xcb, 0x97, 0xa9, 0x42, 0xe8, 0x9c, 0x71, 0x99, 0x94, 0x91, 0xe3, 0xaf, 0xac};
+
+static inline quint16 readU16(const uchar *ptr, bool bigEndian)
+{
+    return bigEndian ? (quint16)((ptr[0] << 8) | ptr[1]) : (quint16)((ptr[1] << 8) | ptr[0]);
+}
+
+static inline quint32 readU32(const uchar *ptr, bool bigEndian)
+{
+    return bigEndian ? ((quint32)ptr[0] << 24) | ((quint32)ptr[1] << 16) | ((quint32)ptr[2] << 8) | ptr[3]
+                     : ((quint32)ptr[3] << 24) | ((quint32)ptr[2] << 16) | ((quint32)ptr[1] << 8) | ptr[0];
+}
+
+static inline quint64 readUBE(const uchar *ptr, int numBytes)
+{
+    quint64 val = 0;
+    for (int idx = 0; idx < numBytes; idx++)
+        val = (val << 8) | ptr[idx];
+
+    return val;
+}
+
+bool DkExifScanner::scan(const QString &filePath)
+{
+    DK_TRACE_SCOPE("scan exif header");
+
+    QFile file(filePath);
+
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    // mapping is lazy - we only touch the pages of the tags we read
+    const uchar *data = file.map(0, file.size());
+
+    if (data)
+        return scan(data, file.size());
+
+    return scan(file.read(sMaxHeaderSize));
+}
+
+bool DkExifScanner::scan(const QByteArray &ba)
+{
+    return scan(reinterpret_cast<const uchar *>(ba.constData()), ba.size());
+}
+
+bool DkExifScanner::scan(const uchar *data, qint64 size)
+{
+    if (!data || size < 12)
+        return false;
+
+    if (data[0] == 0xFF && data[1] == 0xD8)
+        return scanJpeg(data, size);
+
+    if ((data[0] == 'I' && data[1] == 'I') || (data[0] == 'M' && data[1] == 'M'))
+        return scanTiff(data, size);
+
+    if (std::memcmp(data + 4, "ftyp", 4) == 0)
+        return scanBmff(data, size);
+
+    return false;
+}
+
+int DkExifScanner::orientation() const
+{
+    return mOrientation;
+}
+
+int DkExifScanner::rating() const
+{
+    // same priority as DkMetaDataT::getRating()
+    if (mExifRating == -1 && mXmpRating != -1)
+        return mXmpRating;
+
+    return mExifRating;
+}
+
+QDateTime DkExifScanner::dateTaken() const
+{
+    return mDateTaken.isValid() ? mDateTaken : mDateTime;
+}
+
+QDateTime DkExifScanner::parseExifDate(const QByteArray &date)
+{
+    // e.g. 2013:04:19 12:59:01 (some cameras zero the string or use blanks)
+    QString dateStr = QString::fromLatin1(date).trimmed();
+    QDateTime dt = QDateTime::fromString(dateStr, "yyyy:MM:dd hh:mm:ss");
+
+    if (!dt.isValid())
+        dt = QDateTime::fromString(dateStr, "yyyy-MM-dd hh:mm:ss");
+
+    return dt;
+}
+
+bool DkExifScanner::scanJpeg(const uchar *data, qint64 size)
+{
+    static const char exifId[] = "Exif\0\0";
+    static const char xmpId[] = "http://ns.adobe.com/xap/1.0/";
+
+    qint64 pos = 2;
+
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF)
+            break;
+
+        uchar marker = data[pos + 1];
+
+        // fill bytes
+        if (marker == 0xFF) {
+            pos++;
+            continue;
+        }
+
+        // start of scan or end of image: no more metadata
+        if (marker == 0xDA || marker == 0xD9)
+            break;
+
+        qint64 length = readU16(data + pos + 2, true);
+        const uchar *segment = data + pos + 4;
+        qint64 segmentSize = qMin(length - 2, size - pos - 4);
+
+        if (length < 2)
+            break;
+
+        if (marker == 0xE1) {
+            if (segmentSize > 6 && std::memcmp(segment, exifId, 6) == 0)
+                scanTiff(segment + 6, segmentSize - 6);
+            else if (segmentSize > (qint64)sizeof(xmpId) && std::memcmp(segment, xmpId, sizeof(xmpId)) == 0)
+                scanXmp(segment + sizeof(xmpId), segmentSize - sizeof(xmpId));
+        }
+
+        pos += 2 + length;
+    }
+
+    return true;
+}
+
+bool DkExifScanner::scanTiff(const uchar *data, qint64 size)
+{
+    if (size < 8)
+        return false;
+
+    bool bigEndian = data[0] == 'M';
+
+    // we do not check the magic number since
+    // RAW formats use their own (e.g. ORF: 0x4F52, RW2: 0x55)
+    quint32 ifdOffset = readU32(data + 4, bigEndian);
+    readIfd(data, size, ifdOffset, bigEndian, 0);
+
+    return true;
+}
+
+void DkExifScanner::readIfd(const uchar *tiff, qint64 size, quint32 offset, bool bigEndian, int depth)
+{
+    // ignore broken/cyclic offsets
+    if (depth > 2 || offset < 8 || (qint64)offset + 2 > size)
+        return;
+
+    int numEntries = readU16(tiff + offset, bigEndian);
+
+    for (int idx = 0; idx < numEntries; idx++) {
+        qint64 ePos = (qint64)offset + 2 + idx * 12;
+
+        if (ePos + 12 > size)
+            break;
+
+        const uchar *entry = tiff + ePos;
+        quint16 tag = readU16(entry, bigEndian);
+        quint16 type = readU16(entry + 2, bigEndian);
+        quint32 count = readU32(entry + 4, bigEndian);
+
+        switch (tag) {
+        case sTagOrientation:
+        case sTagRating: {
+            // SHORT (3) values are left aligned in the value field
+            int val = (type == 3) ? readU16(entry + 8, bigEndian) : (int)readU32(entry + 8, bigEndian);
+
+            if (tag == sTagOrientation && val >= 1 && val <= 8)
+                mOrientation = val;
+            else if (tag == sTagRating)
+                mExifRating = val;
+            break;
+        }
+        case sTagDateTime:
+        case sTagDateTimeOriginal: {
+            quint32 valOffset = readU32(entry + 8, bigEndian);
+            const uchar *val = (count <= 4) ? entry + 8 : tiff + valOffset;
+
+            if (count > 4 && (qint64)valOffset + count > size)
+                break;
+
+            QDateTime dt = parseExifDate(QByteArray(reinterpret_cast<const char *>(val), (int)qstrnlen(reinterpret_cast<const char *>(val), count)));
+
+            if (tag == sTagDateTimeOriginal)
+                mDateTaken = dt;
+            else
+                mDateTime = dt;
+            break;
+        }
+        case sTagXmp: {
+            quint32 valOffset = readU32(entry + 8, bigEndian);
+
+            if (count > 4 && (qint64)valOffset + count <= size)
+                scanXmp(tiff + valOffset, count);
+            break;
+        }
+        case sTagExifIfd:
+            readIfd(tiff, size, readU32(entry + 8, bigEndian), bigEndian, depth + 1);
+            break;
+        }
+    }
+}
+
+void DkExifScanner::scanXmp(const uchar *data, qint64 size)
+{
+    const QByteArray xmp = QByteArray::fromRawData(reinterpret_cast<const char *>(data), (int)qMin(size, (qint64)INT_MAX));
+
+    // <xmp:Rating>3</xmp:Rating> or xmp:Rating="3"
+    for (const char *key : {"xmp:Rating", "MicrosoftPhoto:Rating"}) {
+        int idx = xmp.indexOf(key);
+
+        if (idx == -1)
+            continue;
+
+        idx += (int)std::strlen(key);
+        while (idx < xmp.size() && (xmp[idx] == '=' || xmp[idx] == '"' || xmp[idx] == '\'' || xmp[idx] == '>' || xmp[idx] == ' '))
+            idx++;
+
+        int end = idx;
+        while (end < xmp.size() && ((xmp[end] >= '0' && xmp[end] <= '9') || xmp[end] == '-'))
+            end++;
+
+        bool ok = false;
+        int rating = xmp.mid(idx, end - idx).toInt(&ok);
+
+        if (ok) {
+            mXmpRating = rating;
+            break;
+        }
+    }
+}
+
+bool DkExifScanner::scanBmff(const uchar *data, qint64 size)
+{
+    scanBmffBoxes(data, size, data, size, 0);
+    return true;
+}
+
+void DkExifScanner::scanBmffBoxes(const uchar *data, qint64 size, const uchar *file, qint64 fileSize, int depth)
+{
+    qint64 pos = 0;
+
+    while (pos + 8 <= size) {
+        quint64 boxSize = readU32(data + pos, true);
+        const uchar *type = data + pos + 4;
+        qint64 headerSize = 8;
+
+        if (boxSize == 1 && pos + 16 <= size) {
+            boxSize = readUBE(data + pos + 8, 8);
+            headerSize = 16;
+        } else if (boxSize == 0) {
+            boxSize = size - pos; // box extends to the end
+        }
+
+        if (boxSize < (quint64)headerSize || (qint64)boxSize > size - pos)
+            break;
+
+        const uchar *payload = data + pos + headerSize;
+        qint64 payloadSize = boxSize - headerSize;
+
+        if (std::memcmp(type, "meta", 4) == 0 && payloadSize > 4) {
+            // HEIF/AVIF: Exif is an item
+            scanBmffMeta(payload + 4, payloadSize - 4, file, fileSize);
+        } else if (std::memcmp(type, "moov", 4) == 0 && depth == 0) {
+            scanBmffBoxes(payload, payloadSize, file, fileSize, depth + 1);
+        } else if (std::memcmp(type, "uuid", 4) == 0 && payloadSize > 16) {
+            if (std::memcmp(payload, sCanonUuid, 16) == 0)
+                scanBmffBoxes(payload + 16, payloadSize - 16, file, fileSize, depth + 1);
+            else if (std::memcmp(payload, sXmpUuid, 16) == 0)
+                scanXmp(payload + 16, payloadSize - 16);
+        } else if (std::memcmp(type, "CMT1", 4) == 0 || std::memcmp(type, "CMT2", 4) == 0) {
+            // CR3: IFD0 & the EXIF IFD stored as TIFF
+            scanTiff(payload, payloadSize);
+        }
+
+        pos += boxSize;
+    }
+}
+
+void DkExifScanner::scanBmffMeta(const uchar *data, qint64 size, const uchar *file, qint64 fileSize)
+{
+    quint32 exifItemId = 0;
+    const uchar *iloc = nullptr;
+    qint64 ilocSize = 0;
+
+    // find the Exif item (iinf) and where it is located (iloc)
+    qint64 pos = 0;
+    while (pos + 8 <= size) {
+        quint32 boxSize = readU32(data + pos, true);
+
+        if (boxSize < 8 || boxSize > size - pos)
+            break;
+
+        const uchar *type = data + pos + 4;
+        const uchar *payload = data + pos + 8;
+        qint64 payloadSize = boxSize - 8;
+
+        if (std::memcmp(type, "iinf", 4) == 0 && payloadSize > 6) {
+            int version = payload[0];
+            qint64 iPos = version == 0 ? 6 : 8;
+
+            while (iPos + 8 <= payloadSize) {
+                quint32 infeSize = readU32(payload + iPos, true);
+
+                if (infeSize < 8 || infeSize > payloadSize - iPos)
+                    break;
+
+                const uchar *infe = payload + iPos + 8;
+                int infeVersion = infe[0];
+
+                if (std::memcmp(payload + iPos + 4, "infe", 4) == 0 && infeVersion >= 2) {
+                    int idBytes = infeVersion == 2 ? 2 : 4;
+                    const uchar *itemType = infe + 4 + idBytes + 2;
+
+                    if (itemType + 4 <= payload + iPos + infeSize && std::memcmp(itemType, "Exif", 4) == 0)
+                        exifItemId = (quint32)readUBE(infe + 4, idBytes);
+                }
+
+                iPos += infeSize;
+            }
+        } else if (std::memcmp(type, "iloc", 4) == 0) {
+            iloc = payload;
+            ilocSize = payloadSize;
+        }
+
+        pos += boxSize;
+    }
+
+    if (!exifItemId || !iloc || ilocSize < 8)
+        return;
+
+    int version = iloc[0];
+    int offsetSize = iloc[4] >> 4;
+    int lengthSize = iloc[4] & 0xF;
+    int baseOffsetSize = iloc[5] >> 4;
+    int indexSize = (version == 1 || version == 2) ? iloc[5] & 0xF : 0;
+    int idBytes = version < 2 ? 2 : 4;
+    int methodBytes = (version == 1 || version == 2) ? 2 : 0;
+
+    // the spec only allows 0, 4 or 8 bytes - readUBE() cannot read more than 8
+    auto validSize = [](int size) {
+        return size == 0 || size == 4 || size == 8;
+    };
+
+    if (!validSize(offsetSize) || !validSize(lengthSize) || !validSize(baseOffsetSize) || !validSize(indexSize))
+        return;
+
+    qint64 lPos = 6;
+    if (lPos + idBytes > ilocSize)
+        return;
+
+    quint32 itemCount = (quint32)readUBE(iloc + lPos, idBytes);
+    lPos += idBytes;
+
+    for (quint32 idx = 0; idx < itemCount; idx++) {
+        // item id, construction method, data reference index, base offset, extent count
+        if (lPos + idBytes + methodBytes + 2 + baseOffsetSize + 2 > ilocSize)
+            return;
+
+        quint32 itemId = (quint32)readUBE(iloc + lPos, idBytes);
+        lPos += idBytes;
+
+        int constructionMethod = 0;
+        if (version == 1 || version == 2) {
+            constructionMethod = readU16(iloc + lPos, true) & 0xF;
+            lPos += 2;
+        }
+
+        lPos += 2; // data reference index
+        quint64 baseOffset = readUBE(iloc + lPos, baseOffsetSize);
+        lPos += baseOffsetSize;
+
+        int extentCount = readU16(iloc + lPos, true);
+        lPos += 2;
+
+        for (int eIdx = 0; eIdx < extentCount; eIdx++) {
+            if (lPos + indexSize + offsetSize + lengthSize > ilocSize)
+                return;
+
+            lPos += indexSize;
+            quint64 extentOffset = readUBE(iloc + lPos, offsetSize);
+            lPos += offsetSize;
+            quint64 extentLength = readUBE(iloc + lPos, lengthSize);
+            lPos += lengthSize;
+
+            // we only support items that are stored in the file (no idat)
+            if (itemId == exifItemId && eIdx == 0 && constructionMethod == 0) {
+                quint64 fSize = (quint64)fileSize;
+
+                // malformed files must not overflow the offset computations
+                if (extentOffset > fSize || baseOffset > fSize - extentOffset)
+                    return;
+
+                quint64 offset = baseOffset + extentOffset;
+
+                if (extentLength <= fSize && offset <= fSize - extentLength)
+                    scanExifItem(file + offset, extentLength);
+
+                return;
+            }
+        }
+    }
+}
+
+void DkExifScanner::scanExifItem(const uchar *data, qint64 size)
+{
+    if (size < 4)
+        return;
+
+    // the item starts with the offset to the TIFF header (usually after 'Exif\0\0')
+    quint32 tiffOffset = readU32(data, true);
+
+    if ((qint64)tiffOffset + 4 + 8 <= size)
+        scanTiff(data + 4 + tiffOffset, size - 4 - tiffOffset);
+}
+
+}
@@ -0,0 +1,91 @@
+/*******************************************************************************************************
+ DkExifScanner.h
+ Created on:	18.10.2026
+
+ nomacs is a fast and small image viewer with the capability of synchronizing multiple instances
+
+ Copyright (C) 2011-2013 Markus Diem <markus@nomacs.org>
+ Copyright (C) 2011-2013 Stefan Fiel <stefan@nomacs.org>
+ Copyright (C) 2011-2013 Florian Kleber <florian@nomacs.org>
+
+ This file is part of nomacs.
+
+ nomacs is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ nomacs is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ *******************************************************************************************************/
+
+#pragma once
+
+#pragma warning(push, 0) // no warnings from includes - begin
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+#pragma warning(pop) // no warnings from includes - end
+
+#ifndef DllCoreExport
+#ifdef DK_CORE_DLL_EXPORT
+#define DllCoreExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllCoreExport Q_DECL_IMPORT
+#else
+#define DllCoreExport Q_DECL_IMPORT
+#endif
+#endif
+
+namespace nmc
+{
+
+/**
+ * Reads the few EXIF tags needed for browsing (orientation, date taken, rating)
+ * straight from the file header. It parses JPEG (APP1), TIFF based RAW files
+ * and ISO BMFF containers (HEIF/AVIF/CR3) without opening the file with Exiv2.
+ * Use DkMetaDataT if you need all tags or want to edit them.
+ **/
+class DllCoreExport DkExifScanner
+{
+public:
+    DkExifScanner() = default;
+
+    /**
+     * Scans the file's header (the file is memory mapped).
+     * @return false if the format is unknown - fall back to DkMetaDataT in this case
+     **/
+    bool scan(const QString &filePath);
+    bool scan(const QByteArray &ba);
+    bool scan(const uchar *data, qint64 size);
+
+    int orientation() const;
+    int rating() const;
+    QDateTime dateTaken() const;
+
+    static QDateTime parseExifDate(const QByteArray &date);
+
+protected:
+    bool scanJpeg(const uchar *data, qint64 size);
+    bool scanTiff(const uchar *data, qint64 size);
+    bool scanBmff(const uchar *data, qint64 size);
+    void scanBmffBoxes(const uchar *data, qint64 size, const uchar *file, qint64 fileSize, int depth);
+    void scanBmffMeta(const uchar *data, qint64 size, const uchar *file, qint64 fileSize);
+    void scanExifItem(const uchar *data, qint64 size);
+    void scanXmp(const uchar *data, qint64 size);
+    void readIfd(const uchar *tiff, qint64 size, quint32 offset, bool bigEndian, int depth);
+
+    int mOrientation = 0; // EXIF value [1 8] or 0 if not set
+    int mExifRating = -1;
+    int mXmpRating = -1;
+    QDateTime mDateTaken;
+    QDateTime mDateTime; // Exif.Image.DateTime - if no DateTimeOriginal is present
+};
+
+}
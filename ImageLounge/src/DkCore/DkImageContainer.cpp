@@ -27,6 +27,7 @@
 
 #include "DkImageContainer.h"
 #include "DkBasicLoader.h"
+#include "DkExifScanner.h"
 #include "DkImageStorage.h"
 #include "DkMetaData.h"
 #include "DkSettings.h"
@@ -34,10 +35,13 @@
 #include "DkUtils.h"
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QCryptographicHash>
 #include <QDir>
+#include <QGuiApplication>
 #include <QImage>
 #include <QObject>
 #include <QRegularExpression>
+#include <QScreen>
 #include <QtConcurrentRun>
 
 // quazip
@@ -46,6 +50,8 @@
 #endif
 #pragma warning(pop) // no warnings from includes - end
 
+#include <limits>
+
 #pragma warning(disable : 4251) // TODO: remove
 
 namespace nmc
@@ -113,11 +119,11 @@ void DkImageContainer::setHistoryIndex(int idx)
 void DkImageContainer::cropImage(const DkRotatingRect &rect, const QColor &col, bool cropToMetadata)
 {
     if (!cropToMetadata) {
-        QImage cropped = DkImage::cropToImage(image(), rect, col);
+        QImage cropped = DkImage::cropToImage(fullSizeImage(), rect, col);
         setImage(cropped, QObject::tr("Cropped"));
         getMetaData()->clearXMPRect();
     } else
-        getMetaData()->saveRectToXMP(rect, image().size());
+        getMetaData()->saveRectToXMP(rect, getLoader()->fullSize());
 }
 
 QFileInfo DkImageContainer::fileInfo() const
@@ -125,6 +131,36 @@ QFileInfo DkImageContainer::fileInfo() const
     return mFileInfo;
 }
 
+/**
+ * Returns the EXIF capture date (DateTimeOriginal) which is used for sorting.
+ * The date is read once using the DkExifScanner (no Exiv2 image is created
+ * for common formats). If the file has no capture date, its birth time is returned.
+ * @return QDateTime the date the image was taken
+ **/
+QDateTime DkImageContainer::dateTaken()
+{
+    if (mDateTakenRead)
+        return mDateTaken;
+
+    DkExifScanner scanner;
+
+    if (!isFromZip() && scanner.scan(mFilePath)) {
+        mDateTaken = scanner.dateTaken();
+    } else if (!isFromZip()) {
+        // unknown container - let exiv2 try
+        DkMetaDataT metaData;
+        metaData.readMetaData(mFilePath);
+        mDateTaken = DkUtils::getConvertableDate(metaData.getExifValue("DateTimeOriginal"));
+    }
+
+    if (!mDateTaken.isValid())
+        mDateTaken = mFileInfo.birthTime();
+
+    mDateTakenRead = true;
+
+    return mDateTaken;
+}
+
 QString DkImageContainer::filePath() const
 {
     return mFilePath;
@@ -229,10 +265,20 @@ float DkImageContainer::getMemoryUsage() const
 
     float memSize = mFileBuffer ? mFileBuffer->size() / (1024.0f * 1024.0f) : 0;
     memSize += DkImage::getBufferSizeFloat(mLoader->image().size(), mLoader->image().depth());
+    memSize += mDisplayMemory;
 
     return memSize;
 }
 
+/**
+ * Sets the memory (in MB) that is needed to display this image.
+ * It is added to getMemoryUsage() so that the cacher accounts for it.
+ **/
+void DkImageContainer::setDisplayMemory(float memory)
+{
+    mDisplayMemory = memory;
+}
+
 float DkImageContainer::getFileSize() const
 {
     return QFileInfo(mFilePath).size() / (1024.0f * 1024.0f);
@@ -243,7 +289,7 @@ DkRotatingRect DkImageContainer::cropRect()
     QSharedPointer<DkMetaDataT> metaData = getMetaData();
 
     if (metaData) {
-        return metaData->getXMPRect(image().size());
+        return metaData->getXMPRect(getLoader()->fullSize());
     } else
         qWarning() << "empty crop rect because there are no metadata...";
 
@@ -252,36 +298,68 @@ DkRotatingRect DkImageContainer::cropRect()
 
 std::function<bool(const QSharedPointer<DkImageContainer> &, const QSharedPointer<DkImageContainer> &)> DkImageContainer::compareFunc()
 {
-    // select from the assortment of QFileInfo functions; if there isn't one use this one
-    // future: exif, custom sorting, etc can all be tied in here, need not be QFileInfo
-    std::function<bool(const QFileInfo &, const QFileInfo &FileInfo)> cmp;
-
     int mode = DkSettingsManager::param().global().sortMode;
 
-    switch ((DkSettings::sortMode)mode) {
-    case DkSettings::sort_filename:
-        cmp = &DkUtils::compFilename;
+    if (mode < 0 || mode >= DkSettings::sort_end) {
+        qWarning() << "[compareFunc] bogus sort mode ignored" << mode;
+        mode = DkSettings::sort_filename;
+    }
+
+    return [mode](const QSharedPointer<DkImageContainer> &lhs, const QSharedPointer<DkImageContainer> &rhs) {
+        return lhs->sortKey(mode) < rhs->sortKey(mode);
+    };
+}
+
+// invalid dates are sorted first
+static qint64 sortTime(const QDateTime &dt)
+{
+    return dt.isValid() ? dt.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+}
+
+/**
+ * Returns the key of this image for the given sort mode.
+ * The file name key is cached, file sizes and dates are cached by QFileInfo
+ * so that computing the key twice does not access the disk.
+ * @param sortMode a DkSettings::sortMode
+ * @return DkSortKey the key (compare with operator<)
+ **/
+DkSortKey DkImageContainer::sortKey(int sortMode)
+{
+    if (mFileNameKey.isEmpty())
+        mFileNameKey = DkUtils::naturalSortKey(fileName());
+
+    DkSortKey key;
+    key.name = mFileNameKey;
+
+    switch ((DkSettings::sortMode)sortMode) {
+    case DkSettings::sort_file_size:
+        key.value = mFileInfo.size();
         break;
     case DkSettings::sort_date_created:
-        cmp = &DkUtils::compDateCreated;
-        break;
-    case DkSettings::sort_file_size:
-        cmp = &DkUtils::compFileSize;
+        key.value = sortTime(mFileInfo.birthTime());
         break;
     case DkSettings::sort_date_modified:
-        cmp = &DkUtils::compDateModified;
+        key.value = sortTime(mFileInfo.lastModified());
         break;
-    case DkSettings::sort_random:
-        cmp = &DkUtils::compRandom;
+    case DkSettings::sort_date_taken:
+        key.value = sortTime(dateTaken());
         break;
+    case DkSettings::sort_random: {
+        QByteArray hash = QCryptographicHash::hash(mFileInfo.absoluteFilePath().toUtf8() + QByteArray::number(DkSettingsManager::param().global().sortSeed),
+                                                   QCryptographicHash::Algorithm::Md5);
+
+        // invert it: large hashes first (see DkUtils::compRandom)
+        for (char &c : hash)
+            c = ~c;
+
+        key.name = hash + mFileNameKey;
+        break;
+    }
     default:
-        qWarning() << "[compareFunc] bogus sort mode ignored" << mode;
-        cmp = &DkUtils::compFilename;
+        break;
     }
 
-    return [cmp](const QSharedPointer<DkImageContainer> &lhs, const QSharedPointer<DkImageContainer> &rhs) {
-        return cmp(lhs->fileInfo(), rhs->fileInfo());
-    };
+    return key;
 }
 
 QImage DkImageContainer::image()
@@ -292,6 +370,19 @@ QImage DkImageContainer::image()
     return mLoader->pixmap(); // current pixmap (rotated pixmap after exif rotation)
 }
 
+/**
+ * Returns the image in full resolution.
+ * In contrast to image(), downscaled images are decoded (synchronously).
+ * Use it for edits and saving - not for displaying.
+ **/
+QImage DkImageContainer::fullSizeImage()
+{
+    image();
+    loadFullSize();
+
+    return mLoader->pixmap();
+}
+
 QImage DkImageContainer::pixmap()
 {
     return mLoader->pixmap();
@@ -362,6 +453,8 @@ void DkImageContainer::setFilePath(const QString &filePath)
 {
     mFilePath = filePath;
     mFileInfo = QFileInfo(filePath);
+    mFileNameKey.clear();
+    mDateTakenRead = false;
 
 #ifdef Q_OS_WIN
     mFileNameStr = DkUtils::qStringToStdWString(fileName());
@@ -403,11 +496,28 @@ bool DkImageContainer::loadImage()
 
     mLoader = loadImageIntern(mFilePath, getLoader(), mFileBuffer);
 
+    // mapped files are only kept for one decode - otherwise each cached image keeps its file open
+    if (DkBasicLoader::isMappedBuffer(mFileBuffer))
+        mFileBuffer.reset();
+
     return mLoader->hasImage();
 }
 
+/**
+ * Decodes the full resolution image if the image was
+ * downscaled for browsing (see DkBasicLoader::setTargetSize()).
+ **/
+bool DkImageContainer::loadFullSize()
+{
+    if (!mLoader || !mLoader->isDownscaled() || getLoadState() == loading)
+        return false;
+
+    return mLoader->loadFullSize(mFileBuffer);
+}
+
 bool DkImageContainer::saveImage(const QString &filePath, int compression /* = -1 */)
 {
+    loadFullSize();
     return saveImage(filePath, getLoader()->lastImage(), compression);
 }
 
@@ -423,6 +533,8 @@ bool DkImageContainer::saveImage(const QString &filePath, const QImage saveImg,
 
 QSharedPointer<QByteArray> DkImageContainer::loadFileToBuffer(const QString &filePath)
 {
+    DK_TRACE_SCOPE("read file");
+
     QFileInfo fInfo = QFileInfo(filePath);
 
     if (fInfo.isSymLink())
@@ -433,17 +545,8 @@ QSharedPointer<QByteArray> DkImageContainer::loadFileToBuffer(const QString &fil
         return getZipData()->extractImage(getZipData()->getZipFilePath(), getZipData()->getImageFileName());
 #endif
 
-    if (fInfo.suffix().contains("psd")) { // for now just psd's are not cached because their file might be way larger than the part we need to read
-        return QSharedPointer<QByteArray>(new QByteArray());
-    }
-
-    QFile file(fInfo.absoluteFilePath());
-    file.open(QIODevice::ReadOnly);
-
-    QSharedPointer<QByteArray> ba(new QByteArray(file.readAll()));
-    file.close();
-
-    return ba;
+    // the file is mapped: large files (e.g. psd) are only paged in as far as the decoder reads them
+    return DkBasicLoader::mapFileToBuffer(fInfo.absoluteFilePath());
 }
 
 QSharedPointer<DkBasicLoader>
@@ -580,6 +683,9 @@ void DkImageContainerT::checkForFileUpdates()
         changed = true;
     }
 
+    if (mFileInfo.lastModified() != modifiedBefore)
+        mDateTakenRead = false;
+
     if (mWaitForUpdate != update_loading && mFileInfo.lastModified() != modifiedBefore)
         mWaitForUpdate = update_pending;
 
@@ -696,6 +802,16 @@ void DkImageContainerT::bufferLoaded()
     }
 }
 
+// the size of the largest screen in device pixels
+static QSize screenSize()
+{
+    QSize size;
+    for (const QScreen *screen : QGuiApplication::screens())
+        size = size.expandedTo(screen->size() * screen->devicePixelRatio());
+
+    return size;
+}
+
 void DkImageContainerT::fetchImage()
 {
     if (mFetchingBuffer)
@@ -711,6 +827,9 @@ void DkImageContainerT::fetchImage()
         return;
     }
 
+    // large images are decoded at the screen resolution, loadFullSize() decodes the full image on demand
+    getLoader()->setTargetSize(DkSettingsManager::param().display().decodeAtScreenSize ? screenSize() : QSize());
+
     qInfoClean() << "loading " << filePath();
     mFetchingImage = true;
 
@@ -721,6 +840,57 @@ void DkImageContainerT::fetchImage()
     }));
 }
 
+/**
+ * Decodes the full resolution image of a downscaled image (see
+ * DkImageContainer::loadFullSize()) in the background.
+ * fullSizeLoadedSignal is emitted once the image is replaced.
+ **/
+void DkImageContainerT::fetchFullSize()
+{
+    if (mFetchingFullSize || !mLoader || !mLoader->isDownscaled() || getLoadState() != loaded)
+        return;
+
+    mFetchingFullSize = true;
+    connect(&mFullSizeWatcher, &QFutureWatcher<QSharedPointer<DkBasicLoader>>::finished, this, &DkImageContainerT::fullSizeLoaded, Qt::UniqueConnection);
+
+    const QString fp = filePath();
+    const QSharedPointer<QByteArray> ba = mFileBuffer;
+
+    // a new loader is used since the current image is displayed meanwhile
+    mFullSizeWatcher.setFuture(QtConcurrent::run([fp, ba] {
+        QSharedPointer<DkBasicLoader> loader(new DkBasicLoader());
+
+        try {
+            loader->loadGeneral(fp, ba, true, false);
+        } catch (...) {
+            qWarning() << "Unhandled exception in loadGeneral()";
+        }
+
+        return loader;
+    }));
+}
+
+bool DkImageContainerT::loadFullSize()
+{
+    if (!DkImageContainer::loadFullSize())
+        return false;
+
+    // the viewport still shows the downscaled image
+    emit fullSizeLoadedSignal();
+
+    return true;
+}
+
+void DkImageContainerT::fullSizeLoaded()
+{
+    mFetchingFullSize = false;
+
+    QSharedPointer<DkBasicLoader> loader = mFullSizeWatcher.result();
+
+    if (loader && mLoader && mLoader->setFullSize(*loader))
+        emit fullSizeLoadedSignal();
+}
+
 void DkImageContainerT::imageLoaded()
 {
     mFetchingImage = false;
@@ -747,6 +917,10 @@ void DkImageContainerT::loadingFinished()
         return;
     }
 
+    // mapped files are only kept for one decode - otherwise each cached image keeps its file open
+    if (DkBasicLoader::isMappedBuffer(mFileBuffer))
+        mFileBuffer.reset();
+
     // fix the update states
     if (mWaitForUpdate != update_idle) {
         if (!getLoader()->hasImage()) {
@@ -867,6 +1041,7 @@ void DkImageContainerT::saveMetaDataThreaded()
 
 bool DkImageContainerT::saveImageThreaded(const QString &filePath, int compression /* = -1 */)
 {
+    loadFullSize();
     return saveImageThreaded(filePath, getLoader()->lastImage(), compression);
 }
 
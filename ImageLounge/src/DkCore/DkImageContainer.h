@@ -28,6 +28,7 @@
 #pragma once
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QDateTime>
 #include <QFileInfo>
 #include <QFutureWatcher>
 #include <QSharedPointer>
@@ -55,6 +56,20 @@ class DkZipContainer;
 class FileDownloader;
 class DkRotatingRect;
 
+/**
+ * Compact sort key of an image container.
+ * It is computed once per sort so that comparisons neither parse file names nor stat files.
+ **/
+struct DkSortKey {
+    qint64 value = 0; // file size, time stamp (ms) or 0
+    QByteArray name; // see DkUtils::naturalSortKey()
+
+    bool operator<(const DkSortKey &o) const
+    {
+        return value != o.value ? value < o.value : name < o.name;
+    }
+};
+
 class DllCoreExport DkImageContainer
 {
 public:
@@ -71,6 +86,7 @@ public:
     bool operator==(const DkImageContainer &ric) const;
 
     QImage image();
+    QImage fullSizeImage();
     QImage pixmap();
     QImage imageScaledToHeight(int height);
 
@@ -89,8 +105,11 @@ public:
     void setEdited(bool edited = true);
     QString getTitleAttribute() const;
     float getMemoryUsage() const;
+    void setDisplayMemory(float memory);
     float getFileSize() const;
     QString originalFilePath() const;
+    QDateTime dateTaken();
+    DkSortKey sortKey(int sortMode);
 
     virtual QSharedPointer<DkBasicLoader> getLoader();
     virtual QSharedPointer<DkMetaDataT> getMetaData();
@@ -107,6 +126,7 @@ public:
 
     QSharedPointer<QByteArray> loadFileToBuffer(const QString &filePath);
     bool loadImage();
+    virtual bool loadFullSize();
     void setImage(const QImage &img, const QString &editName);
     void setImage(const QImage &img, const QString &editName, const QString &filePath);
     void setMetaData(QSharedPointer<DkMetaDataT> editedMetaData, const QImage &img, const QString &editName);
@@ -143,8 +163,12 @@ protected:
     int mLoadState = not_loaded;
     bool mEdited = false;
     bool mSelected = false;
+    bool mDateTakenRead = false;
+    float mDisplayMemory = 0.0f; // memory held by the viewport for this image (e.g. the pyramid)
 
     QFileInfo mFileInfo;
+    QDateTime mDateTaken;
+    QByteArray mFileNameKey;
     QVector<QImage> scaledImages;
 
 #ifdef WITH_QUAZIP
@@ -180,6 +204,8 @@ public:
     bool saveImageThreaded(const QString &filePath, int compression = -1);
     void saveMetaDataThreaded(const QString &filePath);
     void saveMetaDataThreaded();
+    void fetchFullSize();
+    bool loadFullSize() override;
     bool isFileDownloaded() const;
 
     virtual QSharedPointer<DkBasicLoader> getLoader() override;
@@ -196,6 +222,7 @@ signals:
     void errorDialogSignal(const QString &msg) const;
     void thumbLoadedSignal(bool loaded = true) const;
     void imageUpdatedSignal() const;
+    void fullSizeLoadedSignal() const;
 
 public slots:
     void checkForFileUpdates();
@@ -203,6 +230,7 @@ public slots:
 protected slots:
     void bufferLoaded();
     void imageLoaded();
+    void fullSizeLoaded();
     void savingFinished();
     void loadingFinished();
     void fileDownloaded(const QString &filePath);
@@ -217,6 +245,7 @@ protected:
 
     QFutureWatcher<QSharedPointer<QByteArray>> mBufferWatcher;
     QFutureWatcher<QSharedPointer<DkBasicLoader>> mImageWatcher;
+    QFutureWatcher<QSharedPointer<DkBasicLoader>> mFullSizeWatcher;
     QFutureWatcher<QString> mSaveImageWatcher;
     QFutureWatcher<bool> mSaveMetaDataWatcher;
 
@@ -234,6 +263,7 @@ protected:
 
     bool mFetchingImage = false;
     bool mFetchingBuffer = false;
+    bool mFetchingFullSize = false;
     bool mDownloaded = false;
 
     QTimer mFileUpdateTimer;
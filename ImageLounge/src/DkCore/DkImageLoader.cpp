@@ -40,6 +40,8 @@
 #include "DkThumbs.h"
 #include "DkTimer.h"
 #include "DkUtils.h"
+#include <algorithm>
+#include <numeric>
 #include <utility>
 
 #pragma warning(push, 0) // no warnings from includes - begin
@@ -47,6 +49,9 @@
 #include <QBuffer>
 #include <QByteArray>
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDebug>
 #include <QDesktopServices>
 #include <QDir>
@@ -67,6 +72,8 @@
 #include <QReadLocker>
 #include <QReadWriteLock>
 #include <QRegularExpression>
+#include <QSaveFile>
+#include <QSet>
 #include <QSettings>
 #include <QStandardPaths>
 #include <QStringBuilder>
@@ -75,6 +82,7 @@
 #include <QTimer>
 #include <QWidget>
 #include <QWriteLocker>
+#include <QtConcurrentMap>
 #include <QtConcurrentRun>
 #include <qmath.h>
 
@@ -244,6 +252,28 @@ bool DkImageLoader::loadDir(const QString &newDirPath, bool scanRecursive)
             return false;
         }
 
+        // only rebuild if files were added or removed - the names are compared only (files are not stat'ed)
+        if (files.size() == mImages.size()) {
+            QSet<QString> currentFiles;
+            currentFiles.reserve(mImages.size());
+            for (const QSharedPointer<DkImageContainerT> &img : std::as_const(mImages))
+                currentFiles.insert(img->filePath());
+
+            bool changed = false;
+            for (const QFileInfo &f : std::as_const(files)) {
+                if (!currentFiles.contains(f.absoluteFilePath())) {
+                    changed = true;
+                    break;
+                }
+            }
+
+            if (!changed) {
+                updateModifiedImages(files);
+                qInfoClean() << newDirPath << " unchanged - checked in " << dt;
+                return true;
+            }
+        }
+
         // disabled threaded sorting - people didn't like it (#484 and #460)
         // if (files.size() > 2000) {
         //	createImages(files, false);
@@ -252,6 +282,9 @@ bool DkImageLoader::loadDir(const QString &newDirPath, bool scanRecursive)
         // else
         createImages(files, true);
 
+        mDirModified = QFileInfo(newDirPath).lastModified();
+        mDirScanned = QDateTime::currentDateTime();
+
         qDebug() << "getting file list.....";
     }
     // new folder is loaded
@@ -274,8 +307,12 @@ bool DkImageLoader::loadDir(const QString &newDirPath, bool scanRecursive)
                                             mFolderFilterString); // this line takes seconds if you have lots of files and slow loading (e.g. network)
 
         // ok new folder, this should speed-up loading
+        mPrefetcher.clear();
         mImages.clear();
 
+        mDirModified = QFileInfo(mCurrentDir).lastModified();
+        mDirScanned = QDateTime::currentDateTime();
+
         //// TODO: creating ~120 000 images takes about 2 secs
         //// but sorting (just filenames) takes ages (on windows)
         //// so we should fix this using 2 strategies:
@@ -296,6 +333,52 @@ bool DkImageLoader::loadDir(const QString &newDirPath, bool scanRecursive)
     return true;
 }
 
+/**
+ * Replaces the containers of files that were modified since the last scan.
+ * Files that are saved atomically (e.g. by editors) are replaced without changing
+ * the file names. This changes the directory's modification time, so the files
+ * are only stat'ed if it changed - not on every directory event.
+ * @param files the current files of the directory (same names as mImages).
+ **/
+void DkImageLoader::updateModifiedImages(const QFileInfoList &files)
+{
+    QDateTime dirModified = QFileInfo(mCurrentDir).lastModified();
+
+    if (dirModified == mDirModified)
+        return;
+
+    QDateTime lastScan = mDirScanned;
+    mDirModified = dirModified;
+    mDirScanned = QDateTime::currentDateTime();
+
+    if (!lastScan.isValid())
+        return;
+
+    QHash<QString, int> indexes;
+    indexes.reserve(mImages.size());
+    for (int idx = 0; idx < mImages.size(); idx++)
+        indexes.insert(mImages[idx]->filePath(), idx);
+
+    bool changed = false;
+    for (const QFileInfo &f : files) {
+        if (f.lastModified() < lastScan)
+            continue;
+
+        int idx = indexes.value(f.absoluteFilePath(), -1);
+
+        // the current image checks for updates itself (see DkImageContainerT::checkForFileUpdates())
+        if (idx == -1 || mImages[idx] == mCurrentImage)
+            continue;
+
+        // a new container - cached file infos, thumbnails & meta data are stale
+        mImages[idx] = QSharedPointer<DkImageContainerT>(new DkImageContainerT(f.absoluteFilePath()));
+        changed = true;
+    }
+
+    if (changed)
+        sort();
+}
+
 void DkImageLoader::loadDirRecursive(const QString &newDirPath)
 {
     this->loadDir(newDirPath, true);
@@ -343,18 +426,24 @@ void DkImageLoader::createImages(const QFileInfoList &files, bool sort)
 {
     // TODO: change files to QStringList
     DkTimer dt;
-    QVector<QSharedPointer<DkImageContainerT>> oldImages = mImages;
-    mImages.clear();
+    QHash<QString, QSharedPointer<DkImageContainerT>> oldImages;
+    oldImages.reserve(mImages.size());
+    for (const QSharedPointer<DkImageContainerT> &img : std::as_const(mImages))
+        oldImages.insert(img->filePath(), img);
 
-    QDate today = QDate::currentDate();
+    mImages.clear();
+    mImages.reserve(files.size());
 
     for (const QFileInfo &f : files) {
         const QString &fp = f.absoluteFilePath();
-        int oIdx = findFileIdx(fp, oldImages);
+        QSharedPointer<DkImageContainerT> oldImg = oldImages.value(fp);
+
+        // files modified since the last scan get a new container (cached file info & thumbnail are stale)
+        // the current image checks for updates itself (see DkImageContainerT::checkForFileUpdates())
+        if (oldImg && oldImg != mCurrentImage && mDirScanned.isValid() && f.lastModified() >= mDirScanned)
+            oldImg.clear();
 
-        // NOTE: we had this here: oIdx != -1 && QFileInfo(oldImages.at(oIdx)->filePath()).lastModified() == f.lastModified())
-        // however, that did not detect file changes & slowed down the process - so I removed it...
-        mImages << ((oIdx != -1) ? oldImages.at(oIdx) : QSharedPointer<DkImageContainerT>(new DkImageContainerT(fp)));
+        mImages << (oldImg ? oldImg : QSharedPointer<DkImageContainerT>(new DkImageContainerT(fp)));
     }
     qInfo() << "[DkImageLoader]" << mImages.size() << "containers created in" << dt;
 
@@ -722,7 +811,7 @@ bool DkImageLoader::unloadFile()
                 else if (metaEdited)
                     mCurrentImage->saveMetaData();
             } else {
-                saveUserFileAs(mCurrentImage->image(), false); // we loose all metadata here - right?
+                saveUserFileAs(mCurrentImage->fullSizeImage(), false); // we loose all metadata here - right?
             }
 
         } else if (answer != QMessageBox::No) { // only 'No' will discard the changes
@@ -1323,7 +1412,7 @@ void DkImageLoader::saveFile(const QString &filePath, const QImage &saveImg, con
     }
 
     emit updateSpinnerSignalDelayed(true);
-    QImage sImg = (saveImg.isNull()) ? imgC->image() : saveImg;
+    QImage sImg = (saveImg.isNull()) ? imgC->fullSizeImage() : saveImg;
 
     mDirWatcher->blockSignals(true);
     bool saveStarted = (threaded) ? imgC->saveImageThreaded(lFilePath, sImg, compression) : imgC->saveImage(lFilePath, sImg, compression);
@@ -1464,9 +1553,9 @@ void DkImageLoader::rotateImage(double angle)
         return;
     }
 
-    QImage img = DkImage::rotateImage(mCurrentImage->pixmap(), qRound(angle));
+    QImage img = DkImage::rotateImage(mCurrentImage->fullSizeImage(), qRound(angle));
 
-    QImage thumb = DkImage::createThumb(mCurrentImage->pixmap());
+    QImage thumb = DkImage::createThumb(mCurrentImage->image());
 
     QSharedPointer<DkMetaDataT> metaData = mCurrentImage->getMetaData(); // via ImageContainer, BasicLoader
     bool metaDataSet = false;
@@ -1688,67 +1777,19 @@ void DkImageLoader::errorDialog(const QString &msg) const
 
 void DkImageLoader::updateCacher(QSharedPointer<DkImageContainerT> imgC)
 {
+    DK_TRACE_SCOPE("updateCacher");
+
     if (!imgC || !DkSettingsManager::param().resources().cacheMemory)
         return;
 
-    DkTimer dt;
-
-    //// no caching? delete all
-    // if (!DkSettingsManager::param().resources().cacheMemory) {
-    //	for (int idx = 0; idx < images.size(); idx++) {
-    //		images.at(idx)->clear();
-    //	}
-    //	return;
-    // }
-
     int cIdx = findFileIdx(imgC->filePath(), mImages);
-    double mem = 0;
-    double totalMem = 0;
 
     if (cIdx == -1) {
         qWarning() << "WARNING: image not found for caching!";
         return;
     }
 
-    for (int idx = 0; idx < mImages.size(); idx++) {
-        auto cImg = mImages.at(idx);
-
-        // clear images if they are edited
-        if (idx != cIdx && cImg->isEdited()) {
-            cImg->clear();
-            continue;
-        }
-
-        // do not count the last & the current image
-        if (idx > cIdx && idx <= cIdx + DkSettingsManager::param().resources().maxImagesCached)
-            mem += cImg->getMemoryUsage();
-        else if (abs(cIdx - idx) > 1) {
-            cImg->clear();
-            if (cImg->hasImage())
-                qDebug() << "[Cacher]" << cImg->filePath() << "freed";
-
-            continue;
-        } else
-            totalMem += cImg->getMemoryUsage();
-
-        // ignore the last and current one
-        if (idx == cIdx - 1 || idx == cIdx) {
-            continue;
-        }
-        // fully load the next image
-        else if (idx == cIdx + 1 && mem < DkSettingsManager::param().resources().cacheMemory
-                 && mImages.at(idx)->getLoadState() == DkImageContainerT::not_loaded) {
-            cImg->loadImageThreaded();
-            qDebug() << "[Cacher] " << cImg->filePath() << " fully cached...";
-        } else if (idx > cIdx && idx < cIdx + DkSettingsManager::param().resources().maxImagesCached - 2
-                   && mem < DkSettingsManager::param().resources().cacheMemory && mImages.at(idx)->getLoadState() == DkImageContainerT::not_loaded) {
-            // dt.getIvl();
-            mImages.at(idx)->fetchFile(); // TODO: crash detected here
-            qDebug() << "[Cacher] " << cImg->filePath() << " file fetched...";
-        }
-    }
-
-    qDebug() << "[Cacher] created in" << dt << "(" << mem + totalMem << "MB)";
+    mPrefetcher.update(mImages, cIdx);
 }
 
 /**
@@ -1761,76 +1802,12 @@ void DkImageLoader::updateCacher(QSharedPointer<DkImageContainerT> imgC)
  **/
 QFileInfoList DkImageLoader::getFilteredFileInfoList(const QString &dirPath, QString folderKeywords) const
 {
-    DkTimer dt;
+    DK_TRACE_SCOPE("getFilteredFileInfoList");
 
     if (dirPath.isEmpty())
         return QFileInfoList();
 
-#ifdef Q_OS_WIN
-
-    QString winPath = QDir::toNativeSeparators(dirPath) + "\\*.*";
-
-    const wchar_t *fname = reinterpret_cast<const wchar_t *>(winPath.utf16());
-
-    WIN32_FIND_DATAW findFileData;
-    HANDLE MyHandle = FindFirstFileW(fname, &findFileData);
-
-    std::vector<std::wstring> fileNameList;
-    std::wstring fileName;
-
-    if (MyHandle != INVALID_HANDLE_VALUE) {
-        do {
-            fileName = findFileData.cFileName;
-            fileNameList.push_back(fileName); // TODO: sort correct according to numbers
-        } while (FindNextFileW(MyHandle, &findFileData) != 0);
-    }
-
-    FindClose(MyHandle);
-
-    // remove the * in fileFilters
-    QStringList fileFiltersClean = DkSettingsManager::param().app().browseFilters;
-    for (QString &filter : fileFiltersClean)
-        filter.replace("*", "");
-
-    // qDebug() << "browse filters: " << DkSettingsManager::param().app().browseFilters;
-
-    QStringList fileList;
-    std::vector<std::wstring>::iterator lIter = fileNameList.begin();
-
-    // convert to QStringList
-    for (unsigned int idx = 0; idx < fileNameList.size(); idx++, lIter++) {
-        QString qFilename = DkUtils::stdWStringToQString(*lIter);
-
-        // believe it or not, but this is 10 times faster than QRegExp
-        // drawback: we also get files that contain *.jpg*
-        for (int i = 0; i < fileFiltersClean.size(); i++) {
-            if (qFilename.contains(fileFiltersClean[i], Qt::CaseInsensitive)) {
-                fileList.append(qFilename);
-                break;
-            }
-        }
-    }
-
-    qInfoClean() << "WinAPI, indexed (" << fileList.size() << ") files in: " << dt;
-#else
-
-    // true file list
-    QDir tmpDir(dirPath);
-    tmpDir.setSorting(QDir::LocaleAware);
-    QStringList fileList = tmpDir.entryList(DkSettingsManager::param().app().browseFilters);
-
-#endif
-
-    // append files with no suffix
-    QDir cDir(dirPath);
-    QStringList allFiles = cDir.entryList();
-    QStringList noSuffixFiles;
-
-    for (const QString &name : allFiles) {
-        if (!name.contains(".") && DkUtils::isValid(QFileInfo(dirPath, name))) {
-            fileList << name;
-        }
-    }
+    QStringList fileList = DkDirectoryIndex::instance().fileNames(dirPath);
 
     if (folderKeywords != "") {
         QStringList filterList = fileList;
@@ -1880,6 +1857,54 @@ QFileInfoList DkImageLoader::getFilteredFileInfoList(const QString &dirPath, QSt
     return fileInfoList;
 }
 
+/**
+ * Sorts vec (using operator<) in parallel.
+ * Chunks are sorted concurrently and merged pairwise afterwards.
+ **/
+template <typename T>
+static void parallelSort(QVector<T> &vec)
+{
+    int numChunks = QThread::idealThreadCount();
+
+    // not worth it
+    if (vec.size() < 1024 || numChunks < 2) {
+        std::sort(vec.begin(), vec.end());
+        return;
+    }
+
+    T *data = vec.data();
+
+    QVector<int> bounds;
+    for (int idx = 0; idx <= numChunks; idx++)
+        bounds << (int)((qint64)vec.size() * idx / numChunks);
+
+    QVector<int> chunks(numChunks);
+    std::iota(chunks.begin(), chunks.end(), 0);
+
+    QtConcurrent::blockingMap(chunks, [&](int cIdx) {
+        std::sort(data + bounds[cIdx], data + bounds[cIdx + 1]);
+    });
+
+    // merge neighbouring chunks until one is left
+    while (bounds.size() > 2) {
+        QVector<int> pairs;
+        for (int idx = 0; idx + 2 < bounds.size(); idx += 2)
+            pairs << idx;
+
+        QtConcurrent::blockingMap(pairs, [&](int idx) {
+            std::inplace_merge(data + bounds[idx], data + bounds[idx + 1], data + bounds[idx + 2]);
+        });
+
+        QVector<int> merged;
+        for (int idx = 0; idx < bounds.size(); idx += 2)
+            merged << bounds[idx];
+        if (merged.last() != bounds.last())
+            merged << bounds.last();
+
+        bounds = merged;
+    }
+}
+
 void DkImageLoader::sort()
 {
     for (auto &img : std::as_const(mImages))
@@ -1888,14 +1913,35 @@ void DkImageLoader::sort()
             return;
         }
 
+    DkTimer dt;
     bool ascending = DkSettingsManager::param().global().sortDir == DkSettings::sort_ascending;
+    int mode = DkSettingsManager::param().global().sortMode;
+
+    if (mode < 0 || mode >= DkSettings::sort_end)
+        mode = DkSettings::sort_filename;
 
-    auto cmp = DkImageContainer::compareFunc();
+    // compute the keys once - this parses the file names & reads file stats (or EXIF dates) in parallel
+    QVector<QPair<DkSortKey, int>> keys(mImages.size());
+    QVector<int> indexes(mImages.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
 
-    std::sort(mImages.begin(), mImages.end(), cmp);
+    QtConcurrent::blockingMap(indexes, [&](int idx) {
+        keys[idx] = qMakePair(mImages[idx]->sortKey(mode), idx);
+    });
+
+    parallelSort(keys);
+
+    QVector<QSharedPointer<DkImageContainerT>> images;
+    images.reserve(mImages.size());
+    for (const QPair<DkSortKey, int> &k : std::as_const(keys))
+        images << mImages[k.second];
+
+    mImages = images;
     if (!ascending)
         std::reverse(mImages.begin(), mImages.end());
 
+    qInfo() << "[DkImageLoader]" << mImages.size() << "images sorted in" << dt;
+
     emit updateDirSignal(mImages);
 }
 
@@ -2069,4 +2115,479 @@ void DkImageLoader::receiveUpdates(bool connectSignals)
 
     currImage->receiveUpdates(connectSignals);
 }
+
+// DkDirectoryIndex --------------------------------------------------------------------
+static const quint32 dirIndexMagic = 0x4e444931; // NDI1
+static const quint32 dirIndexVersion = 1;
+static const int dirIndexMinFiles = 1000; // smaller directories are listed fast enough
+static const qint64 dirIndexMinAge = 2000; // ms - modification times are not exact on all file systems
+static const int dirIndexMaxFiles = 256; // the least recently used index files are removed if there are more
+
+DkDirectoryIndex::DkDirectoryIndex()
+{
+    if (DkSettingsManager::param().isPortable())
+        mDirPath = QFileInfo(DkSettingsManager::param().settingsPath()).absolutePath();
+    else
+        mDirPath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+
+    mDirPath = QDir(mDirPath).absoluteFilePath("directories");
+}
+
+DkDirectoryIndex &DkDirectoryIndex::instance()
+{
+    static DkDirectoryIndex inst;
+    return inst;
+}
+
+/**
+ * Returns the file names of all images in dirPath.
+ * The directory is only listed if it changed since the last call.
+ * @param dirPath the directory
+ * @return QStringList the file names (not sorted)
+ **/
+QStringList DkDirectoryIndex::fileNames(const QString &dirPath)
+{
+    QDateTime modified = QFileInfo(dirPath).lastModified();
+    qint64 age = modified.msecsTo(QDateTime::currentDateTime());
+    QString key = filterKey();
+
+    QMutexLocker locker(&mMutex);
+
+    // a directory that was just modified might be modified again within the time resolution
+    if (modified.isValid() && age > dirIndexMinAge) {
+        auto it = mEntries.constFind(dirPath);
+
+        if (it != mEntries.constEnd() && it->modified == modified.toMSecsSinceEpoch() && it->filterKey == key)
+            return it->names;
+
+        Entry entry;
+        if (load(dirPath, entry) && entry.modified == modified.toMSecsSinceEpoch() && entry.filterKey == key) {
+            mEntries.insert(dirPath, entry);
+            qInfo() << "[DkDirectoryIndex]" << entry.names.size() << "files restored from the index";
+            return entry.names;
+        }
+    }
+
+    locker.unlock();
+    QStringList names = scan(dirPath);
+    locker.relock();
+
+    Entry entry;
+    entry.modified = modified.toMSecsSinceEpoch();
+    entry.filterKey = key;
+    entry.names = names;
+
+    // only cache stable directories - the listing is outdated otherwise
+    if (modified.isValid() && age > dirIndexMinAge) {
+        mEntries.insert(dirPath, entry);
+
+        if (names.size() >= dirIndexMinFiles)
+            save(dirPath, entry);
+    } else
+        mEntries.remove(dirPath);
+
+    return names;
+}
+
+void DkDirectoryIndex::clear()
+{
+    QMutexLocker locker(&mMutex);
+    mEntries.clear();
+    QDir(mDirPath).removeRecursively();
+}
+
+QStringList DkDirectoryIndex::scan(const QString &dirPath)
+{
+    DkTimer dt;
+
+#ifdef Q_OS_WIN
+
+    QString winPath = QDir::toNativeSeparators(dirPath) + "\\*.*";
+
+    const wchar_t *fname = reinterpret_cast<const wchar_t *>(winPath.utf16());
+
+    WIN32_FIND_DATAW findFileData;
+    HANDLE MyHandle = FindFirstFileW(fname, &findFileData);
+
+    std::vector<std::wstring> fileNameList;
+    std::wstring fileName;
+
+    if (MyHandle != INVALID_HANDLE_VALUE) {
+        do {
+            fileName = findFileData.cFileName;
+            fileNameList.push_back(fileName); // TODO: sort correct according to numbers
+        } while (FindNextFileW(MyHandle, &findFileData) != 0);
+    }
+
+    FindClose(MyHandle);
+
+    // remove the * in fileFilters
+    QStringList fileFiltersClean = DkSettingsManager::param().app().browseFilters;
+    for (QString &filter : fileFiltersClean)
+        filter.replace("*", "");
+
+    // qDebug() << "browse filters: " << DkSettingsManager::param().app().browseFilters;
+
+    QStringList fileList;
+    std::vector<std::wstring>::iterator lIter = fileNameList.begin();
+
+    // convert to QStringList
+    for (unsigned int idx = 0; idx < fileNameList.size(); idx++, lIter++) {
+        QString qFilename = DkUtils::stdWStringToQString(*lIter);
+
+        // believe it or not, but this is 10 times faster than QRegExp
+        // drawback: we also get files that contain *.jpg*
+        for (int i = 0; i < fileFiltersClean.size(); i++) {
+            if (qFilename.contains(fileFiltersClean[i], Qt::CaseInsensitive)) {
+                fileList.append(qFilename);
+                break;
+            }
+        }
+    }
+
+    qInfoClean() << "WinAPI, indexed (" << fileList.size() << ") files in: " << dt;
+#else
+
+    // true file list
+    QDir tmpDir(dirPath);
+    tmpDir.setSorting(QDir::LocaleAware);
+    QStringList fileList = tmpDir.entryList(DkSettingsManager::param().app().browseFilters);
+
+#endif
+
+    // append files with no suffix
+    QDir cDir(dirPath);
+    QStringList allFiles = cDir.entryList();
+
+    for (const QString &name : allFiles) {
+        if (!name.contains(".") && DkUtils::isValid(QFileInfo(dirPath, name))) {
+            fileList << name;
+        }
+    }
+
+    return fileList;
+}
+
+// the index is invalid if the browse filters change
+QString DkDirectoryIndex::filterKey()
+{
+    return DkSettingsManager::param().app().browseFilters.join(";");
+}
+
+QString DkDirectoryIndex::indexPath(const QString &dirPath) const
+{
+    QByteArray hash = QCryptographicHash::hash(dirPath.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QDir(mDirPath).absoluteFilePath(QString::fromLatin1(hash) + ".idx");
+}
+
+bool DkDirectoryIndex::load(const QString &dirPath, Entry &entry) const
+{
+    QFile file(indexPath(dirPath));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream ds(&file);
+    quint32 magic = 0, version = 0;
+    QString path;
+    ds >> magic >> version;
+
+    if (magic != dirIndexMagic || version != dirIndexVersion)
+        return false;
+
+    ds >> path >> entry.modified >> entry.filterKey >> entry.names;
+
+    // hash collision or corrupt file
+    if (ds.status() != QDataStream::Ok || path != dirPath)
+        return false;
+
+    // the modification time of index files is their last access (see evict())
+    file.close();
+    if (file.open(QIODevice::ReadWrite))
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+
+    return true;
+}
+
+void DkDirectoryIndex::save(const QString &dirPath, const Entry &entry) const
+{
+    if (!QDir().mkpath(mDirPath))
+        return;
+
+    QSaveFile file(indexPath(dirPath));
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream ds(&file);
+    ds << dirIndexMagic << dirIndexVersion << dirPath << entry.modified << entry.filterKey << entry.names;
+
+    if (!file.commit()) {
+        qWarning() << "[DkDirectoryIndex] could not write" << file.fileName();
+        return;
+    }
+
+    evict();
+}
+
+// removes the least recently used index files
+void DkDirectoryIndex::evict() const
+{
+    QFileInfoList files = QDir(mDirPath).entryInfoList(QStringList() << "*.idx", QDir::Files, QDir::Time);
+
+    for (int idx = dirIndexMaxFiles; idx < files.size(); idx++)
+        QFile::remove(files[idx].absoluteFilePath());
+}
+
+// DkPrefetchScheduler --------------------------------------------------------------------
+DkPrefetchScheduler::DkPrefetchScheduler(QObject *parent)
+    : QObject(parent)
+{
+}
+
+/**
+ * Updates the prefetching after the image at cIdx was displayed.
+ * Predicted images are queued for decoding, stale jobs are cancelled
+ * and the least recently used images are freed if cacheMemory is exceeded.
+ * @param images the images of the current folder
+ * @param cIdx the index of the image currently displayed
+ **/
+void DkPrefetchScheduler::update(const QVector<QSharedPointer<DkImageContainerT>> &images, int cIdx)
+{
+    if (cIdx < 0 || cIdx >= images.size())
+        return;
+
+    DkTimer dt;
+
+    QSharedPointer<DkImageContainerT> cImg = images.at(cIdx);
+    updateVelocity(cIdx, images.size());
+
+    mLastAccess.insert(cImg->filePath(), ++mAccessCount);
+
+    // images might have been loaded without us (e.g. the current image)
+    // only the current & predicted images are checked - any other image was one of them when it was loaded
+    if (cImg->hasImage())
+        mCached.insert(cImg);
+
+    float budget = DkSettingsManager::param().resources().cacheMemory;
+    float mem = cImg->getMemoryUsage();
+    bool budgetExceeded = false;
+
+    // predicted images have the highest priority
+    QSet<DkImageContainerT *> keep;
+    keep << cImg.data();
+    mQueue.clear();
+
+    for (int idx : predict(cIdx, images.size())) {
+        QSharedPointer<DkImageContainerT> img = images.at(idx);
+
+        if (img->hasImage())
+            mCached.insert(img);
+
+        // the next & previous image are always decoded (even if the current image exceeds the budget)
+        int dist = qAbs(idx - cIdx);
+        bool neighbour = qMin(dist, images.size() - dist) == 1;
+
+        float m = estimateMemory(img);
+        if (budgetExceeded || mem + m > budget) {
+            budgetExceeded = true;
+            if (!neighbour)
+                continue;
+        }
+
+        mem += m;
+        keep << img.data();
+
+        if (img->getLoadState() == DkImageContainerT::not_loaded && !mJobs.contains(img))
+            mQueue << img;
+    }
+
+    // cancel jobs that are not needed anymore
+    for (auto &job : mJobs) {
+        if (!keep.contains(job.data())) {
+            job->cancel();
+            qDebug() << "[Cacher]" << job->filePath() << "cancelled";
+        }
+    }
+
+    // keep recently viewed images while they fit into the budget
+    QVector<QSharedPointer<DkImageContainerT>> lru(mCached.begin(), mCached.end());
+    std::sort(lru.begin(), lru.end(), [this](const QSharedPointer<DkImageContainerT> &l, const QSharedPointer<DkImageContainerT> &r) {
+        return mLastAccess.value(l->filePath()) > mLastAccess.value(r->filePath());
+    });
+
+    QSet<QSharedPointer<DkImageContainerT>> cached;
+    for (auto &img : lru) {
+        if (keep.contains(img.data())) {
+            cached << img;
+            continue;
+        }
+
+        // edited images are only kept while they are displayed
+        float m = img->getMemoryUsage();
+        if (!img->isEdited() && img->hasImage() && mem + m <= budget) {
+            mem += m;
+            cached << img;
+            continue;
+        }
+
+        img->clear();
+        mLastAccess.remove(img->filePath());
+        qDebug() << "[Cacher]" << img->filePath() << "freed";
+    }
+    mCached = cached;
+
+    startJobs();
+
+    qDebug() << "[Cacher] updated in" << dt << "(" << mem << "MB, velocity:" << mVelocity << "img/s," << mQueue.size() << "queued)";
+}
+
+/**
+ * Cancels all jobs and forgets about cached images.
+ * Call this if the folder changes.
+ **/
+void DkPrefetchScheduler::clear()
+{
+    for (auto &job : mJobs)
+        job->cancel();
+
+    mJobs.clear();
+    mQueue.clear();
+    mCached.clear();
+    mLastAccess.clear();
+    mLastIdx = -1;
+    mVelocity = 0.0;
+}
+
+double DkPrefetchScheduler::velocity() const
+{
+    return mVelocity;
+}
+
+int DkPrefetchScheduler::maxJobs() const
+{
+    // keep threads free for the image that is displayed & thumbnails
+    return qBound(1, QThread::idealThreadCount() / 2, 4);
+}
+
+void DkPrefetchScheduler::startJobs()
+{
+    // jobs might be finished without signal (e.g. if they were cancelled)
+    for (int idx = mJobs.size() - 1; idx >= 0; idx--) {
+        int state = mJobs.at(idx)->getLoadState();
+        if (state != DkImageContainerT::loading && state != DkImageContainerT::loading_canceled)
+            mJobs.removeAt(idx);
+    }
+
+    while (mJobs.size() < maxJobs() && !mQueue.isEmpty()) {
+        QSharedPointer<DkImageContainerT> img = mQueue.takeFirst();
+
+        if (img->getLoadState() != DkImageContainerT::not_loaded)
+            continue;
+
+        connect(img.data(), &DkImageContainerT::fileLoadedSignal, this, &DkPrefetchScheduler::prefetchFinished, Qt::UniqueConnection);
+
+        if (img->loadImageThreaded()) {
+            mJobs << img;
+            if (!mCached.contains(img)) {
+                mLastAccess.insert(img->filePath(), 0);
+                mCached.insert(img);
+            }
+            qDebug() << "[Cacher]" << img->filePath() << "prefetching...";
+        }
+    }
+}
+
+void DkPrefetchScheduler::prefetchFinished()
+{
+    DkImageContainerT *img = qobject_cast<DkImageContainerT *>(sender());
+
+    if (!img)
+        return;
+
+    disconnect(img, &DkImageContainerT::fileLoadedSignal, this, &DkPrefetchScheduler::prefetchFinished);
+
+    for (int idx = 0; idx < mJobs.size(); idx++) {
+        if (mJobs.at(idx).data() == img) {
+            mJobs.removeAt(idx);
+            break;
+        }
+    }
+
+    // learn how much memory a decoded image needs relative to its file size
+    float fileSize = img->fileInfo().size() / (1024.0f * 1024.0f);
+    if (img->hasImage() && fileSize > 0)
+        mAvgDecodedSize = 0.8f * mAvgDecodedSize + 0.2f * img->getMemoryUsage() / fileSize;
+
+    startJobs();
+}
+
+void DkPrefetchScheduler::updateVelocity(int cIdx, int numImages)
+{
+    if (mLastIdx == -1 || !mNavTimer.isValid()) {
+        mNavTimer.start();
+        mLastIdx = cIdx;
+        return;
+    }
+
+    int step = cIdx - mLastIdx;
+    mLastIdx = cIdx;
+
+    // we looped around the folder
+    if (qAbs(step) > numImages / 2)
+        step += (step > 0) ? -numImages : numImages;
+
+    if (step == 0)
+        return;
+
+    double sec = qMax(mNavTimer.restart() / 1000.0, 0.001);
+
+    // after a pause only the direction is relevant
+    if (sec > 2.0)
+        mVelocity = (step > 0) ? 0.5 : -0.5;
+    else
+        mVelocity = 0.5 * mVelocity + 0.5 * step / sec;
+}
+
+/**
+ * Returns the indexes of images that will be displayed next.
+ * The list is sorted by priority: the images ahead in navigation
+ * direction come first (the faster we navigate, the more),
+ * followed by the previous image.
+ **/
+QVector<int> DkPrefetchScheduler::predict(int cIdx, int numImages) const
+{
+    int dir = (mVelocity < 0) ? -1 : 1;
+    int maxAhead = qMax(DkSettingsManager::param().resources().maxImagesCached, 2);
+
+    // look ~1 second ahead
+    int ahead = qBound(2, qCeil(qAbs(mVelocity)) + 1, maxAhead);
+    bool loop = DkSettingsManager::param().global().loop;
+
+    QVector<int> steps;
+    for (int idx = 1; idx <= ahead; idx++)
+        steps << dir * idx;
+    steps << -dir;
+
+    QVector<int> idxs;
+    for (int s : steps) {
+        int idx = cIdx + s;
+
+        if (loop)
+            idx = ((idx % numImages) + numImages) % numImages;
+        else if (idx < 0 || idx >= numImages)
+            continue;
+
+        if (idx != cIdx && !idxs.contains(idx))
+            idxs << idx;
+    }
+
+    return idxs;
+}
+
+float DkPrefetchScheduler::estimateMemory(QSharedPointer<DkImageContainerT> img) const
+{
+    if (img->hasImage())
+        return img->getMemoryUsage();
+
+    return img->fileInfo().size() / (1024.0f * 1024.0f) * mAvgDecodedSize;
+}
 }
@@ -28,7 +28,11 @@
 #pragma once
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QElapsedTimer>
+#include <QHash>
 #include <QImage>
+#include <QMutex>
+#include <QSet>
 #include <QTimer>
 #pragma warning(pop) // no warnings from includes - end
 
@@ -56,6 +60,87 @@ class QUrl;
 namespace nmc
 {
 
+/**
+ * Caches the (browse filtered) file names of directories.
+ * A directory is only listed again if its modification time changed - which
+ * happens if files are added, removed or renamed. Large directories are
+ * persisted, so reopening them does not need a directory listing at all.
+ * Only the most recently used index files are kept on disk.
+ * All functions are thread-safe.
+ **/
+class DllCoreExport DkDirectoryIndex
+{
+public:
+    static DkDirectoryIndex &instance();
+
+    QStringList fileNames(const QString &dirPath);
+    void clear();
+
+private:
+    DkDirectoryIndex();
+    DkDirectoryIndex(const DkDirectoryIndex &);
+
+    struct Entry {
+        qint64 modified = 0; // directory modification time in ms since epoch
+        QString filterKey;
+        QStringList names;
+    };
+
+    static QStringList scan(const QString &dirPath);
+    static QString filterKey();
+    QString indexPath(const QString &dirPath) const;
+    bool load(const QString &dirPath, Entry &entry) const;
+    void save(const QString &dirPath, const Entry &entry) const;
+    void evict() const;
+
+    QMutex mMutex;
+    QString mDirPath;
+    QHash<QString, Entry> mEntries;
+};
+
+/**
+ * Predicts which images of a folder are needed next and decodes them ahead.
+ * The navigation velocity (images/s) determines the direction and how far
+ * we look ahead. Decoding runs on a bounded number of concurrent jobs.
+ * Decoded images are kept as long as they fit into cacheMemory, predicted
+ * images take precedence over recently viewed (LRU) ones. The direct
+ * neighbours of the current image are always decoded.
+ * Jobs that are no longer predicted are cancelled.
+ **/
+class DllCoreExport DkPrefetchScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    DkPrefetchScheduler(QObject *parent = 0);
+
+    void update(const QVector<QSharedPointer<DkImageContainerT>> &images, int cIdx);
+    void clear();
+
+    double velocity() const;
+    int maxJobs() const;
+
+protected slots:
+    void prefetchFinished();
+
+protected:
+    void updateVelocity(int cIdx, int numImages);
+    QVector<int> predict(int cIdx, int numImages) const;
+    float estimateMemory(QSharedPointer<DkImageContainerT> img) const;
+    void startJobs();
+
+    QVector<QSharedPointer<DkImageContainerT>> mQueue; // predicted images that are not yet loaded
+    QVector<QSharedPointer<DkImageContainerT>> mJobs; // images that are currently decoded
+    QSet<QSharedPointer<DkImageContainerT>> mCached; // images that are held in memory
+    QHash<QString, quint64> mLastAccess; // file path -> access count
+    quint64 mAccessCount = 0;
+
+    QElapsedTimer mNavTimer;
+    int mLastIdx = -1;
+    double mVelocity = 0.0; // signed, images per second
+    float mAvgDecodedSize = 10.0f; // decoded MB per MB of file
+};
+
 /**
  * This class is a basic image loader class.
  * It takes care of the file watches for the current folder,
@@ -156,6 +241,7 @@ protected:
     void updateHistory();
     void sortImagesThreaded(QVector<QSharedPointer<DkImageContainerT>> images);
     void createImages(const QFileInfoList &files, bool sort = true);
+    void updateModifiedImages(const QFileInfoList &files);
     QVector<QSharedPointer<DkImageContainerT>> sortImages(QVector<QSharedPointer<DkImageContainerT>> images) const;
     void receiveUpdates(bool connectSignals);
 
@@ -185,9 +271,12 @@ protected:
     QSharedPointer<DkImageContainerT> mCurrentImage;
     QSharedPointer<DkImageContainerT> mLastImageLoaded;
     bool mFolderUpdated = false;
+    QDateTime mDirModified; // of mCurrentDir when it was scanned
+    QDateTime mDirScanned;
     bool mSortingImages = false;
     bool mSortingIsDirty = false;
     QFutureWatcher<QVector<QSharedPointer<DkImageContainerT>>> mCreateImageWatcher;
+    DkPrefetchScheduler mPrefetcher;
 };
 
 }
@@ -45,6 +45,7 @@
 #include <QPixmap>
 #include <QSvgRenderer>
 #include <QTimer>
+#include <QtConcurrentMap>
 #include <QtConcurrentRun>
 #include <qmath.h>
 #pragma warning(pop) // no warnings from includes - end
@@ -855,91 +856,250 @@ QImage DkImage::cropToImage(const QImage &src, const DkRotatingRect &rect, const
 
 QImage DkImage::hueSaturation(const QImage &src, int hue, int sat, int brightness)
 {
-    // nothing to do?
-    if (hue == 0 && sat == 0 && brightness == 0)
-        return src;
+    return colorAdjust(src, hue, sat, brightness, 0.0, 0.0, 1.0);
+}
 
-    QImage imgR;
+QImage DkImage::exposure(const QImage &src, double exposure, double offset, double gamma)
+{
+    return colorAdjust(src, 0, 0, 0, exposure, offset, gamma);
+}
 
-#ifdef WITH_OPENCV
+/**
+ * Exposure tone curve for 16 bit values.
+ * Values are scaled linearly and compressed smoothly towards white if exposure > 1.
+ **/
+class DkExposureCurve
+{
+public:
+    DkExposureCurve(double exposure)
+    {
+        mExposure = exposure;
+
+        double smooth = 0.5;
+        double cStops = std::log(exposure) / std::log(2.0);
+        double range = cStops * 2.0;
+        double linRange = std::pow(2.0, range);
+        mX1 = (mMaxVal + 1.0) / linRange - 1.0;
+        double y1 = mX1 * exposure;
+        double y2 = mMaxVal * (1.0 + (1.0 - smooth) * (exposure - 1.0));
+        double sq3x = std::pow(mX1 * mX1 * mMaxVal, 1.0 / 3.0);
+        mB = (y2 - y1 + exposure * (3.0 * mX1 - 3.0 * sq3x)) / (mMaxVal + 2.0 * mX1 - 3.0 * sq3x);
+        mA = (exposure - mB) * 3.0 * std::pow(mX1 * mX1, 1.0 / 3.0);
+        mC = y2 - mA * std::pow(mMaxVal, 1.0 / 3.0) - mB * mMaxVal;
+    }
 
-    // normalize brightness/saturation
-    int brightnessN = qRound(brightness / 100.0 * 255.0);
-    double satN = sat / 100.0 + 1.0;
+    unsigned short operator()(double val) const
+    {
+        double valE = 0.0;
 
-    cv::Mat hsvImg = DkImage::qImage2Mat(src);
-
-    if (hsvImg.channels() > 3)
-        cv::cvtColor(hsvImg, hsvImg, CV_RGBA2BGR);
-
-    cv::cvtColor(hsvImg, hsvImg, CV_BGR2HSV);
-
-    // apply hue/saturation changes
-    for (int rIdx = 0; rIdx < hsvImg.rows; rIdx++) {
-        unsigned char *iPtr = hsvImg.ptr<unsigned char>(rIdx);
-
-        for (int cIdx = 0; cIdx < hsvImg.cols * 3; cIdx += 3) {
-            // adopt hue
-            int h = iPtr[cIdx] + hue;
-            if (h < 0)
-                h += 180;
-            if (h >= 180)
-                h -= 180;
-
-            iPtr[cIdx] = (unsigned char)h;
-
-            // adopt value
-            int v = iPtr[cIdx + 2] + brightnessN;
-            if (v < 0)
-                v = 0;
-            if (v > 255)
-                v = 255;
-            iPtr[cIdx + 2] = (unsigned char)v;
-
-            // adopt saturation
-            int s = qRound(iPtr[cIdx + 1] * satN);
-            if (s < 0)
-                s = 0;
-            if (s > 255)
-                s = 255;
-            iPtr[cIdx + 1] = (unsigned char)s;
+        if (mExposure < 1.0) {
+            valE = val * std::exp(mExposure / 10.0); // /10 - make it slower -> we go down till -20
+        } else if (val < mX1) {
+            valE = val * mExposure;
+        } else {
+            valE = mA * std::pow(val, 1.0 / 3.0) + mB * val + mC;
         }
+
+        if (valE < 0)
+            return 0;
+        else if (valE > mMaxVal)
+            return (unsigned short)mMaxVal;
+
+        return (unsigned short)qRound(valE);
     }
 
-    cv::cvtColor(hsvImg, hsvImg, CV_HSV2BGR);
-    imgR = DkImage::mat2QImage(hsvImg);
+private:
+    const double mMaxVal = std::numeric_limits<unsigned short>::max();
+    double mExposure = 1.0;
+    double mX1 = 0.0;
+    double mA = 0.0;
+    double mB = 0.0;
+    double mC = 0.0;
+};
 
-#endif // WITH_OPENCV
+/**
+ * Maps 8 bit values to 8 bit values with offset, exposure and gamma applied.
+ * The curves are evaluated in 16 bit (see exposureMat and gammaMat) but since
+ * the input is 8 bit, the whole chain boils down to a single LUT.
+ **/
+QVector<uchar> DkImage::exposureTable(double exposure, double offset, double gamma)
+{
+    const double maxVal = std::numeric_limits<unsigned short>::max();
+    DkExposureCurve curve(exposure);
 
-    return imgR;
+    QVector<uchar> table(256);
+
+    for (int idx = 0; idx < table.size(); idx++) {
+        double val = qBound(0.0, (double)qRound(idx * 256.0 + offset * maxVal), maxVal);
+
+        if (exposure != 0.0)
+            val = curve(val);
+
+        if (gamma != 1.0)
+            val = qRound(std::pow(val / maxVal, 1.0 / gamma) * maxVal);
+
+        table[idx] = (uchar)qBound(0, qRound(val / 256.0), 255);
+    }
+
+    return table;
 }
 
-QImage DkImage::exposure(const QImage &src, double exposure, double offset, double gamma)
+/**
+ * Shifts hue and scales saturation and value of a single pixel.
+ * Hue is in [0 180) and saturation & value are in [0 255] (OpenCV's 8 bit HSV convention).
+ * Hue is kept as float between the conversions, so it is not quantized.
+ **/
+static inline void adjustHsv(int &r, int &g, int &b, int hue, const uchar *satTable, const uchar *valTable)
 {
-    if (exposure == 0.0 && offset == 0.0 && gamma == 1.0)
+    int v = qMax(r, qMax(g, b));
+    int diff = v - qMin(r, qMin(g, b));
+
+    if (v == 0) {
+        r = g = b = valTable[0];
+        return;
+    }
+
+    int s = (diff * 255 + v / 2) / v;
+
+    float h = 0.0f;
+    if (diff > 0) {
+        if (v == r)
+            h = (g - b) * 30.0f / diff;
+        else if (v == g)
+            h = (b - r + 2 * diff) * 30.0f / diff;
+        else
+            h = (r - g + 4 * diff) * 30.0f / diff;
+    }
+
+    h += hue;
+    h = std::fmod(h, 180.0f);
+    if (h < 0.0f)
+        h += 180.0f;
+
+    float vn = valTable[v];
+    float sn = satTable[s] / 255.0f;
+
+    if (sn == 0.0f) {
+        r = g = b = qRound(vn);
+        return;
+    }
+
+    float hh = h / 30.0f;
+    int sector = qMin((int)hh, 5);
+    float f = hh - sector;
+
+    int vi = qRound(vn);
+    int p = qRound(vn * (1.0f - sn));
+    int q = qRound(vn * (1.0f - sn * f));
+    int t = qRound(vn * (1.0f - sn * (1.0f - f)));
+
+    switch (sector) {
+    case 0:
+        r = vi, g = t, b = p;
+        break;
+    case 1:
+        r = q, g = vi, b = p;
+        break;
+    case 2:
+        r = p, g = vi, b = t;
+        break;
+    case 3:
+        r = p, g = q, b = vi;
+        break;
+    case 4:
+        r = t, g = p, b = vi;
+        break;
+    default:
+        r = vi, g = p, b = q;
+        break;
+    }
+}
+
+/**
+ * Applies exposure, offset, gamma and hue, saturation, brightness in one pass.
+ * Exposure, offset and gamma are applied first using a single 8 bit LUT.
+ * Hue, saturation and brightness are then applied in HSV space. The image
+ * is processed in blocks of rows in parallel and the alpha channel is kept.
+ * @param hue hue shift in [-180 180] (in units of 2 degree like OpenCV's 8 bit hue)
+ * @param sat saturation change in percent [-100 100]
+ * @param brightness brightness change in percent [-100 100]
+ * @return QImage the adjusted image (ARGB32 or RGB32)
+ **/
+QImage DkImage::colorAdjust(const QImage &src, int hue, int sat, int brightness, double exposure, double offset, double gamma)
+{
+    bool hsv = hue != 0 || sat != 0 || brightness != 0;
+    bool tone = exposure != 0.0 || offset != 0.0 || gamma != 1.0;
+
+    // nothing to do?
+    if ((!hsv && !tone) || src.isNull())
         return src;
 
-    QImage imgR;
-#ifdef WITH_OPENCV
+    DK_TRACE_SCOPE("colorAdjust");
 
-    cv::Mat rgbImg = DkImage::qImage2Mat(src);
-    rgbImg.convertTo(rgbImg, CV_16U, 256, offset * std::numeric_limits<unsigned short>::max());
+    QImage img = src.convertToFormat(src.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
 
-    if (rgbImg.channels() > 3)
-        cv::cvtColor(rgbImg, rgbImg, CV_RGBA2BGR);
+    QVector<uchar> toneTable = exposureTable(exposure, offset, gamma);
 
-    if (exposure != 0.0)
-        rgbImg = exposureMat(rgbImg, exposure);
+    // normalize brightness/saturation
+    int brightnessN = qRound(brightness / 100.0 * 255.0);
+    double satN = sat / 100.0 + 1.0;
 
-    if (gamma != 1.0)
-        rgbImg = gammaMat(rgbImg, gamma);
+    QVector<uchar> satTable(256);
+    QVector<uchar> valTable(256);
+    for (int idx = 0; idx < 256; idx++) {
+        satTable[idx] = (uchar)qBound(0, qRound(idx * satN), 255);
+        valTable[idx] = (uchar)qBound(0, idx + brightnessN, 255);
+    }
 
-    rgbImg.convertTo(rgbImg, CV_8U, 1.0 / 256.0);
-    imgR = DkImage::mat2QImage(rgbImg);
+    const int blockSize = 64;
+    QVector<int> blocks;
+    for (int rIdx = 0; rIdx < img.height(); rIdx += blockSize)
+        blocks << rIdx;
+
+    uchar *bits = img.bits(); // detach before going parallel
+    qsizetype bpl = img.bytesPerLine();
+    int width = img.width();
+    int height = img.height();
+
+    auto adjustBlock = [&](int startRow) {
+        const uchar *tLut = toneTable.constData();
+        const uchar *sLut = satTable.constData();
+        const uchar *vLut = valTable.constData();
+
+        for (int rIdx = startRow; rIdx < qMin(startRow + blockSize, height); rIdx++) {
+            QRgb *ptr = reinterpret_cast<QRgb *>(bits + rIdx * bpl);
+
+            if (tone && !hsv) {
+                // a pure LUT loop
+                for (int cIdx = 0; cIdx < width; cIdx++) {
+                    QRgb c = ptr[cIdx];
+                    ptr[cIdx] = qRgba(tLut[qRed(c)], tLut[qGreen(c)], tLut[qBlue(c)], qAlpha(c));
+                }
+                continue;
+            }
 
-#endif // WITH_OPENCV
+            for (int cIdx = 0; cIdx < width; cIdx++) {
+                QRgb c = ptr[cIdx];
+                int r = qRed(c);
+                int g = qGreen(c);
+                int b = qBlue(c);
 
-    return imgR;
+                if (tone) {
+                    r = tLut[r];
+                    g = tLut[g];
+                    b = tLut[b];
+                }
+
+                adjustHsv(r, g, b, hue, sLut, vLut);
+
+                ptr[cIdx] = qRgba(r, g, b, qAlpha(c));
+            }
+        }
+    };
+
+    QtConcurrent::blockingMap(blocks, adjustBlock);
+
+    return img;
 }
 
 QImage DkImage::bgColor(const QImage &src, const QColor &col)
@@ -1062,41 +1222,13 @@ cv::Mat DkImage::exposureMat(const cv::Mat &src, double exposure)
 {
     int maxVal = std::numeric_limits<unsigned short>::max();
     cv::Mat lut(1, maxVal + 1, CV_16UC1);
-
-    double smooth = 0.5;
-    double cStops = std::log(exposure) / std::log(2.0);
-    double range = cStops * 2.0;
-    double linRange = std::pow(2.0, range);
-    double x1 = (maxVal + 1.0) / linRange - 1.0;
-    double y1 = x1 * exposure;
-    double y2 = maxVal * (1.0 + (1.0 - smooth) * (exposure - 1.0));
-    double sq3x = std::pow(x1 * x1 * maxVal, 1.0 / 3.0);
-    double B = (y2 - y1 + exposure * (3.0 * x1 - 3.0 * sq3x)) / (maxVal + 2.0 * x1 - 3.0 * sq3x);
-    double A = (exposure - B) * 3.0 * std::pow(x1 * x1, 1.0 / 3.0);
-    double CC = y2 - A * std::pow(maxVal, 1.0 / 3.0) - B * maxVal;
+    DkExposureCurve curve(exposure);
 
     for (int rIdx = 0; rIdx < lut.rows; rIdx++) {
         unsigned short *ptrLut = lut.ptr<unsigned short>(rIdx);
 
-        for (int cIdx = 0; cIdx < lut.cols; cIdx++) {
-            double val = cIdx;
-            double valE = 0.0;
-
-            if (exposure < 1.0) {
-                valE = val * std::exp(exposure / 10.0); // /10 - make it slower -> we go down till -20
-            } else if (cIdx < x1) {
-                valE = val * exposure;
-            } else {
-                valE = A * std::pow(val, 1.0 / 3.0) + B * val + CC;
-            }
-
-            if (valE < 0)
-                ptrLut[cIdx] = 0;
-            else if (valE > maxVal)
-                ptrLut[cIdx] = (unsigned short)maxVal;
-            else
-                ptrLut[cIdx] = (unsigned short)qRound(valE);
-        }
+        for (int cIdx = 0; cIdx < lut.cols; cIdx++)
+            ptrLut[cIdx] = curve(cIdx);
     }
 
     return applyLUT(src, lut);
@@ -1461,6 +1593,8 @@ bool DkImage::unsharpMask(QImage &img, float sigma, float weight)
 
 QImage DkImage::createThumb(const QImage &image, int maxSize)
 {
+    DK_TRACE_SCOPE("createThumb");
+
     if (image.isNull()) {
         return image;
     }
@@ -1493,6 +1627,13 @@ QImage DkImage::createThumb(const QImage &image, int maxSize)
 }
 
 // DkImageStorage --------------------------------------------------------------------
+// images with more pixels than this get a multi-resolution pyramid
+static const qint64 pyramidMinPixels = 4096 * 4096;
+// the pyramid stops as soon as a level fits into this size
+static const int pyramidMinLevelSize = 2048;
+// visible regions are snapped to this grid so that panning blits stable tiles
+static const int pyramidTileSize = 512;
+
 DkImageStorage::DkImageStorage(const QImage &img)
 {
     mImg = img;
@@ -1500,6 +1641,7 @@ DkImageStorage::DkImageStorage(const QImage &img)
     init();
 
     connect(&mFutureWatcher, &QFutureWatcher<QImage>::finished, this, &DkImageStorage::imageComputed, Qt::UniqueConnection);
+    connect(&mPyramidWatcher, &QFutureWatcher<QVector<QImage>>::finished, this, &DkImageStorage::pyramidComputed, Qt::UniqueConnection);
     connect(DkActionManager::instance().action(DkActionManager::menu_view_anti_aliasing),
             &QAction::toggled,
             this,
@@ -1515,9 +1657,16 @@ void DkImageStorage::init()
 
 void DkImageStorage::setImage(const QImage &img)
 {
+    bool hadPyramid = hasPyramid();
+
     mScaledImg = QImage();
+    mPyramid.clear();
     mImg = img;
     mComputeState = l_cancelled;
+
+    // the pyramid is computed lazily if the new image is zoomed out
+    if (hadPyramid)
+        emit pyramidChanged();
 }
 
 void DkImageStorage::antiAliasingChanged(bool antiAliasing)
@@ -1555,8 +1704,6 @@ QImage DkImageStorage::image(const QSize &size)
     return mImg;
 }
 
-QImage imageStorageScaleToSize(const QImage &src, const QSize &size);
-
 void DkImageStorage::compute(const QSize &size)
 {
     // don't compute twice
@@ -1568,11 +1715,180 @@ void DkImageStorage::compute(const QSize &size)
     mScaledImg = QImage();
     mComputeState = l_computing;
 
-    mFutureWatcher.setFuture(QtConcurrent::run(imageStorageScaleToSize, mImg, size));
+    // start from the smallest pyramid level that is still larger than the target
+    QImage src = mImg;
+    if (hasPyramid()) {
+        int level = pyramidLevel((double)size.width() / mImg.width());
+        while (level > 0 && mPyramid[level].width() <= size.width())
+            level--;
+        src = mPyramid[level];
+    }
+
+    mFutureWatcher.setFuture(QtConcurrent::run(imageStorageScaleToSize, src, size));
+}
+
+void DkImageStorage::computePyramid()
+{
+    if (mImg.isNull() || (qint64)mImg.width() * mImg.height() <= pyramidMinPixels)
+        return;
+
+    // pyramidComputed() drops the result if the image changed meanwhile
+    if (mPyramidWatcher.isRunning())
+        return;
+
+    mPyramidWatcher.setFuture(QtConcurrent::run(imageStorageBuildPyramid, mImg, pyramidMinLevelSize));
+}
+
+void DkImageStorage::pyramidComputed()
+{
+    QVector<QImage> pyramid = mPyramidWatcher.result();
+
+    // the image was changed while we were computing - the next draw requests a new one
+    if (pyramid.isEmpty() || pyramid[0].cacheKey() != mImg.cacheKey()) {
+        emit imageUpdated();
+        return;
+    }
+
+    mPyramid = pyramid;
+    emit pyramidChanged();
+    emit imageUpdated();
+}
+
+bool DkImageStorage::hasPyramid() const
+{
+    return mPyramid.size() > 1;
+}
+
+/**
+ * Returns the memory needed by the pyramid levels.
+ * The first level is not counted since it shares its data with the image.
+ * @return float the memory in MB
+ **/
+float DkImageStorage::pyramidMemory() const
+{
+    float mem = 0.0f;
+
+    for (int idx = 1; idx < mPyramid.size(); idx++)
+        mem += DkImage::getBufferSizeFloat(mPyramid[idx].size(), mPyramid[idx].depth());
+
+    return mem;
+}
+
+/**
+ * Returns the pyramid level that should be rendered at a given scale.
+ * The level returned is the smallest one that still has at least
+ * as many pixels as the display.
+ * @param scale display pixels per image pixel
+ * @return int the pyramid level (0 is the full resolution image)
+ **/
+int DkImageStorage::pyramidLevel(double scale) const
+{
+    if (mPyramid.isEmpty() || scale <= 0.0 || scale >= 1.0)
+        return 0;
+
+    int level = qFloor(std::log2(1.0 / scale));
+
+    return qBound(0, level, (int)mPyramid.size() - 1);
+}
+
+/**
+ * Draws the currently visible part of the image.
+ * The visible region (snapped to a tile grid) is blitted
+ * from the pyramid level that matches the current zoom, or from
+ * the image itself if no smaller level is needed (or available yet).
+ * The pyramid is computed the first time a large image is zoomed out.
+ * @param painter the painter, its world transform maps targetRect to the device
+ * @param targetRect the rectangle the full image is mapped to
+ * @return bool false if nothing was drawn (the caller should draw the image)
+ **/
+bool DkImageStorage::drawVisibleRegion(QPainter &painter, const QRectF &targetRect)
+{
+    if (mImg.isNull() || targetRect.isEmpty() || !painter.device())
+        return false;
+
+    const QTransform &wm = painter.worldTransform();
+    QRectF displayRect = wm.mapRect(targetRect);
+    double scale = displayRect.width() / mImg.width();
+
+    // zoomed out -> a smaller level would be rendered
+    if (!hasPyramid() && scale < 0.5)
+        computePyramid();
+
+    const QImage &img = hasPyramid() ? mPyramid[pyramidLevel(scale)] : mImg;
+
+    // device -> level coordinates
+    QRectF deviceRect(0, 0, painter.device()->width(), painter.device()->height());
+    QRectF visibleRect = wm.inverted().mapRect(deviceRect).intersected(targetRect);
+
+    if (visibleRect.isEmpty())
+        return true;
+
+    double sx = img.width() / targetRect.width();
+    double sy = img.height() / targetRect.height();
+    QRectF srcRect((visibleRect.left() - targetRect.left()) * sx,
+                   (visibleRect.top() - targetRect.top()) * sy,
+                   visibleRect.width() * sx,
+                   visibleRect.height() * sy);
+
+    // snap to the tile grid
+    int x0 = qFloor(srcRect.left() / pyramidTileSize) * pyramidTileSize;
+    int y0 = qFloor(srcRect.top() / pyramidTileSize) * pyramidTileSize;
+    int x1 = qCeil(srcRect.right() / pyramidTileSize) * pyramidTileSize;
+    int y1 = qCeil(srcRect.bottom() / pyramidTileSize) * pyramidTileSize;
+
+    QRect tileRect = QRect(QPoint(x0, y0), QPoint(x1 - 1, y1 - 1)).intersected(img.rect());
+
+    QRectF tileTarget(targetRect.left() + tileRect.left() / sx, targetRect.top() + tileRect.top() / sy, tileRect.width() / sx, tileRect.height() / sy);
+
+    painter.drawImage(tileTarget, img, tileRect);
+
+    return true;
+}
+
+QVector<QImage> imageStorageBuildPyramid(const QImage &src, int minSize)
+{
+    DkTimer dt;
+    QVector<QImage> pyramid;
+    pyramid << src;
+
+    QImage level = src;
+
+    while (qMax(level.width(), level.height()) > minSize) {
+        QSize s(qMax(level.width() / 2, 1), qMax(level.height() / 2, 1));
+
+#ifdef WITH_OPENCV
+        // INTER_AREA averages 2x2 blocks - wrap the buffers to avoid copies
+        if (level.depth() == 32) {
+            QImage dst(s, level.format());
+
+            try {
+                cv::Mat srcMat(level.height(), level.width(), CV_8UC4, (void *)level.constBits(), level.bytesPerLine());
+                cv::Mat dstMat(dst.height(), dst.width(), CV_8UC4, dst.bits(), dst.bytesPerLine());
+                cv::resize(srcMat, dstMat, dstMat.size(), 0, 0, cv::INTER_AREA);
+                level = dst;
+            } catch (...) {
+                qWarning() << "imageStorageBuildPyramid: OpenCV exception caught while resizing...";
+                level = level.scaled(s, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            }
+        } else
+#endif
+            level = level.scaled(s, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+        if (level.isNull())
+            break;
+
+        pyramid << level;
+    }
+
+    qDebug() << "image pyramid with" << pyramid.size() << "levels computed in" << dt;
+
+    return pyramid;
 }
 
 QImage imageStorageScaleToSize(const QImage &src, const QSize &size)
 {
+    DK_TRACE_SCOPE("scale");
+
     // should not happen
     if (size.width() >= src.width()) {
         qWarning() << "imageStorageScaleToSize was called without a need...";
@@ -62,9 +62,11 @@
 #endif
 
 // Qt defines
+class QPainter;
 class QPixmap;
 class QString;
 class QSize;
+class QRectF;
 class QColor;
 class QTimer;
 
@@ -126,6 +128,8 @@ public:
     static QImage cropToImage(const QImage &src, const DkRotatingRect &rect, const QColor &fillColor = QColor());
     static QImage hueSaturation(const QImage &src, int hue, int sat, int brightness);
     static QImage exposure(const QImage &src, double exposure, double offset, double gamma);
+    static QImage colorAdjust(const QImage &src, int hue, int sat, int brightness, double exposure, double offset, double gamma);
+    static QVector<uchar> exposureTable(double exposure, double offset, double gamma);
     static QImage bgColor(const QImage &src, const QColor &col);
     static QByteArray extractImageFromDataStream(const QByteArray &ba,
                                                  const QByteArray &beginSignature = "‰PNG",
@@ -172,13 +176,20 @@ public:
     QImage imageConst() const;
     QImage image(const QSize &size = QSize());
 
+    bool hasPyramid() const;
+    int pyramidLevel(double scale) const;
+    float pyramidMemory() const;
+    bool drawVisibleRegion(QPainter &painter, const QRectF &targetRect);
+
 public slots:
     void antiAliasingChanged(bool antiAliasing);
     void imageComputed();
+    void pyramidComputed();
 
 signals:
     void imageUpdated() const;
     void infoSignal(const QString &msg) const;
+    void pyramidChanged() const;
 
 protected:
     QImage mImg;
@@ -186,12 +197,33 @@ protected:
 
     QFutureWatcher<QImage> mFutureWatcher;
 
+    // mPyramid[0] is mImg, each further level halves the previous one
+    QVector<QImage> mPyramid;
+    QFutureWatcher<QVector<QImage>> mPyramidWatcher;
+
     ComputeState mComputeState = l_not_computed;
 
     void init();
     void compute(const QSize &size);
+    void computePyramid();
 };
 
+/**
+ * Downscales src to size (area interpolation if OpenCV is available).
+ *
+ * This is used by DkImageStorage to compute the anti-aliased image.
+ */
+QImage imageStorageScaleToSize(const QImage &src, const QSize &size);
+
+/**
+ * Builds a multi-resolution pyramid of src.
+ *
+ * The first level is src itself, each further level is
+ * downscaled by a factor of 2 until it fits into minSize.
+ * The memory overhead is bounded by 1/3 of src.
+ */
+QVector<QImage> imageStorageBuildPyramid(const QImage &src, int minSize);
+
 /**
  * Rotates the image clockwise by angle.
  *
@@ -294,4 +294,9 @@ bool DkBaseManipulatorExt::isDirty() const
     return mDirty;
 }
 
+bool DkBaseManipulatorExt::isPointOperation() const
+{
+    return false;
+}
+
 }
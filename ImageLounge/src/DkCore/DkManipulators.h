@@ -100,6 +100,10 @@ public:
     void setDirty(bool dirty);
     bool isDirty() const;
 
+    // point operations map each pixel independently of its neighbors and the image size
+    // only these are previewed on a cropped & downscaled proxy (see DkViewPort::previewManipulator)
+    virtual bool isPointOperation() const;
+
 private:
     bool mDirty = false;
     QWidget *mWidget = 0;
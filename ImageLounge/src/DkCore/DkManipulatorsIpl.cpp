@@ -394,6 +394,11 @@ QString DkThresholdManipulator::errorMessage() const
     return QObject::tr("Cannot threshold image");
 }
 
+bool DkThresholdManipulator::isPointOperation() const
+{
+    return true;
+}
+
 void DkThresholdManipulator::setThreshold(int thr)
 {
     if (thr == mThreshold)
@@ -438,6 +443,11 @@ QString DkHueManipulator::errorMessage() const
     return QObject::tr("Cannot change Hue/Saturation");
 }
 
+bool DkHueManipulator::isPointOperation() const
+{
+    return true;
+}
+
 void DkHueManipulator::setHue(int hue)
 {
     if (mHue == hue)
@@ -495,6 +505,11 @@ QString DkExposureManipulator::errorMessage() const
     return QObject::tr("Cannot apply exposure");
 }
 
+bool DkExposureManipulator::isPointOperation() const
+{
+    return true;
+}
+
 void DkExposureManipulator::setExposure(double exposure)
 {
     if (mExposure == exposure)
@@ -553,6 +568,11 @@ QString DkColorManipulator::errorMessage() const
     return QObject::tr("Cannot draw background color");
 }
 
+bool DkColorManipulator::isPointOperation() const
+{
+    return true;
+}
+
 void DkColorManipulator::setColor(const QColor &col)
 {
     if (mColor == col)
@@ -138,6 +138,7 @@ public:
 
     QImage apply(const QImage &img) const override;
     QString errorMessage() const override;
+    bool isPointOperation() const override;
 
     void setColor(const QColor &col);
     QColor color() const;
@@ -225,6 +226,7 @@ public:
 
     QImage apply(const QImage &img) const override;
     QString errorMessage() const override;
+    bool isPointOperation() const override;
 
     void setThreshold(int thr);
     int threshold() const;
@@ -244,6 +246,7 @@ public:
 
     QImage apply(const QImage &img) const override;
     QString errorMessage() const override;
+    bool isPointOperation() const override;
 
     void setHue(int hue);
     int hue() const;
@@ -267,6 +270,7 @@ public:
 
     QImage apply(const QImage &img) const override;
     QString errorMessage() const override;
+    bool isPointOperation() const override;
 
     void setExposure(double exposure);
     double exposure() const;
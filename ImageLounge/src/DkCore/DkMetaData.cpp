@@ -39,6 +39,7 @@
 #include <QImage>
 #include <QObject>
 #include <QRegularExpression>
+#include <QSaveFile>
 #include <QTranslator>
 #include <QVector2D>
 #pragma warning(pop) // no warnings from includes - end
@@ -98,6 +99,8 @@ void DkMetaDataT::update(const QSharedPointer<DkMetaDataT> &other)
 
 void DkMetaDataT::readMetaData(const QString &filePath, QSharedPointer<QByteArray> ba)
 {
+    DK_TRACE_SCOPE("parse metadata");
+
     mExifState = no_data;
 
     if (mUseSidecar) {
@@ -186,10 +189,14 @@ bool DkMetaDataT::saveMetaData(const QString &filePath, bool force)
         return false;
     }
 
-    // Open image file for WRITING, save it with modified metadata
-    file.open(QFile::WriteOnly);
-    file.write(ba->data(), ba->size());
-    file.close();
+    // write to a temporary file first - the original stays intact if we fail
+    QSaveFile saveFile(filePath);
+    saveFile.setDirectWriteFallback(true);
+
+    if (!saveFile.open(QFile::WriteOnly) || saveFile.write(ba->data(), ba->size()) != ba->size() || !saveFile.commit()) {
+        qWarning() << "[DkMetaDataT] could not write: " << QFileInfo(filePath).fileName();
+        return false;
+    }
 
     qInfo() << "[DkMetaDataT] I saved: " << ba->size() << " bytes";
 
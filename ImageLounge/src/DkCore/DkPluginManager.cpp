@@ -35,9 +35,13 @@
 
 #pragma warning(push, 0) // no warnings from includes - begin
 #include <QAction>
+#include <QDataStream>
 #include <QDebug>
 #include <QDir>
+#include <QFileInfo>
+#include <QHash>
 #include <QHeaderView>
+#include <QIcon>
 #include <QJsonValue>
 #include <QLibraryInfo>
 #include <QLineEdit>
@@ -52,6 +56,7 @@
 #include <QProgressDialog>
 #include <QPushButton>
 #include <QRegularExpression>
+#include <QSaveFile>
 #include <QScrollBar>
 #include <QSettings>
 #include <QSlider>
@@ -171,11 +176,16 @@ QVector<DkLibrary> DkLibrary::loadDependencies() const
 }
 
 // DkPluginContainer --------------------------------------------------------------------
-DkPluginContainer::DkPluginContainer(const QString &pluginPath)
+DkPluginContainer::DkPluginContainer(const QString &pluginPath, const QByteArray &manifest)
 {
     mPluginPath = pluginPath;
     mLoader = QSharedPointer<QPluginLoader>(new QPluginLoader(mPluginPath));
-    loadJson();
+
+    // the manifest saves us from reading the library
+    if (manifest.isEmpty() || !loadManifest(manifest))
+        loadJson();
+    else
+        createMenu();
 }
 
 DkPluginContainer::~DkPluginContainer()
@@ -194,6 +204,10 @@ void DkPluginContainer::setActive(bool active)
 {
     mActive = active;
 
+    // the plugin was never used
+    if (!isLoaded())
+        return;
+
     DkPluginInterface *p = plugin();
     if (p && p->interfaceType() == DkPluginInterface::interface_viewport) {
         DkViewPortInterface *vPlugin = pluginViewPort();
@@ -212,11 +226,14 @@ bool DkPluginContainer::isActive() const
 
 bool DkPluginContainer::isLoaded() const
 {
-    return mLoader->isLoaded();
+    return mLoaded;
 }
 
 bool DkPluginContainer::load()
 {
+    if (mLoaded)
+        return true;
+
     DkTimer dt;
 
     if (!isValid()) {
@@ -245,23 +262,37 @@ bool DkPluginContainer::load()
         }
     }
 
-    if (pluginViewPort())
+    // we cannot use plugin() & co. here since they load the plugin if it is not loaded
+    QObject *instance = mLoader->instance();
+
+    if (qobject_cast<DkViewPortInterface *>(instance))
         mType = type_viewport;
-    else if (batchPlugin()) {
-        // load the settings
+    else if (qobject_cast<DkBatchPluginInterface *>(instance))
         mType = type_batch;
-        batchPlugin()->loadSettings();
-    } else if (plugin())
+    else if (qobject_cast<DkPluginInterface *>(instance))
         mType = type_simple;
     else {
         qWarning() << "could not initialize: " << mPluginPath << "unknown interface";
+        mLoader->unload();
         return false;
     }
 
+    mLoaded = true;
+
+    // load the settings
+    if (mType == type_batch)
+        batchPlugin()->loadSettings();
+
     if (mType != type_unknown) {
         // init actions
         plugin()->createActions(DkUtils::getMainWindow());
-        createMenu();
+
+        // the menu was created from the manifest
+        if (mPluginMenu) {
+            for (auto action : plugin()->pluginActions())
+                connect(action, &QAction::triggered, this, &DkPluginContainer::run, Qt::UniqueConnection);
+        } else
+            createMenu();
     }
 
     qInfo() << mPluginPath << "loaded in" << dt;
@@ -278,18 +309,86 @@ bool DkPluginContainer::uninstall()
 
 void DkPluginContainer::createMenu()
 {
-    DkPluginInterface *p = plugin();
+    QList<QAction *> actions = pluginActions();
 
     // empty menu if we do not have any actions
-    if (!p || p->pluginActions().empty())
+    if (actions.empty())
         return;
 
     mPluginMenu = new QMenu(pluginName(), DkUtils::getMainWindow());
 
-    for (auto action : p->pluginActions()) {
+    for (auto action : actions) {
         mPluginMenu->addAction(action);
-        connect(action, &QAction::triggered, this, &DkPluginContainer::run, Qt::UniqueConnection);
+
+        if (isLoaded())
+            connect(action, &QAction::triggered, this, &DkPluginContainer::run, Qt::UniqueConnection);
+        else
+            connect(action, &QAction::triggered, this, &DkPluginContainer::runPluginAction, Qt::UniqueConnection);
+    }
+}
+
+/**
+ * Returns the plugin's description (meta data, type & actions).
+ * It is cached so that the plugin menus can be created without loading the library.
+ **/
+QByteArray DkPluginContainer::manifest() const
+{
+    QByteArray manifest;
+    QDataStream ds(&manifest, QIODevice::WriteOnly);
+
+    ds << mPluginName << mAuthorName << mCompany << mDescription << mVersion << mTagline << mId;
+    ds << mDateCreated << mDateModified << mIsValid << (qint32)mType;
+
+    QList<QAction *> actions = pluginActions();
+    ds << (qint32)actions.size();
+
+    for (const QAction *a : actions)
+        ds << a->text() << a->data() << a->statusTip() << a->toolTip() << a->icon() << a->shortcuts() << a->isCheckable() << a->isChecked();
+
+    return manifest;
+}
+
+bool DkPluginContainer::loadManifest(const QByteArray &manifest)
+{
+    QDataStream ds(manifest);
+
+    qint32 type = type_unknown;
+    qint32 numActions = 0;
+
+    ds >> mPluginName >> mAuthorName >> mCompany >> mDescription >> mVersion >> mTagline >> mId;
+    ds >> mDateCreated >> mDateModified >> mIsValid >> type;
+    ds >> numActions;
+
+    mType = (PluginType)type;
+
+    for (int idx = 0; idx < numActions && ds.status() == QDataStream::Ok; idx++) {
+        QString text, statusTip, toolTip;
+        QVariant data;
+        QIcon icon;
+        QList<QKeySequence> shortcuts;
+        bool checkable = false, checked = false;
+
+        ds >> text >> data >> statusTip >> toolTip >> icon >> shortcuts >> checkable >> checked;
+
+        QAction *a = new QAction(icon, text, this);
+        a->setData(data);
+        a->setStatusTip(statusTip);
+        a->setToolTip(toolTip);
+        a->setShortcuts(shortcuts);
+        a->setCheckable(checkable);
+        a->setChecked(checked);
+        mManifestActions << a;
     }
+
+    if (ds.status() != QDataStream::Ok || type <= type_unknown || type >= type_end) {
+        qWarning() << "[DkPluginContainer] corrupted manifest for" << mPluginPath;
+        qDeleteAll(mManifestActions);
+        mManifestActions.clear();
+        mIsValid = false;
+        return false;
+    }
+
+    return true;
 }
 
 void DkPluginContainer::loadJson()
@@ -393,6 +492,32 @@ void DkPluginContainer::run()
         qWarning() << "plugin with illegal interface detected in DkPluginContainer::run()";
 }
 
+/**
+ * Loads the plugin & triggers its action that corresponds to the manifest action (sender).
+ **/
+void DkPluginContainer::runPluginAction()
+{
+    QAction *a = qobject_cast<QAction *>(QObject::sender());
+
+    if (!a || !load())
+        return;
+
+    for (QAction *pa : plugin()->pluginActions()) {
+        if (pa->data() == a->data() && pa->text() == a->text()) {
+            // trigger() toggles checkable actions - so they end up with the state of the menu's action
+            if (pa->isCheckable()) {
+                pa->setChecked(!a->isChecked());
+                connect(pa, &QAction::toggled, a, &QAction::setChecked, Qt::UniqueConnection);
+            }
+
+            pa->trigger();
+            return;
+        }
+    }
+
+    qWarning() << "[DkPluginContainer]" << mPluginName << "has no action" << a->text() << "- please delete" << DkPluginManager::manifestPath();
+}
+
 bool DkPluginContainer::isValid() const
 {
     return mIsValid;
@@ -478,6 +603,20 @@ QMenu *DkPluginContainer::pluginMenu() const
     return mPluginMenu;
 }
 
+QList<QAction *> DkPluginContainer::pluginActions() const
+{
+    if (!isLoaded())
+        return mManifestActions;
+
+    DkPluginInterface *p = plugin();
+    return p ? p->pluginActions() : QList<QAction *>();
+}
+
+DkPluginContainer::PluginType DkPluginContainer::type() const
+{
+    return mType;
+}
+
 QSharedPointer<QPluginLoader> DkPluginContainer::loader() const
 {
     return mLoader;
@@ -489,6 +628,10 @@ DkPluginInterface *DkPluginContainer::plugin() const
     if (!mLoader)
         return 0;
 
+    // plugins created from the manifest are loaded when they are first used
+    if (!mLoaded && !const_cast<DkPluginContainer *>(this)->load())
+        return 0;
+
     DkPluginInterface *pi = qobject_cast<DkPluginInterface *>(mLoader->instance());
 
     if (!pi && pluginViewPort())
@@ -505,6 +648,9 @@ DkBatchPluginInterface *DkPluginContainer::batchPlugin() const
     if (!mLoader)
         return 0;
 
+    if (!mLoaded && !const_cast<DkPluginContainer *>(this)->load())
+        return 0;
+
     return qobject_cast<DkBatchPluginInterface *>(mLoader->instance());
 }
 
@@ -514,15 +660,15 @@ DkViewPortInterface *DkPluginContainer::pluginViewPort() const
     if (!mLoader)
         return 0;
 
+    if (!mLoaded && !const_cast<DkPluginContainer *>(this)->load())
+        return 0;
+
     return qobject_cast<DkViewPortInterface *>(mLoader->instance());
 }
 
 QString DkPluginContainer::actionNameToRunId(const QString &actionName) const
 {
-    if (!plugin())
-        return QString();
-
-    QList<QAction *> actions = plugin()->pluginActions();
+    QList<QAction *> actions = pluginActions();
     for (const QAction *a : actions) {
         if (a->text() == actionName)
             return a->data().toString();
@@ -1056,6 +1202,74 @@ void DkDescriptionImage::selectionChanged(const QItemSelection &, const QItemSel
 }
 
 // DkPluginManager --------------------------------------------------------------------
+static const quint32 pluginManifestMagic = 0x4e504d31; // NPM1
+static const quint32 pluginManifestVersion = 2;
+
+// cached state of a file in the plugin directories
+struct DkPluginManifestEntry {
+    qint64 modified = 0;
+    qint64 size = 0;
+    QByteArray manifest; // empty if the file is not a nomacs plugin
+};
+
+static QHash<QString, DkPluginManifestEntry> loadPluginManifest()
+{
+    QHash<QString, DkPluginManifestEntry> entries;
+
+    QFile file(DkPluginManager::manifestPath());
+    if (!file.open(QIODevice::ReadOnly))
+        return entries;
+
+    QDataStream ds(&file);
+
+    quint32 magic = 0, version = 0;
+    QString appVersion;
+    ds >> magic >> version >> appVersion;
+
+    // plugins are rebuilt along with nomacs
+    if (magic != pluginManifestMagic || version != pluginManifestVersion || appVersion != QCoreApplication::applicationVersion())
+        return entries;
+
+    qint32 numEntries = 0;
+    ds >> numEntries;
+
+    for (int idx = 0; idx < numEntries && ds.status() == QDataStream::Ok; idx++) {
+        QString path;
+        DkPluginManifestEntry e;
+        ds >> path >> e.modified >> e.size >> e.manifest;
+        entries.insert(path, e);
+    }
+
+    if (ds.status() != QDataStream::Ok) {
+        qWarning() << "[DkPluginManager] ignoring corrupted manifest" << file.fileName();
+        entries.clear();
+    }
+
+    return entries;
+}
+
+static void savePluginManifest(const QHash<QString, DkPluginManifestEntry> &entries)
+{
+    QString filePath = DkPluginManager::manifestPath();
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "[DkPluginManager] cannot write" << filePath << file.errorString();
+        return;
+    }
+
+    QDataStream ds(&file);
+    ds << pluginManifestMagic << pluginManifestVersion << QCoreApplication::applicationVersion();
+    ds << (qint32)entries.size();
+
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it)
+        ds << it.key() << it.value().modified << it.value().size << it.value().manifest;
+
+    if (!file.commit())
+        qWarning() << "[DkPluginManager] cannot write" << filePath << file.errorString();
+}
+
 DkPluginManager &DkPluginManager::instance()
 {
     static DkPluginManager inst;
@@ -1134,6 +1348,11 @@ void DkPluginManager::loadPlugins()
 
     DkTimer dt;
 
+    // plugins that did not change since the last start are not loaded (see DkPluginContainer::plugin())
+    QHash<QString, DkPluginManifestEntry> manifest = loadPluginManifest();
+    QHash<QString, DkPluginManifestEntry> newManifest;
+    int numLoaded = 0;
+
     QStringList loadedPluginFileNames = QStringList();
     QStringList libPaths = QCoreApplication::libraryPaths();
     libPaths.append(QCoreApplication::applicationDirPath() + "/plugins");
@@ -1163,16 +1382,38 @@ void DkPluginManager::loadPlugins()
 #endif
             QString shortFileName = fileName.split("/").last();
             if (!loadedPluginFileNames.contains(shortFileName)) { // prevent double loading of the same plugin
-                if (singlePluginLoad(pluginsDir.absoluteFilePath(fileName)))
+                QString filePath = pluginsDir.absoluteFilePath(fileName);
+                QFileInfo fileInfo(filePath);
+
+                DkPluginManifestEntry e = manifest.value(filePath);
+
+                if (e.modified != fileInfo.lastModified().toMSecsSinceEpoch() || e.size != fileInfo.size()) {
+                    e.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+                    e.size = fileInfo.size();
+                    e.manifest.clear();
+
+                    if (singlePluginLoad(filePath))
+                        e.manifest = mPlugins.last()->manifest();
+
+                    numLoaded++;
+                } else if (!e.manifest.isEmpty())
+                    mPlugins.append(QSharedPointer<DkPluginContainer>(new DkPluginContainer(filePath, e.manifest)));
+
+                if (!e.manifest.isEmpty())
                     loadedPluginFileNames.append(shortFileName);
+
+                newManifest.insert(filePath, e);
             }
             // else
             //	qDebug() << "rejected since it is twice: " << shortFileName;
         }
     }
 
+    if (numLoaded > 0 || newManifest.size() != manifest.size())
+        savePluginManifest(newManifest);
+
     std::sort(mPlugins.begin(), mPlugins.end()); // , &DkPluginContainer::operator<);
-    qInfo() << mPlugins.size() << "plugins loaded in" << dt;
+    qInfo() << mPlugins.size() << "plugins found in" << dt << "-" << numLoaded << "loaded";
 
     if (mPlugins.empty())
         qInfo() << "I was searching these paths" << libPaths;
@@ -1189,10 +1430,11 @@ bool DkPluginManager::singlePluginLoad(const QString &filePath)
 
     DkTimer dt;
     QSharedPointer<DkPluginContainer> plugin = QSharedPointer<DkPluginContainer>(new DkPluginContainer(filePath));
-    if (plugin->load())
+    bool loaded = plugin->load();
+    if (loaded)
         mPlugins.append(plugin);
 
-    return plugin->isLoaded();
+    return loaded;
 }
 
 QSharedPointer<DkPluginContainer> DkPluginManager::getPluginByName(const QString &pluginName) const
@@ -1219,10 +1461,9 @@ QVector<QSharedPointer<DkPluginContainer>> DkPluginManager::getBasicPlugins() co
 {
     QVector<QSharedPointer<DkPluginContainer>> plugins;
 
+    // NOTE: we use the type since plugin() would load the library
     for (auto plugin : mPlugins) {
-        DkPluginInterface *p = plugin->plugin();
-
-        if (p && p->interfaceType() == DkPluginInterface::interface_basic) {
+        if (plugin->type() == DkPluginContainer::type_simple) {
             plugins.append(plugin);
         }
     }
@@ -1235,9 +1476,7 @@ QVector<QSharedPointer<DkPluginContainer>> DkPluginManager::getBatchPlugins() co
     QVector<QSharedPointer<DkPluginContainer>> plugins;
 
     for (auto plugin : mPlugins) {
-        DkPluginInterface *p = plugin->plugin();
-
-        if (p && (p->interfaceType() == DkPluginInterface::interface_basic || p->interfaceType() == DkPluginInterface::interface_batch)) {
+        if (plugin->type() == DkPluginContainer::type_simple || plugin->type() == DkPluginContainer::type_batch) {
             plugins.append(plugin);
         }
     }
@@ -1295,6 +1534,11 @@ QStringList DkPluginManager::blackList()
     return QStringList() << "opencv";
 }
 
+QString DkPluginManager::manifestPath()
+{
+    return QFileInfo(DkSettingsManager::param().settingsPath()).absoluteDir().absoluteFilePath("plugins.manifest");
+}
+
 void DkPluginManager::createPluginsPath()
 {
 #ifdef WITH_PLUGINS
@@ -1439,13 +1683,15 @@ void DkPluginActionManager::addPluginsToMenu()
     QStringList pluginMenu = QStringList();
 
     for (auto plugin : loadedPlugins) {
-        DkPluginInterface *pi = plugin->plugin();
+        // NOTE: plugin() is not called here since it would load all plugins
+        bool hasInterface = plugin->type() != DkPluginContainer::type_unknown;
 
-        if (pi && plugin->pluginMenu()) {
-            QList<QAction *> actions = pi->createActions(DkUtils::getMainWindow());
+        if (hasInterface && plugin->pluginMenu()) {
+            if (plugin->isLoaded())
+                plugin->plugin()->createActions(DkUtils::getMainWindow());
             mPluginSubMenus.append(plugin->pluginMenu());
             mMenu->addMenu(plugin->pluginMenu());
-        } else if (pi) {
+        } else if (hasInterface) {
             QAction *a = new QAction(plugin->pluginName(), this);
             a->setData(plugin->id());
             mPluginActions.append(a);
@@ -95,7 +95,12 @@ class DllCoreExport DkPluginContainer : public QObject
     Q_OBJECT
 
 public:
-    DkPluginContainer(const QString &pluginPath);
+    /**
+     * Creates a plugin container.
+     * @param pluginPath the plugin's library
+     * @param manifest cached description (see manifest()), the library is loaded lazily if it is set
+     **/
+    DkPluginContainer(const QString &pluginPath, const QByteArray &manifest = QByteArray());
     ~DkPluginContainer();
 
     enum PluginType {
@@ -132,6 +137,10 @@ public:
     QDate dateModified() const;
 
     QMenu *pluginMenu() const;
+    QList<QAction *> pluginActions() const;
+    PluginType type() const;
+
+    QByteArray manifest() const;
 
     QSharedPointer<QPluginLoader> loader() const;
     DkPluginInterface *plugin() const;
@@ -145,6 +154,7 @@ signals:
 
 public slots:
     void run();
+    void runPluginAction();
 
 protected:
     QString mPluginPath;
@@ -161,16 +171,19 @@ protected:
 
     bool mActive = false;
     bool mIsValid = false;
+    bool mLoaded = false;
 
     PluginType mType = type_unknown;
 
     QMenu *mPluginMenu = 0;
+    QList<QAction *> mManifestActions; // stand-ins for the plugin's actions until it is loaded
 
     QSharedPointer<QPluginLoader> mLoader = QSharedPointer<QPluginLoader>();
 
     void createMenu();
     void loadJson();
     void loadMetaData(const QJsonValue &val);
+    bool loadManifest(const QByteArray &manifest);
 };
 
 class DllCoreExport DkPluginActionManager : public QObject
@@ -245,6 +258,7 @@ public:
     bool isBlackListed(const QString &pluginPath) const;
     static QStringList blackList();
     static void createPluginsPath();
+    static QString manifestPath();
 
 private:
     DkPluginManager();
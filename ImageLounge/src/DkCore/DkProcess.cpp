@@ -38,12 +38,18 @@
 #include "DkMetaData.h"
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QElapsedTimer>
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThreadPool>
 #include <QWidget>
-#include <QtConcurrentMap>
+#include <QtConcurrentRun>
+#include <QtMath>
 #pragma warning(pop) // no warnings from includes - end
 
+#include <algorithm>
 #include <cassert>
 
 namespace nmc
@@ -755,10 +761,39 @@ bool DkBatchProcess::wasProcessed() const
     return mIsProcessed;
 }
 
+bool DkBatchProcess::wasSkipped() const
+{
+    return mIsSkipped;
+}
+
 bool DkBatchProcess::compute()
 {
-    mIsProcessed = true;
+    if (readInput()) {
+        processInput();
+        writeOutput();
+    }
+
+    return mFailure == 0;
+}
+
+/**
+ * Checks the input and loads the image (first pipeline stage).
+ * Rename and copy operations are completely done here.
+ * @return bool true if the image was loaded and needs to be processed
+ **/
+bool DkBatchProcess::readInput()
+{
+    QElapsedTimer dt;
+    dt.start();
+
+    bool loaded = loadInput();
+    mDecodeTime = dt.nsecsElapsed();
+
+    return loaded;
+}
 
+bool DkBatchProcess::loadInput()
+{
     QFileInfo fInfoIn(mSaveInfo.inputFilePath());
     QFileInfo fInfoOut(mSaveInfo.outputFilePath());
 
@@ -767,23 +802,27 @@ bool DkBatchProcess::compute()
         (fInfoOut.exists() && mSaveInfo.mode() == DkSaveInfo::mode_skip_existing)) {
         mLogStrings.append(QObject::tr("%1 already exists -> skipping (check 'overwrite' if you want to overwrite the file)").arg(mSaveInfo.outputFilePath()));
         mFailure++;
-        return mFailure == 0;
+        mIsProcessed = true;
+        return false;
     } else if (!fInfoIn.exists()) {
         mLogStrings.append(QObject::tr("Error: input file does not exist"));
         mLogStrings.append(QObject::tr("Input: %1").arg(mSaveInfo.inputFilePath()));
         mFailure++;
-        return mFailure == 0;
+        mIsProcessed = true;
+        return false;
     } else if (mSaveInfo.inputFilePath() == mSaveInfo.outputFilePath() && mProcessFunctions.empty()) {
         mLogStrings.append(QObject::tr("Skipping: nothing to do here."));
         mFailure++;
-        return mFailure == 0;
+        mIsProcessed = true;
+        return false;
     }
 
     // rename operation?
     if (mProcessFunctions.empty() && mSaveInfo.inputFilePath() == mSaveInfo.outputFilePath() && fInfoIn.suffix() == fInfoOut.suffix()) {
         if (!renameFile())
             mFailure++;
-        return mFailure == 0;
+        mIsProcessed = true;
+        return false;
     }
     // copy operation?
     else if (mProcessFunctions.empty() && fInfoIn.suffix() == fInfoOut.suffix()) {
@@ -792,35 +831,39 @@ bool DkBatchProcess::compute()
         else
             deleteOriginalFile();
 
-        return mFailure == 0;
+        mIsProcessed = true;
+        return false;
     }
 
-    // do the work
-    process();
-
-    // delete the original file if the user requested it
-    deleteOriginalFile();
-
-    return mFailure == 0;
-}
-
-QStringList DkBatchProcess::getLog() const
-{
-    return mLogStrings;
-}
-
-bool DkBatchProcess::process()
-{
     mLogStrings.append(QObject::tr("processing %1").arg(mSaveInfo.inputFilePath()));
 
-    QSharedPointer<DkImageContainer> imgC(new DkImageContainer(mSaveInfo.inputFilePath()));
+    mImgC = QSharedPointer<DkImageContainer>(new DkImageContainer(mSaveInfo.inputFilePath()));
 
-    if (!imgC->loadImage() || imgC->image().isNull()) {
+    if (!mImgC->loadImage() || mImgC->image().isNull()) {
         mLogStrings.append(QObject::tr("Error while loading..."));
         mFailure++;
+        mImgC.clear();
+
+        // delete the original file if the user requested it
+        deleteOriginalFile();
+        mIsProcessed = true;
         return false;
     }
 
+    return true;
+}
+
+/**
+ * Applies the process chain to the loaded image (second pipeline stage).
+ **/
+void DkBatchProcess::processInput()
+{
+    if (!mImgC)
+        return;
+
+    QElapsedTimer dt;
+    dt.start();
+
     for (QSharedPointer<DkAbstractBatch> batch : mProcessFunctions) {
         if (!batch) {
             mLogStrings.append(QObject::tr("Error: cannot process a NULL function."));
@@ -828,7 +871,7 @@ bool DkBatchProcess::process()
         }
 
         QVector<QSharedPointer<DkBatchInfo>> cInfos;
-        if (!batch->compute(imgC, mSaveInfo, mLogStrings, cInfos)) {
+        if (!batch->compute(mImgC, mSaveInfo, mLogStrings, cInfos)) {
             mLogStrings.append(QObject::tr("%1 failed").arg(batch->name()));
             mFailure++;
         }
@@ -836,6 +879,86 @@ bool DkBatchProcess::process()
         mInfos << cInfos;
     }
 
+    mProcessTime = dt.nsecsElapsed();
+}
+
+/**
+ * Encodes and saves the processed image (last pipeline stage).
+ * @return bool true if the item was processed without errors
+ **/
+bool DkBatchProcess::writeOutput()
+{
+    if (mImgC) {
+        QElapsedTimer dt;
+        dt.start();
+
+        saveOutput();
+        mImgC.clear(); // free the image as early as possible
+        mEncodeTime = dt.nsecsElapsed();
+    }
+
+    // delete the original file if the user requested it
+    deleteOriginalFile();
+    mIsProcessed = true;
+
+    return mFailure == 0;
+}
+
+/**
+ * Drops the item if the batch was cancelled.
+ * The decoded image (if any) is released immediately.
+ **/
+void DkBatchProcess::skip()
+{
+    if (mIsProcessed || mIsSkipped)
+        return;
+
+    mImgC.clear();
+    mIsSkipped = true;
+    mLogStrings.append(QObject::tr("%1 skipped - batch processing was cancelled").arg(mSaveInfo.inputFilePath()));
+}
+
+/// time from starting to decode the item until it was done in ms (including the waits between the stages)
+double DkBatchProcess::latency() const
+{
+    return mLatency / 1e6;
+}
+
+void DkBatchProcess::setStarted(qint64 ns)
+{
+    mStartedAt = ns;
+}
+
+void DkBatchProcess::setFinished(qint64 ns)
+{
+    mLatency = ns - mStartedAt;
+}
+
+QStringList DkBatchProcess::getLog() const
+{
+    return mLogStrings;
+}
+
+/// decoding time (incl. rename/copy operations) in ms
+double DkBatchProcess::decodeTime() const
+{
+    return mDecodeTime / 1e6;
+}
+
+/// time spent in the process chain in ms
+double DkBatchProcess::processTime() const
+{
+    return mProcessTime / 1e6;
+}
+
+/// encoding & saving time in ms
+double DkBatchProcess::encodeTime() const
+{
+    return mEncodeTime / 1e6;
+}
+
+bool DkBatchProcess::saveOutput()
+{
     // report we could not back-up & break here
     if (!prepareDeleteExisting()) {
         mFailure++;
@@ -849,11 +972,11 @@ bool DkBatchProcess::process()
     }
 
     // udpate metadata
-    if (updateMetaData(imgC->getMetaData().data()))
+    if (updateMetaData(mImgC->getMetaData().data()))
         mLogStrings.append(QObject::tr("Original filename added to Exif"));
 
     // save the image
-    if (imgC->saveImage(mSaveInfo.outputFilePath(), mSaveInfo.compression())) {
+    if (mImgC->saveImage(mSaveInfo.outputFilePath(), mSaveInfo.compression())) {
         mLogStrings.append(QObject::tr("%1 saved...").arg(mSaveInfo.outputFilePath()));
     } else {
         mLogStrings.append(QObject::tr("Could not save: %1").arg(mSaveInfo.outputFilePath()));
@@ -1058,13 +1181,185 @@ bool DkBatchConfig::isOk() const
     return true;
 }
 
+// DkBatchQueue --------------------------------------------------------------------
+DkBatchQueue::DkBatchQueue(int capacity)
+{
+    mCapacity = qMax(capacity, 1);
+}
+
+bool DkBatchQueue::push(DkBatchProcess *item)
+{
+    QMutexLocker locker(&mMutex);
+
+    while (mItems.size() >= mCapacity && !mClosed)
+        mNotFull.wait(&mMutex);
+
+    if (mClosed)
+        return false;
+
+    mItems.enqueue(item);
+    mNotEmpty.wakeOne();
+
+    return true;
+}
+
+bool DkBatchQueue::pop(DkBatchProcess *&item)
+{
+    QMutexLocker locker(&mMutex);
+
+    while (mItems.empty() && !mClosed)
+        mNotEmpty.wait(&mMutex);
+
+    if (mItems.empty())
+        return false;
+
+    item = mItems.dequeue();
+    mNotFull.wakeOne();
+
+    return true;
+}
+
+void DkBatchQueue::close()
+{
+    QMutexLocker locker(&mMutex);
+    mClosed = true;
+    mNotEmpty.wakeAll();
+    mNotFull.wakeAll();
+}
+
+// DkBatchPipeline --------------------------------------------------------------------
+DkBatchPipeline::DkBatchPipeline()
+{
+    // the stages share the threads the user granted us - decoding & encoding are I/O bound
+    // NOTE: every stage needs at least one thread, so we exceed maxThreadCount if it is < 3
+    int numThreads = qMax(QThreadPool::globalInstance()->maxThreadCount(), 1);
+    int numReaders = qBound(1, numThreads / 4, 4);
+    int numWriters = qBound(1, numThreads / 4, 8);
+    setNumThreads(numReaders, numThreads - numReaders - numWriters, numWriters);
+}
+
+void DkBatchPipeline::setNumThreads(int numReaders, int numWorkers, int numWriters)
+{
+    mNumReaders = qMax(numReaders, 1);
+    mNumWorkers = qMax(numWorkers, 1);
+    mNumWriters = qMax(numWriters, 1);
+
+    // backpressure: keep every worker busy but do not decode (much) more than we can process
+    mQueueSize = 2 * mNumWorkers;
+}
+
+void DkBatchPipeline::setQueueSize(int queueSize)
+{
+    mQueueSize = qMax(queueSize, 1);
+}
+
+void DkBatchPipeline::setItemFinishedCallback(const std::function<void(int, const DkBatchProcess &)> &callback)
+{
+    mItemFinished = callback;
+}
+
+void DkBatchPipeline::run(QVector<DkBatchProcess> &items)
+{
+    mCancelled = 0;
+    mNumFinished = 0;
+    mClock.start();
+
+    DkBatchQueue input(items.size());
+    for (DkBatchProcess &item : items)
+        input.push(&item);
+    input.close();
+
+    DkBatchQueue decoded(mQueueSize);
+    DkBatchQueue processed(mQueueSize);
+
+    QThreadPool readers;
+    QThreadPool workers;
+    QThreadPool writers;
+
+    // items are all enqueued at once - the latency starts when a reader takes them
+    runStage(readers, mNumReaders, &input, &decoded, [this](DkBatchProcess *item) {
+        item->setStarted(mClock.nsecsElapsed());
+        return item->readInput();
+    });
+    runStage(workers, mNumWorkers, &decoded, &processed, [](DkBatchProcess *item) {
+        item->processInput();
+        return true;
+    });
+    runStage(writers, mNumWriters, &processed, nullptr, [](DkBatchProcess *item) {
+        item->writeOutput();
+        return false;
+    });
+
+    readers.waitForDone();
+    workers.waitForDone();
+    writers.waitForDone();
+}
+
+void DkBatchPipeline::cancel()
+{
+    mCancelled = 1;
+}
+
+bool DkBatchPipeline::isCancelled() const
+{
+    return mCancelled.loadRelaxed() != 0;
+}
+
+/**
+ * Starts numThreads threads that pull items from in, apply stage and pass them to out.
+ * Threads of a stage share their input queue, so an idle thread always takes the next
+ * item regardless of which thread is still busy with a slow image.
+ * If stage returns false, the item is done and does not enter the next stage.
+ **/
+void DkBatchPipeline::runStage(QThreadPool &pool,
+                               int numThreads,
+                               DkBatchQueue *in,
+                               DkBatchQueue *out,
+                               const std::function<bool(DkBatchProcess *)> &stage)
+{
+    QSharedPointer<QAtomicInt> numRunning(new QAtomicInt(numThreads));
+    pool.setMaxThreadCount(numThreads);
+
+    for (int idx = 0; idx < numThreads; idx++) {
+        pool.start([this, in, out, stage, numRunning]() {
+            DkBatchProcess *item = nullptr;
+
+            while (in->pop(item)) {
+                // drain the queue on cancel - otherwise the previous stage blocks
+                if (isCancelled()) {
+                    item->skip();
+                    continue;
+                }
+
+                if (stage(item) && out)
+                    out->push(item);
+                else
+                    itemFinished(*item);
+            }
+
+            // the last thread of a stage tells the next stage that no more items arrive
+            if (!numRunning->deref() && out)
+                out->close();
+        });
+    }
+}
+
+void DkBatchPipeline::itemFinished(DkBatchProcess &item)
+{
+    item.setFinished(mClock.nsecsElapsed());
+
+    int numFinished = mNumFinished.fetchAndAddRelaxed(1) + 1;
+
+    if (mItemFinished)
+        mItemFinished(numFinished, item);
+}
+
 // DkBatchProcessing --------------------------------------------------------------------
 DkBatchProcessing::DkBatchProcessing(const DkBatchConfig &config, QWidget *parent /*= 0*/)
     : QObject(parent)
 {
     mBatchConfig = config;
 
-    connect(&mBatchWatcher, &QFutureWatcher<void>::progressValueChanged, this, &DkBatchProcessing::progressValueChanged);
     connect(&mBatchWatcher, &QFutureWatcher<void>::finished, this, &DkBatchProcessing::finished);
 }
 
@@ -1076,6 +1371,10 @@ void DkBatchProcessing::init()
 
     DkFileNameConverter converter(mBatchConfig.getFileNamePattern());
     for (int idx = 0; idx < fileList.size(); idx++) {
+        // the index is kept for sharded runs so that file name patterns stay consistent
+        if (idx % mNumShards != mShardIdx)
+            continue;
+
         DkSaveInfo si = mBatchConfig.saveInfo();
 
         QFileInfo cFileInfo = QFileInfo(fileList.at(idx));
@@ -1149,13 +1448,17 @@ void DkBatchProcessing::compute()
     if (mBatchWatcher.isRunning())
         mBatchWatcher.waitForFinished();
 
-    QFuture<void> future = QtConcurrent::map(mBatchItems, &nmc::DkBatchProcessing::computeItem);
-    mBatchWatcher.setFuture(future);
-}
+    // items are decoded, processed and encoded in parallel stages
+    mPipeline = QSharedPointer<DkBatchPipeline>(new DkBatchPipeline());
+    mPipeline->setItemFinishedCallback([this](int numFinished, const DkBatchProcess &) {
+        emit progressValueChanged(numFinished);
+    });
 
-bool DkBatchProcessing::computeItem(DkBatchProcess &item)
-{
-    return item.compute();
+    QSharedPointer<DkBatchPipeline> pipeline = mPipeline;
+    QFuture<void> future = QtConcurrent::run([this, pipeline]() {
+        pipeline->run(mBatchItems);
+    });
+    mBatchWatcher.setFuture(future);
 }
 
 void DkBatchProcessing::postLoad()
@@ -1172,7 +1475,7 @@ void DkBatchProcessing::postLoad()
     }
 }
 
-void DkBatchProcessing::computeBatch(const QString &settingsPath, const QString &logPath)
+void DkBatchProcessing::computeBatch(const QString &settingsPath, const QString &logPath, int shardIdx, int numShards)
 {
     DkTimer dt;
     DkBatchConfig bc = DkBatchProfile::loadProfile(settingsPath);
@@ -1185,6 +1488,7 @@ void DkBatchProcessing::computeBatch(const QString &settingsPath, const QString
 
     QSharedPointer<nmc::DkBatchProcessing> process(new nmc::DkBatchProcessing());
     process->setBatchConfig(bc);
+    process->setShard(shardIdx, numShards);
     process->compute();
 
     process->waitForFinished(); // block
@@ -1209,6 +1513,115 @@ void DkBatchProcessing::computeBatch(const QString &settingsPath, const QString
     }
 }
 
+/**
+ * Runs a batch profile without any UI and streams JSON lines to stdout.
+ * Every finished item is reported with its decode/process/encode timings,
+ * the last line summarizes the throughput and latency percentiles.
+ * @param shardIdx the shard processed by this instance (0 <= shardIdx < numShards)
+ * @param numShards the number of instances sharing the profile's file list
+ * @return int 0 if all images were processed, 1 on failures, 2 if the batch could not start
+ **/
+int DkBatchProcessing::computeBatchHeadless(const QString &settingsPath, const QString &logPath, int shardIdx, int numShards)
+{
+    QFile out;
+    out.open(stdout, QIODevice::WriteOnly);
+    QMutex outMutex;
+
+    auto writeLine = [&out, &outMutex](const QJsonObject &line) {
+        QMutexLocker locker(&outMutex);
+        out.write(QJsonDocument(line).toJson(QJsonDocument::Compact) + '\n');
+        out.flush();
+    };
+
+    DkBatchConfig bc = DkBatchProfile::loadProfile(settingsPath);
+
+    if (!bc.isOk() || numShards < 1 || shardIdx < 0 || shardIdx >= numShards) {
+        writeLine({{"event", "error"}, {"message", QString("invalid batch profile or shard: %1").arg(settingsPath)}});
+        return 2;
+    }
+
+    // guarantee that the output path exists
+    if (!QDir().mkpath(bc.getOutputDirPath())) {
+        writeLine({{"event", "error"}, {"message", QString("could not create: %1").arg(bc.getOutputDirPath())}});
+        return 2;
+    }
+
+    DkBatchProcessing process(bc);
+    process.setShard(shardIdx, numShards);
+    process.init();
+
+    int numItems = process.mBatchItems.size();
+    writeLine({{"event", "start"}, {"profile", settingsPath}, {"shard", shardIdx}, {"shards", numShards}, {"items", numItems}});
+
+    DkBatchPipeline pipeline;
+    pipeline.setItemFinishedCallback([&writeLine, numItems](int numFinished, const DkBatchProcess &item) {
+        writeLine({{"event", "item"},
+                   {"input", item.inputFile()},
+                   {"output", item.outputFile()},
+                   {"ok", !item.hasFailed()},
+                   {"done", numFinished},
+                   {"items", numItems},
+                   {"decode_ms", item.decodeTime()},
+                   {"process_ms", item.processTime()},
+                   {"encode_ms", item.encodeTime()},
+                   {"latency_ms", item.latency()}});
+    });
+
+    QElapsedTimer dt;
+    dt.start();
+    pipeline.run(process.mBatchItems);
+    double seconds = dt.nsecsElapsed() / 1e9;
+
+    // latency percentiles (nearest rank) - measured from decoding so that waits between the stages count
+    QVector<double> latencies;
+    int numProcessed = 0;
+    for (const DkBatchProcess &item : std::as_const(process.mBatchItems)) {
+        if (item.wasProcessed())
+            latencies << item.latency();
+        if (item.wasProcessed() && !item.hasFailed())
+            numProcessed++;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    auto percentile = [&latencies](double p) -> double {
+        if (latencies.empty())
+            return 0.0;
+        int idx = qBound(0, qCeil(p * latencies.size()) - 1, (int)latencies.size() - 1);
+        return latencies[idx];
+    };
+
+    int numFailures = process.getNumFailures();
+    writeLine({{"event", "summary"},
+               {"items", numItems},
+               {"failed", numFailures},
+               {"seconds", seconds},
+               {"processed", numProcessed},
+               {"images_per_sec", seconds > 0 ? numProcessed / seconds : 0.0},
+               {"p50_ms", percentile(0.5)},
+               {"p99_ms", percentile(0.99)}});
+
+    if (!logPath.isEmpty()) {
+        QDir().mkpath(QFileInfo(logPath).absolutePath());
+
+        QFile file(logPath);
+        if (!file.open(QIODevice::WriteOnly))
+            qWarning() << "Sorry, I could not write to" << logPath;
+        else {
+            QTextStream s(&file);
+            for (const QString &line : process.getLog())
+                s << line << '\n';
+        }
+    }
+
+    return numFailures > 0 ? 1 : 0;
+}
+
+void DkBatchProcessing::setShard(int shardIdx, int numShards)
+{
+    mNumShards = qMax(numShards, 1);
+    mShardIdx = qBound(0, shardIdx, mNumShards - 1);
+}
+
 QStringList DkBatchProcessing::getLog() const
 {
     QStringList log;
@@ -1268,7 +1681,7 @@ QStringList DkBatchProcessing::getResultList() const
     QStringList results;
 
     for (DkBatchProcess batch : mBatchItems) {
-        if (batch.wasProcessed())
+        if (batch.wasProcessed() || batch.wasSkipped())
             results.append(getBatchSummary(batch));
     }
 
@@ -1279,7 +1692,9 @@ QString DkBatchProcessing::getBatchSummary(const DkBatchProcess &batch) const
 {
     QString res = batch.inputFile() + "\t";
 
-    if (!batch.hasFailed())
+    if (batch.wasSkipped())
+        res += " <span style=\" color:#888888;\">" + tr("[SKIPPED]") + "</span>";
+    else if (!batch.hasFailed())
         res += " <span style=\" color:#00aa00;\">" + tr("[OK]") + "</span>";
     else
         res += " <span style=\" color:#aa0000;\">" + tr("[FAIL]") + "</span>";
@@ -1304,7 +1719,8 @@ bool DkBatchProcessing::isComputing() const
 
 void DkBatchProcessing::cancel()
 {
-    mBatchWatcher.cancel();
+    if (mPipeline)
+        mPipeline->cancel();
 }
 
 // DkBatchProfile --------------------------------------------------------------------
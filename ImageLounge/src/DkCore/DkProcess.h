@@ -30,15 +30,22 @@
 #pragma warning(push, 0) // no warnings from includes - begin
 #include <QDir>
 #include <QFileInfo>
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QFutureWatcher>
+#include <QMutex>
+#include <QQueue>
 #include <QSharedPointer>
 #include <QStringList>
 #include <QUrl>
+#include <QWaitCondition>
 #pragma warning(pop) // no warnings from includes - end
 
 #include "DkBatchInfo.h"
 #include "DkManipulators.h"
 
+#include <functional>
+
 #pragma warning(disable : 4251) // TODO: remove
 
 #ifndef DllCoreExport
@@ -54,6 +61,7 @@
 // Qt defines
 class QImage;
 class QSettings;
+class QThreadPool;
 
 namespace nmc
 {
@@ -241,13 +249,30 @@ public:
     QStringList getLog() const;
     bool hasFailed() const;
     bool wasProcessed() const;
+    bool wasSkipped() const;
     QString inputFile() const;
     QString outputFile() const;
 
+    double decodeTime() const;
+    double processTime() const;
+    double encodeTime() const;
+    double latency() const;
+
+    // set by DkBatchPipeline (ns since the pipeline started)
+    void setStarted(qint64 ns);
+    void setFinished(qint64 ns);
+
     QVector<QSharedPointer<DkBatchInfo>> batchInfo() const;
 
+    // pipeline stages - compute() runs them in order
+    bool readInput();
+    void processInput();
+    bool writeOutput();
+    void skip();
+
 protected:
-    bool process();
+    bool loadInput();
+    bool saveOutput();
     bool prepareDeleteExisting();
     bool deleteOrRestoreExisting();
     bool deleteOriginalFile();
@@ -258,10 +283,77 @@ protected:
     DkSaveInfo mSaveInfo;
     int mFailure = 0;
     bool mIsProcessed = false;
+    bool mIsSkipped = false;
 
     QVector<QSharedPointer<DkBatchInfo>> mInfos;
     QVector<QSharedPointer<DkAbstractBatch>> mProcessFunctions;
     QStringList mLogStrings;
+
+    QSharedPointer<DkImageContainer> mImgC; // only valid between readInput() and writeOutput()
+
+    // stage timings in ns
+    qint64 mDecodeTime = 0;
+    qint64 mProcessTime = 0;
+    qint64 mEncodeTime = 0;
+    qint64 mStartedAt = 0;
+    qint64 mLatency = 0; // started -> finished
+};
+
+/**
+ * Blocking FIFO with a fixed capacity that connects two pipeline stages.
+ * push() blocks if the queue is full, pop() blocks if it is empty.
+ * Once the queue is closed, pop() returns false as soon as it ran dry.
+ **/
+class DllCoreExport DkBatchQueue
+{
+public:
+    DkBatchQueue(int capacity = 1);
+
+    bool push(DkBatchProcess *item);
+    bool pop(DkBatchProcess *&item);
+    void close();
+
+protected:
+    QMutex mMutex;
+    QWaitCondition mNotEmpty;
+    QWaitCondition mNotFull;
+    QQueue<DkBatchProcess *> mItems;
+    int mCapacity = 1;
+    bool mClosed = false;
+};
+
+/**
+ * Runs batch items in three overlapping stages: decoding, processing and encoding.
+ * Each stage owns a thread pool so that disk I/O and codecs do not block the
+ * process workers. Stages are connected by bounded queues - this keeps at most
+ * a few decoded images in memory even if reading is faster than processing.
+ **/
+class DllCoreExport DkBatchPipeline
+{
+public:
+    DkBatchPipeline();
+
+    void setNumThreads(int numReaders, int numWorkers, int numWriters);
+    void setQueueSize(int queueSize);
+    void setItemFinishedCallback(const std::function<void(int, const DkBatchProcess &)> &callback);
+
+    void run(QVector<DkBatchProcess> &items); // blocks until all items are done
+    void cancel();
+    bool isCancelled() const;
+
+protected:
+    void runStage(QThreadPool &pool, int numThreads, DkBatchQueue *in, DkBatchQueue *out, const std::function<bool(DkBatchProcess *)> &stage);
+    void itemFinished(DkBatchProcess &item);
+
+    int mNumReaders = 2;
+    int mNumWorkers = 1;
+    int mNumWriters = 2;
+    int mQueueSize = 2;
+
+    QAtomicInt mCancelled = 0;
+    QAtomicInt mNumFinished = 0;
+    QElapsedTimer mClock;
+    std::function<void(int, const DkBatchProcess &)> mItemFinished; // (number of finished items, item)
 };
 
 class DllCoreExport DkBatchConfig
@@ -343,7 +435,6 @@ public:
     DkBatchProcessing(const DkBatchConfig &config = DkBatchConfig(), QWidget *parent = 0);
 
     void compute();
-    static bool computeItem(DkBatchProcess &item);
 
     QStringList getLog() const;
     int getNumFailures() const;
@@ -368,7 +459,10 @@ public:
 
     void postLoad();
 
-    static void computeBatch(const QString &settingsPath, const QString &logPath);
+    static void computeBatch(const QString &settingsPath, const QString &logPath, int shardIdx = 0, int numShards = 1);
+    static int computeBatchHeadless(const QString &settingsPath, const QString &logPath, int shardIdx = 0, int numShards = 1);
+
+    void setShard(int shardIdx, int numShards);
 
 public slots:
     // user interaction
@@ -385,6 +479,11 @@ protected:
 
     // threading
     QFutureWatcher<void> mBatchWatcher;
+    QSharedPointer<DkBatchPipeline> mPipeline;
+
+    // only items with idx % mNumShards == mShardIdx are processed
+    int mShardIdx = 0;
+    int mNumShards = 1;
 
     void init();
 };
@@ -26,6 +26,7 @@
  *******************************************************************************************************/
 
 #include "DkSettings.h"
+#include "DkTimer.h"
 #include "DkUtils.h"
 #include "DkVersion.h"
 
@@ -467,6 +468,7 @@ void DkSettings::load(QSettings &settings, bool defaults)
     display_p.defaultForegroundColor = settings.value("defaultForegroundColor", display_p.defaultForegroundColor).toBool();
     display_p.defaultIconColor = settings.value("defaultIconColor", display_p.defaultIconColor).toBool();
     display_p.interpolateZoomLevel = settings.value("interpolateZoomlevel", display_p.interpolateZoomLevel).toInt();
+    display_p.decodeAtScreenSize = settings.value("decodeAtScreenSize", display_p.decodeAtScreenSize).toBool();
     display_p.animateWidgets = settings.value("animateWidgets", display_p.animateWidgets).toBool();
 
     settings.endGroup();
@@ -509,10 +511,12 @@ void DkSettings::load(QSettings &settings, bool defaults)
 
     resources_p.cacheMemory = settings.value("cacheMemory", resources_p.cacheMemory).toFloat();
     resources_p.historyMemory = settings.value("historyMemory", resources_p.historyMemory).toFloat();
+    resources_p.thumbCacheSize = settings.value("thumbCacheSize", resources_p.thumbCacheSize).toFloat();
     resources_p.nativeDialog = settings.value("nativeDialog", resources_p.nativeDialog).toBool();
     resources_p.maxImagesCached = settings.value("maxImagesCached", resources_p.maxImagesCached).toInt();
     resources_p.waitForLastImg = settings.value("waitForLastImg", resources_p.waitForLastImg).toBool();
     resources_p.filterRawImages = settings.value("filterRawImages", resources_p.filterRawImages).toBool();
+    resources_p.halfSizeRawImages = settings.value("halfSizeRawImages", resources_p.halfSizeRawImages).toBool();
     resources_p.loadRawThumb = settings.value("loadRawThumb", resources_p.loadRawThumb).toInt();
     resources_p.filterDuplicats = settings.value("filterDuplicates", resources_p.filterDuplicats).toBool();
     resources_p.preferredExtension = settings.value("preferredExtension", resources_p.preferredExtension).toString();
@@ -739,6 +743,8 @@ void DkSettings::save(QSettings &settings, bool force)
         settings.setValue("defaultIconColor", display_p.defaultIconColor);
     if (force || display_p.interpolateZoomLevel != display_d.interpolateZoomLevel)
         settings.setValue("interpolateZoomlevel", display_p.interpolateZoomLevel);
+    if (force || display_p.decodeAtScreenSize != display_d.decodeAtScreenSize)
+        settings.setValue("decodeAtScreenSize", display_p.decodeAtScreenSize);
     if (force || display_p.animateWidgets != display_d.animateWidgets)
         settings.setValue("animateWidgets", display_p.animateWidgets);
 
@@ -797,6 +803,8 @@ void DkSettings::save(QSettings &settings, bool force)
         settings.setValue("cacheMemory", resources_p.cacheMemory);
     if (force || resources_p.historyMemory != resources_d.historyMemory)
         settings.setValue("historyMemory", resources_p.historyMemory);
+    if (force || resources_p.thumbCacheSize != resources_d.thumbCacheSize)
+        settings.setValue("thumbCacheSize", resources_p.thumbCacheSize);
     if (force || resources_p.nativeDialog != resources_d.nativeDialog)
         settings.setValue("nativeDialog", resources_p.nativeDialog);
     if (force || resources_p.maxImagesCached != resources_d.maxImagesCached)
@@ -805,6 +813,8 @@ void DkSettings::save(QSettings &settings, bool force)
         settings.setValue("waitForLastImg", resources_p.waitForLastImg);
     if (force || resources_p.filterRawImages != resources_d.filterRawImages)
         settings.setValue("filterRawImages", resources_p.filterRawImages);
+    if (force || resources_p.halfSizeRawImages != resources_d.halfSizeRawImages)
+        settings.setValue("halfSizeRawImages", resources_p.halfSizeRawImages);
     if (force || resources_p.loadRawThumb != resources_d.loadRawThumb)
         settings.setValue("loadRawThumb", resources_p.loadRawThumb);
     if (force || resources_p.filterDuplicats != resources_d.filterDuplicats)
@@ -932,6 +942,7 @@ void DkSettings::setToDefaultSettings()
     display_p.defaultForegroundColor = true;
     display_p.defaultIconColor = true;
     display_p.interpolateZoomLevel = 200;
+    display_p.decodeAtScreenSize = true;
     display_p.animateWidgets = true;
 
     slideShow_p.filter = 0;
@@ -954,9 +965,11 @@ void DkSettings::setToDefaultSettings()
 
     resources_p.cacheMemory = 256;
     resources_p.historyMemory = 128;
+    resources_p.thumbCacheSize = 512;
     resources_p.nativeDialog = true;
     resources_p.maxImagesCached = 5;
     resources_p.filterRawImages = true;
+    resources_p.halfSizeRawImages = false;
     resources_p.loadRawThumb = raw_thumb_always;
     resources_p.filterDuplicats = false;
     resources_p.preferredExtension = "*.jpg";
@@ -1110,6 +1123,7 @@ void DkSettingsManager::init()
 
     // init debug
     DkUtils::initializeDebug();
+    DkTrace::instance().initFromEnvironment();
 
     if (nmc::DkSettingsManager::param().app().useLogFile)
         std::cout << "log is saved to: " << nmc::DkUtils::getLogFilePath().toStdString() << std::endl;
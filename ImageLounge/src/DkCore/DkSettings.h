@@ -125,6 +125,7 @@ public:
         sort_date_created,
         sort_date_modified,
         sort_random,
+        sort_date_taken,
         sort_end,
     };
 
@@ -240,6 +241,7 @@ public:
         int thumbPreviewSize;
         // bool saveThumb;
         int interpolateZoomLevel;
+        bool decodeAtScreenSize;
         bool showCrop;
         bool antiAliasing;
         bool highQualityAntiAliasing;
@@ -318,10 +320,12 @@ public:
     struct Resources {
         float cacheMemory;
         float historyMemory;
+        float thumbCacheSize;
         bool nativeDialog;
         int maxImagesCached;
         bool waitForLastImg;
         bool filterRawImages;
+        bool halfSizeRawImages;
         bool filterDuplicats;
         int loadRawThumb;
         QString preferredExtension;
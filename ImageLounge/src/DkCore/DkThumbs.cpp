@@ -34,9 +34,15 @@
 #include "qpainter.h"
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDir>
 #include <QFileInfo>
 #include <QImageReader>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QStringBuilder>
 #include <QStringList>
 #include <QTimer>
@@ -193,6 +199,401 @@ void removeBlackBorder(QImage &img)
         img = img.copy(0, rIdx, img.width(), rIdxB - rIdx);
 }
 
+// DkThumbDiskCache --------------------------------------------------------------------
+// index file header
+static const quint32 thumbCacheMagic = 0x4e544331; // NTC1
+static const quint32 thumbCacheVersion = 2;
+static const int thumbCacheNumShards = 256;
+// the index is written after this many inserts/evictions
+static const int thumbCacheSaveInterval = 64;
+// sha1 key + flags + blob size
+static const int thumbCacheRecordHeader = 20 + 1 + 4;
+
+DkThumbDiskCache::DkThumbDiskCache()
+    : mDeadBytes(thumbCacheNumShards, 0)
+{
+    if (DkSettingsManager::param().isPortable())
+        mDirPath = QFileInfo(DkSettingsManager::param().settingsPath()).absolutePath();
+    else
+        mDirPath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+
+    mDirPath = QDir(mDirPath).absoluteFilePath("thumbnails");
+}
+
+DkThumbDiskCache::~DkThumbDiskCache()
+{
+    save();
+}
+
+DkThumbDiskCache &DkThumbDiskCache::instance()
+{
+    static DkThumbDiskCache inst;
+    return inst;
+}
+
+qint64 DkThumbDiskCache::maxSize()
+{
+    return qRound64(DkSettingsManager::param().resources().thumbCacheSize * 1024.0 * 1024.0);
+}
+
+QByteArray DkThumbDiskCache::key(const QFileInfo &fileInfo)
+{
+    QByteArray id = fileInfo.absoluteFilePath().toUtf8();
+    id += '|' + QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch());
+    id += '|' + QByteArray::number(fileInfo.size());
+
+    return QCryptographicHash::hash(id, QCryptographicHash::Sha1);
+}
+
+QString DkThumbDiskCache::shardPath(quint8 shard) const
+{
+    return QDir(mDirPath).absoluteFilePath(QString("%1.pack").arg((int)shard, 2, 16, QChar('0')));
+}
+
+QString DkThumbDiskCache::indexPath() const
+{
+    return QDir(mDirPath).absoluteFilePath("index.bin");
+}
+
+/**
+ * Returns the size of all thumbnails cached.
+ * @return qint64 the size in bytes
+ **/
+qint64 DkThumbDiskCache::size()
+{
+    QMutexLocker locker(&mMutex);
+    load();
+
+    return mTotalBytes;
+}
+
+/**
+ * Returns the cached thumbnail of a file.
+ * The thumbnail is only returned if neither the file's
+ * modification date nor its size changed since it was cached.
+ * @param fileInfo the image file
+ * @return std::optional<DkThumbDiskCache::Thumb> the thumbnail or nullopt
+ **/
+std::optional<DkThumbDiskCache::Thumb> DkThumbDiskCache::find(const QFileInfo &fileInfo)
+{
+    if (maxSize() <= 0 || !fileInfo.exists())
+        return std::nullopt;
+
+    QByteArray k = key(fileInfo);
+    Entry e;
+
+    {
+        QMutexLocker locker(&mMutex);
+        load();
+
+        auto it = mIndex.find(k);
+        if (it == mIndex.end())
+            return std::nullopt;
+
+        // the LRU order is written with the next index
+        it->lastAccess = QDateTime::currentMSecsSinceEpoch();
+        mNumChanges++;
+        e = *it;
+    }
+
+    // packs are only appended or replaced (compaction) so we can read without locking
+    QFile file(shardPath(e.shard));
+    QByteArray blob;
+    quint8 flags = 0;
+    bool valid = false;
+
+    if (file.open(QIODevice::ReadOnly) && file.seek(e.offset)) {
+        QDataStream ds(&file);
+        QByteArray recordKey(20, '\0');
+        quint32 blobSize = 0;
+        ds.readRawData(recordKey.data(), recordKey.size());
+        ds >> flags >> blobSize;
+
+        // the index does not match the pack (e.g. we crashed before saving the index)
+        if (recordKey == k && blobSize + thumbCacheRecordHeader == e.size) {
+            blob = file.read(blobSize);
+            valid = blob.size() == (int)blobSize;
+        }
+    }
+
+    if (!valid) {
+        QMutexLocker locker(&mMutex);
+
+        // the shard might have been compacted meanwhile
+        auto it = mIndex.find(k);
+        if (it != mIndex.end() && it->shard == e.shard && it->offset == e.offset) {
+            qWarning() << "[DkThumbDiskCache] corrupted entry for" << fileInfo.absoluteFilePath();
+            remove(k);
+        }
+
+        return std::nullopt;
+    }
+
+    QImage img;
+    if (!img.loadFromData(blob))
+        return std::nullopt;
+
+    return Thumb{img, (flags & 1) != 0};
+}
+
+/**
+ * Adds a thumbnail to the cache.
+ * Nothing is written if the file's thumbnail is already cached, unless
+ * an EXIF thumbnail is replaced by one computed from the full image.
+ * @param fileInfo the image file
+ * @param thumb the thumbnail
+ * @param fromExif true if the thumbnail was read from the file's metadata
+ **/
+void DkThumbDiskCache::insert(const QFileInfo &fileInfo, const QImage &thumb, bool fromExif)
+{
+    qint64 cap = maxSize();
+
+    if (cap <= 0 || thumb.isNull() || !fileInfo.exists())
+        return;
+
+    QByteArray k = key(fileInfo);
+    quint8 flags = fromExif ? 1 : 0;
+
+    {
+        QMutexLocker locker(&mMutex);
+        load();
+
+        auto it = mIndex.constFind(k);
+        if (it != mIndex.constEnd() && (fromExif || !(it->flags & 1)))
+            return;
+    }
+
+    QByteArray blob;
+    QBuffer buffer(&blob);
+    buffer.open(QIODevice::WriteOnly);
+    if (!thumb.save(&buffer, thumb.hasAlphaChannel() ? "PNG" : "JPG", 90))
+        return;
+
+    quint8 shard = (quint8)k.at(0);
+
+    QMutexLocker locker(&mMutex);
+    load();
+
+    if (!QDir().mkpath(mDirPath)) {
+        qWarning() << "[DkThumbDiskCache] I could not create" << mDirPath;
+        return;
+    }
+
+    QFile file(shardPath(shard));
+    if (!file.open(QIODevice::ReadWrite)) {
+        qWarning() << "[DkThumbDiskCache] I could not open" << file.fileName();
+        return;
+    }
+
+    remove(k);
+
+    Entry e;
+    e.shard = shard;
+    e.offset = (quint32)file.size();
+    e.size = thumbCacheRecordHeader + blob.size();
+    e.flags = flags;
+    e.lastAccess = QDateTime::currentMSecsSinceEpoch();
+
+    file.seek(e.offset);
+    QDataStream ds(&file);
+    ds.writeRawData(k.constData(), k.size());
+    ds << flags << (quint32)blob.size();
+    ds.writeRawData(blob.constData(), blob.size());
+    file.close();
+
+    if (ds.status() != QDataStream::Ok) {
+        qWarning() << "[DkThumbDiskCache] I could not write to" << file.fileName();
+        return;
+    }
+
+    mIndex.insert(k, e);
+    mTotalBytes += e.size;
+
+    if (mTotalBytes > cap)
+        evict(qRound64(cap * 0.9));
+
+    if (++mNumChanges >= thumbCacheSaveInterval)
+        saveIndex();
+}
+
+void DkThumbDiskCache::save()
+{
+    QMutexLocker locker(&mMutex);
+
+    if (mLoaded && mNumChanges > 0)
+        saveIndex();
+}
+
+void DkThumbDiskCache::clear()
+{
+    QMutexLocker locker(&mMutex);
+
+    for (int idx = 0; idx < thumbCacheNumShards; idx++)
+        QFile::remove(shardPath((quint8)idx));
+    QFile::remove(indexPath());
+
+    mIndex.clear();
+    mDeadBytes.fill(0);
+    mTotalBytes = 0;
+    mNumChanges = 0;
+    mLoaded = true;
+}
+
+// call with mMutex locked
+void DkThumbDiskCache::load()
+{
+    if (mLoaded)
+        return;
+
+    mLoaded = true;
+
+    QFile file(indexPath());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    DkTimer dt;
+    QDataStream ds(&file);
+    quint32 magic = 0, version = 0, numEntries = 0;
+    ds >> magic >> version >> numEntries;
+
+    if (magic != thumbCacheMagic || version != thumbCacheVersion) {
+        qInfo() << "[DkThumbDiskCache] ignoring incompatible index" << file.fileName();
+        return;
+    }
+
+    mIndex.reserve(numEntries);
+
+    for (quint32 idx = 0; idx < numEntries && ds.status() == QDataStream::Ok; idx++) {
+        QByteArray k;
+        Entry e;
+        ds >> k >> e.shard >> e.offset >> e.size >> e.flags >> e.lastAccess;
+        mIndex.insert(k, e);
+        mTotalBytes += e.size;
+    }
+
+    for (int idx = 0; idx < thumbCacheNumShards && ds.status() == QDataStream::Ok; idx++)
+        ds >> mDeadBytes[idx];
+
+    if (ds.status() != QDataStream::Ok) {
+        qWarning() << "[DkThumbDiskCache] index is corrupted - starting with an empty cache";
+        mIndex.clear();
+        mDeadBytes.fill(0);
+        mTotalBytes = 0;
+        return;
+    }
+
+    qInfo() << "[DkThumbDiskCache]" << mIndex.size() << "thumbnails indexed in" << dt;
+}
+
+// call with mMutex locked
+void DkThumbDiskCache::saveIndex()
+{
+    if (!QDir().mkpath(mDirPath))
+        return;
+
+    QSaveFile file(indexPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "[DkThumbDiskCache] I could not write" << file.fileName();
+        return;
+    }
+
+    QDataStream ds(&file);
+    ds << thumbCacheMagic << thumbCacheVersion << (quint32)mIndex.size();
+
+    for (auto it = mIndex.constBegin(); it != mIndex.constEnd(); ++it)
+        ds << it.key() << it->shard << it->offset << it->size << it->flags << it->lastAccess;
+
+    for (qint64 db : std::as_const(mDeadBytes))
+        ds << db;
+
+    if (file.commit())
+        mNumChanges = 0;
+}
+
+// call with mMutex locked
+void DkThumbDiskCache::remove(const QByteArray &key)
+{
+    auto it = mIndex.find(key);
+    if (it == mIndex.end())
+        return;
+
+    mDeadBytes[it->shard] += it->size;
+    mTotalBytes -= it->size;
+    mIndex.erase(it);
+    mNumChanges++;
+}
+
+// call with mMutex locked
+void DkThumbDiskCache::evict(qint64 maxBytes)
+{
+    DkTimer dt;
+
+    QVector<QPair<qint64, QByteArray>> lru;
+    lru.reserve(mIndex.size());
+    for (auto it = mIndex.constBegin(); it != mIndex.constEnd(); ++it)
+        lru << qMakePair(it->lastAccess, it.key());
+
+    std::sort(lru.begin(), lru.end());
+
+    int numRemoved = 0;
+    for (const auto &e : std::as_const(lru)) {
+        if (mTotalBytes <= maxBytes)
+            break;
+        remove(e.second);
+        numRemoved++;
+    }
+
+    // reclaim the space of shards that are mostly dead
+    for (int idx = 0; idx < thumbCacheNumShards; idx++) {
+        QFileInfo fi(shardPath((quint8)idx));
+        if (mDeadBytes[idx] > 0 && mDeadBytes[idx] * 2 > fi.size())
+            compact((quint8)idx);
+    }
+
+    qInfo() << "[DkThumbDiskCache]" << numRemoved << "thumbnails evicted in" << dt;
+}
+
+// call with mMutex locked
+void DkThumbDiskCache::compact(quint8 shard)
+{
+    QVector<QPair<quint32, QByteArray>> live;
+    for (auto it = mIndex.constBegin(); it != mIndex.constEnd(); ++it) {
+        if (it->shard == shard)
+            live << qMakePair(it->offset, it.key());
+    }
+    std::sort(live.begin(), live.end());
+
+    QFile src(shardPath(shard));
+    QSaveFile dst(shardPath(shard));
+
+    if (!src.open(QIODevice::ReadOnly) || !dst.open(QIODevice::WriteOnly))
+        return;
+
+    QHash<QByteArray, quint32> offsets;
+    for (const auto &l : std::as_const(live)) {
+        const Entry &e = mIndex[l.second];
+
+        if (!src.seek(e.offset))
+            continue;
+
+        offsets.insert(l.second, (quint32)dst.pos());
+        dst.write(src.read(e.size));
+    }
+
+    src.close();
+
+    if (!dst.commit()) {
+        qWarning() << "[DkThumbDiskCache] could not compact" << dst.fileName();
+        return;
+    }
+
+    for (auto it = offsets.constBegin(); it != offsets.constEnd(); ++it)
+        mIndex[it.key()].offset = it.value();
+
+    mDeadBytes[shard] = 0;
+    mNumChanges++;
+}
+
 // DkThumbsThreadPool --------------------------------------------------------------------
 DkThumbsThreadPool::DkThumbsThreadPool()
 {
@@ -228,16 +629,36 @@ DkThumbLoader::DkThumbLoader()
 
 DkThumbLoader::LoadThumbnailResultLocal DkThumbLoader::loadThumbnailLocal(const QString &filePath)
 {
+    DK_TRACE_SCOPE("load thumbnail");
+
+    QFileInfo fileInfo(filePath);
+
+    // try the persistent cache first
+    if (auto cached = DkThumbDiskCache::instance().find(fileInfo)) {
+        return {cached->img, filePath, true, cached->fromExif};
+    }
+
     const auto res = loadThumbnail(filePath, LoadThumbnailOption::none);
     if (!res) {
         return {QImage(), filePath, false, false};
     }
-    return {DkImage::createThumb(res->thumb), filePath, true, res->fromExif};
+
+    QImage thumb = DkImage::createThumb(res->thumb);
+    DkThumbDiskCache::instance().insert(fileInfo, thumb, res->fromExif);
+
+    return {thumb, filePath, true, res->fromExif};
 }
 
 DkThumbLoader::LoadThumbnailResultLocal DkThumbLoader::scaleFullThumbnail(const QString &filePath, const QImage &img)
 {
-    return {DkImage::createThumb(img), filePath, true, false};
+    DK_TRACE_SCOPE("scale thumbnail");
+
+    QImage thumb = DkImage::createThumb(img);
+
+    // thumbnails of full images replace (lower quality) exif thumbnails
+    DkThumbDiskCache::instance().insert(QFileInfo(filePath), thumb, false);
+
+    return {thumb, filePath, true, false};
 }
 
 void DkThumbLoader::requestThumbnail(const QString &filePath)
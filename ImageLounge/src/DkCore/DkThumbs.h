@@ -35,6 +35,7 @@
 #pragma warning(pop) // no warnings from includes - end
 #include "DkMetaData.h"
 #include <QCache>
+#include <QMutex>
 #include <QThread>
 #include <optional>
 
@@ -51,6 +52,7 @@
 #endif
 
 class QThreadPool;
+class QFileInfo;
 
 namespace nmc
 {
@@ -72,6 +74,66 @@ private:
     QThreadPool *mPool;
 };
 
+/**
+ * Persistent on-disk thumbnail store.
+ *
+ * Thumbnails are keyed by file path, modification time and file size.
+ * They are encoded as JPG (PNG if they have an alpha channel) and packed
+ * into 256 shard files. A single index maps keys to their location and
+ * keeps the last access time which is used for LRU eviction once
+ * DkSettings::Resources::thumbCacheSize is exceeded.
+ * All functions are thread-safe.
+ **/
+class DllCoreExport DkThumbDiskCache
+{
+public:
+    static DkThumbDiskCache &instance();
+    ~DkThumbDiskCache();
+
+    struct Thumb {
+        QImage img{};
+        bool fromExif{};
+    };
+
+    std::optional<Thumb> find(const QFileInfo &fileInfo);
+    void insert(const QFileInfo &fileInfo, const QImage &thumb, bool fromExif);
+    void save();
+    void clear();
+
+    qint64 size();
+
+private:
+    DkThumbDiskCache();
+    DkThumbDiskCache(const DkThumbDiskCache &);
+
+    struct Entry {
+        quint8 shard{};
+        quint32 offset{};
+        quint32 size{};
+        quint8 flags{};
+        qint64 lastAccess{};
+    };
+
+    static QByteArray key(const QFileInfo &fileInfo);
+    static qint64 maxSize();
+    QString shardPath(quint8 shard) const;
+    QString indexPath() const;
+
+    void load();
+    void saveIndex();
+    void remove(const QByteArray &key);
+    void evict(qint64 maxBytes);
+    void compact(quint8 shard);
+
+    mutable QMutex mMutex;
+    QString mDirPath;
+    QHash<QByteArray, Entry> mIndex;
+    QVector<qint64> mDeadBytes;
+    qint64 mTotalBytes = 0;
+    int mNumChanges = 0;
+    bool mLoaded = false;
+};
+
 struct LoadThumbnailResult {
     QImage thumb{};
     QString filePath{};
@@ -32,8 +32,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "DkUtils.h"
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QCoreApplication>
 #include <QDebug>
+#include <QFile>
 #include <QString>
+#include <QTextStream>
+#include <QThread>
 #include <qmath.h>
 #pragma warning(pop) // no warnings from includes - end
 
@@ -130,4 +134,137 @@ int DkTimer::elapsed() const
 {
     return mTimer.elapsed();
 }
-}
\ No newline at end of file
+
+// DkTrace --------------------------------------------------------------------
+std::atomic<bool> DkTrace::sEnabled{false};
+
+DkTrace::DkTrace()
+{
+    mClock.start();
+}
+
+DkTrace &DkTrace::instance()
+{
+    static DkTrace inst;
+    return inst;
+}
+
+void DkTrace::setEnabled(bool enabled)
+{
+    sEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * Enables tracing if NOMACS_TRACE is set.
+ * The trace is written to the file NOMACS_TRACE points to when the application quits.
+ **/
+void DkTrace::initFromEnvironment()
+{
+    if (qEnvironmentVariableIsEmpty("NOMACS_TRACE"))
+        return;
+
+    setEnabled(true);
+    qAddPostRoutine([]() {
+        DkTrace::instance().save(qEnvironmentVariable("NOMACS_TRACE"));
+    });
+}
+
+void DkTrace::clear()
+{
+    QMutexLocker locker(&mMutex);
+
+    for (auto &b : mBuffers) {
+        QMutexLocker bl(&b->mutex);
+        b->events.clear();
+        b->next = 0;
+    }
+}
+
+qint64 DkTrace::now() const
+{
+    return mClock.nsecsElapsed();
+}
+
+void DkTrace::record(const char *name, qint64 start, qint64 end)
+{
+    ThreadBuffer *b = threadBuffer();
+
+    Event e;
+    e.name = name;
+    e.start = start;
+    e.duration = end - start;
+
+    QMutexLocker locker(&b->mutex);
+
+    // overwrite the oldest events once the buffer is full
+    if (b->events.size() < mBufferSize)
+        b->events.append(e);
+    else {
+        b->events[b->next] = e;
+        b->next = (b->next + 1) % mBufferSize;
+    }
+}
+
+DkTrace::ThreadBuffer *DkTrace::threadBuffer()
+{
+    // buffers are owned by DkTrace so that spans of finished threads are kept
+    static thread_local ThreadBuffer *buffer = nullptr;
+
+    if (!buffer) {
+        QSharedPointer<ThreadBuffer> b(new ThreadBuffer());
+        b->threadId = (quint64)(quintptr)QThread::currentThreadId();
+        b->threadName = QThread::currentThread()->objectName();
+
+        QMutexLocker locker(&mMutex);
+        mBuffers << b;
+        buffer = b.data();
+    }
+
+    return buffer;
+}
+
+/**
+ * Saves all recorded spans in the Chrome trace event format.
+ * @param filePath the json file
+ * @return bool true if the file was written
+ **/
+bool DkTrace::save(const QString &filePath) const
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "[DkTrace] could not write to" << filePath;
+        return false;
+    }
+
+    QTextStream s(&file);
+    s << "{\"traceEvents\":[\n";
+
+    qint64 pid = QCoreApplication::applicationPid();
+    bool first = true;
+
+    QMutexLocker locker(&mMutex);
+
+    for (const auto &b : mBuffers) {
+        QMutexLocker bl(&b->mutex);
+
+        QString threadName = b->threadName.isEmpty() ? QString("Thread %1").arg(b->threadId) : b->threadName;
+        threadName.replace("\\", "\\\\").replace("\"", "\\\"");
+
+        s << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << b->threadId
+          << ",\"args\":{\"name\":\"" << threadName << "\"}}";
+        first = false;
+
+        // timestamps are in microseconds
+        for (const Event &e : b->events) {
+            s << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << b->threadId
+              << ",\"ts\":" << QString::number(e.start / 1000.0, 'f', 3) << ",\"dur\":" << QString::number(e.duration / 1000.0, 'f', 3) << "}";
+        }
+    }
+
+    s << "\n]}\n";
+
+    qInfo() << "[DkTrace] trace saved to" << filePath;
+
+    return true;
+}
+}
@@ -30,9 +30,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma warning(push, 0) // no warnings from includes - begin
 #include <QElapsedTimer>
+#include <QMutex>
 #include <QObject>
+#include <QSharedPointer>
+#include <QVector>
 #pragma warning(pop) // no warnings from includes - end
 
+#include <atomic>
+
 #ifndef DllCoreExport
 #ifdef DK_CORE_DLL_EXPORT
 #define DllCoreExport Q_DECL_EXPORT
@@ -77,4 +82,88 @@ protected:
     QElapsedTimer mTimer;
 };
 
+/**
+ * Collects timing spans of hot paths and exports them as Chrome trace.
+ * Each thread writes to its own ring buffer, so recording does not contend.
+ * If tracing is disabled, a span costs a single atomic load.
+ * Set NOMACS_TRACE=<trace.json> to record from startup and save on exit.
+ * Traces can be viewed in chrome://tracing or https://ui.perfetto.dev.
+ **/
+class DllCoreExport DkTrace
+{
+public:
+    static DkTrace &instance();
+
+    static bool isEnabled()
+    {
+        return sEnabled.load(std::memory_order_relaxed);
+    }
+
+    void setEnabled(bool enabled);
+    void initFromEnvironment();
+    void clear();
+    bool save(const QString &filePath) const;
+
+    qint64 now() const;
+    void record(const char *name, qint64 start, qint64 end);
+
+private:
+    DkTrace();
+
+    struct Event {
+        const char *name = nullptr; // must be a string literal
+        qint64 start = 0; // ns
+        qint64 duration = 0; // ns
+    };
+
+    struct ThreadBuffer {
+        QMutex mutex; // only contended while saving
+        QVector<Event> events;
+        int next = 0;
+        quint64 threadId = 0;
+        QString threadName;
+    };
+
+    ThreadBuffer *threadBuffer();
+
+    static std::atomic<bool> sEnabled;
+    static const int mBufferSize = 1 << 16; // events per thread
+
+    QElapsedTimer mClock;
+    mutable QMutex mMutex;
+    QVector<QSharedPointer<ThreadBuffer>> mBuffers;
+};
+
+/**
+ * Records the lifetime of this object as span if tracing is enabled.
+ * Use DK_TRACE_SCOPE("name") to trace the current scope.
+ **/
+class DkTraceSpan
+{
+public:
+    explicit DkTraceSpan(const char *name)
+        : mName(DkTrace::isEnabled() ? name : nullptr)
+    {
+        if (mName)
+            mStart = DkTrace::instance().now();
+    }
+
+    ~DkTraceSpan()
+    {
+        if (mName)
+            DkTrace::instance().record(mName, mStart, DkTrace::instance().now());
+    }
+
+    DkTraceSpan(const DkTraceSpan &) = delete;
+    DkTraceSpan &operator=(const DkTraceSpan &) = delete;
+
+private:
+    const char *mName = nullptr;
+    qint64 mStart = 0;
+};
+
 }
+
+#define DK_TRACE_CONCAT_IMPL(a, b) a##b
+#define DK_TRACE_CONCAT(a, b) DK_TRACE_CONCAT_IMPL(a, b)
+#define DK_TRACE_SCOPE(name) nmc::DkTraceSpan DK_TRACE_CONCAT(dkTraceSpan, __LINE__)(name)
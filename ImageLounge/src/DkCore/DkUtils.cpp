@@ -258,6 +258,48 @@ bool DkUtils::naturalCompare(const QString &s1, const QString &s2, Qt::CaseSensi
     return QString::compare(s1, s2, cs) < 0;
 }
 
+QByteArray DkUtils::naturalSortKey(const QString &str)
+{
+    const QString s = str.toCaseFolded();
+
+    QByteArray key;
+    key.reserve(str.size() * 4 + 8);
+
+    for (int idx = 0; idx < s.size();) {
+        // characters are stored as 16 bit big endian
+        if (s[idx] < '0' || s[idx] > '9') {
+            ushort c = s[idx].unicode();
+            key.append(char(c >> 8)).append(char(c & 0xff));
+            idx++;
+            continue;
+        }
+
+        int start = idx;
+        while (idx < s.size() && s[idx] >= '0' && s[idx] <= '9')
+            idx++;
+
+        // skip leading zeros
+        while (start < idx - 1 && s[start] == '0')
+            start++;
+
+        // numbers sort like the digit '0' - longer numbers are larger
+        // and numbers with the same length are compared digit by digit
+        int numDigits = idx - start;
+        key.append('\0').append('0');
+        key.append(char(numDigits >> 8)).append(char(numDigits & 0xff));
+
+        for (int dIdx = start; dIdx < idx; dIdx++)
+            key.append(char(s[dIdx].unicode()));
+    }
+
+    // ties (e.g. img01 & img1) are sorted by the original string
+    key.append('\0').append('\0');
+    for (const QChar &c : str)
+        key.append(char(c.unicode() >> 8)).append(char(c.unicode() & 0xff));
+
+    return key;
+}
+
 /// <summary>
 /// Resolves symbolic links.
 /// </summary>
@@ -142,6 +142,16 @@ public:
 
     static bool naturalCompare(const QString &s1, const QString &s2, Qt::CaseSensitivity cs = Qt::CaseSensitive);
 
+    /**
+     * Returns a key that sorts in natural order if keys are compared byte-wise.
+     * Numbers are compared by their value and all other characters case
+     * insensitive (img2.png < IMG10.png). Compute the keys once and compare
+     * them instead of calling naturalCompare() for each comparison.
+     * @param str the string (e.g. a file name)
+     * @return QByteArray the sort key
+     **/
+    static QByteArray naturalSortKey(const QString &str);
+
     static QString resolveSymLink(const QString &filePath);
 
     static QString getLongestNumber(const QString &str, int startIdx = 0);
@@ -1659,7 +1659,7 @@ void DkBatchPluginWidget::addPlugins(QStandardItemModel *model) const
         mPluginItem->setData(p->pluginName(), Qt::UserRole);
         mModel->appendRow(mPluginItem);
 
-        QList<QAction *> actions = p->plugin()->pluginActions();
+        QList<QAction *> actions = p->pluginActions();
 
         for (const QAction *a : actions) {
             QStandardItem *item = new QStandardItem(a->icon(), a->text());
@@ -35,11 +35,87 @@
 #include <QHostInfo>
 #include <QThread>
 #include <QTimer>
+#include <QtConcurrentMap>
 #pragma warning(pop) // no warnings from includes - end
 
+#include <algorithm>
+#include <cstring>
+
 namespace nmc
 {
 
+// images are sent in tiles of this size
+static const int sImageTileSize = 256;
+// longest side of the (JPG) preview that is sent before the tiles
+static const int sImagePreviewSize = 512;
+// we only queue new tiles if less bytes are waiting in the socket
+static const qint64 sMaxPendingImageBytes = 4 << 20;
+// minimum time between two progressive updates (in ms)
+static const int sImageUpdateInterval = 250;
+
+static QByteArray imageTileMessage(const QImage &img, const QRect &rect, quint32 imageId)
+{
+    int rowBytes = rect.width() * img.depth() / 8;
+    int xOffset = rect.x() * img.depth() / 8;
+
+    QByteArray raw(rowBytes * rect.height(), Qt::Uninitialized);
+    for (int rIdx = 0; rIdx < rect.height(); rIdx++)
+        std::memcpy(raw.data() + rIdx * rowBytes, img.constScanLine(rect.y() + rIdx) + xOffset, rowBytes);
+
+    QByteArray ba;
+    QDataStream ds(&ba, QIODevice::ReadWrite);
+    ds << imageId;
+    ds << rect;
+    ds << qCompress(raw, 1);
+
+    QByteArray data = "IMAGETILE";
+    data.append(SeparatorToken).append(QByteArray::number(ba.size())).append(SeparatorToken).append(ba);
+    return data;
+}
+
+/**
+ * Returns all tiles of an image, the center tiles first.
+ **/
+static QVector<QRect> imageTiles(const QImage &img)
+{
+    QVector<QRect> tiles;
+
+    for (int y = 0; y < img.height(); y += sImageTileSize)
+        for (int x = 0; x < img.width(); x += sImageTileSize)
+            tiles << QRect(x, y, sImageTileSize, sImageTileSize).intersected(img.rect());
+
+    // the user is most likely looking at the image's center
+    QPoint c = img.rect().center();
+    std::stable_sort(tiles.begin(), tiles.end(), [c](const QRect &lhs, const QRect &rhs) {
+        return (lhs.center() - c).manhattanLength() < (rhs.center() - c).manhattanLength();
+    });
+
+    return tiles;
+}
+
+/**
+ * Returns the tiles of img that differ from lastImg.
+ * Both images must have the same size & format.
+ **/
+static QVector<QRect> dirtyImageTiles(const QImage &img, const QImage &lastImg)
+{
+    QVector<QRect> dirty;
+
+    for (const QRect &r : imageTiles(img)) {
+        int rowBytes = r.width() * img.depth() / 8;
+        int xOffset = r.x() * img.depth() / 8;
+
+        for (int y = r.top(); y <= r.bottom(); y++) {
+            if (std::memcmp(img.constScanLine(y) + xOffset, lastImg.constScanLine(y) + xOffset, rowBytes) != 0) {
+                dirty << r;
+                break;
+            }
+        }
+    }
+
+    return dirty;
+}
+
 // DkConnection --------------------------------------------------------------------
 
 DkConnection::DkConnection(QObject *parent)
@@ -53,6 +129,7 @@ DkConnection::DkConnection(QObject *parent)
 
     connect(mSynchronizedTimer, &QTimer::timeout, this, &DkConnection::synchronizedTimerTimeout);
     connect(this, &DkConnection::readyRead, this, &DkConnection::processReadyRead);
+    connect(this, &DkConnection::bytesWritten, this, &DkConnection::sendPendingTiles);
 
     setReadBufferSize(MaxBufferSize);
 }
@@ -151,6 +228,93 @@ void DkConnection::sendNewFileMessage(qint16 op, const QString &filename)
     write(data);
 }
 
+/**
+ * Sends an image to the peer.
+ * A small JPG preview is sent first, followed by lossless (zlib) tiles.
+ * If the peer already has an image with the same size (e.g. an edit of
+ * the last image), only the tiles that changed are sent.
+ * The tiles are queued so that the socket (and the UI) are never blocked.
+ * @param image the image to be sent
+ * @param title the image's title
+ **/
+void DkConnection::sendNewImageMessage(const QImage &image, const QString &title)
+{
+    if (image.isNull())
+        return;
+
+    QImage img = image;
+
+    // we only send images with full bytes per pixel
+    if (img.depth() < 8 || img.format() == QImage::Format_Indexed8)
+        img = img.convertToFormat(img.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+
+    // if the last transfer is not finished, the peer's image is incomplete
+    if (!mSendImage.isNull())
+        mSentImage = QImage();
+
+    bool delta = !mSentImage.isNull() && mSentImage.size() == img.size() && mSentImage.format() == img.format();
+
+    mPendingTiles = delta ? dirtyImageTiles(img, mSentImage) : imageTiles(img);
+    mSendImage = img;
+    mSentImage = QImage();
+    mSendImageId++;
+
+    QByteArray preview;
+    if (!delta) {
+        QBuffer buffer(&preview);
+        buffer.open(QIODevice::WriteOnly);
+
+        QImage pImg = img;
+        if (img.width() > sImagePreviewSize || img.height() > sImagePreviewSize)
+            pImg = img.scaled(sImagePreviewSize, sImagePreviewSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+        pImg.save(&buffer, "JPG", 80);
+    }
+
+    QByteArray ba;
+    QDataStream ds(&ba, QIODevice::ReadWrite);
+    ds << mSendImageId;
+    ds << (delta ? mSentImageId : quint32(0)); // base image of the delta
+    ds << title;
+    ds << img.size();
+    ds << qint32(img.format());
+    ds << quint32(mPendingTiles.size());
+    ds << preview;
+
+    QByteArray data = "NEWIMAGE";
+    data.append(SeparatorToken).append(QByteArray::number(ba.size())).append(SeparatorToken).append(ba);
+    write(data);
+
+    sendPendingTiles();
+}
+
+void DkConnection::sendPendingTiles()
+{
+    // keep the socket's queue short - otherwise transform messages wait for the whole image
+    while (!mPendingTiles.isEmpty() && bytesToWrite() < sMaxPendingImageBytes) {
+        int numTiles = qMin(mPendingTiles.size(), QThread::idealThreadCount() * 2);
+        QVector<QRect> tiles = mPendingTiles.mid(0, numTiles);
+        mPendingTiles.remove(0, numTiles);
+
+        const QImage img = mSendImage;
+        const quint32 imageId = mSendImageId;
+
+        QVector<QByteArray> messages = QtConcurrent::blockingMapped<QVector<QByteArray>>(tiles, [img, imageId](const QRect &r) {
+            return imageTileMessage(img, r, imageId);
+        });
+
+        for (const QByteArray &m : messages)
+            write(m);
+    }
+
+    // the peer has got everything
+    if (mPendingTiles.isEmpty() && !mSendImage.isNull()) {
+        mSentImage = mSendImage;
+        mSentImageId = mSendImageId;
+        mSendImage = QImage();
+    }
+}
+
 void DkConnection::sendNewGoodbyeMessage()
 {
     // qDebug() << "sending good bye to " << peerName() << ":" << this->peerPort();
@@ -176,6 +340,8 @@ bool DkConnection::readProtocolHeader()
     QByteArray newtransformBA = QByteArray("NEWTRANSFORM").append(SeparatorToken);
     QByteArray newpositionBA = QByteArray("NEWPOSITION").append(SeparatorToken);
     QByteArray newFileBA = QByteArray("NEWFILE").append(SeparatorToken);
+    QByteArray newImageBA = QByteArray("NEWIMAGE").append(SeparatorToken);
+    QByteArray imageTileBA = QByteArray("IMAGETILE").append(SeparatorToken);
     QByteArray goodbyeBA = QByteArray("GOODBYE").append(SeparatorToken);
 
     if (mBuffer == greetingBA) {
@@ -199,6 +365,10 @@ bool DkConnection::readProtocolHeader()
     } else if (mBuffer == newFileBA) {
         // qDebug() << "New File received from:" << this->peerAddress() << ":" << this->peerPort();
         mCurrentDataType = newFile;
+    } else if (mBuffer == newImageBA) {
+        mCurrentDataType = newImage;
+    } else if (mBuffer == imageTileBA) {
+        mCurrentDataType = newImageTile;
     } else if (mBuffer == goodbyeBA) {
         // qDebug() << "Goodbye received from:" << this->peerAddress() << ":" << this->peerPort();
         mCurrentDataType = GoodBye;
@@ -458,6 +628,16 @@ void DkConnection::processData()
         }
         break;
     }
+    case newImage: {
+        if (mState == Synchronized)
+            readNewImageMessage();
+        break;
+    }
+    case newImageTile: {
+        if (mState == Synchronized)
+            readImageTileMessage();
+        break;
+    }
     default:
         break;
     }
@@ -467,6 +647,116 @@ void DkConnection::processData()
     mBuffer.clear();
 }
 
+void DkConnection::readNewImageMessage()
+{
+    quint32 imageId;
+    quint32 baseId;
+    QString title;
+    QSize size;
+    qint32 format;
+    quint32 numTiles;
+    QByteArray preview;
+
+    QDataStream ds(mBuffer);
+    ds >> imageId;
+    ds >> baseId;
+    ds >> title;
+    ds >> size;
+    ds >> format;
+    ds >> numTiles;
+    ds >> preview;
+
+    mReceivedImageId = 0;
+
+    if (ds.status() != QDataStream::Ok || size.isEmpty() || format <= QImage::Format_Indexed8 || format >= QImage::NImageFormats) {
+        qWarning() << "[DkConnection] illegal image message received";
+        return;
+    }
+
+    if (baseId != 0) {
+        // delta - the tiles are applied to the last image
+        if (baseId != mCompletedImageId || mReceivedImage.size() != size || mReceivedImage.format() != format) {
+            qWarning() << "[DkConnection] cannot apply image delta - base image is missing";
+            return;
+        }
+    } else {
+        QImage pImg;
+        pImg.loadFromData(preview, "JPG");
+
+        // the preview is replaced by the tiles in a bit
+        if (!pImg.isNull())
+            mReceivedImage = pImg.scaled(size, Qt::IgnoreAspectRatio, Qt::FastTransformation).convertToFormat((QImage::Format)format);
+        else {
+            mReceivedImage = QImage(size, (QImage::Format)format);
+            mReceivedImage.fill(Qt::black);
+        }
+
+        if (mReceivedImage.isNull()) {
+            qWarning() << "[DkConnection] could not allocate" << size << "image";
+            return;
+        }
+
+        emit connectionNewImage(this, mReceivedImage, title);
+    }
+
+    mReceivedImageId = imageId;
+    mReceivedTitle = title;
+    mNumPendingTiles = numTiles;
+    mReceiveTimer.start();
+
+    if (mNumPendingTiles == 0)
+        imageReceived();
+}
+
+void DkConnection::readImageTileMessage()
+{
+    quint32 imageId;
+    QRect rect;
+    QByteArray data;
+
+    QDataStream ds(mBuffer);
+    ds >> imageId;
+    ds >> rect;
+    ds >> data;
+
+    // tile of an outdated image
+    if (imageId != mReceivedImageId || mReceivedImageId == 0)
+        return;
+
+    if (!mReceivedImage.rect().contains(rect)) {
+        qWarning() << "[DkConnection] illegal image tile received:" << rect;
+        return;
+    }
+
+    QByteArray raw = qUncompress(data);
+    int rowBytes = rect.width() * mReceivedImage.depth() / 8;
+    int xOffset = rect.x() * mReceivedImage.depth() / 8;
+
+    if (raw.size() != rowBytes * rect.height()) {
+        qWarning() << "[DkConnection] corrupted image tile received";
+        return;
+    }
+
+    for (int rIdx = 0; rIdx < rect.height(); rIdx++)
+        std::memcpy(mReceivedImage.scanLine(rect.y() + rIdx) + xOffset, raw.constData() + rIdx * rowBytes, rowBytes);
+
+    mNumPendingTiles--;
+
+    if (mNumPendingTiles <= 0)
+        imageReceived();
+    else if (mReceiveTimer.elapsed() > sImageUpdateInterval) {
+        emit connectionNewImage(this, mReceivedImage, mReceivedTitle);
+        mReceiveTimer.restart();
+    }
+}
+
+void DkConnection::imageReceived()
+{
+    mCompletedImageId = mReceivedImageId;
+    mReceivedImageId = 0;
+    emit connectionNewImage(this, mReceivedImage, mReceivedTitle);
+}
+
 void DkConnection::synchronizedTimerTimeout()
 {
     mSynchronizedTimer->stop();
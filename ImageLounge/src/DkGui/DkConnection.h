@@ -28,6 +28,7 @@
 #pragma once
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QElapsedTimer>
 #include <QHostAddress>
 #include <QImage>
 #include <QRect>
@@ -99,6 +100,7 @@ signals:
     void connectionNewPosition(DkConnection *connection, QRect position, bool opacity, bool overlaid) const;
     void connectionNewTransform(DkConnection *connection, QTransform transform, QTransform imgTransform, QPointF canvasSize) const;
     void connectionNewFile(DkConnection *connection, qint16 op, const QString &filename) const;
+    void connectionNewImage(DkConnection *connection, const QImage &image, const QString &title) const;
     void connectionGoodBye(DkConnection *connection) const;
     void connectionShowStatusMessage(DkConnection *connection, const QString &msg) const;
 
@@ -110,12 +112,13 @@ public slots:
     virtual void sendNewPositionMessage(QRect position, bool opacity, bool overlaid);
     virtual void sendNewTransformMessage(QTransform transform, QTransform imgTransform, QPointF canvasSize);
     virtual void sendNewFileMessage(qint16 op, const QString &filename);
+    void sendNewImageMessage(const QImage &image, const QString &title);
     void sendNewGoodbyeMessage();
     void synchronizedPeersListChanged(QList<quint16> newList);
 
 protected:
     enum ConnectionState { WaitingForGreeting, ReadyForUse, Synchronized };
-    enum DataType { Greeting, startSynchronize, stopSynchronize, newTitle, newPosition, newTransform, newFile, GoodBye, Undefined };
+    enum DataType { Greeting, startSynchronize, stopSynchronize, newTitle, newPosition, newTransform, newFile, newImage, newImageTile, GoodBye, Undefined };
 
     virtual bool readProtocolHeader();
     virtual void checkState();
@@ -130,6 +133,9 @@ protected:
     {
         return true;
     };
+    void readNewImageMessage();
+    void readImageTileMessage();
+    void imageReceived();
 
     ConnectionState mState = WaitingForGreeting;
     DataType mCurrentDataType = Undefined;
@@ -146,11 +152,27 @@ protected slots:
 
 private slots:
     void synchronizedTimerTimeout();
+    void sendPendingTiles();
 
 protected:
     QTimer *mSynchronizedTimer;
     QList<quint16> mSynchronizedPeersServerPorts;
     quint16 mPeerId;
+
+    // image transfer (sending)
+    QImage mSendImage; // image that is currently sent
+    QImage mSentImage; // last image the peer received completely - base for deltas
+    QVector<QRect> mPendingTiles;
+    quint32 mSendImageId = 0;
+    quint32 mSentImageId = 0;
+
+    // image transfer (receiving)
+    QImage mReceivedImage;
+    QString mReceivedTitle;
+    quint32 mReceivedImageId = 0;
+    quint32 mCompletedImageId = 0;
+    int mNumPendingTiles = 0;
+    QElapsedTimer mReceiveTimer;
 };
 
 class DllCoreExport DkLocalConnection : public DkConnection
@@ -348,7 +348,7 @@ void DkControlWidget::update()
 
 void DkControlWidget::showWidgetsSettings()
 {
-    if (mViewport->getImage().isNull()) {
+    if (mViewport->getDisplayedImage().isNull()) {
         showPreview(false);
         showScroller(false);
         showMetaData(false);
@@ -407,7 +407,7 @@ void DkControlWidget::showPreview(bool visible)
     if (visible && !mFilePreview->isVisible())
         mFilePreview->show();
     else if (!visible && mFilePreview->isVisible())
-        mFilePreview->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the viewport
+        mFilePreview->hide(!mViewport->getDisplayedImage().isNull()); // do not save settings if we have no image in the viewport
 }
 
 void DkControlWidget::showScroller(bool visible)
@@ -418,7 +418,7 @@ void DkControlWidget::showScroller(bool visible)
     if (visible && !mFolderScroll->isVisible())
         mFolderScroll->show();
     else if (!visible && mFolderScroll->isVisible())
-        mFolderScroll->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the viewport
+        mFolderScroll->hide(!mViewport->getDisplayedImage().isNull()); // do not save settings if we have no image in the viewport
 }
 
 void DkControlWidget::showMetaData(bool visible)
@@ -430,7 +430,7 @@ void DkControlWidget::showMetaData(bool visible)
         mMetaDataInfo->show();
         qDebug() << "showing metadata...";
     } else if (!visible && mMetaDataInfo->isVisible())
-        mMetaDataInfo->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the viewport
+        mMetaDataInfo->hide(!mViewport->getDisplayedImage().isNull()); // do not save settings if we have no image in the viewport
 }
 
 void DkControlWidget::showFileInfo(bool visible)
@@ -441,7 +441,7 @@ void DkControlWidget::showFileInfo(bool visible)
     if (visible && !mFileInfoLabel->isVisible())
         mFileInfoLabel->show();
     else if (!visible && mFileInfoLabel->isVisible())
-        mFileInfoLabel->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the viewport
+        mFileInfoLabel->hide(!mViewport->getDisplayedImage().isNull()); // do not save settings if we have no image in the viewport
 }
 
 void DkControlWidget::showPlayer(bool visible)
@@ -452,7 +452,7 @@ void DkControlWidget::showPlayer(bool visible)
     if (visible)
         mPlayer->show();
     else
-        mPlayer->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the viewport
+        mPlayer->hide(!mViewport->getDisplayedImage().isNull()); // do not save settings if we have no image in the viewport
 }
 
 void DkControlWidget::startSlideshow(bool start)
@@ -468,7 +468,7 @@ void DkControlWidget::showOverview(bool visible)
     if (visible && !mZoomWidget->isVisible()) {
         mZoomWidget->show();
     } else if (!visible && mZoomWidget->isVisible()) {
-        mZoomWidget->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the mViewport
+        mZoomWidget->hide(!mViewport->getDisplayedImage().isNull()); // do not save settings if we have no image in the mViewport
     }
 }
 
@@ -494,12 +494,12 @@ void DkControlWidget::showHistogram(bool visible)
 
     if (visible && !mHistogram->isVisible()) {
         mHistogram->show();
-        if (!mViewport->getImage().isNull())
-            mHistogram->drawHistogram(mViewport->getImage());
+        if (!mViewport->getDisplayedImage().isNull())
+            mHistogram->drawHistogram(mViewport->getDisplayedImage());
         else
             mHistogram->clearHistogram();
     } else if (!visible && mHistogram->isVisible()) {
-        mHistogram->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the mViewport
+        mHistogram->hide(!mViewport->getDisplayedImage().isNull()); // do not save settings if we have no image in the mViewport
     }
 }
 
@@ -511,7 +511,7 @@ void DkControlWidget::showCommentWidget(bool visible)
     if (visible && !mCommentWidget->isVisible()) {
         mCommentWidget->show();
     } else if (!visible && mCommentWidget->isVisible()) {
-        mCommentWidget->hide(!mViewport->getImage().isNull()); // do not save settings if we have no image in the mViewport
+        mCommentWidget->hide(!mViewport->getDisplayedImage().isNull()); // do not save settings if we have no image in the mViewport
     }
 }
 
@@ -589,8 +589,10 @@ bool DkControlWidget::closePlugin(bool askForSaving, bool force)
                 applyChanges = (answer == QMessageBox::Accepted || answer == QMessageBox::Yes);
             }
 
-            if (applyChanges)
+            if (applyChanges) {
+                mViewport->imageContainer()->loadFullSize(); // plugins edit the full resolution
                 pluginImage = DkImageContainerT::fromImageContainer(vPlugin->runPlugin("", mViewport->imageContainer()));
+            }
         } else
             qDebug() << "[DkControlWidget] I cannot close a plugin if the image container is NULL";
     }
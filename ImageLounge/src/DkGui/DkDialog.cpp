@@ -53,8 +53,11 @@
 #include <QColorDialog>
 #include <QComboBox>
 #include <QCompleter>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDesktopServices>
 #include <QDialogButtonBox>
+#include <QDirIterator>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QFormLayout>
@@ -79,6 +82,7 @@
 #include <QPushButton>
 #include <QRadioButton>
 #include <QRandomGenerator>
+#include <QSaveFile>
 #include <QScreen>
 #include <QSlider>
 #include <QSpinBox>
@@ -93,6 +97,7 @@
 #include <QToolButton>
 #include <QTreeView>
 #include <QWidget>
+#include <QtConcurrentMap>
 #include <QtConcurrentRun>
 #include <QtGlobal>
 #include <qmath.h>
@@ -104,6 +109,10 @@
 
 #pragma warning(pop) // no warnings from includes - end
 
+#include <atomic>
+#include <climits>
+#include <numeric>
+
 namespace nmc
 {
 
@@ -2650,6 +2659,269 @@ void DkExportTiffDialog::enableTIFFSave(bool enable)
 
 #ifdef WITH_OPENCV
 
+// DkMosaicDatabase --------------------------------------------------------------------
+static const quint32 mosaicDbMagic = 0x4e4d4431; // NMD1
+static const quint32 mosaicDbVersion = 1;
+
+/**
+ * Indexes all images in dirPath (and its sub folders).
+ * Descriptors of images that did not change since the last call are read from the cache.
+ * @param dirPath the database folder
+ * @param ignore files that contain any of these (; separated) strings are skipped
+ * @param suffix if not empty, only files with this suffix are indexed
+ * @param progress is called with the progress in percent - return false to cancel
+ * @return bool false if the indexing was canceled
+ **/
+bool DkMosaicDatabase::update(const QString &dirPath, const QString &ignore, const QString &suffix, const std::function<bool(int)> &progress)
+{
+    DkTimer dt;
+
+    QStringList fileFilters = (suffix.isEmpty()) ? DkSettingsManager::param().app().fileFilters : QStringList(suffix);
+    QStringList ignoreList = ignore.split(";", Qt::SkipEmptyParts);
+
+    QVector<Entry> entries;
+    QDirIterator it(dirPath, fileFilters, QDir::Files, QDirIterator::Subdirectories);
+
+    while (it.hasNext()) {
+        it.next();
+
+        Entry e;
+        e.filePath = it.filePath();
+
+        bool lIgnore = false;
+        for (const QString &i : ignoreList) {
+            if (e.filePath.contains(i)) {
+                lIgnore = true;
+                break;
+            }
+        }
+
+        if (lIgnore)
+            continue;
+
+        e.modified = it.fileInfo().lastModified();
+        entries << e;
+    }
+
+    // re-use cached descriptors
+    QHash<QString, Entry> cached;
+    if (dirPath != mDirPath)
+        cached = load(dirPath);
+    else {
+        for (const Entry &e : std::as_const(mEntries))
+            cached.insert(e.filePath, e);
+        for (const Entry &e : std::as_const(mFailed))
+            cached.insert(e.filePath, e);
+    }
+
+    QVector<int> newEntries;
+    for (int idx = 0; idx < entries.size(); idx++) {
+        auto c = cached.constFind(entries[idx].filePath);
+
+        if (c != cached.constEnd() && c->modified == entries[idx].modified)
+            entries[idx] = c.value();
+        else
+            newEntries << idx;
+    }
+
+    qDebug() << "[DkMosaicDatabase]" << entries.size() << "images found," << newEntries.size() << "need to be indexed";
+
+    QAtomicInt numIndexed = 0;
+    std::atomic<bool> canceled{false};
+
+    QtConcurrent::blockingMap(newEntries, [&](int idx) {
+        if (canceled)
+            return;
+
+        Entry &e = entries[idx];
+
+        try {
+            std::optional<LoadThumbnailResult> thumb = loadThumbnail(e.filePath, LoadThumbnailOption::none);
+
+            if (thumb && !thumb->thumb.isNull()) {
+                cv::Mat desc = DkMosaicDialog::createPatch(thumb->thumb, e.filePath, descSize);
+                e.desc = QByteArray((const char *)desc.data, descSize * descSize);
+            }
+        }
+        // catch cv exceptions e.g. out of memory
+        catch (...) {
+            qWarning() << "[DkMosaicDatabase] could not index" << e.filePath;
+        }
+
+        int cnt = numIndexed.fetchAndAddRelaxed(1) + 1;
+        if (!progress(qRound((float)cnt / newEntries.size() * 100)))
+            canceled = true;
+    });
+
+    if (canceled)
+        return false;
+
+    mDirPath = dirPath;
+    mEntries.clear();
+    mFailed.clear();
+    for (Entry &e : entries) {
+        // remember failures so that we do not decode them again
+        if (e.desc.size() != descSize * descSize) {
+            e.desc.clear();
+            mFailed << e;
+            continue;
+        }
+
+        e.sum = 0;
+        for (char v : std::as_const(e.desc))
+            e.sum += (uchar)v;
+
+        mEntries << e;
+    }
+
+    std::sort(mEntries.begin(), mEntries.end(), [](const Entry &lhs, const Entry &rhs) {
+        return lhs.sum < rhs.sum;
+    });
+
+    if (!newEntries.isEmpty())
+        save(dirPath);
+
+    qInfo() << "[DkMosaicDatabase]" << mEntries.size() << "images indexed in" << dt;
+
+    return true;
+}
+
+/**
+ * Returns the k entries that are closest (L1) to desc.
+ * @param desc a descSize x descSize CV_8UC1 descriptor
+ * @param k the number of neighbours
+ * @return QVector<QPair<int, int> > (distance, entry index) pairs sorted by their distance
+ **/
+QVector<QPair<int, int>> DkMosaicDatabase::nearest(const cv::Mat &desc, int k) const
+{
+    QVector<QPair<int, int>> best;
+
+    if (mEntries.isEmpty() || desc.rows * desc.cols != descSize * descSize || !desc.isContinuous())
+        return best;
+
+    const uchar *dPtr = desc.ptr<uchar>();
+    int sum = (int)cv::sum(desc)[0];
+
+    // the entries are sorted by their sum: |sum - e.sum| is a lower bound of the L1 distance
+    // so we start at the same sum and stop if no closer entry can follow
+    int right = std::lower_bound(mEntries.begin(), mEntries.end(), sum, [](const Entry &e, int s) {
+                    return e.sum < s;
+                })
+        - mEntries.begin();
+    int left = right - 1;
+
+    auto worst = [&best, k]() {
+        return best.size() < k ? INT_MAX : best.last().first;
+    };
+
+    while (left >= 0 || right < mEntries.size()) {
+        int lbLeft = left >= 0 ? sum - mEntries[left].sum : INT_MAX;
+        int lbRight = right < mEntries.size() ? mEntries[right].sum - sum : INT_MAX;
+        int idx;
+
+        if (lbLeft <= lbRight) {
+            if (lbLeft >= worst())
+                break;
+            idx = left--;
+        } else {
+            if (lbRight >= worst())
+                break;
+            idx = right++;
+        }
+
+        const uchar *ePtr = (const uchar *)mEntries[idx].desc.constData();
+        int dist = 0;
+        for (int pIdx = 0; pIdx < descSize * descSize; pIdx++)
+            dist += std::abs((int)dPtr[pIdx] - (int)ePtr[pIdx]);
+
+        if (dist < worst()) {
+            auto pos = std::upper_bound(best.begin(), best.end(), qMakePair(dist, idx));
+            best.insert(pos, qMakePair(dist, idx));
+
+            if (best.size() > k)
+                best.removeLast();
+        }
+    }
+
+    return best;
+}
+
+const DkMosaicDatabase::Entry &DkMosaicDatabase::entry(int idx) const
+{
+    return mEntries[idx];
+}
+
+int DkMosaicDatabase::size() const
+{
+    return mEntries.size();
+}
+
+QString DkMosaicDatabase::cachePath(const QString &dirPath) const
+{
+    QString cacheDir;
+    if (DkSettingsManager::param().isPortable())
+        cacheDir = QFileInfo(DkSettingsManager::param().settingsPath()).absolutePath();
+    else
+        cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+
+    QByteArray hash = QCryptographicHash::hash(dirPath.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QDir(cacheDir).absoluteFilePath("mosaic/" + QString::fromLatin1(hash) + ".db");
+}
+
+QHash<QString, DkMosaicDatabase::Entry> DkMosaicDatabase::load(const QString &dirPath) const
+{
+    QHash<QString, Entry> entries;
+
+    QFile file(cachePath(dirPath));
+    if (!file.open(QIODevice::ReadOnly))
+        return entries;
+
+    QDataStream ds(&file);
+    quint32 magic = 0, version = 0;
+    QString path;
+    int descLength = 0;
+    qint32 numEntries = 0;
+    ds >> magic >> version >> path >> descLength >> numEntries;
+
+    // hash collision, other descriptor or corrupt file
+    if (magic != mosaicDbMagic || version != mosaicDbVersion || path != dirPath || descLength != descSize * descSize)
+        return entries;
+
+    for (int idx = 0; idx < numEntries && ds.status() == QDataStream::Ok; idx++) {
+        Entry e;
+        ds >> e.filePath >> e.modified >> e.desc;
+        entries.insert(e.filePath, e);
+    }
+
+    if (ds.status() != QDataStream::Ok)
+        entries.clear();
+
+    return entries;
+}
+
+void DkMosaicDatabase::save(const QString &dirPath) const
+{
+    QString filePath = cachePath(dirPath);
+    if (!QDir().mkpath(QFileInfo(filePath).absolutePath()))
+        return;
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream ds(&file);
+    ds << mosaicDbMagic << mosaicDbVersion << dirPath << int(descSize * descSize) << qint32(mEntries.size() + mFailed.size());
+
+    // failed entries are stored with an empty descriptor
+    for (const Entry &e : mEntries)
+        ds << e.filePath << e.modified << e.desc;
+    for (const Entry &e : mFailed)
+        ds << e.filePath << e.modified << e.desc;
+
+    if (!file.commit())
+        qWarning() << "[DkMosaicDatabase] could not write" << file.fileName();
+}
+
 // DkMosaicDialog --------------------------------------------------------------------
 DkMosaicDialog::DkMosaicDialog(QWidget *parent /* = 0 */, Qt::WindowFlags f /* = 0 */)
     : QDialog(parent, f)
@@ -3106,12 +3378,8 @@ int DkMosaicDialog::computeMosaic(const QString &filter, const QString &suffix,
     cv::split(mImgLab, channels);
     cv::Mat imgL = channels[0];
 
-    // keeps track of the weights
-    cv::Mat cc(numPatches.height(), numPatches.width(), CV_32FC1);
-    cc.setTo(0);
-    cv::Mat ccD(numPatches.height(), numPatches.width(), CV_8UC1); // tells us if we have already computed the real patch
-
-    mFilesUsed.resize(numPatches.height() * numPatches.width());
+    int maxP = numPatches.width() * numPatches.height();
+    mFilesUsed.resize(maxP);
 
     // destination image
     cv::Mat dImg(patchResD * numPatches.height(), patchResD * numPatches.width(), CV_8UC1);
@@ -3127,155 +3395,132 @@ int DkMosaicDialog::computeMosaic(const QString &filter, const QString &suffix,
     qDebug() << "num patches: " << numPatches.width() << " x " << numPatches.height();
     qDebug() << "mosaic data --------------------------------";
 
-    // progress bar
-    int pIdx = 0;
-    int maxP = numPatches.width() * numPatches.height();
-
-    int iDidNothing = 0;
-    bool force = false;
-    bool useTwice = false;
-
-    while (iDidNothing < 10000) {
-        if (!mProcessing)
-            return QDialog::Rejected;
+    // index the database (only new images are decoded)
+    emit infoMessage(tr("Indexing images..."));
+    mDatabase.update(mSavePath, filter, suffix, [&](int progress) {
+        emit updateProgress(progress);
+        return mProcessing;
+    });
 
-        if (iDidNothing > 100) {
-            force = true;
+    if (!mProcessing)
+        return QDialog::Rejected;
 
-            if (!useTwice)
-                emit infoMessage(tr("Filling empty areas..."));
-        }
+    if (mDatabase.size() == 0) {
+        emit infoMessage(tr("Sorry, it seems that i cannot create your mosaic with this database."));
+        return QDialog::Rejected;
+    }
 
-        if (iDidNothing > 400 && !useTwice) {
-            emit infoMessage(tr("I need to use some images twice - maybe the database is too small?"));
-            iDidNothing = 0;
-            useTwice = true;
-        } else if (iDidNothing > 400) {
-            emit infoMessage(tr("Sorry, it seems that i cannot create your mosaic with this database."));
-            return QDialog::Rejected;
-        }
+    qDebug() << "mosaic database with" << mDatabase.size() << "images indexed in" << dt;
 
-        QString imgPath = getRandomImagePath(mSavePath, filter, suffix);
+    // find the best tiles for each patch
+    emit infoMessage(tr("Matching patches..."));
 
-        if (!useTwice && mFilesUsed.contains(QFileInfo(imgPath))) {
-            iDidNothing++;
-            continue;
-        }
+    QVector<int> patchIndexes(maxP);
+    std::iota(patchIndexes.begin(), patchIndexes.end(), 0);
 
-        try {
-            std::optional<LoadThumbnailResult> thumb = loadThumbnail(imgPath, LoadThumbnailOption::none);
-            if (thumb) {
-                thumb->thumb = DkImage::createThumb(thumb->thumb);
-            }
+    QVector<QVector<QPair<int, int>>> candidates(maxP);
+    QtConcurrent::blockingMap(patchIndexes, [&](int pIdx) {
+        int rIdx = pIdx / numPatches.width();
+        int cIdx = pIdx % numPatches.width();
 
-            cv::Mat ccTmp(cc.size(), cc.depth());
+        cv::Mat patch = imgL.rowRange(rIdx * patchResO, rIdx * patchResO + patchResO).colRange(cIdx * patchResO, cIdx * patchResO + patchResO);
+        cv::Mat desc;
+        cv::resize(patch, desc, cv::Size(DkMosaicDatabase::descSize, DkMosaicDatabase::descSize), 0.0, 0.0, CV_INTER_AREA);
 
-            if (!force)
-                ccTmp.setTo(0);
-            else
-                ccTmp = cc.clone();
+        candidates[pIdx] = mDatabase.nearest(desc, 8);
+    });
 
-            cv::Mat thumbPatch = createPatch(thumb ? thumb->thumb : QImage(), imgPath, patchResO);
+    // best matches first - they get their favorite image
+    QVector<int> order = patchIndexes;
+    std::sort(order.begin(), order.end(), [&](int lhs, int rhs) {
+        return candidates[lhs].first().first < candidates[rhs].first().first;
+    });
 
-            if (thumbPatch.rows != patchResO || thumbPatch.cols != patchResO) {
-                iDidNothing++;
-                continue;
-            }
+    // assign tiles - we try to not use an image twice
+    QVector<bool> used(mDatabase.size(), false);
+    QHash<int, QVector<int>> patchesOfTile;
+    bool usedTwice = false;
 
-            matchPatch(imgL, thumbPatch, patchResO, ccTmp);
+    for (int pIdx : order) {
+        int tile = -1;
 
-            if (force) {
-                cv::Mat mask = (cc == 0);
-                mask.convertTo(mask, CV_32FC1, 1.0f / 255.0f);
-                ccTmp = ccTmp.mul(mask);
+        for (const QPair<int, int> &c : candidates[pIdx]) {
+            if (!used[c.second]) {
+                tile = c.second;
+                break;
             }
+        }
 
-            double maxVal = 0;
-            cv::Point maxIdx;
-            cv::minMaxLoc(ccTmp, 0, &maxVal, 0, &maxIdx);
-            float *ccPtr = cc.ptr<float>(maxIdx.y);
-
-            if (maxVal > ccPtr[maxIdx.x]) {
-                cv::Mat pPatch =
-                    pImg.rowRange(maxIdx.y * patchResO, maxIdx.y * patchResO + patchResO).colRange(maxIdx.x * patchResO, maxIdx.x * patchResO + patchResO);
-                thumbPatch.copyTo(pPatch);
-
-                // visualize
-                if (pIdx % 10 == 0) {
-                    channels[0] = pImg;
-
-                    // debug
-                    cv::Mat imgT3;
-                    cv::merge(channels, imgT3);
-                    cv::cvtColor(imgT3, imgT3, CV_Lab2BGR);
-                    emit updateImage(DkImage::mat2QImage(imgT3));
-                }
-
-                if (ccPtr[maxIdx.x] == 0) {
-                    pIdx++;
-                    emit updateProgress(qRound((float)pIdx / maxP * 100));
-                }
-
-                // compute it now if we already have the full image loaded
-                if (thumb && thumb->thumb.width() > patchResD && thumb->thumb.height() > patchResD) {
-                    thumbPatch = createPatch(thumb->thumb, imgPath, patchResD);
+        if (tile == -1) {
+            tile = candidates[pIdx].first().second;
+            usedTwice = true;
+        }
 
-                    cv::Mat dPatch =
-                        dImg.rowRange(maxIdx.y * patchResD, maxIdx.y * patchResD + patchResD).colRange(maxIdx.x * patchResD, maxIdx.x * patchResD + patchResD);
-                    thumbPatch.copyTo(dPatch);
-                    ccD.ptr<unsigned char>(maxIdx.y)[maxIdx.x] = 1;
-                } else
-                    ccD.ptr<unsigned char>(maxIdx.y)[maxIdx.x] = 0;
+        used[tile] = true;
+        patchesOfTile[tile] << pIdx;
+        mFilesUsed[pIdx] = QFileInfo(mDatabase.entry(tile).filePath);
+    }
 
-                // update cc
-                ccPtr[maxIdx.x] = (float)maxVal;
+    if (usedTwice)
+        emit infoMessage(tr("I need to use some images twice - maybe the database is too small?"));
 
-                mFilesUsed[maxIdx.y * numPatchesH + maxIdx.x] = QFileInfo(imgPath); // replaces additionally the old file
-                iDidNothing = 0;
-            } else
-                iDidNothing++;
-        }
-        // catch cv exceptions e.g. out of memory
-        catch (...) {
-            iDidNothing++;
-        }
+    // render patches - each image is decoded once
+    QList<int> tiles = patchesOfTile.keys();
+    QAtomicInt numRendered = 0;
 
-        // are we done yet?
-        double minVal = 0;
-        cv::minMaxLoc(cc, &minVal);
+    QtConcurrent::blockingMap(tiles, [&](int tile) {
+        if (!mProcessing)
+            return;
 
-        if (minVal > 0)
-            break;
-    }
+        const QString filePath = mDatabase.entry(tile).filePath;
+        const QVector<int> patches = patchesOfTile.value(tile);
 
-    pIdx = 0;
+        try {
+            std::optional<LoadThumbnailResult> thumb = loadThumbnail(filePath, LoadThumbnailOption::none);
+            QImage img = thumb ? thumb->thumb : QImage();
+
+            // load the full image if the thumbnail is too small
+            if (img.isNull() || qMin(img.width(), img.height()) < patchResD) {
+                DkBasicLoader loader;
+                loader.loadGeneral(filePath, true, true);
+                img = loader.image();
+            }
 
-    // compute real resolution
-    for (int rIdx = 0; rIdx < ccD.rows; rIdx++) {
-        const unsigned char *ccDPtr = ccD.ptr<unsigned char>(rIdx);
+            // convert once and resize to both resolutions
+            cv::Mat lumPatch = luminancePatch(img);
+            cv::Mat thumbPatchO, thumbPatchD;
+            cv::resize(lumPatch, thumbPatchO, cv::Size(patchResO, patchResO), 0.0, 0.0, CV_INTER_AREA);
+            cv::resize(lumPatch, thumbPatchD, cv::Size(patchResD, patchResD), 0.0, 0.0, CV_INTER_AREA);
 
-        for (int cIdx = 0; cIdx < ccD.cols; cIdx++) {
-            // is the patch already computed?
-            if (ccDPtr[cIdx])
-                continue;
+            for (int pIdx : patches) {
+                int rIdx = pIdx / numPatches.width();
+                int cIdx = pIdx % numPatches.width();
 
-            QFileInfo cFile = mFilesUsed.at(rIdx * ccD.cols + cIdx);
+                cv::Mat pPatch = pImg.rowRange(rIdx * patchResO, rIdx * patchResO + patchResO).colRange(cIdx * patchResO, cIdx * patchResO + patchResO);
+                thumbPatchO.copyTo(pPatch);
 
-            if (!cFile.exists()) {
-                emit infoMessage(tr("Something is seriously wrong, I could not load: %1").arg(cFile.absoluteFilePath()));
-                continue;
+                cv::Mat dPatch = dImg.rowRange(rIdx * patchResD, rIdx * patchResD + patchResD).colRange(cIdx * patchResD, cIdx * patchResD + patchResD);
+                thumbPatchD.copyTo(dPatch);
             }
+        }
+        // catch cv exceptions e.g. out of memory
+        catch (...) {
+            emit infoMessage(tr("Something is seriously wrong, I could not load: %1").arg(filePath));
+        }
 
-            cv::Mat thumbPatch = createPatch({}, cFile.absoluteFilePath(), patchResD);
+        int pIdx = numRendered.fetchAndAddRelaxed(patches.size()) + patches.size();
+        emit updateProgress(qRound((float)pIdx / maxP * 100));
+    });
 
-            cv::Mat dPatch = dImg.rowRange(rIdx * patchResD, rIdx * patchResD + patchResD).colRange(cIdx * patchResD, cIdx * patchResD + patchResD);
-            thumbPatch.copyTo(dPatch);
-            emit updateProgress(qRound((float)pIdx / maxP * 100));
-            pIdx++;
-        }
-    }
+    if (!mProcessing)
+        return QDialog::Rejected;
 
-    qDebug() << "I fully rendered: " << ccD.rows * ccD.cols - cv::sum(ccD)[0] << " images";
+    // visualize
+    channels[0] = pImg;
+    cv::Mat imgT3;
+    cv::merge(channels, imgT3);
+    cv::cvtColor(imgT3, imgT3, CV_Lab2BGR);
+    emit updateImage(DkImage::mat2QImage(imgT3));
 
     // create final images
     mOrigImg = mImgLab;
@@ -3289,26 +3534,6 @@ int DkMosaicDialog::computeMosaic(const QString &filter, const QString &suffix,
     return QDialog::Accepted;
 }
 
-void DkMosaicDialog::matchPatch(const cv::Mat &img, const cv::Mat &thumb, int patchRes, cv::Mat &cc)
-{
-    for (int rIdx = 0; rIdx < cc.rows; rIdx++) {
-        float *ccPtr = cc.ptr<float>(rIdx);
-        const cv::Mat imgStrip = img.rowRange(rIdx * patchRes, rIdx * patchRes + patchRes);
-
-        for (int cIdx = 0; cIdx < cc.cols; cIdx++) {
-            // already computed?
-            if (ccPtr[cIdx] != 0)
-                continue;
-
-            const cv::Mat cPatch = imgStrip.colRange(cIdx * patchRes, cIdx * patchRes + patchRes);
-
-            cv::Mat absDiff;
-            cv::absdiff(cPatch, thumb, absDiff);
-            ccPtr[cIdx] = 1.0f - ((float)cv::sum(absDiff)[0] / (patchRes * patchRes * 255));
-        }
-    }
-}
-
 cv::Mat DkMosaicDialog::createPatch(const QImage &thumb, const QString &filePath, int patchRes)
 {
     QImage img;
@@ -3321,6 +3546,23 @@ cv::Mat DkMosaicDialog::createPatch(const QImage &thumb, const QString &filePath
     } else
         img = thumb;
 
+    cv::Mat cvThumb = luminancePatch(img);
+
+    if (cvThumb.rows < patchRes || cvThumb.cols < patchRes)
+        qDebug() << "enlarging thumbs!!";
+
+    cv::resize(cvThumb, cvThumb, cv::Size(patchRes, patchRes), 0.0, 0.0, CV_INTER_AREA);
+
+    return cvThumb;
+}
+
+/**
+ * Returns the center square of img's luminance (Lab) channel.
+ * @param img the image
+ * @return cv::Mat a square CV_8UC1 patch
+ **/
+cv::Mat DkMosaicDialog::luminancePatch(const QImage &img)
+{
     cv::Mat cvThumb = DkImage::qImage2Mat(img);
     cv::cvtColor(cvThumb, cvThumb, CV_RGB2Lab);
     std::vector<cv::Mat> channels;
@@ -3339,63 +3581,9 @@ cv::Mat DkMosaicDialog::createPatch(const QImage &thumb, const QString &filePath
         }
     }
 
-    if (cvThumb.rows < patchRes || cvThumb.cols < patchRes)
-        qDebug() << "enlarging thumbs!!";
-
-    cv::resize(cvThumb, cvThumb, cv::Size(patchRes, patchRes), 0.0, 0.0, CV_INTER_AREA);
-
     return cvThumb;
 }
 
-QString DkMosaicDialog::getRandomImagePath(const QString &cPath, const QString &ignore, const QString &suffix)
-{
-    // TODO: remove hierarchy
-    QStringList fileFilters = (suffix.isEmpty()) ? DkSettingsManager::param().app().fileFilters : QStringList(suffix);
-
-    // get all dirs
-    QFileInfoList entries = QDir(cPath).entryInfoList(QStringList(), QDir::AllDirs | QDir::NoDotAndDotDot);
-    // qDebug() << entries;
-    //  get all files
-    entries += QDir(cPath).entryInfoList(fileFilters);
-    // qDebug() << "current entries: " << e;
-
-    if (!ignore.isEmpty()) {
-        QStringList ignoreList = ignore.split(";");
-        QFileInfoList entriesTmp = entries;
-        entries.clear();
-
-        for (int idx = 0; idx < entriesTmp.size(); idx++) {
-            bool lIgnore = false;
-            QString p = entriesTmp.at(idx).absoluteFilePath();
-
-            for (int iIdx = 0; iIdx < ignoreList.size(); iIdx++) {
-                if (p.contains(ignoreList.at(iIdx))) {
-                    lIgnore = true;
-                    break;
-                }
-            }
-
-            if (!lIgnore)
-                entries.append(entriesTmp.at(idx));
-        }
-    }
-
-    if (entries.isEmpty())
-        return QString();
-
-    int rIdx = qRound(QRandomGenerator::global()->generateDouble() * (entries.size() - 1));
-
-    // qDebug() << "rand index: " << rIdx;
-
-    QFileInfo rPath = entries.at(rIdx);
-    // qDebug() << rPath.absoluteFilePath();
-
-    if (rPath.isDir())
-        return getRandomImagePath(rPath.absoluteFilePath(), ignore, suffix);
-    else
-        return rPath.absoluteFilePath();
-}
-
 void DkMosaicDialog::updatePostProcess()
 {
     if (mMosaicMat.empty() || mProcessing)
@@ -4080,7 +4268,7 @@ void DkDialogManager::openPrintDialog() const
     }
 
     DkPrintPreviewDialog *previewDialog = new DkPrintPreviewDialog(DkUtils::getMainWindow());
-    previewDialog->setImage(imgC->image());
+    previewDialog->setImage(imgC->fullSizeImage());
 
     // load all pages of tiffs
     if (imgC->getLoader()->getNumPages() > 1) {
@@ -28,6 +28,7 @@
 #pragma once
 
 #pragma warning(push, 0) // no warnings from includes - begin
+#include <QDateTime>
 #include <QDialog>
 #include <QDir>
 #include <QDoubleSpinBox>
@@ -41,6 +42,8 @@
 
 #include "DkBasicLoader.h"
 
+#include <functional>
+
 // Qt defines
 class QStandardItemModel;
 class QStandardItem;
@@ -678,6 +681,39 @@ protected:
 
 #ifdef WITH_OPENCV
 
+/**
+ * Keeps a small luminance descriptor of every image in a mosaic database (folder).
+ * The descriptors are cached on disk so that only new or changed images are decoded.
+ * The entries are sorted by their descriptor's sum which allows for a fast (exact)
+ * nearest neighbour search.
+ **/
+class DkMosaicDatabase
+{
+public:
+    static const int descSize = 16;
+
+    struct Entry {
+        QString filePath;
+        QDateTime modified;
+        QByteArray desc; // descSize x descSize luminance values - empty if the image could not be decoded
+        int sum = 0;
+    };
+
+    bool update(const QString &dirPath, const QString &ignore, const QString &suffix, const std::function<bool(int)> &progress);
+    QVector<QPair<int, int>> nearest(const cv::Mat &desc, int k) const;
+    const Entry &entry(int idx) const;
+    int size() const;
+
+protected:
+    QString cachePath(const QString &dirPath) const;
+    QHash<QString, Entry> load(const QString &dirPath) const;
+    void save(const QString &dirPath) const;
+
+    QVector<Entry> mEntries;
+    QVector<Entry> mFailed; // images that could not be decoded - retried once they are modified
+    QString mDirPath;
+};
+
 class DkMosaicDialog : public QDialog
 {
     Q_OBJECT
@@ -686,6 +722,9 @@ public:
     DkMosaicDialog(QWidget *parent = 0, Qt::WindowFlags f = Qt::WindowFlags());
     QImage getImage();
 
+    static cv::Mat createPatch(const QImage &thumb, const QString &filePath, int patchRes);
+    static cv::Mat luminancePatch(const QImage &img);
+
 public slots:
     void onOpenButtonPressed();
     void onDbButtonPressed();
@@ -718,9 +757,6 @@ protected:
     void createLayout();
     void enableMosaicSave(bool enable);
     void enableAll(bool enable);
-    QString getRandomImagePath(const QString &cPath, const QString &ignore, const QString &suffix);
-    void matchPatch(const cv::Mat &img, const cv::Mat &thumb, int patchRes, cv::Mat &cc);
-    cv::Mat createPatch(const QImage &thumb, const QString &filePath, int patchRes);
 
     void dropEvent(QDropEvent *event) override;
     void dragEnterEvent(QDragEnterEvent *event) override;
@@ -762,6 +798,7 @@ protected:
     cv::Mat mMosaicMatSmall;
     QImage mMosaic;
     QVector<QFileInfo> mFilesUsed;
+    DkMosaicDatabase mDatabase;
 
     enum {
         finished,
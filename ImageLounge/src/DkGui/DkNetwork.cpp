@@ -142,6 +142,12 @@ void DkClientManager::connectionReceivedNewFile(DkConnection *, qint16 op, const
     emit receivedNewFile(op, filename);
 }
 
+void DkClientManager::connectionReceivedNewImage(DkConnection *, const QImage &image, const QString &title)
+{
+    emit receivedImageTitle(title);
+    emit receivedImage(image);
+}
+
 void DkClientManager::connectionReceivedGoodBye(DkConnection *connection)
 {
     mPeerList.removePeer(connection->getPeerId());
@@ -215,6 +221,19 @@ void DkClientManager::sendNewFile(qint16 op, const QString &filename)
     }
 }
 
+void DkClientManager::sendNewImage(QImage image, const QString &title)
+{
+    QList<DkPeer *> synchronizedPeers = mPeerList.getSynchronizedPeers();
+    foreach (DkPeer *peer, synchronizedPeers) {
+        if (!peer)
+            continue;
+
+        connect(this, &DkClientManager::sendNewImageMessage, peer->connection, &DkConnection::sendNewImageMessage);
+        emit sendNewImageMessage(image, title);
+        disconnect(this, &DkClientManager::sendNewImageMessage, peer->connection, &DkConnection::sendNewImageMessage);
+    }
+}
+
 void DkClientManager::newConnection(int socketDescriptor)
 {
     DkConnection *connection = createConnection();
@@ -235,6 +254,7 @@ void DkClientManager::connectConnection(DkConnection *connection)
     connect(connection, &DkConnection::connectionNewPosition, this, &DkClientManager::connectionReceivedPosition);
     connect(connection, &DkConnection::connectionNewTransform, this, &DkClientManager::connectionReceivedTransformation);
     connect(connection, &DkConnection::connectionNewFile, this, &DkClientManager::connectionReceivedNewFile);
+    connect(connection, &DkConnection::connectionNewImage, this, &DkClientManager::connectionReceivedNewImage);
     connect(connection, &DkConnection::connectionGoodBye, this, &DkClientManager::connectionReceivedGoodBye);
     connect(connection, &DkConnection::connectionShowStatusMessage, this, &DkClientManager::connectionShowStatusMessage);
 
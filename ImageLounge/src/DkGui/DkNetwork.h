@@ -168,7 +168,7 @@ public slots:
     void sendPosition(QRect newRect, bool overlaid);
 
     void sendNewFile(qint16 op, const QString &filename);
-    virtual void sendNewImage(QImage, const QString &){}; // dummy
+    virtual void sendNewImage(QImage image, const QString &title);
     void sendGoodByeToAll();
 
 protected slots:
@@ -181,6 +181,7 @@ protected slots:
     connectionReceivedTransformation(DkConnection *connection, const QTransform &transform, const QTransform &imgTransform, const QPointF &canvasSize);
     virtual void connectionReceivedPosition(DkConnection *connection, const QRect &rect, bool opacity, bool overlaid);
     virtual void connectionReceivedNewFile(DkConnection *connection, qint16 op, const QString &filename);
+    virtual void connectionReceivedNewImage(DkConnection *connection, const QImage &image, const QString &title);
     virtual void connectionReceivedGoodBye(DkConnection *connection);
     void connectionShowStatusMessage(DkConnection *connection, const QString &msg);
     void disconnected();
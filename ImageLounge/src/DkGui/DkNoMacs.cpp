@@ -292,6 +292,7 @@ void DkNoMacs::createActions()
     connect(am.action(DkActionManager::menu_sort_date_created), &QAction::triggered, this, &DkNoMacs::changeSorting);
     connect(am.action(DkActionManager::menu_sort_date_modified), &QAction::triggered, this, &DkNoMacs::changeSorting);
     connect(am.action(DkActionManager::menu_sort_random), &QAction::triggered, this, &DkNoMacs::changeSorting);
+    connect(am.action(DkActionManager::menu_sort_date_taken), &QAction::triggered, this, &DkNoMacs::changeSorting);
     connect(am.action(DkActionManager::menu_sort_ascending), &QAction::triggered, this, &DkNoMacs::changeSorting);
     connect(am.action(DkActionManager::menu_sort_descending), &QAction::triggered, this, &DkNoMacs::changeSorting);
 
@@ -339,6 +340,7 @@ void DkNoMacs::createActions()
     connect(am.action(DkActionManager::menu_help_about), &QAction::triggered, this, &DkNoMacs::aboutDialog);
     connect(am.action(DkActionManager::menu_help_documentation), &QAction::triggered, this, &DkNoMacs::openDocumentation);
     connect(am.action(DkActionManager::menu_help_bug), &QAction::triggered, this, &DkNoMacs::bugReport);
+    connect(am.action(DkActionManager::menu_help_trace), &QAction::triggered, this, &DkNoMacs::recordTrace);
     connect(am.action(DkActionManager::menu_help_update), &QAction::triggered, this, &DkNoMacs::checkForUpdate);
     connect(am.action(DkActionManager::menu_help_update_translation), &QAction::triggered, this, &DkNoMacs::updateTranslations);
 
@@ -928,6 +930,7 @@ void DkNoMacs::newClientConnected(bool connected)
     am.action(DkActionManager::menu_sync_view)->setEnabled(connected);
     am.action(DkActionManager::menu_sync_pos)->setEnabled(connected);
     am.action(DkActionManager::menu_sync_arrange)->setEnabled(connected);
+    am.action(DkActionManager::menu_sync_send_image)->setEnabled(connected);
 }
 
 void DkNoMacs::tcpSetWindowRect(QRect newRect, bool opacity, bool overlaid)
@@ -1380,6 +1383,8 @@ void DkNoMacs::changeSorting(bool change)
             DkSettingsManager::param().global().sortMode = DkSettings::sort_date_modified;
         else if (senderName == "menu_sort_random")
             DkSettingsManager::param().global().sortMode = DkSettings::sort_random;
+        else if (senderName == "menu_sort_date_taken")
+            DkSettingsManager::param().global().sortMode = DkSettings::sort_date_taken;
         else if (senderName == "menu_sort_ascending")
             DkSettingsManager::param().global().sortDir = DkSettings::sort_ascending;
         else if (senderName == "menu_sort_descending")
@@ -1514,6 +1519,30 @@ Add any other context about the problem.
     QDesktopServices::openUrl(url);
 }
 
+void DkNoMacs::recordTrace(bool record)
+{
+    if (record) {
+        DkTrace::instance().clear();
+        DkTrace::instance().setEnabled(true);
+        return;
+    }
+
+    DkTrace::instance().setEnabled(false);
+
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    tr("Save Performance Trace"),
+                                                    QDir(getTabWidget()->getCurrentDir()).filePath("nomacs-trace.json"),
+                                                    tr("Chrome Trace (*.json)"),
+                                                    nullptr,
+                                                    DkDialog::fileDialogOptions());
+
+    if (fileName.isEmpty())
+        return;
+
+    if (!DkTrace::instance().save(fileName))
+        QMessageBox::critical(this, tr("Error"), tr("Sorry, I could not write to %1").arg(fileName));
+}
+
 void DkNoMacs::cleanSettings()
 {
     DefaultSettings settings;
@@ -1725,7 +1754,8 @@ void DkNoMacs::setWindowTitle(QSharedPointer<DkImageContainerT> imgC)
         return;
     }
 
-    setWindowTitle(imgC->filePath(), imgC->image().size(), imgC->isEdited(), imgC->getTitleAttribute());
+    // the full size of downscaled images without decoding them
+    setWindowTitle(imgC->filePath(), imgC->getLoader()->fullSize(), imgC->isEdited(), imgC->getTitleAttribute());
 }
 
 void DkNoMacs::setWindowTitle(const QString &filePath, const QSize &size, bool edited, const QString &attr)
@@ -1758,7 +1788,7 @@ void DkNoMacs::setWindowTitle(const QString &filePath, const QSize &size, bool e
     if (!size.isEmpty())
         attributes = QString::asprintf(" - %i x %i", size.width(), size.height());
     if (size.isEmpty() && vp && !vp->getImageSize().isEmpty())
-        attributes = QString::asprintf(" - %i x %i", vp->getImage().width(), vp->getImage().height());
+        attributes = QString::asprintf(" - %i x %i", vp->getImageSize().width(), vp->getImageSize().height());
     if (DkSettingsManager::param().app().privateMode)
         attributes.append(tr(" [Private Mode]"));
 
@@ -165,6 +165,7 @@ public slots:
     void aboutDialog();
     void openDocumentation();
     void bugReport();
+    void recordTrace(bool record);
     void loadRecursion();
     void setWindowTitle(QSharedPointer<DkImageContainerT> imgC);
     void setWindowTitle(const QString &filePath, const QSize &size = QSize(), bool edited = false, const QString &attr = QString());
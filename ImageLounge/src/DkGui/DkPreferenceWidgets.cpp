@@ -35,6 +35,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "DkSettings.h"
 #include "DkSettingsWidget.h"
 #include "DkThemeManager.h"
+#include "DkThumbs.h"
 #include "DkUtils.h"
 #include "DkWidgets.h"
 
@@ -727,6 +728,11 @@ void DkDisplayPreference::createLayout()
     hQAntiAliasing->setChecked(DkSettingsManager::param().display().highQualityAntiAliasing);
     connect(hQAntiAliasing, &QCheckBox::toggled, this, &DkDisplayPreference::onHQAntiAliasingToggled);
 
+    QCheckBox *decodeAtScreenSize = new QCheckBox(tr("Decode Large Images at Screen Resolution"), this);
+    decodeAtScreenSize->setToolTip(tr("If checked, large images load faster. The full resolution is decoded when zooming in or editing."));
+    decodeAtScreenSize->setChecked(DkSettingsManager::param().display().decodeAtScreenSize);
+    connect(decodeAtScreenSize, &QCheckBox::toggled, this, &DkDisplayPreference::onDecodeAtScreenSizeToggled);
+
     // show scollbars
     QCheckBox *showScrollBars = new QCheckBox(tr("Show Scrollbars when zooming into images"), this);
     showScrollBars->setToolTip(tr("If checked, scrollbars will appear that allow panning with the mouse."));
@@ -769,6 +775,7 @@ void DkDisplayPreference::createLayout()
     DkGroupWidget *zoomGroup = new DkGroupWidget(tr("Zoom"), this);
     zoomGroup->addWidget(invertZoom);
     zoomGroup->addWidget(hQAntiAliasing);
+    zoomGroup->addWidget(decodeAtScreenSize);
     zoomGroup->addWidget(showScrollBars);
     zoomGroup->addWidget(interpolationLabel);
     zoomGroup->addWidget(sbInterpolation);
@@ -958,6 +965,12 @@ void DkDisplayPreference::onHQAntiAliasingToggled(bool checked) const
         DkSettingsManager::param().display().highQualityAntiAliasing = checked;
 }
 
+void DkDisplayPreference::onDecodeAtScreenSizeToggled(bool checked) const
+{
+    if (DkSettingsManager::param().display().decodeAtScreenSize != checked)
+        DkSettingsManager::param().display().decodeAtScreenSize = checked;
+}
+
 void DkDisplayPreference::onZoomToFitToggled(bool checked) const
 {
     if (DkSettingsManager::param().display().zoomToFit != checked)
@@ -1079,6 +1092,31 @@ void DkFilePreference::createLayout()
     historyGroup->addWidget(historyBox);
     historyGroup->addWidget(hLabel);
 
+    // thumbnail cache size
+    QSpinBox *thumbCacheBox = new QSpinBox(this);
+    thumbCacheBox->setMinimum(0);
+    thumbCacheBox->setMaximum(16384);
+    thumbCacheBox->setSuffix(" MB");
+    thumbCacheBox->setMaximumWidth(200);
+    thumbCacheBox->setValue(qRound(DkSettingsManager::param().resources().thumbCacheSize));
+    connect(thumbCacheBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &DkFilePreference::onThumbCacheBoxValueChanged);
+
+    QLabel *tcLabel = new QLabel(tr("Thumbnails are stored on disk so that folders open faster. Set to 0 to disable. [%1-%2 MB]")
+                                     .arg(thumbCacheBox->minimum())
+                                     .arg(thumbCacheBox->maximum()),
+                                 this);
+
+    mClearThumbCacheButton = new QPushButton(this);
+    mClearThumbCacheButton->setMaximumWidth(300);
+    mClearThumbCacheButton->setText(
+        tr("Clear Thumbnail Cache (%1 MB)").arg(qRound(DkThumbDiskCache::instance().size() / (1024.0 * 1024.0))));
+    connect(mClearThumbCacheButton, &QPushButton::clicked, this, &DkFilePreference::onClearThumbCacheClicked);
+
+    DkGroupWidget *thumbCacheGroup = new DkGroupWidget(tr("Thumbnail Cache Size"), this);
+    thumbCacheGroup->addWidget(thumbCacheBox);
+    thumbCacheGroup->addWidget(tcLabel);
+    thumbCacheGroup->addWidget(mClearThumbCacheButton);
+
     // loading policy
     QVector<QRadioButton *> loadButtons;
     loadButtons.append(new QRadioButton(tr("Skip Images"), this));
@@ -1138,6 +1176,7 @@ void DkFilePreference::createLayout()
     l->addWidget(tempFolderGroup);
     l->addWidget(cacheGroup);
     l->addWidget(historyGroup);
+    l->addWidget(thumbCacheGroup);
     l->addWidget(loadGroup);
     l->addWidget(saveGroup);
     l->addWidget(skipGroup);
@@ -1186,6 +1225,21 @@ void DkFilePreference::onHistoryBoxValueChanged(int value) const
     }
 }
 
+void DkFilePreference::onThumbCacheBoxValueChanged(int value) const
+{
+    if (DkSettingsManager::param().resources().thumbCacheSize != value) {
+        DkSettingsManager::param().resources().thumbCacheSize = (float)value;
+    }
+}
+
+void DkFilePreference::onClearThumbCacheClicked()
+{
+    DkThumbDiskCache::instance().clear();
+    mClearThumbCacheButton->setText(tr("Clear Thumbnail Cache (%1 MB)").arg(0));
+
+    emit infoSignal(tr("Thumbnail cache cleared"));
+}
+
 void DkFilePreference::paintEvent(QPaintEvent *event)
 {
     // fixes stylesheets which are not applied to custom widgets
@@ -1394,12 +1448,18 @@ void DkAdvancedPreference::createLayout()
     cbFilterRaw->setChecked(DkSettingsManager::param().resources().filterRawImages);
     connect(cbFilterRaw, &QCheckBox::toggled, this, &DkAdvancedPreference::onFilterRawToggled);
 
+    QCheckBox *cbHalfSizeRaw = new QCheckBox(tr("Load RAW Data at Half Resolution"), this);
+    cbHalfSizeRaw->setToolTip(tr("If checked, RAW data is developed at half resolution while browsing which is much faster. Editing and saving use the full resolution."));
+    cbHalfSizeRaw->setChecked(DkSettingsManager::param().resources().halfSizeRawImages);
+    connect(cbHalfSizeRaw, &QCheckBox::toggled, this, &DkAdvancedPreference::onHalfSizeRawToggled);
+
     DkGroupWidget *loadRawGroup = new DkGroupWidget(tr("RAW Loader Settings"), this);
     loadRawGroup->addWidget(loadRawButtons[DkSettings::raw_thumb_always]);
     loadRawGroup->addWidget(loadRawButtons[DkSettings::raw_thumb_if_large]);
     loadRawGroup->addWidget(loadRawButtons[DkSettings::raw_thumb_never]);
     loadRawGroup->addSpace();
     loadRawGroup->addWidget(cbFilterRaw);
+    loadRawGroup->addWidget(cbHalfSizeRaw);
 
     // file loading
     QCheckBox *cbSaveDeleted = new QCheckBox(tr("Ask to Save Deleted Files"), this);
@@ -1484,6 +1544,12 @@ void DkAdvancedPreference::onFilterRawToggled(bool checked) const
         DkSettingsManager::param().resources().filterRawImages = checked;
 }
 
+void DkAdvancedPreference::onHalfSizeRawToggled(bool checked) const
+{
+    if (DkSettingsManager::param().resources().halfSizeRawImages != checked)
+        DkSettingsManager::param().resources().halfSizeRawImages = checked;
+}
+
 void DkAdvancedPreference::onSaveDeletedToggled(bool checked) const
 {
     if (DkSettingsManager::param().global().askToSaveDeletedFiles != checked)
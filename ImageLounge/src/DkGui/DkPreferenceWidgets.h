@@ -190,6 +190,7 @@ public slots:
     void onKeepZoomButtonClicked(int buttonId) const;
     void onInvertZoomToggled(bool checked) const;
     void onHQAntiAliasingToggled(bool checked) const;
+    void onDecodeAtScreenSizeToggled(bool checked) const;
     void onZoomToFitToggled(bool checked) const;
     void onTransitionCurrentIndexChanged(int index) const;
     void onAlwaysAnimateToggled(bool checked) const;
@@ -224,6 +225,8 @@ public slots:
     void onSkipBoxValueChanged(int value) const;
     void onCacheBoxValueChanged(int value) const;
     void onHistoryBoxValueChanged(int value) const;
+    void onThumbCacheBoxValueChanged(int value) const;
+    void onClearThumbCacheClicked();
     void onSaveGroupButtonClicked(int buttonId) const;
 
 signals:
@@ -232,6 +235,8 @@ signals:
 protected:
     void createLayout();
     void paintEvent(QPaintEvent *ev) override;
+
+    QPushButton *mClearThumbCacheButton = 0;
 };
 
 class DkFileAssociationsPreference : public DkWidget
@@ -271,6 +276,7 @@ public:
 public slots:
     void onLoadRawButtonClicked(int buttonId) const;
     void onFilterRawToggled(bool checked) const;
+    void onHalfSizeRawToggled(bool checked) const;
     void onSaveDeletedToggled(bool checked) const;
     void onIgnoreExifToggled(bool checked) const;
     void onSaveExifToggled(bool checked) const;
@@ -856,19 +856,9 @@ DkThumbLabel::DkThumbLabel(DkThumbLoader *thumbLoader, const QString &path, bool
     : QGraphicsObject(parent)
     , mText(this)
     , mThumbLoader{thumbLoader}
-    , mFilePath{path}
     , mFillSquare{fillSquare}
 
 {
-    const QFileInfo fileInfo(mFilePath);
-    // clang-format off
-    mTooltip =
-        QObject::tr("Name: ") % fileInfo.fileName() % "\n" %
-        QObject::tr("Size: ") % DkUtils::readableByte((float)fileInfo.size()) % "\n" %
-        QObject::tr("Created: ") % fileInfo.birthTime().toString();
-    // clang-format on
-    setToolTip(mTooltip);
-
     QColor col = DkSettingsManager::param().display().highlightColor;
     col.setAlpha(90);
     mSelectBrush = col;
@@ -878,16 +868,41 @@ DkThumbLabel::DkThumbLabel(DkThumbLoader *thumbLoader, const QString &path, bool
     font.setBold(false);
     font.setPointSize(9); // two sizes smaller than default font see:stylesheet.css
     mText.setFont(font);
-    mText.setPlainText(fileInfo.fileName());
     mText.setDefaultTextColor(QColor(255, 255, 255));
     mText.hide();
 
-    // Not loaded -> disable selection
-    setFlag(ItemIsSelectable, false);
-
     setAcceptHoverEvents(true);
     connect(mThumbLoader, &DkThumbLoader::thumbnailLoaded, this, &DkThumbLabel::onThumbnailLoaded);
     connect(mThumbLoader, &DkThumbLoader::thumbnailLoadFailed, this, &DkThumbLabel::onThumbnailLoadFailed);
+
+    setFilePath(path);
+}
+
+void DkThumbLabel::setFilePath(const QString &path)
+{
+    // labels are recycled by the scene -> reset everything that belongs to the old file
+    cancelLoading();
+
+    mFilePath = path;
+    mThumbNotExist = false;
+    mIsHovered = false;
+
+    if (mPixmapKey) {
+        QPixmapCache::remove(mPixmapKey.value());
+    }
+    mPixmapKey = std::nullopt;
+
+    const QFileInfo fileInfo(mFilePath);
+    // clang-format off
+    mTooltip =
+        QObject::tr("Name: ") % fileInfo.fileName() % "\n" %
+        QObject::tr("Size: ") % DkUtils::readableByte((float)fileInfo.size()) % "\n" %
+        QObject::tr("Created: ") % fileInfo.birthTime().toString();
+    // clang-format on
+    setToolTip(mTooltip);
+    mText.setPlainText(fileInfo.fileName());
+
+    update();
 }
 
 void DkThumbLabel::onThumbnailLoaded(const QString &filePath, const QImage &thumb, bool fromExif)
@@ -904,7 +919,6 @@ void DkThumbLabel::onThumbnailLoaded(const QString &filePath, const QImage &thum
     generatePixmap(thumb);
     updateTooltip(thumb, fromExif);
     update();
-    setFlag(ItemIsSelectable, true);
 }
 
 void DkThumbLabel::onThumbnailLoadFailed(const QString &filePath)
@@ -1083,7 +1097,7 @@ void DkThumbLabel::paint(QPainter *painter, const QStyleOptionGraphicsItem *opti
     }
 
     // render selected
-    if (isSelected()) {
+    if (mSelected) {
         painter->setBrush(mSelectBrush);
         painter->setPen(mSelectPen);
         painter->drawRect(boundingRect());
@@ -1117,6 +1131,20 @@ void DkThumbLabel::setFillSquare(bool value)
     update();
 }
 
+bool DkThumbLabel::isThumbSelected() const
+{
+    return mSelected;
+}
+
+void DkThumbLabel::setThumbSelected(bool selected)
+{
+    if (mSelected == selected)
+        return;
+
+    mSelected = selected;
+    update();
+}
+
 // DkThumbWidget --------------------------------------------------------------------
 DkThumbScene::DkThumbScene(DkThumbLoader *thumbLoader, QWidget *parent /* = 0 */)
     : QGraphicsScene(parent)
@@ -1139,7 +1167,7 @@ DkThumbScene::DkThumbScene(DkThumbLoader *thumbLoader, QWidget *parent /* = 0 */
 
 void DkThumbScene::updateLayout()
 {
-    if (mThumbLabels.empty())
+    if (mThumbs.empty())
         return;
 
     QSize pSize;
@@ -1150,38 +1178,137 @@ void DkThumbScene::updateLayout()
     int psz = DkSettingsManager::param().effectiveThumbPreviewSize();
     mXOffset = 2; // qCeil(psz*0.1f);
     mNumCols = qMax(qFloor(((float)pSize.width() - mXOffset) / (psz + mXOffset)), 1);
-    mNumCols = qMin(mThumbLabels.size(), mNumCols);
-    mNumRows = qCeil((float)mThumbLabels.size() / mNumCols);
+    mNumCols = qMin(mThumbs.size(), mNumCols);
+    mNumRows = qCeil((float)mThumbs.size() / mNumCols);
 
     int tso = psz + mXOffset;
     setSceneRect(0, 0, mNumCols * tso + mXOffset, mNumRows * tso + mXOffset);
 
-    DkTimer dt;
-    int cYOffset = mXOffset;
+    // the thumb size might have changed -> move all labels
+    for (auto it = mThumbLabels.constBegin(); it != mThumbLabels.constEnd(); it++) {
+        it.value()->setPos(thumbRect(it.key()).topLeft());
+    }
 
-    for (int rIdx = 0; rIdx < mNumRows; rIdx++) {
-        int cXOffset = mXOffset;
+    int selIdx = selectedThumbIndex();
+    if (selIdx != -1)
+        ensureThumbVisible(selIdx);
 
-        for (int cIdx = 0; cIdx < mNumCols; cIdx++) {
-            int tIdx = rIdx * mNumCols + cIdx;
+    updateVisibleThumbs();
+    update();
+}
 
-            if (tIdx < 0 || tIdx >= mThumbLabels.size())
-                break;
+void DkThumbScene::updateVisibleThumbs()
+{
+    if (mThumbs.empty() || mNumCols <= 0 || views().empty())
+        return;
 
-            DkThumbLabel *cLabel = mThumbLabels.at(tIdx);
-            cLabel->setPos(cXOffset, cYOffset);
-            cXOffset += psz + mXOffset;
-        }
+    DK_TRACE_SCOPE("updateVisibleThumbs");
+
+    const QGraphicsView *view = views().first();
+    QRectF vr = view->mapToScene(view->viewport()->rect()).boundingRect();
+
+    // keep one extra screen above & below so that scrolling does not show empty cells
+    vr.adjust(0, -vr.height(), 0, vr.height());
 
-        // update ypos
-        cYOffset += psz + mXOffset; // 20 for label
+    int tso = DkSettingsManager::param().effectiveThumbPreviewSize() + mXOffset;
+    int firstRow = qBound(0, qFloor((vr.top() - mXOffset) / tso), mNumRows - 1);
+    int lastRow = qBound(0, qFloor((vr.bottom() - mXOffset) / tso), mNumRows - 1);
+
+    int firstIdx = firstRow * mNumCols;
+    int lastIdx = qMin((lastRow + 1) * mNumCols, mThumbs.size()) - 1;
+
+    // recycle labels that scrolled out of the visible range
+    for (auto it = mThumbLabels.begin(); it != mThumbLabels.end();) {
+        if (it.key() < firstIdx || it.key() > lastIdx) {
+            it.value()->cancelLoading();
+            it.value()->hide();
+            mFreeLabels << it.value();
+            it = mThumbLabels.erase(it);
+        } else
+            it++;
     }
 
-    for (int idx = 0; idx < mThumbLabels.size(); idx++) {
-        if (mThumbLabels.at(idx)->isSelected())
-            mThumbLabels.at(idx)->ensureVisible();
+    const bool fillSquare = DkSettingsManager::param().display().displaySquaredThumbs;
+
+    for (int idx = firstIdx; idx <= lastIdx; idx++) {
+        if (mThumbLabels.contains(idx))
+            continue;
+
+        DkThumbLabel *label = acquireThumbLabel();
+        label->setFillSquare(fillSquare);
+        label->setFilePath(mThumbs[idx]);
+        label->setThumbSelected(mSelected[idx]);
+        label->setPos(thumbRect(idx).topLeft());
+        label->show();
+        mThumbLabels.insert(idx, label);
     }
-    update();
+}
+
+DkThumbLabel *DkThumbScene::acquireThumbLabel()
+{
+    if (!mFreeLabels.empty())
+        return mFreeLabels.takeLast();
+
+    DkThumbLabel *label = new DkThumbLabel(mThumbLoader, QString(), DkSettingsManager::param().display().displaySquaredThumbs);
+    connect(label, &DkThumbLabel::loadFileSignal, this, &DkThumbScene::loadFileSignal);
+    connect(label, &DkThumbLabel::showFileSignal, this, &DkThumbScene::showFile);
+    addItem(label);
+
+    return label;
+}
+
+void DkThumbScene::releaseThumbLabels()
+{
+    for (DkThumbLabel *label : std::as_const(mThumbLabels)) {
+        label->cancelLoading();
+        label->hide();
+        mFreeLabels << label;
+    }
+
+    mThumbLabels.clear();
+}
+
+QRectF DkThumbScene::thumbRect(int idx) const
+{
+    int psz = DkSettingsManager::param().effectiveThumbPreviewSize();
+
+    if (mNumCols <= 0)
+        return QRectF(mXOffset, mXOffset, psz, psz);
+
+    int tso = psz + mXOffset;
+    int rIdx = idx / mNumCols;
+    int cIdx = idx % mNumCols;
+
+    return QRectF(mXOffset + cIdx * tso, mXOffset + rIdx * tso, psz, psz);
+}
+
+int DkThumbScene::thumbIndexAt(const QPointF &scenePos) const
+{
+    if (mNumCols <= 0 || scenePos.x() < mXOffset || scenePos.y() < mXOffset)
+        return -1;
+
+    int tso = DkSettingsManager::param().effectiveThumbPreviewSize() + mXOffset;
+    int cIdx = qFloor((scenePos.x() - mXOffset) / tso);
+    int rIdx = qFloor((scenePos.y() - mXOffset) / tso);
+
+    if (cIdx >= mNumCols)
+        return -1;
+
+    int idx = rIdx * mNumCols + cIdx;
+
+    // hit the gap between two thumbs?
+    if (idx >= mThumbs.size() || !thumbRect(idx).contains(scenePos))
+        return -1;
+
+    return idx;
+}
+
+void DkThumbScene::ensureThumbVisible(int idx) const
+{
+    QRectF r = thumbRect(idx);
+
+    for (QGraphicsView *view : views())
+        view->ensureVisible(r);
 }
 
 void DkThumbScene::updateThumbs(QVector<QSharedPointer<DkImageContainerT>> thumbs)
@@ -1189,14 +1316,8 @@ void DkThumbScene::updateThumbs(QVector<QSharedPointer<DkImageContainerT>> thumb
     int selectedIdx = mLastSelectedIdx;
     mLastSelectedIdx = -1;
 
-    if (selectedIdx < 0) {
-        for (int idx = 0; idx < mThumbLabels.size(); idx++) {
-            if (mThumbLabels.at(idx)->isSelected()) {
-                selectedIdx = idx;
-                break;
-            }
-        }
-    }
+    if (selectedIdx < 0)
+        selectedIdx = selectedThumbIndex();
 
     mThumbs.clear();
     mThumbs.reserve(thumbs.size());
@@ -1205,28 +1326,16 @@ void DkThumbScene::updateThumbs(QVector<QSharedPointer<DkImageContainerT>> thumb
     }
     updateThumbLabels();
 
-    if (selectedIdx >= 0) {
-        selectedIdx = qMax(0, qMin(selectedIdx, mThumbLabels.size() - 1));
+    if (selectedIdx >= 0 && !mThumbs.empty()) {
+        selectedIdx = qMax(0, qMin(selectedIdx, mThumbs.size() - 1));
         selectThumb(selectedIdx);
     }
 }
 
 void DkThumbScene::updateThumbLabels()
 {
-    blockSignals(true); // do not emit selection changed while clearing!
-    clear(); // deletes the thumbLabels
-    blockSignals(false);
-
-    mThumbLabels.clear();
-
-    for (const auto &filePath : mThumbs) {
-        DkThumbLabel *thumb = new DkThumbLabel(mThumbLoader, filePath, DkSettingsManager::param().display().displaySquaredThumbs);
-        connect(thumb, &DkThumbLabel::loadFileSignal, this, &DkThumbScene::loadFileSignal);
-        connect(thumb, &DkThumbLabel::showFileSignal, this, &DkThumbScene::showFile);
-
-        addItem(thumb);
-        mThumbLabels.append(thumb);
-    }
+    releaseThumbLabels();
+    mSelected = QVector<bool>(mThumbs.size(), false);
 
     showFile();
 
@@ -1273,7 +1382,7 @@ void DkThumbScene::keyPressEvent(QKeyEvent *event)
         break;
     }
     case Qt::Key_Right: {
-        selectThumb(qMin(idx + 1, mThumbLabels.size() - 1));
+        selectThumb(qMin(idx + 1, mThumbs.size() - 1));
         break;
     }
     case Qt::Key_Up: {
@@ -1281,7 +1390,7 @@ void DkThumbScene::keyPressEvent(QKeyEvent *event)
         break;
     }
     case Qt::Key_Down: {
-        selectThumb(qMin(idx + mNumCols, mThumbLabels.size() - 1));
+        selectThumb(qMin(idx + mNumCols, mThumbs.size() - 1));
         break;
     }
     }
@@ -1305,7 +1414,7 @@ void DkThumbScene::showFile(const QString &filePath)
     DkStatusBar *bar = DkStatusBarManager::instance().statusbar();
     if (filePath == QDir::currentPath() || filePath.isEmpty()) { // i.e. user is NO LONGER hovering over a file
         if (sf == 0) {
-            QString info = QString::number(mThumbLabels.size()) + tr(" images");
+            QString info = QString::number(mThumbs.size()) + tr(" images");
             bar->setMessage(tr("%1 | %2").arg(info, currentDir()));
             bar->setMessage("", DkStatusBar::status_filesize_info);
         } else if (sf == 1) {
@@ -1322,12 +1431,10 @@ void DkThumbScene::showFile(const QString &filePath)
 
 void DkThumbScene::ensureVisible(const QString &path) const
 {
-    for (DkThumbLabel *label : mThumbLabels) {
-        if (label->filePath() == path) {
-            label->ensureVisible();
-            break;
-        }
-    }
+    int idx = mThumbs.indexOf(path);
+
+    if (idx != -1)
+        ensureThumbVisible(idx);
 }
 
 QString DkThumbScene::currentDir() const
@@ -1345,15 +1452,10 @@ QString DkThumbScene::currentDir() const
 
 int DkThumbScene::selectedThumbIndex(bool first)
 {
-    int selIdx = -1;
-    for (int idx = 0; idx < mThumbLabels.size(); idx++) {
-        if (first && mThumbLabels[idx]->isSelected())
-            return idx;
-        else if (mThumbLabels[idx]->isSelected())
-            selIdx = idx;
-    }
+    if (first)
+        return mSelected.indexOf(true);
 
-    return selIdx;
+    return mSelected.lastIndexOf(true);
 }
 
 void DkThumbScene::toggleThumbLabels(bool show)
@@ -1411,11 +1513,11 @@ void DkThumbScene::selectAllThumbs(bool selected)
 
 void DkThumbScene::selectThumbs(bool selected /* = true */, int from /* = 0 */, int to /* = -1 */)
 {
-    if (mThumbLabels.empty())
+    if (mThumbs.empty())
         return;
 
     if (to == -1)
-        to = mThumbLabels.size() - 1;
+        to = mThumbs.size() - 1;
 
     if (from > to) {
         int tmp = to;
@@ -1423,34 +1525,39 @@ void DkThumbScene::selectThumbs(bool selected /* = true */, int from /* = 0 */,
         from = tmp;
     }
 
-    blockSignals(true);
-    for (int idx = from; idx <= to && idx < mThumbLabels.size(); idx++) {
-        mThumbLabels.at(idx)->setSelected(selected);
+    for (int idx = qMax(from, 0); idx <= to && idx < mThumbs.size(); idx++) {
+        setThumbSelected(idx, selected);
     }
-    blockSignals(false);
     emit selectionChanged();
     showFile(); // update selection label
 }
 
 void DkThumbScene::selectThumb(int idx, bool select)
 {
-    if (mThumbLabels.empty())
+    if (mThumbs.empty())
         return;
 
-    if (idx < 0 || idx >= mThumbLabels.size()) {
+    if (idx < 0 || idx >= mThumbs.size()) {
         qWarning() << "index out of bounds in selectThumbs()" << idx;
         return;
     }
 
-    blockSignals(true);
-    mThumbLabels[idx]->setSelected(select);
-    blockSignals(false);
+    setThumbSelected(idx, select);
 
     emit selectionChanged();
     showFile(); // update selection label
 
-    Q_ASSERT(mThumbLabels.size() > idx && mThumbLabels[idx]);
-    mThumbLabels[idx]->ensureVisible();
+    ensureThumbVisible(idx);
+}
+
+void DkThumbScene::setThumbSelected(int idx, bool select)
+{
+    mSelected[idx] = select;
+
+    // offscreen thumbs get their state when they are materialized
+    DkThumbLabel *label = mThumbLabels.value(idx);
+    if (label)
+        label->setThumbSelected(select);
 }
 
 void DkThumbScene::copySelected() const
@@ -1539,7 +1646,7 @@ void DkThumbScene::copyImages(const QMimeData *mimeData, const Qt::DropAction &d
 
 void DkThumbScene::deleteSelected()
 {
-    const int numFiles = getSelectedThumbs().size();
+    const int numFiles = getSelectedFiles().size();
 
     if (numFiles <= 0)
         return;
@@ -1556,20 +1663,19 @@ void DkThumbScene::deleteSelected()
     int answer = msgBox->exec();
 
     if (answer == QMessageBox::Yes || answer == QMessageBox::Accepted) {
-        blockSignals(true); // setSelected may emit
+        blockSignals(true);
         mLoader->blockSignals(true); // use-after-free if loader emits in the loop
 
         mLastSelectedIdx = -1;
 
-        for (int i = 0; i < mThumbLabels.size(); i++) {
-            DkThumbLabel *thumb = mThumbLabels.at(i);
-            if (!thumb->isSelected())
+        for (int i = 0; i < mThumbs.size(); i++) {
+            if (!mSelected[i])
                 continue;
 
             if (mLastSelectedIdx < 0)
                 mLastSelectedIdx = i;
 
-            const QString filePath = thumb->filePath();
+            const QString filePath = mThumbs[i];
             const QString fileName = QFileInfo(filePath).fileName();
 
             if (!DkUtils::moveToTrash(filePath)) {
@@ -1584,7 +1690,7 @@ void DkThumbScene::deleteSelected()
             }
 
             // we might try to delete it twice because directoryChanged() can defer the update
-            thumb->setSelected(false);
+            setThumbSelected(i, false);
         }
 
         mLoader->blockSignals(false);
@@ -1633,10 +1739,9 @@ QStringList DkThumbScene::getSelectedFiles() const
 {
     QStringList fileList;
 
-    for (int idx = 0; idx < mThumbLabels.size(); idx++) {
-        if (mThumbLabels.at(idx) && mThumbLabels.at(idx)->isSelected()) {
-            fileList.append(mThumbLabels.at(idx)->filePath());
-        }
+    for (int idx = 0; idx < mThumbs.size(); idx++) {
+        if (mSelected[idx])
+            fileList.append(mThumbs[idx]);
     }
 
     return fileList;
@@ -1644,37 +1749,25 @@ QStringList DkThumbScene::getSelectedFiles() const
 
 QVector<DkThumbLabel *> DkThumbScene::getSelectedThumbs() const
 {
+    // NOTE: only materialized (i.e. visible) thumbs are returned
     QVector<DkThumbLabel *> selected;
 
-    for (DkThumbLabel *label : mThumbLabels) {
-        if (label->isSelected())
-            selected << label;
+    for (auto it = mThumbLabels.constBegin(); it != mThumbLabels.constEnd(); it++) {
+        if (mSelected[it.key()])
+            selected << it.value();
     }
 
     return selected;
 }
 
-int DkThumbScene::findThumb(DkThumbLabel *thumb) const
+bool DkThumbScene::isThumbSelected(int idx) const
 {
-    int thumbIdx = -1;
-
-    for (int idx = 0; idx < mThumbLabels.size(); idx++) {
-        if (thumb == mThumbLabels.at(idx)) {
-            thumbIdx = idx;
-            break;
-        }
-    }
-
-    return thumbIdx;
+    return idx >= 0 && idx < mSelected.size() && mSelected[idx];
 }
 
 bool DkThumbScene::allThumbsSelected() const
 {
-    for (DkThumbLabel *label : mThumbLabels)
-        if (label->flags() & QGraphicsItem::ItemIsSelectable && !label->isSelected())
-            return false;
-
-    return true;
+    return !mSelected.contains(false);
 }
 
 // DkThumbView --------------------------------------------------------------------
@@ -1695,19 +1788,14 @@ DkThumbsView::DkThumbsView(DkThumbScene *scene, QWidget *parent /* = 0 */)
 
 void DkThumbsView::onScroll()
 {
-    const QRectF portRect = mapToScene(viewport()->rect()).boundingRect();
-
-    for (const auto item : items()) {
-        auto it = dynamic_cast<DkThumbLabel *>(item);
-        if (it == nullptr) {
-            continue;
-        }
+    // recycles labels that left the viewport (this cancels their loading too)
+    scene->updateVisibleThumbs();
+}
 
-        const bool intesects = portRect.intersects(it->sceneBoundingRect());
-        if (!intesects) {
-            it->cancelLoading();
-        }
-    }
+void DkThumbsView::resizeEvent(QResizeEvent *event)
+{
+    QGraphicsView::resizeEvent(event);
+    scene->updateVisibleThumbs();
 }
 
 void DkThumbsView::wheelEvent(QWheelEvent *event)
@@ -1729,18 +1817,30 @@ void DkThumbsView::mousePressEvent(QMouseEvent *event)
         mousePos = event->pos();
     }
 
-    qDebug() << "mouse pressed";
-
-    DkThumbLabel *itemClicked = static_cast<DkThumbLabel *>(scene->itemAt(mapToScene(event->pos()), QTransform()));
+    int idxClicked = scene->thumbIndexAt(mapToScene(event->pos()));
+    pressedIdx = -1;
+
+    // the selection is managed by the scene since offscreen thumbs have no items
+    if (event->button() == Qt::LeftButton) {
+        if (idxClicked == -1) {
+            // if the user is selecting with e.g. shift or ctrl and (unintentionally)
+            // clicks into the background - we keep the selection
+            if (event->modifiers() == Qt::NoModifier)
+                scene->selectThumbs(false);
+        } else if (event->modifiers() & Qt::ControlModifier) {
+            scene->selectThumbs(!scene->isThumbSelected(idxClicked), idxClicked, idxClicked);
+        } else if (event->modifiers() == Qt::NoModifier && scene->isThumbSelected(idxClicked)) {
+            // keep a multi-selection for dragging, it is reduced on release
+            pressedIdx = idxClicked;
+        } else {
+            scene->selectThumbs(false);
+            scene->selectThumbs(true, idxClicked, idxClicked);
+        }
+    }
 
-    // this is a bit of a hack
-    // what we want to achieve: if the user is selecting with e.g. shift or ctrl
-    // and he clicks (unintentionally) into the background - the selection would be lost
-    // otherwise so we just don't propagate this event
-    if (itemClicked || event->modifiers() == Qt::NoModifier)
-        QGraphicsView::mousePressEvent(event);
+    QGraphicsView::mousePressEvent(event);
 
-    if (!itemClicked) {
+    if (idxClicked == -1) {
         scene->showFile("");
     }
 }
@@ -1788,12 +1888,18 @@ void DkThumbsView::mouseReleaseEvent(QMouseEvent *event)
 {
     QGraphicsView::mouseReleaseEvent(event);
 
-    DkThumbLabel *itemClicked = static_cast<DkThumbLabel *>(scene->itemAt(mapToScene(event->pos()), QTransform()));
+    int idxClicked = scene->thumbIndexAt(mapToScene(event->pos()));
+
+    if (pressedIdx != -1 && pressedIdx == idxClicked) {
+        scene->selectThumbs(false);
+        scene->selectThumbs(true, idxClicked, idxClicked);
+    }
+    pressedIdx = -1;
 
-    if (lastShiftIdx != -1 && event->modifiers() & Qt::ShiftModifier && itemClicked != 0) {
-        scene->selectThumbs(true, lastShiftIdx, scene->findThumb(itemClicked));
-    } else if (itemClicked != 0) {
-        lastShiftIdx = scene->findThumb(itemClicked);
+    if (lastShiftIdx != -1 && event->modifiers() & Qt::ShiftModifier && idxClicked != -1) {
+        scene->selectThumbs(true, lastShiftIdx, idxClicked);
+    } else if (idxClicked != -1) {
+        lastShiftIdx = idxClicked;
     } else
         lastShiftIdx = -1;
 }
@@ -1999,15 +2105,12 @@ void DkThumbScrollWidget::batchPrint() const
 
 void DkThumbScrollWidget::onLoadFileTriggered()
 {
-    auto selected = mThumbsScene->selectedItems();
+    QStringList selected = mThumbsScene->getSelectedFiles();
 
     if (selected.isEmpty())
         return;
 
-    auto thumb = dynamic_cast<DkThumbLabel *>(selected.first());
-
-    if (thumb)
-        mThumbsScene->loadFileSignal(thumb->filePath(), false);
+    mThumbsScene->loadFileSignal(selected.first(), false);
 }
 
 void DkThumbScrollWidget::updateThumbs(QVector<QSharedPointer<DkImageContainerT>> thumbs)
@@ -210,8 +210,11 @@ public:
     QPainterPath shape() const override;
     void cancelLoading();
     QString filePath() const;
+    void setFilePath(const QString &path);
     QImage image() const;
     void setFillSquare(bool value);
+    bool isThumbSelected() const;
+    void setThumbSelected(bool selected);
 
 signals:
     void loadFileSignal(const QString &filePath, bool newTab) const;
@@ -239,6 +242,7 @@ private:
     bool mFetchingThumb = false;
     bool mIsHovered = false;
     bool mFillSquare = false;
+    bool mSelected = false;
 
     static constexpr QColor sNoImagePen = QColor(150, 150, 150);
     static constexpr QColor sNoImageBrush = QColor(100, 100, 100, 50);
@@ -252,12 +256,14 @@ public:
     DkThumbScene(DkThumbLoader *thumbLoader, QWidget *parent = 0);
 
     void updateLayout();
+    void updateVisibleThumbs();
     QStringList getSelectedFiles() const;
     QVector<DkThumbLabel *> getSelectedThumbs() const;
 
     void setImageLoader(QSharedPointer<DkImageLoader> loader);
     void copyImages(const QMimeData *mimeData, const Qt::DropAction &da = Qt::CopyAction) const;
-    int findThumb(DkThumbLabel *thumb) const;
+    int thumbIndexAt(const QPointF &scenePos) const;
+    bool isThumbSelected(int idx) const;
     bool allThumbsSelected() const;
     void ensureVisible(const QString &path) const;
 
@@ -288,15 +294,23 @@ private:
     void keyPressEvent(QKeyEvent *event) override;
     QString currentDir() const;
     int selectedThumbIndex(bool first = true);
+    QRectF thumbRect(int idx) const;
+    void ensureThumbVisible(int idx) const;
+    void setThumbSelected(int idx, bool select);
+    void releaseThumbLabels();
+    DkThumbLabel *acquireThumbLabel();
 
     int mXOffset = 0;
     int mNumRows = 0;
     int mNumCols = 0;
     int mLastSelectedIdx = -1; // last selected item to restore on updateThumbs()
 
-    QVector<DkThumbLabel *> mThumbLabels;
+    // labels are only created for the visible rows, they are recycled while scrolling
+    QMap<int, DkThumbLabel *> mThumbLabels;
+    QVector<DkThumbLabel *> mFreeLabels;
     QSharedPointer<DkImageLoader> mLoader;
     QVector<QString> mThumbs;
+    QVector<bool> mSelected;
     DkThumbLoader *mThumbLoader;
 };
 
@@ -318,10 +332,12 @@ protected:
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
 
     DkThumbScene *scene;
     QPointF mousePos;
     int lastShiftIdx;
+    int pressedIdx = -1; // selected thumb that was pressed without modifiers
 
 private:
     void onScroll();
@@ -40,6 +40,7 @@
 #include "DkSettings.h"
 #include "DkStatusBar.h"
 #include "DkThumbsWidgets.h" // needed in the connects -> shall we move them to mController?
+#include "DkTimer.h"
 #include "DkToolbars.h"
 #include "DkUtils.h"
 #include "DkWidgets.h"
@@ -77,6 +78,7 @@ DkViewPort::DkViewPort(DkThumbLoader *thumbLoader, QWidget *parent)
 {
     mRepeatZoomTimer = new QTimer(this);
     mAnimationTimer = new QTimer(this);
+    mCommitTimer = new QTimer(this);
 
     // try loading a custom file
     mImgBg.load(QFileInfo(QApplication::applicationDirPath(), "bg.png").absoluteFilePath());
@@ -125,6 +127,7 @@ DkViewPort::DkViewPort(DkThumbLoader *thumbLoader, QWidget *parent)
     addActions(am.openWithActions().toList());
 
     connect(&mImgStorage, &DkImageStorage::infoSignal, this, &DkViewPort::infoSignal);
+    connect(&mImgStorage, &DkImageStorage::pyramidChanged, this, &DkViewPort::updatePyramidMemory);
 
     if (am.pluginActionManager())
         connect(am.pluginActionManager(),
@@ -161,6 +164,7 @@ DkViewPort::DkViewPort(DkThumbLoader *thumbLoader, QWidget *parent)
 
     connect(am.action(DkActionManager::sc_test_img), &QAction::triggered, this, &DkViewPort::loadLena);
     connect(am.action(DkActionManager::menu_sync_view), &QAction::triggered, this, &DkViewPort::tcpForceSynchronize);
+    connect(am.action(DkActionManager::menu_sync_send_image), &QAction::triggered, this, &DkViewPort::tcpSendImage);
 
     // playing
     connect(mNavigationWidget, &DkHudNavigation::previousSignal, this, &DkViewPort::loadPrevFileFast);
@@ -177,6 +181,11 @@ DkViewPort::DkViewPort(DkThumbLoader *thumbLoader, QWidget *parent)
     connect(this, &DkViewPort::sendTransformSignal, cm, &DkClientManager::sendTransform);
     connect(this, &DkViewPort::sendNewFileSignal, cm, &DkClientManager::sendNewFile);
     connect(cm, &DkClientManager::receivedNewFile, this, &DkViewPort::tcpLoadFile);
+    connect(this, &DkViewPort::sendImageSignal, cm, &DkClientManager::sendNewImage);
+    connect(cm, &DkClientManager::receivedImageTitle, this, [this](const QString &title) {
+        mTcpImageTitle = title;
+    });
+    connect(cm, &DkClientManager::receivedImage, this, &DkViewPort::tcpShowImage);
     connect(cm, &DkClientManager::updateConnectionSignal, mController, [this](const QString &msg) {
         mController->setInfo(msg);
     });
@@ -186,6 +195,11 @@ DkViewPort::DkViewPort(DkThumbLoader *thumbLoader, QWidget *parent)
         connect(action, &QAction::triggered, this, &DkViewPort::applyManipulator);
 
     connect(&mManipulatorWatcher, &QFutureWatcher<QImage>::finished, this, &DkViewPort::manipulatorApplied);
+    connect(&mPreviewWatcher, &QFutureWatcher<QPair<QImage, QImage>>::finished, this, &DkViewPort::previewApplied);
+
+    mCommitTimer->setSingleShot(true);
+    mCommitTimer->setInterval(400);
+    connect(mCommitTimer, &QTimer::timeout, this, &DkViewPort::commitManipulator);
 
     // TODO:
     // one could blur the canvas if a transparent GUI is present
@@ -202,6 +216,8 @@ DkViewPort::~DkViewPort()
 
     mManipulatorWatcher.cancel();
     mManipulatorWatcher.blockSignals(true);
+    mPreviewWatcher.cancel();
+    mPreviewWatcher.blockSignals(true);
 }
 
 void DkViewPort::createShortcuts()
@@ -259,6 +275,9 @@ void DkViewPort::onImageLoaded(QSharedPointer<DkImageContainerT> image, bool loa
         return;
     }
 
+    // edits decode the full resolution synchronously (see DkImageContainer::fullSizeImage())
+    connect(image.data(), &DkImageContainerT::fullSizeLoadedSignal, this, &DkViewPort::fullSizeLoaded, Qt::UniqueConnection);
+
     updateLoadedImage();
 
     mController->updateImage(image);
@@ -316,6 +335,12 @@ void DkViewPort::setImage(QImage newImg)
     if (mManipulatorWatcher.isRunning())
         mManipulatorWatcher.cancel();
 
+    // keep the preview if the user is still adjusting the current image
+    if (mPreviewContainer.toStrongRef() != imageContainer())
+        clearManipulatorPreview();
+    else if (!mCommitTimer->isActive())
+        mPreviewImg = QImage();
+
     mController->getOverview()->setImage(QImage()); // clear overview
 
     bool wasImageLoaded = !mImgStorage.isEmpty();
@@ -383,7 +408,7 @@ void DkViewPort::setImage(QImage newImg)
         DkStatusBarManager::instance().setMessage(QString::number(qRound((float)(mWorldMatrix.m11() * mImgMatrix.m11() * 100))) + "%",
                                                   DkStatusBar::status_zoom_info);
         DkStatusBarManager::instance().setMessage(DkUtils::formatToString(newImg.format()), DkStatusBar::status_format_info);
-        DkStatusBarManager::instance().setMessage(QString::number(newImg.width()) + " x " + QString::number(newImg.height()),
+        DkStatusBarManager::instance().setMessage(QString::number(getImageSize().width()) + " x " + QString::number(getImageSize().height()),
                                                   DkStatusBar::status_dimension_info);
 
         if (imageContainer())
@@ -465,6 +490,7 @@ void DkViewPort::zoom(double factor, const QPointF &center, bool force)
     }
 
     zoomToPoint(factor, pos, mWorldMatrix);
+    loadFullSize();
 
     controlImagePosition();
     if (blackBorder && factor < 1)
@@ -655,6 +681,10 @@ void DkViewPort::applyPlugin(DkPluginContainer *plugin, const QString &key)
     if (bPlugin)
         bPlugin->loadSettings();
 
+    // plugins edit the full resolution
+    if (imageContainer())
+        imageContainer()->loadFullSize();
+
     QSharedPointer<DkImageContainerT> result = DkImageContainerT::fromImageContainer(plugin->plugin()->runPlugin(key, imageContainer()));
     if (result)
         setEditedImage(result);
@@ -674,11 +704,83 @@ bool DkViewPort::isEdited() const
 QImage DkViewPort::getImage() const
 {
     if (imageContainer() && (!mSvg || !mSvg->isValid()) && (!mMovie || !mMovie->isValid()))
-        return imageContainer()->image();
+        return imageContainer()->fullSizeImage();
 
     return DkBaseViewPort::getImage();
 }
 
+/**
+ * Returns the image as it is displayed. In contrast to getImage(),
+ * this does not decode the full resolution of downscaled images.
+ **/
+QImage DkViewPort::getDisplayedImage() const
+{
+    return DkBaseViewPort::getImage();
+}
+
+QSize DkViewPort::getImageSize() const
+{
+    // downscaled images are mapped to the full image size
+    QSharedPointer<DkImageContainerT> imgC = imageContainer();
+    if (imgC && (!mSvg || !mSvg->isValid()) && imgC->getLoader()->isDownscaled() && imgC->pixmap().size() == mImgStorage.size())
+        return imgC->getLoader()->fullSize();
+
+    return DkBaseViewPort::getImageSize();
+}
+
+/**
+ * Replaces a downscaled image (see DkSettings::Display::decodeAtScreenSize)
+ * with the full resolution image if we zoom beyond its resolution.
+ **/
+void DkViewPort::loadFullSize()
+{
+    QSharedPointer<DkImageContainerT> imgC = imageContainer();
+
+    if (!imgC || mImgStorage.isEmpty() || !imgC->getLoader()->isDownscaled())
+        return;
+
+    // screen pixels per decoded pixel
+    double scale = mWorldMatrix.m11() * mImgMatrix.m11() * devicePixelRatioF() * getImageSize().width() / mImgStorage.size().width();
+
+    if (scale <= 1.0)
+        return;
+
+    // the full image is decoded in the background - we keep showing the downscaled image meanwhile
+    connect(imgC.data(), &DkImageContainerT::fullSizeLoadedSignal, this, &DkViewPort::fullSizeLoaded, Qt::UniqueConnection);
+    imgC->fetchFullSize();
+}
+
+void DkViewPort::fullSizeLoaded()
+{
+    QSharedPointer<DkImageContainerT> imgC = imageContainer();
+
+    // the user switched to another image in the meantime
+    if (!imgC || imgC.data() != sender())
+        return;
+
+    // the view does not change since getImageSize() already reported the full size
+    mImgStorage.setImage(imgC->pixmap());
+    update();
+}
+
+/**
+ * Accounts the memory of the image pyramid to the image container displayed
+ * so that the cacher considers it.
+ **/
+void DkViewPort::updatePyramidMemory()
+{
+    QSharedPointer<DkImageContainerT> imgC = imageContainer();
+    QSharedPointer<DkImageContainerT> oldImgC = mPyramidContainer.toStrongRef();
+
+    if (oldImgC && oldImgC != imgC)
+        oldImgC->setDisplayMemory(0.0f);
+
+    if (imgC)
+        imgC->setDisplayMemory(mImgStorage.pyramidMemory());
+
+    mPyramidContainer = imgC;
+}
+
 void DkViewPort::resizeImage()
 {
     if (!mResizeDialog)
@@ -698,7 +800,7 @@ void DkViewPort::resizeImage()
         return;
     }
 
-    mResizeDialog->setImage(imgC->image());
+    mResizeDialog->setImage(imgC->fullSizeImage());
 
     if (!mResizeDialog->exec())
         return;
@@ -803,7 +905,7 @@ void DkViewPort::setAsWallpaper()
         qWarning() << "cannot create wallpaper because there is no image loaded...";
     }
 
-    QImage img = imgC->image();
+    QImage img = imgC->fullSizeImage();
     QString tmpPath = mLoader->saveTempFile(img, "wallpaper", ".jpg", true, false);
 
     // is there a more elegant way to see if saveTempFile returned an empty path
@@ -844,6 +946,33 @@ void DkViewPort::applyManipulator()
     // try to cast up
     QSharedPointer<DkBaseManipulatorExt> mplExt = qSharedPointerDynamicCast<DkBaseManipulatorExt>(mpl);
 
+    // extended manipulators are previewed while the user adjusts them
+    // geometric & neighborhood operations (e.g. rotate, blur) depend on the full image - they are not previewed
+    if (mplExt && mplExt->isPointOperation() && imageContainer() && !(mManipulatorWatcher.isRunning() && mActiveManipulator != mpl)) {
+        // show the dock (in case it's not shown yet)
+        am.action(DkActionManager::menu_edit_image)->setChecked(true);
+
+        previewManipulator(mplExt);
+        mCommitTimer->start();
+        return;
+    }
+
+    applyManipulatorFull(mpl);
+}
+
+void DkViewPort::commitManipulator()
+{
+    if (mPreviewManipulator)
+        applyManipulatorFull(mPreviewManipulator);
+}
+
+void DkViewPort::applyManipulatorFull(QSharedPointer<DkBaseManipulator> mpl)
+{
+    DkActionManager &am = DkActionManager::instance();
+
+    // try to cast up
+    QSharedPointer<DkBaseManipulatorExt> mplExt = qSharedPointerDynamicCast<DkBaseManipulatorExt>(mpl);
+
     // mark dirty
     if (mManipulatorWatcher.isRunning() && mplExt && mActiveManipulator == mpl) {
         mplExt->setDirty(true);
@@ -877,7 +1006,7 @@ void DkViewPort::applyManipulator()
             // However, the next undo will be wrong.
         }
 
-        img = imageContainer()->image();
+        img = imageContainer()->fullSizeImage();
     } else
         img = getImage();
 
@@ -890,6 +1019,107 @@ void DkViewPort::applyManipulator()
     emit showProgress(true, 500);
 }
 
+/**
+ * Returns the image an extended manipulator is applied to.
+ * If the last edit is the same manipulator, it is replaced (see applyManipulatorFull())
+ * so the image before that edit is returned. The history is not changed.
+ **/
+QImage DkViewPort::manipulatorSource(QSharedPointer<DkBaseManipulatorExt> mplExt) const
+{
+    auto l = imageContainer()->getLoader();
+    int idx = l->historyIndex();
+
+    if (idx > 0 && idx < l->history()->size() && l->lastEdit().editName() == mplExt->name())
+        return l->history()->at(idx - 1).image();
+
+    return imageContainer()->fullSizeImage();
+}
+
+/**
+ * Applies the manipulator to the visible part of the image at display resolution.
+ * The proxy is cached, so while the user drags a slider only the manipulator runs
+ * on a screen sized image. If a preview is running, only the latest parameters are
+ * computed once it finishes.
+ **/
+void DkViewPort::previewManipulator(QSharedPointer<DkBaseManipulatorExt> mplExt)
+{
+    mPreviewManipulator = mplExt;
+    mPreviewContainer = imageContainer();
+
+    if (mPreviewWatcher.isRunning()) {
+        mPreviewDirty = true;
+        return;
+    }
+
+    QImage src = manipulatorSource(mplExt);
+
+    // the view matrices belong to the current image - we cannot preview if the size differs
+    if (src.isNull() || src.size() != getImageSize())
+        return;
+
+    // visible image region & its size on screen
+    QRectF viewRect = mWorldMatrix.inverted().mapRect(QRectF(viewport()->rect()));
+    QRect visibleRect = mImgMatrix.inverted().mapRect(viewRect).toAlignedRect().intersected(src.rect());
+
+    if (visibleRect.isEmpty())
+        return;
+
+    QSizeF displaySize = mWorldMatrix.mapRect(mImgMatrix.mapRect(QRectF(visibleRect))).size() * devicePixelRatioF();
+    QSize proxySize = displaySize.toSize().boundedTo(visibleRect.size()).expandedTo(QSize(1, 1));
+
+    // recompute the proxy only if the source or the visible region changed
+    if (src.cacheKey() != mProxyKey || visibleRect != mProxyRect || proxySize != mProxyImg.size()) {
+        mProxyImg = QImage();
+        mProxyKey = src.cacheKey();
+        mProxyRect = visibleRect;
+    }
+
+    QImage proxy = mProxyImg;
+
+    mPreviewWatcher.setFuture(QtConcurrent::run([mplExt, src, proxy, visibleRect, proxySize]() {
+        QImage p = proxy;
+
+        if (p.isNull()) {
+            p = (visibleRect == src.rect()) ? src : src.copy(visibleRect);
+
+            if (p.size() != proxySize)
+                p = p.scaled(proxySize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }
+
+        return qMakePair(p, mplExt->apply(p));
+    }));
+}
+
+void DkViewPort::previewApplied()
+{
+    if (mPreviewWatcher.isCanceled())
+        return;
+
+    QPair<QImage, QImage> result = mPreviewWatcher.result();
+    mProxyImg = result.first;
+
+    // the full resolution image might have been set in the meantime
+    if (mCommitTimer->isActive() || mManipulatorWatcher.isRunning()) {
+        mPreviewImg = result.second;
+        viewport()->update();
+    }
+
+    if (mPreviewDirty && mPreviewManipulator) {
+        mPreviewDirty = false;
+        previewManipulator(mPreviewManipulator);
+    }
+}
+
+void DkViewPort::clearManipulatorPreview()
+{
+    mCommitTimer->stop();
+    mPreviewWatcher.cancel();
+    mPreviewDirty = false;
+    mPreviewImg = QImage();
+    mProxyImg = QImage();
+    mProxyKey = 0;
+}
+
 void DkViewPort::manipulatorApplied()
 {
     if (mManipulatorWatcher.isCanceled() || !mActiveManipulator) {
@@ -919,6 +1149,8 @@ void DkViewPort::manipulatorApplied()
 
 void DkViewPort::paintEvent(QPaintEvent *event)
 {
+    DK_TRACE_SCOPE("paint");
+
     QPainter painter(viewport());
 
     if (!mImgStorage.isEmpty()) {
@@ -948,6 +1180,10 @@ void DkViewPort::paintEvent(QPaintEvent *event)
         double opacity = (DkSettingsManager::param().display().transition == DkSettings::trans_fade) ? 1.0 - mAnimationValue : 1.0;
         draw(painter, opacity);
 
+        // manipulator preview while the full image is computed
+        if (!mPreviewImg.isNull())
+            painter.drawImage(mImgMatrix.mapRect(QRectF(mProxyRect)), mPreviewImg, mPreviewImg.rect());
+
         if (!mAnimationBuffer.isNull() && mAnimationValue > 0) {
             float oldOp = (float)painter.opacity();
 
@@ -1271,13 +1507,13 @@ void DkViewPort::mouseMoveEvent(QMouseEvent *event)
     int dist = QPoint(event->pos() - mPosGrab.toPoint()).manhattanLength();
 
     // drag & drop action
-    if (event->buttons() == Qt::LeftButton && dist > QApplication::startDragDistance() && imageInside() && !getImage().isNull() && mLoader
+    if (event->buttons() == Qt::LeftButton && dist > QApplication::startDragDistance() && imageInside() && !mImgStorage.isEmpty() && mLoader
         && !QApplication::widgetAt(event->globalPosition().toPoint())) { // is NULL if the mouse leaves the window
 
         QMimeData *mimeData = createMime();
 
         QPixmap pm;
-        if (!getImage().isNull())
+        if (!mImgStorage.isEmpty())
             pm = QPixmap::fromImage(mImgStorage.image().scaledToHeight(73, Qt::SmoothTransformation));
         if (pm.width() > 130)
             pm = pm.scaledToWidth(100, Qt::SmoothTransformation);
@@ -1414,6 +1650,20 @@ QPoint DkViewPort::mapToImage(const QPoint &windowPos) const
     return xy;
 }
 
+/**
+ * Maps a pixel of the (full resolution) image to the displayed image.
+ * The displayed image is smaller if it was downscaled (see getImageSize()).
+ **/
+QPoint DkViewPort::mapToDisplayedImage(const QPoint &xy, const QImage &img) const
+{
+    QSize imgSize = getImageSize();
+
+    if (img.size() == imgSize || imgSize.isEmpty())
+        return xy;
+
+    return QPoint(qMin(xy.x() * img.width() / imgSize.width(), img.width() - 1), qMin(xy.y() * img.height() / imgSize.height(), img.height() - 1));
+}
+
 void DkViewPort::getPixelInfo(const QPoint &pos)
 {
     if (mImgStorage.isEmpty())
@@ -1424,8 +1674,8 @@ void DkViewPort::getPixelInfo(const QPoint &pos)
         return;
 
     // TODO: This is rgb now, but we could display native pixel values too, even CMYK in Qt 6.8.0
-    const QImage img = getImage();
-    const QColor color = img.pixelColor(xy);
+    const QImage img = getDisplayedImage();
+    const QColor color = img.pixelColor(mapToDisplayedImage(xy, img));
 
     const QRgb rgba = color.rgba(); // converts higher depths to ARGB-8888
     QString msg;
@@ -1451,19 +1701,19 @@ QString DkViewPort::getCurrentPixelHexValue()
     if (xy.x() < 0)
         return QString();
 
-    const QImage img = getImage();
-    return DkUtils::colorToCssHex(img.pixelColor(xy), img.hasAlphaChannel()).remove(0, 1);
+    const QImage img = getDisplayedImage();
+    return DkUtils::colorToCssHex(img.pixelColor(mapToDisplayedImage(xy, img)), img.hasAlphaChannel()).remove(0, 1);
 }
 
 // Copy & Paste --------------------------------------------------------
 void DkViewPort::copyPixelColorValue()
 {
-    if (getImage().isNull())
+    if (mImgStorage.isEmpty())
         return;
 
     QMimeData *mimeData = new QMimeData;
 
-    if (!getImage().isNull())
+    if (!mImgStorage.isEmpty())
         mimeData->setText(getCurrentPixelHexValue());
 
     QClipboard *clipboard = QApplication::clipboard();
@@ -1480,7 +1730,7 @@ void DkViewPort::copyImage()
 
 QMimeData *DkViewPort::createMime() const
 {
-    if (getImage().isNull() || !mLoader)
+    if (mImgStorage.isEmpty() || !mLoader)
         return 0;
 
     // NOTE: if we do the file:/// thingy, we will get into problems with mounted drives (e.g. //hermes...)
@@ -1867,6 +2117,37 @@ void DkViewPort::tcpLoadFile(qint16 idx, QString filename)
     // DkSettingsManager::param().sync().syncMode = oldMode;
 }
 
+void DkViewPort::tcpSendImage()
+{
+    QSharedPointer<DkImageContainerT> imgC = imageContainer();
+
+    if (!imgC || !imgC->hasImage())
+        return;
+
+    emit sendImageSignal(imgC->fullSizeImage(), imgC->fileName());
+}
+
+/**
+ * Shows an image received from a connected instance.
+ * The image is refined several times while its tiles arrive - these
+ * updates replace the received image without asking to save it.
+ * @param img the (partially) received image
+ **/
+void DkViewPort::tcpShowImage(const QImage &img)
+{
+    if (!mLoader || img.isNull())
+        return;
+
+    QSharedPointer<DkImageContainerT> tcpImg = mTcpImage.toStrongRef();
+
+    if ((!tcpImg || tcpImg != mLoader->getCurrentImage()) && !unloadImage(true))
+        return; // user canceled
+
+    QString title = mTcpImageTitle.isEmpty() ? tr("Received Image") : mTcpImageTitle;
+    mTcpImage = mLoader->setImage(img, title);
+    setImage(img);
+}
+
 QSharedPointer<DkImageContainerT> DkViewPort::imageContainer() const
 {
     if (!mLoader)
@@ -2021,6 +2302,7 @@ void DkViewPortFrameless::zoom(double factor, const QPointF &center, bool force)
         pos.setY(viewRect.bottom());
 
     zoomToPoint(factor, pos, mWorldMatrix);
+    loadFullSize();
 
     controlImagePosition();
     showZoom();
@@ -2072,7 +2354,9 @@ void DkViewPortFrameless::draw(QPainter &painter, double)
         if (DkSettingsManager::param().display().tpPattern && img.hasAlphaChannel())
             drawPattern(painter);
 
-        painter.drawImage(mImgViewRect, img, QRect(QPoint(), img.size()));
+        // the anti-aliased image is preferred if it matches the display size
+        if (img.size() == displayRect.size() || !mImgStorage.drawVisibleRegion(painter, mImgViewRect))
+            painter.drawImage(mImgViewRect, img, QRect(QPoint(), img.size()));
     }
 }
 
@@ -2537,7 +2821,7 @@ QImage DkViewPortContrast::getImage() const
     if (mDrawFalseColorImg)
         return mFalseColorImg;
     else
-        return imageContainer() ? imageContainer()->image() : QImage();
+        return imageContainer() ? imageContainer()->image() : QImage(); // the histogram does not need the full resolution
 }
 
 // in contrast mode: if the histogram widget is visible redraw the histogram from the selected image channel data
@@ -114,12 +114,14 @@ public:
 
     QString getCurrentPixelHexValue();
     QPoint mapToImage(const QPoint &windowPos) const;
+    QPoint mapToDisplayedImage(const QPoint &xy, const QImage &img) const;
 
     void connectLoader(QSharedPointer<DkImageLoader> loader, bool connectSignals = true);
 
 signals:
     void sendTransformSignal(QTransform transform, QTransform imgTransform, QPointF canvasSize) const;
     void sendNewFileSignal(qint16 op, QString filename = "") const;
+    void sendImageSignal(QImage img, const QString &title) const;
     void movieLoadedSignal(bool isMovie) const;
     void infoSignal(const QString &msg) const; // needed to forward signals
     void addTabSignal(const QString &filePath) const;
@@ -146,6 +148,8 @@ public slots:
     void tcpForceSynchronize();
     void tcpSynchronize(QTransform relativeMatrix = QTransform(), bool force = false);
     void tcpLoadFile(qint16 idx, QString filename);
+    void tcpSendImage();
+    void tcpShowImage(const QImage &img);
 
     // file actions
     void loadFile(const QString &filePath);
@@ -169,6 +173,8 @@ public slots:
     // image saving
     bool isEdited() const;
     QImage getImage() const override;
+    QImage getDisplayedImage() const;
+    QSize getImageSize() const override;
     void saveFile();
     void saveFileAs(bool silent = false);
     void saveFileWeb();
@@ -183,6 +189,8 @@ public slots:
     // image manipulators
     virtual void applyManipulator();
     void manipulatorApplied();
+    void previewApplied();
+    void commitManipulator();
 
     void updateLoadedImage();
     void onImageLoaded(QSharedPointer<DkImageContainerT> image, bool loaded = true);
@@ -211,6 +219,10 @@ protected:
     virtual void mouseDoubleClickEvent(QMouseEvent *event) override;
     virtual void mouseMoveEvent(QMouseEvent *event) override;
     virtual void wheelEvent(QWheelEvent *event) override;
+
+    void loadFullSize();
+    void fullSizeLoaded();
+    void updatePyramidMemory();
     virtual bool event(QEvent *event) override;
     virtual void paintEvent(QPaintEvent *event) override;
     virtual void leaveEvent(QEvent *event) override;
@@ -249,11 +261,30 @@ protected:
     QFutureWatcher<QImage> mManipulatorWatcher;
     QSharedPointer<DkBaseManipulator> mActiveManipulator;
 
+    // live preview of extended manipulators on a display sized proxy
+    QFutureWatcher<QPair<QImage, QImage>> mPreviewWatcher; // (proxy, manipulated proxy)
+    QSharedPointer<DkBaseManipulatorExt> mPreviewManipulator;
+    QWeakPointer<DkImageContainerT> mPreviewContainer;
+    QWeakPointer<DkImageContainerT> mPyramidContainer; // the container the pyramid memory is accounted to
+    QTimer *mCommitTimer = 0; // applies the manipulator to the full image once the user pauses
+
+    QWeakPointer<DkImageContainerT> mTcpImage; // the last image received from a connected instance
+    QString mTcpImageTitle;
+    bool mPreviewDirty = false;
+    QImage mPreviewImg;
+    QImage mProxyImg;
+    QRect mProxyRect; // image region covered by the proxy
+    qint64 mProxyKey = 0; // cacheKey of the proxy's source image
+
     // functions
     virtual int swipeRecognition(QPoint start, QPoint end);
     virtual void swipeAction(int swipeGesture);
     virtual void createShortcuts();
 
+    void applyManipulatorFull(QSharedPointer<DkBaseManipulator> mpl);
+    void previewManipulator(QSharedPointer<DkBaseManipulatorExt> mplExt);
+    void clearManipulatorPreview();
+    QImage manipulatorSource(QSharedPointer<DkBaseManipulatorExt> mplExt) const;
     void drawPolygon(QPainter &painter, const QPolygon &polygon);
     void drawBackground(QPainter &painter) override;
     void updateImageMatrix() override;
@@ -2195,6 +2195,8 @@ void DkHistogram::loadSettings()
  **/
 void DkHistogram::drawHistogram(QImage imgQt)
 {
+    DK_TRACE_SCOPE("drawHistogram");
+
     if (!isVisible() || imgQt.isNull()) {
         setPainted(false);
         return;
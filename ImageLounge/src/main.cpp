@@ -79,6 +79,70 @@
 #include <shlobj.h>
 #endif
 
+static void addBatchOptions(QCommandLineParser &parser)
+{
+    parser.addOption(QCommandLineOption(QStringList() << "batch", QObject::tr("Batch processing of <batch-settings.pnm>."), QObject::tr("batch-settings-path")));
+    parser.addOption(QCommandLineOption(QStringList() << "batch-log", QObject::tr("Saves batch log to <log-path.txt>."), QObject::tr("log-path.txt")));
+    parser.addOption(QCommandLineOption(QStringList() << "batch-json", QObject::tr("Runs the batch without UI and prints JSON lines progress.")));
+    parser.addOption(QCommandLineOption(QStringList() << "batch-shard",
+                                        QObject::tr("Processes only every n-th image of the batch, starting at image i."),
+                                        QObject::tr("i/n")));
+}
+
+// parses --batch-shard <i/n>, returns false if the shard is invalid
+static bool parseBatchShard(const QCommandLineParser &parser, int &shardIdx, int &numShards)
+{
+    shardIdx = 0;
+    numShards = 1;
+
+    if (!parser.isSet("batch-shard"))
+        return true;
+
+    QStringList shard = parser.value("batch-shard").split("/");
+    bool idxOk = false, numOk = false;
+
+    if (shard.size() == 2) {
+        shardIdx = shard[0].toInt(&idxOk);
+        numShards = shard[1].toInt(&numOk);
+    }
+
+    if (!idxOk || !numOk || numShards < 1 || shardIdx < 0 || shardIdx >= numShards) {
+        qCritical() << "invalid shard, expected <i/n> with 0 <= i < n:" << parser.value("batch-shard");
+        return false;
+    }
+
+    return true;
+}
+
+// runs a batch profile without showing any widgets (e.g. in containers without a display)
+static int runHeadlessBatch(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    // plugins might create widgets (and DkUtils::getMainWindow() expects a QApplication)
+    QApplication app(argc, argv);
+    QImageReader::setAllocationLimit(2048);
+
+    nmc::DkSettingsManager::instance().init();
+    nmc::DkMetaDataHelper::initialize();
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    addBatchOptions(parser);
+    parser.process(app);
+
+    int shardIdx = 0;
+    int numShards = 1;
+
+    if (!parseBatchShard(parser, shardIdx, numShards))
+        return 2;
+
+    nmc::DkPluginManager::createPluginsPath();
+
+    return nmc::DkBatchProcessing::computeBatchHeadless(parser.value("batch"), parser.value("batch-log"), shardIdx, numShards);
+}
+
 #ifdef _MSC_BUILD
 int main(int argc, wchar_t *argv[])
 {
@@ -95,6 +159,16 @@ int main(int argc, char *argv[])
     QApplication::setAttribute(Qt::AA_DontShowIconsInMenus, true);
 #endif
 
+    // headless batch processing runs on the offscreen platform
+    for (int idx = 1; idx < argc; idx++) {
+#ifdef _MSC_BUILD
+        if (QString::fromWCharArray(argv[idx]) == "--batch-json")
+#else
+        if (QString::fromLocal8Bit(argv[idx]) == "--batch-json")
+#endif
+            return runHeadlessBatch(argc, (char **)argv);
+    }
+
     QApplication app(argc, (char **)argv);
 
 #ifdef Q_OS_LINUX
@@ -158,11 +232,7 @@ int main(int argc, char *argv[])
                               QObject::tr("images"));
     parser.addOption(tabOpt);
 
-    QCommandLineOption batchOpt(QStringList() << "batch", QObject::tr("Batch processing of <batch-settings.pnm>."), QObject::tr("batch-settings-path"));
-    parser.addOption(batchOpt);
-
-    QCommandLineOption batchLogOpt(QStringList() << "batch-log", QObject::tr("Saves batch log to <log-path.txt>."), QObject::tr("log-path.txt"));
-    parser.addOption(batchLogOpt);
+    addBatchOptions(parser);
 
     QCommandLineOption importSettingsOpt(QStringList() << "import-settings",
                                          QObject::tr("Imports the settings from <settings-path.ini> and saves them."),
@@ -185,13 +255,19 @@ int main(int argc, char *argv[])
     nmc::DkPluginManager::createPluginsPath();
 
     // compute batch process
-    if (!parser.value(batchOpt).isEmpty()) {
+    if (!parser.value("batch").isEmpty()) {
         QString logPath;
-        if (!parser.value(batchLogOpt).isEmpty())
-            logPath = parser.value(batchLogOpt);
+        if (!parser.value("batch-log").isEmpty())
+            logPath = parser.value("batch-log");
+
+        int shardIdx = 0;
+        int numShards = 1;
+
+        if (!parseBatchShard(parser, shardIdx, numShards))
+            return 2;
 
-        QString batchSettingsPath = parser.value(batchOpt);
-        nmc::DkBatchProcessing::computeBatch(batchSettingsPath, logPath);
+        QString batchSettingsPath = parser.value("batch");
+        nmc::DkBatchProcessing::computeBatch(batchSettingsPath, logPath, shardIdx, numShards);
 
         return 0;
     }